@@ -0,0 +1,37 @@
+/*
+ * Batched generation of A5/x keystreams
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* number of frames whose keystream is generated at once */
+#define A5_KS_LANES	64
+
+/* Keystream of up to A5_KS_LANES frames, for one direction.  The keystream
+ * bits are stored bit-sliced: bit i of the keystream of lane j is bit j of
+ * ks[i]. */
+struct a5_ks_cache {
+	int algo;			/* A5/x, 0 if not yet generated */
+	uint8_t key[8];
+	unsigned int num;		/* lanes in use */
+	unsigned int pos;		/* next lane to look at */
+	uint32_t fn[A5_KS_LANES];	/* fn of each lane, ascending */
+	uint64_t ks[114];
+};
+
+void a5_ks_init(void);
+int a5_ks_bitsliced(void);
+void a5_ks_gen(int algo, const uint8_t *key, const uint32_t *fn,
+	       unsigned int num, int ul, uint64_t *ks);
+void a5_ks_fill(struct a5_ks_cache *c, int algo, const uint8_t *key,
+		const uint32_t *fn, unsigned int num, int ul);
+int a5_ks_lookup(struct a5_ks_cache *c, int algo, const uint8_t *key,
+		 uint32_t fn);
+
+/* get keystream bit i of given lane */
+static inline uint8_t a5_ks_bit(const struct a5_ks_cache *c, int lane, int i)
+{
+	return (c->ks[i] >> lane) & 1;
+}
@@ -8,9 +8,12 @@
 
 /* incoming SMS broadcast command from RSL */
 int bts_process_smscb_cmd(struct gsm_bts *bts,
-			  struct rsl_ie_cb_cmd_type cmd_type,
+			  struct rsl_ie_cb_cmd_type cmd_type, int extended,
 			  uint8_t msg_len, const uint8_t *msg);
 
 /* call-back from bts model specific code when it wants to obtain a CBCH
  * block for a given gsm_time.  outbuf must have 23 bytes of space. */
 int bts_cbch_get(struct gsm_bts *bts, uint8_t *outbuf, struct gsm_time *g_time);
+
+/* start with NULL messages on both the basic and extended CBCH */
+void bts_cbch_init(struct gsm_bts *bts);
@@ -0,0 +1,56 @@
+/*
+ * Downlink TCH jitter ring of a logical channel
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct gsm_lchan;
+
+/* number of speech frames held per lchan, a power of two */
+#define DL_TCH_RING_SLOTS	8
+/* largest payload: FR and AMR 12.2 (with CMR and ToC) are 33 octets */
+#define DL_TCH_RING_MAX_LEN	64
+/* RTP timestamp increment of one speech frame, as GSM_RTP_DURATION */
+#define DL_TCH_RING_TS_STEP	160
+/* lost frames in a row that are replaced by the previous frame */
+#define DL_TCH_RING_MAX_CONCEAL	1
+
+struct dl_tch_slot {
+	uint32_t ts;			/* playout timestamp */
+	uint8_t len;			/* 0 if the slot is empty */
+	uint8_t data[DL_TCH_RING_MAX_LEN];
+};
+
+struct dl_tch_ring_stats {
+	uint32_t rx;			/* frames written into the ring */
+	uint32_t tx;			/* frames played out */
+	uint32_t late;			/* arrived after their playout time */
+	uint32_t dup;			/* replaced a frame of the same time */
+	uint32_t stale;			/* overwritten before playout */
+	uint32_t oversize;		/* too large for a slot */
+	uint32_t concealed;		/* lost frames replaced by the previous */
+	uint32_t underrun;		/* nothing to play out */
+};
+
+/* The slot of a frame is given by its playout timestamp, so frames are
+ * played out in timestamp order, whatever order they were written in.
+ * Played out frames stay in their slot until it is reused, which allows
+ * repeating the previous frame without copying it. */
+struct dl_tch_ring {
+	struct dl_tch_slot slots[DL_TCH_RING_SLOTS];
+	uint32_t next_ts;		/* timestamp of the next playout */
+	int started;			/* next_ts is valid */
+	unsigned int lost;		/* frames lost in a row */
+	struct dl_tch_ring_stats stats;
+};
+
+void dl_tch_ring_init(struct dl_tch_ring *r);
+int dl_tch_ring_put(struct dl_tch_ring *r, uint32_t ts, const uint8_t *data,
+		    unsigned int len);
+const uint8_t *dl_tch_ring_pop(struct dl_tch_ring *r, uint32_t ts,
+			       int conceal, unsigned int *len);
+
+struct dl_tch_ring *lchan_dl_tch_ring(struct gsm_lchan *lchan, int create);
+void lchan_dl_tch_ring_reset(struct gsm_lchan *lchan);
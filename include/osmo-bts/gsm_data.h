@@ -22,10 +22,62 @@
 #define GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE 999999
 #define GSM_BTS_AGCH_QUEUE_LOW_LEVEL_DEFAULT 41
 #define GSM_BTS_AGCH_QUEUE_HIGH_LEVEL_DEFAULT 91
+/* request references of IMM ASS REJ held back, a power of two */
+#define GSM_BTS_AGCH_REJ_REFS 1024
+/* pending rejects get at least one of this many AGCH blocks */
+#define GSM_BTS_AGCH_REJ_SHARE 4
+
+/* AGCH queues of messages, in order of transmission.  IMMEDIATE ASSIGN
+ * REJECT is not queued as messages, see struct gsm_bts_agch_rej. */
+enum gsm_bts_agch_prio {
+	AGCH_PRIO_IMM_ASS,
+	AGCH_PRIO_IMM_ASS_EXT,
+	_NUM_AGCH_PRIO
+};
+
+/* request reference waiting to be sent in an IMMEDIATE ASSIGN REJECT */
+struct gsm_bts_agch_rej {
+	struct gsm48_req_ref req_ref;
+	uint8_t wait_ind;
+	uint8_t page_mode;
+};
+
+/* Demand on the CCCH and what the scheduler did with its blocks.  Rates
+ * are moving averages per 51-multiframe, in 1/256. */
+struct gsm_bts_ccch_sched {
+	uint32_t mf;			/* multiframe being accounted */
+	/* within the current multiframe */
+	unsigned int pag_arrivals;
+	unsigned int agch_arrivals;
+	unsigned int ag_blocks;		/* AGCH reserved blocks */
+	unsigned int blocks;
+	unsigned int blocks_used;
+	/* predictions */
+	int pag_rate256;
+	int agch_rate256;
+	int ag_blocks256;
+	int util256;			/* used blocks per block */
+	/* decisions */
+	uint64_t pag_deferred;		/* paging repeat deferred for AGCH */
+	uint64_t blocks_total;
+	uint64_t blocks_used_total;
+};
 
-struct pcu_sock_state;
 struct smscb_msg;
 
+/* SMS-CB state of one CBCH, see cbch.c */
+struct bts_smscb_state {
+	struct llist_head queue;	/* list of struct smscb_msg */
+	unsigned int queue_len;
+	struct smscb_msg *cur_msg;	/* current SMS-CB */
+	struct smscb_msg *default_msg;	/* sent while the queue is empty */
+	/* blocks to send in the current four multiframes */
+	const uint8_t *sched[4];
+};
+
+struct pcu_sock_state;
+struct dl_tch_ring;
+
 struct gsm_network {
 	struct llist_head bts_list;
 	unsigned int num_bts;
@@ -67,8 +119,13 @@ struct gsm_bts_role_bts {
 	uint8_t max_ta;
 
 	/* AGCH queuing */
-	struct llist_head agch_queue;
-	int agch_queue_length;
+	struct llist_head agch_queue[_NUM_AGCH_PRIO];
+	/* ring of pending rejects, sent four per IMM ASS REJ */
+	struct gsm_bts_agch_rej agch_rej[GSM_BTS_AGCH_REJ_REFS];
+	unsigned int agch_rej_head;	/* oldest pending reject */
+	unsigned int agch_rej_num;	/* number of pending rejects */
+	unsigned int agch_rej_skipped;	/* messages sent before rejects */
+	int agch_queue_length;		/* in CCCH blocks */
 	int agch_max_queue_length;
 
 	int agch_queue_thresh_level;	/* Cleanup threshold in percent of max len */
@@ -82,10 +139,18 @@ struct gsm_bts_role_bts {
 	uint64_t agch_queue_agch_msgs;
 	uint64_t agch_queue_pch_msgs;
 
+	struct gsm_bts_ccch_sched ccch_sched;
+
 	struct paging_state *paging_state;
 	char *bsc_oml_host;
 	struct llist_head oml_queue;
 	unsigned int rtp_jitter_buf_ms;
+	/* downlink speech frames per lchan, see dl_tch_ring.c */
+	struct dl_tch_ring **dl_tch_rings;
+	unsigned int num_dl_tch_rings;
+	/* uplink measurement sums per lchan, see measurement.c */
+	struct ul_meas_acc *ul_meas_acc;
+	unsigned int num_ul_meas_acc;
 	struct {
 		uint8_t ciphers;	/* flags A5/1==0x1, A5/2==0x2, A5/3==0x4 */
 	} support;
@@ -100,10 +165,9 @@ struct gsm_bts_role_bts {
 	/* used by the sysmoBTS to adjust band */
 	uint8_t auto_band;
 
-	struct {
-		struct llist_head queue;	/* list of struct smscb_msg */
-		struct smscb_msg *cur_msg;	/* current SMS-CB */
-	} smscb_state;
+	/* basic and extended CBCH */
+	struct bts_smscb_state smscb_basic;
+	struct bts_smscb_state smscb_extended;
 
 	float min_qual_rach;	/* minimum quality for RACH bursts */
 	float min_qual_norm;	/* minimum quality for normal daata */
@@ -0,0 +1,71 @@
+/*
+ * Rate limited GSMTAP export through a ring and a sender thread
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* number of slots of the ring of the BTS, a power of two */
+#define GSMTAP_RING_SLOTS	1024
+/* one slot holds a complete datagram: GSMTAP header and payload */
+#define GSMTAP_RING_SLOT_SIZE	256
+/* the sender thread drains the ring about once per TDMA frame */
+#define GSMTAP_RING_POLL_US	5000
+/* datagrams handed to the kernel with one system call */
+#define GSMTAP_RING_BATCH	32
+
+struct udp_batch;
+
+struct gsmtap_ring_stats {
+	/* main loop */
+	uint32_t queued;		/* datagrams written into the ring */
+	uint32_t full;			/* dropped, the ring was full */
+	uint32_t rate_limited;		/* dropped by the rate limit */
+	uint32_t oversize;		/* dropped, too large for a slot */
+	/* sender thread */
+	uint32_t sent;			/* datagrams sent */
+	uint32_t tx_errors;		/* datagrams lost on send errors */
+	uint32_t syscalls;		/* calls to sendmmsg() / send() */
+	uint32_t max_fill;		/* highest number of slots in use */
+};
+
+/* A single-producer / single-consumer ring of fixed size slots.  Only the
+ * main loop writes head, only the sender thread writes tail. */
+struct gsmtap_ring {
+	unsigned int num_slots;		/* power of two */
+	uint8_t *buf;
+	uint16_t *len;			/* length of the datagram of each slot */
+
+	unsigned int head;		/* next slot to fill */
+	unsigned int tail;		/* next slot to send */
+
+	/* rate limit, as a token bucket in its GCRA form */
+	unsigned int rate;		/* datagrams per second, 0 for none */
+	unsigned int burst;		/* datagrams sent at once */
+	uint64_t interval_ns;		/* time of one token */
+	uint64_t tau_ns;		/* depth of the bucket */
+	uint64_t tat_ns;		/* theoretical arrival time */
+
+	/* sender thread */
+	pthread_t thread;
+	int running;
+	int stop;
+	int fd;
+	struct udp_batch *batch;
+
+	struct gsmtap_ring_stats stats;
+	uint32_t drops_reported;
+};
+
+struct gsmtap_ring *gsmtap_ring_alloc(void *ctx, unsigned int num_slots);
+void gsmtap_ring_free(struct gsmtap_ring *r);
+void gsmtap_ring_set_rate(struct gsmtap_ring *r, unsigned int rate,
+			  unsigned int burst);
+int gsmtap_ring_enqueue(struct gsmtap_ring *r, uint16_t arfcn, uint8_t ts,
+			uint8_t chan_type, uint8_t ss, uint32_t fn,
+			int8_t signal_dbm, uint8_t snr,
+			const uint8_t *data, unsigned int len);
+int gsmtap_ring_start(struct gsmtap_ring *r, int fd);
+void gsmtap_ring_stop(struct gsmtap_ring *r);
@@ -65,6 +65,8 @@ extern const struct value_string gsmtap_sapi_names[];
 extern struct gsmtap_inst *gsmtap;
 extern uint32_t gsmtap_sapi_mask;
 extern uint8_t gsmtap_sapi_acch;
+extern struct gsmtap_ring *gsmtap_ring;
+extern unsigned int gsmtap_rate_limit;
 
 int add_l1sap_header(struct gsm_bts_trx *trx, struct msgb *rmsg,
 		     struct gsm_lchan *lchan, uint8_t chan_nr, uint32_t fn);
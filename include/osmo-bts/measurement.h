@@ -1,6 +1,19 @@
 #ifndef OSMO_BTS_MEAS_H
 #define OSMO_BTS_MEAS_H
 
+#include <stdint.h>
+
+/* running sums of the uplink measurements of an lchan in the current
+ * measurement period, the number of them is lchan->meas.num_ul_meas */
+struct ul_meas_acc {
+	uint32_t ber_full_sum;
+	uint32_t irssi_full_sum;
+	uint32_t ber_sub_sum;
+	uint32_t irssi_sub_sum;
+	int32_t taqb_sum;
+	unsigned int num_sub;
+};
+
 int lchan_new_ul_meas(struct gsm_lchan *lchan, struct bts_ul_meas *ulm);
 
 int trx_meas_check_compute(struct gsm_bts_trx *trx, uint32_t fn);
@@ -39,6 +39,15 @@ int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 int paging_add_imm_ass(struct paging_state *ps, const uint8_t *data,
                        uint8_t len);
 
+/* what is waiting for the paging block of given gsm time */
+enum paging_pending {
+	PAGING_PENDING_NONE,
+	PAGING_PENDING_REPEAT,	/* only records that were paged already */
+	PAGING_PENDING_NEW,
+};
+enum paging_pending paging_block_pending(struct paging_state *ps,
+					 struct gsm_time *gt);
+
 /* generate paging message for given gsm time */
 int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *gt,
 		   int *is_empty);
@@ -48,5 +57,10 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 int paging_group_queue_empty(struct paging_state *ps, uint8_t group);
 int paging_queue_length(struct paging_state *ps);
 int paging_buffer_space(struct paging_state *ps);
+unsigned int paging_group_occupancy(struct paging_state *ps, uint8_t group);
+unsigned int paging_busiest_group(struct paging_state *ps,
+				  unsigned int *occupancy);
+unsigned int paging_get_duplicates(struct paging_state *ps);
+unsigned int paging_get_expired(struct paging_state *ps);
 
 #endif
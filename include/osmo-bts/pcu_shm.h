@@ -0,0 +1,43 @@
+/*
+ * Shared memory transport of the PCU interface, BTS side
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <osmocom/core/select.h>
+
+#include <osmo-bts/pcuif_proto.h>
+
+struct pcu_shm;
+
+/*! \brief called for every record received from the PCU */
+typedef int pcu_shm_rx_cb(struct pcu_shm *shm, struct gsm_pcu_if *pcu_prim);
+
+struct pcu_shm_stats {
+	uint32_t tx;			/* records sent to the PCU */
+	uint32_t rx;			/* records received from the PCU */
+	uint32_t tx_full;		/* ring to the PCU was full */
+	uint32_t doorbells;		/* doorbells rung for the PCU */
+};
+
+struct pcu_shm {
+	int mem_fd;
+	struct gsm_pcu_if_shm *mem;
+	int to_pcu_fd;			/* eventfd: records for the PCU */
+	struct osmo_fd from_pcu_ofd;	/* eventfd: records from the PCU */
+
+	pcu_shm_rx_cb *rx_cb;
+	void *data;
+
+	struct pcu_shm_stats stats;
+};
+
+struct pcu_shm *pcu_shm_alloc(void *ctx);
+void pcu_shm_free(struct pcu_shm *shm);
+int pcu_shm_start(struct pcu_shm *shm, pcu_shm_rx_cb *rx_cb, void *data);
+
+struct gsm_pcu_if *pcu_shm_tx_slot(struct pcu_shm *shm);
+void pcu_shm_tx_commit(struct pcu_shm *shm);
+int pcu_shm_rx(struct pcu_shm *shm);
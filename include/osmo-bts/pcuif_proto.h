@@ -12,7 +12,11 @@
 #define PCU_IF_MSG_INFO_IND	0x32	/* retrieve BTS info */
 #define PCU_IF_MSG_ACT_REQ	0x40	/* activate/deactivate PDCH */
 #define PCU_IF_MSG_TIME_IND	0x52	/* GSM time indication */
+#define PCU_IF_MSG_FN_IND	0x54	/* GSM time and RTS of one frame */
 #define PCU_IF_MSG_PAG_REQ	0x60	/* paging request */
+#define PCU_IF_MSG_SHM_REQ	0x70	/* use shared memory transport */
+#define PCU_IF_MSG_SHM_CNF	0x71	/* shared memory and doorbells */
+#define PCU_IF_MSG_FEAT_REQ	0x80	/* select offered features */
 
 /* sapi */
 #define PCU_IF_SAPI_RACH	0x01	/* channel request on CCCH */
@@ -26,6 +30,8 @@
 /* flags */
 #define PCU_IF_FLAG_ACTIVE	(1 << 0)/* BTS is active */
 #define PCU_IF_FLAG_SYSMO	(1 << 1)/* access PDCH of sysmoBTS directly */
+#define PCU_IF_FLAG_SHM		(1 << 2)/* shared memory transport offered */
+#define PCU_IF_FLAG_FN_IND	(1 << 3)/* FN.ind offered */
 #define PCU_IF_FLAG_CS1		(1 << 16)
 #define PCU_IF_FLAG_CS2		(1 << 17)
 #define PCU_IF_FLAG_CS3		(1 << 18)
@@ -125,12 +131,61 @@ struct gsm_pcu_if_time_ind {
 	uint32_t	fn;
 } __attribute__ ((packed));
 
+/* one RTS.req of an FN.ind */
+struct gsm_pcu_if_fn_rts {
+	uint8_t		sapi;
+	uint8_t		trx_nr;
+	uint8_t		ts_nr;
+	uint8_t		block_nr;
+	uint16_t	arfcn;
+} __attribute__ ((packed));
+
+#define PCU_IF_FN_IND_MAX_RTS	64	/* 8 TRX with 8 PDCH each */
+#define PCU_IF_FN_IND_F_TIME	(1 << 0)/* time_fn is valid */
+
+/* Replaces TIME.ind and RTS.req once the PCU has selected
+ * PCU_IF_FLAG_FN_IND: the time indication and the RTS.req of one frame
+ * number, as far as they are available at the same time.  On the socket,
+ * only the first num_rts entries of rts[] are sent, see PCU_IF_FN_IND_LEN. */
+struct gsm_pcu_if_fn_ind {
+	uint8_t		flags;
+	uint8_t		num_rts;
+	uint8_t		spare[2];
+	uint32_t	time_fn;		/* as in TIME.ind */
+	uint32_t	rts_fn;			/* frame of all rts[] */
+	struct gsm_pcu_if_fn_rts rts[PCU_IF_FN_IND_MAX_RTS];
+} __attribute__ ((packed));
+
+/* length of a struct gsm_pcu_if carrying an FN.ind with n RTS.req */
+#define PCU_IF_FN_IND_LEN(n) \
+	(offsetof(struct gsm_pcu_if, u.fn_ind.rts) \
+	 + (n) * sizeof(struct gsm_pcu_if_fn_rts))
+
+/* sent by the PCU to select any of the PCU_IF_FLAG_* features offered in
+ * INFO.ind, except PCU_IF_FLAG_SHM, which has its own request */
+struct gsm_pcu_if_feat_req {
+	uint32_t	flags;
+} __attribute__ ((packed));
+
 struct gsm_pcu_if_pag_req {
 	uint8_t		sapi;
 	uint8_t		chan_needed;
 	uint8_t		identity_lv[9];
 } __attribute__ ((packed));
 
+/* sent by the PCU in reply to an INFO.ind with PCU_IF_FLAG_SHM */
+struct gsm_pcu_if_shm_req {
+	uint32_t	version;		/* PCU_IF_SHM_VERSION */
+} __attribute__ ((packed));
+
+/* sent by the BTS with three file descriptors (SCM_RIGHTS): the shared
+ * memory, the doorbell of the PCU and the doorbell of the BTS */
+struct gsm_pcu_if_shm_cnf {
+	uint32_t	version;		/* PCU_IF_SHM_VERSION */
+	uint32_t	size;			/* of struct gsm_pcu_if_shm */
+	uint32_t	num_slots;		/* records per ring */
+} __attribute__ ((packed));
+
 struct gsm_pcu_if {
 	/* context based information */
 	uint8_t		msg_type;	/* message type */
@@ -146,8 +201,49 @@ struct gsm_pcu_if {
 		struct gsm_pcu_if_info_ind	info_ind;
 		struct gsm_pcu_if_act_req	act_req;
 		struct gsm_pcu_if_time_ind	time_ind;
+		struct gsm_pcu_if_fn_ind	fn_ind;
+		struct gsm_pcu_if_feat_req	feat_req;
 		struct gsm_pcu_if_pag_req	pag_req;
+		struct gsm_pcu_if_shm_req	shm_req;
+		struct gsm_pcu_if_shm_cnf	shm_cnf;
 	} u;
 } __attribute__ ((packed));
 
+/*
+ * Shared memory transport
+ *
+ * Once the BTS has sent SHM.cnf, any message but SHM.req may be sent as a
+ * record of a ring in the shared memory instead of on the socket.  Each
+ * ring has a single producer, which writes a record at head and then
+ * increments head, and a single consumer, which reads the record at tail
+ * and then increments tail.  head and tail are free running.
+ *
+ * Before it waits for its doorbell (an eventfd), the consumer sets wait and
+ * checks head again.  After incrementing head, the producer checks wait,
+ * clears it and writes the doorbell.  So only the first record after the
+ * consumer has gone to sleep costs a system call.
+ */
+
+#define PCU_IF_SHM_VERSION	1
+#define PCU_IF_SHM_SLOTS	256	/* power of two */
+
+struct gsm_pcu_if_shm_ring {
+	/* written by the producer */
+	uint32_t	head;
+	uint8_t		spare1[60];
+	/* written by the consumer */
+	uint32_t	tail;
+	uint32_t	wait;
+	uint8_t		spare2[56];
+	struct gsm_pcu_if rec[PCU_IF_SHM_SLOTS];
+};
+
+struct gsm_pcu_if_shm {
+	uint32_t	version;		/* PCU_IF_SHM_VERSION */
+	uint32_t	num_slots;		/* PCU_IF_SHM_SLOTS */
+	uint8_t		spare[56];
+	struct gsm_pcu_if_shm_ring to_pcu;
+	struct gsm_pcu_if_shm_ring from_pcu;
+};
+
 #endif /* _PCUIF_PROTO_H */
@@ -32,6 +32,12 @@ struct phy_link {
 	enum phy_link_state state;
 	struct llist_head instances;
 	char *description;
+
+	/* receive L1 primitives on a separate thread (sysmoBTS, Litecell15,
+	 * OCTPHY), with SCHED_FIFO priority if l1_rx_prio > 0 */
+	int l1_rx_thread;
+	int l1_rx_prio;
+
 	union {
 		struct {
 		} sysmobts;
@@ -52,6 +58,9 @@ struct phy_link {
 			int	power;
 			int	power_oml;
 			int	power_sent;
+
+			int	ul_decode_threads;
+			int	tx_packed;	/* send DL bursts as packed bits */
 		} osmotrx;
 		struct {
 			/* MAC address of the PHY */
@@ -63,6 +72,8 @@ struct phy_link {
 			uint32_t rf_port_index;
 			uint32_t rx_gain_db;
 			uint32_t tx_atten_db;
+			/* commands sent before waiting for a response */
+			uint32_t cmd_window;
 			/* arfcn used by TRX with id 0 */
 			uint16_t center_arfcn;
 			struct octphy_hdl *hdl;
@@ -0,0 +1,91 @@
+/*
+ * Lock-free ring for handing L1 primitives from a receive thread to the
+ * main loop
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <osmocom/core/select.h>
+
+#define PRIM_RING_MAX_FDS	4
+
+struct prim_ring;
+
+/*! \brief called on the receive thread when fd is readable
+ *
+ * Reads from fd into the free slots returned by prim_ring_slot_buf() and
+ * publishes them with prim_ring_produce().  Must not allocate from talloc,
+ * log or touch any other state of the main loop.
+ *  \returns number of slots produced, or negative errno */
+typedef int prim_ring_rx_cb(struct prim_ring *r, int fd, int tag);
+
+/*! \brief called from the main loop for every received primitive */
+typedef void prim_ring_dispatch_cb(struct prim_ring *r, const uint8_t *data,
+				   unsigned int len, int tag);
+
+struct prim_ring_slot {
+	unsigned int len;
+	int tag;
+};
+
+struct prim_ring_stats {
+	uint32_t produced;		/* slots filled by the receive thread */
+	uint32_t dispatched;		/* slots handed to the main loop */
+	uint32_t full;			/* receive thread waited for space */
+	uint32_t rx_errors;		/* rx_cb returned an error */
+	uint32_t max_fill;		/* highest number of slots in use */
+};
+
+/* A single-producer / single-consumer ring of fixed size slots.  Only the
+ * receive thread writes head, only the main loop writes tail. */
+struct prim_ring {
+	unsigned int num_slots;		/* power of two */
+	unsigned int slot_size;
+	uint8_t *buf;
+	struct prim_ring_slot *slots;
+
+	unsigned int head;		/* next slot to fill */
+	unsigned int tail;		/* next slot to dispatch */
+	int space_wait;			/* receive thread waits for space */
+
+	/* receive thread */
+	pthread_t thread;
+	int running;
+	int stop;
+	int rt_prio;			/* SCHED_FIFO priority, 0 for none */
+	int fds[PRIM_RING_MAX_FDS];
+	int tags[PRIM_RING_MAX_FDS];
+	unsigned int num_fds;
+	int wake_fd;			/* eventfd: space in ring or stop */
+	struct osmo_fd doorbell;	/* eventfd: slots to dispatch */
+
+	prim_ring_rx_cb *rx_cb;
+	prim_ring_dispatch_cb *dispatch_cb;
+	void *data;
+
+	struct prim_ring_stats stats;
+	uint32_t full_reported;
+};
+
+struct prim_ring *prim_ring_alloc(void *ctx, unsigned int num_slots,
+				  unsigned int slot_size);
+void prim_ring_free(struct prim_ring *r);
+int prim_ring_add_fd(struct prim_ring *r, int fd, int tag);
+int prim_ring_start(struct prim_ring *r, prim_ring_rx_cb *rx_cb,
+		    prim_ring_dispatch_cb *dispatch_cb, void *data,
+		    int rt_prio);
+void prim_ring_stop(struct prim_ring *r);
+
+/* producer side, receive thread only */
+unsigned int prim_ring_space(struct prim_ring *r);
+uint8_t *prim_ring_slot_buf(struct prim_ring *r, unsigned int i);
+void prim_ring_produce(struct prim_ring *r, unsigned int len, int tag);
+
+/* consumer side, main loop only */
+const uint8_t *prim_ring_peek(struct prim_ring *r, unsigned int *len,
+			      int *tag);
+void prim_ring_consume(struct prim_ring *r);
+int prim_ring_drain(struct prim_ring *r);
@@ -2,6 +2,7 @@
 #define TRX_SCHEDULER_H
 
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/a5_ks.h>
 
 /* These types define the different channels on a multiframe.
  * Each channel has queues and can be activated individually.
@@ -56,6 +57,8 @@ struct l1sched_chan_state {
 	sbit_t			*ul_bursts;	/* burst buffer for RX */
 	uint32_t		ul_first_fn;	/* fn of first burst */
 	uint8_t			ul_mask;	/* mask of received bursts */
+	uint8_t			ul_sacch_bad;	/* last SACCH block failed, it is
+						 * kept behind the burst buffer */
 
 	/* RSSI / TOA */
 	uint8_t			rssi_num;	/* number of RSSI values */
@@ -91,6 +94,8 @@ struct l1sched_chan_state {
 	int			dl_encr_key_len;
 	uint8_t			ul_encr_key[MAX_A5_KEY_LEN];
 	uint8_t			dl_encr_key[MAX_A5_KEY_LEN];
+	struct a5_ks_cache	*ul_ks;		/* keystreams of next frames */
+	struct a5_ks_cache	*dl_ks;
 
 	/* measurements */
 	struct {
@@ -107,25 +112,83 @@ struct l1sched_chan_state {
 	uint8_t			ho_rach_detect;	/* if rach detection is on */
 };
 
+struct l1sched_trx;
+
+typedef int trx_sched_rts_func(struct l1sched_trx *l1t, uint8_t tn,
+			       uint32_t fn, enum trx_chan_type chan);
+
+typedef ubit_t *trx_sched_dl_func(struct l1sched_trx *l1t, uint8_t tn,
+				  uint32_t fn, enum trx_chan_type chan,
+				  uint8_t bid);
+
+typedef int trx_sched_ul_func(struct l1sched_trx *l1t, uint8_t tn,
+			      uint32_t fn, enum trx_chan_type chan,
+			      uint8_t bid, sbit_t *bits, int8_t rssi,
+			      float toa);
+
+/* longest multiframe period */
+#define TRX_SCHED_MAX_PERIOD	104
+
+/* burst buffers in the slab of a TRX start on a cache line */
+#define TRX_SCHED_BURSTS_ALIGN	64
+
+/* one frame of a multiframe, compiled from the frame layout and the state
+ * of the logical channels.  The handlers of inactive channels are NULL. */
+struct l1sched_slot {
+	trx_sched_rts_func	*rts_fn;	/* only on the first burst */
+	trx_sched_dl_func	*dl_fn;
+	trx_sched_ul_func	*ul_fn;
+	struct l1sched_chan_state *dl_cs;
+	struct l1sched_chan_state *ul_cs;
+	uint8_t			dl_chan, dl_bid;
+	uint8_t			dl_active;	/* DL channel is active */
+	uint8_t			ul_chan, ul_bid;
+};
+
+/* queue of primitives for TX of one logical channel, ordered by fn */
+struct l1sched_dl_queue {
+	struct llist_head	prims;		/* queued primitives */
+	unsigned int		depth;		/* number of queued primitives */
+	unsigned int		depth_max;	/* highest depth seen */
+	unsigned int		dropped;	/* primitives dropped as stale */
+};
+
 struct l1sched_ts {
 	uint8_t 		mf_index;	/* selected multiframe index */
 	uint32_t 		mf_last_fn;	/* last received frame number */
 	uint8_t			mf_period;	/* period of multiframe */
 	const struct trx_sched_frame *mf_frames; /* pointer to frame layout */
+	struct l1sched_slot	mf_slots[TRX_SCHED_MAX_PERIOD]; /* compiled */
 
-	struct llist_head	dl_prims;	/* Queue primitves for TX */
+	/* Queue primitives for TX, indexed by the channel owning the
+	 * chan_nr / link_id of the primitive, see trx_sched_dl_queue() */
+	struct l1sched_dl_queue	dl_queue[_TRX_CHAN_MAX];
 
 	/* Channel states for all logical channels */
 	struct l1sched_chan_state chan_state[_TRX_CHAN_MAX];
+
+	/* Burst buffers of all logical channels, in the slab of the TRX.
+	 * dl_bursts / ul_bursts of a channel state point to them while
+	 * the channel has bursts buffered. NULL if a channel has none. */
+	ubit_t			*dl_bursts_buf[_TRX_CHAN_MAX];
+	sbit_t			*ul_bursts_buf[_TRX_CHAN_MAX];
 };
 
 struct l1sched_trx {
 	struct gsm_bts_trx	*trx;
 	struct l1sched_ts       ts[TRX_NR_TS];
+
+	/* burst buffers of all timeslots, allocated once per TRX */
+	uint8_t			*bursts_slab;
+	size_t			bursts_slab_size;
 };
 
 struct l1sched_ts *l1sched_trx_get_ts(struct l1sched_trx *l1t, uint8_t tn);
 
+/*! \brief get the TX queue for primitives of given chan_nr / link_id */
+struct l1sched_dl_queue *trx_sched_dl_queue(struct l1sched_ts *l1ts,
+	uint8_t chan_nr, uint8_t link_id);
+
 /*! \brief how many frame numbers in advance we should send bursts to PHY */
 extern uint32_t trx_clock_advance;
 /*! \brief advance RTS.ind to L2 by that many clocks */
@@ -149,6 +212,9 @@ int trx_sched_tch_req(struct l1sched_trx *l1t, struct osmo_phsap_prim *l1sap);
 /*! \brief PHY informs us of new (current) GSM freme nunmber */
 int trx_sched_clock(struct gsm_bts *bts, uint32_t fn);
 
+/*! \brief number of logical channels with bursts buffered */
+unsigned int trx_sched_bursts_in_use(struct l1sched_trx *l1t);
+
 /*! \brief handle an UL burst received by PHY */
 int trx_sched_ul_burst(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
         sbit_t *bits, int8_t rssi, float toa);
@@ -1,17 +1,5 @@
 #pragma once
 
-typedef int trx_sched_rts_func(struct l1sched_trx *l1t, uint8_t tn,
-			       uint32_t fn, enum trx_chan_type chan);
-
-typedef ubit_t *trx_sched_dl_func(struct l1sched_trx *l1t, uint8_t tn,
-				  uint32_t fn, enum trx_chan_type chan,
-				  uint8_t bid);
-
-typedef int trx_sched_ul_func(struct l1sched_trx *l1t, uint8_t tn,
-			      uint32_t fn, enum trx_chan_type chan,
-			      uint8_t bid, sbit_t *bits, int8_t rssi,
-			      float toa);
-
 struct trx_chan_desc {
 	/*! \brief Is this on a PDCH (PS) ? */
 	int			pdch;
@@ -38,6 +26,11 @@ extern const ubit_t _sched_tsc[8][26];
 const ubit_t _sched_fcch_burst[148];
 const ubit_t _sched_sch_train[64];
 
+ubit_t *_sched_dl_bursts(struct l1sched_trx *l1t, uint8_t tn,
+			 enum trx_chan_type chan);
+sbit_t *_sched_ul_bursts(struct l1sched_trx *l1t, uint8_t tn,
+			 enum trx_chan_type chan);
+
 struct msgb *_sched_dequeue_prim(struct l1sched_trx *l1t, int8_t tn, uint32_t fn,
 				 enum trx_chan_type chan);
 
@@ -0,0 +1,53 @@
+/*
+ * Batching of datagrams with sendmmsg() / recvmmsg()
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/* A batch holds up to 'size' datagrams of at most 'buf_len' bytes each.
+ * On transmit, datagrams are queued with udp_batch_tx_buf() and
+ * udp_batch_tx_commit(), and udp_batch_send() hands all of them to the
+ * kernel at once.  On receive, udp_batch_recv() fetches all datagrams that
+ * are pending on the socket, up to 'size', with a single system call.
+ * A batch is used either for transmit or for receive, not both. */
+struct udp_batch {
+	unsigned int num;	/* queued or received datagrams */
+	unsigned int size;	/* maximum number of datagrams */
+	unsigned int buf_len;	/* maximum length of one datagram */
+	uint8_t *buf;
+	unsigned int *len;	/* length of each datagram */
+	struct iovec *iov;
+	struct mmsghdr *msg;	/* only with sendmmsg() / recvmmsg() */
+
+	/* destination on an unconnected socket, see udp_batch_set_dest() */
+	struct sockaddr_storage dest;
+	socklen_t dest_len;
+	/* source of the last received datagram */
+	struct sockaddr_storage src;
+	socklen_t src_len;
+
+	/* statistics */
+	unsigned long syscalls;
+	unsigned long datagrams;
+};
+
+struct udp_batch *udp_batch_alloc(void *ctx, unsigned int size,
+				  unsigned int buf_len);
+uint8_t *udp_batch_tx_buf(struct udp_batch *b);
+void udp_batch_tx_commit(struct udp_batch *b, unsigned int len);
+void udp_batch_set_dest(struct udp_batch *b, const struct sockaddr *sa,
+			socklen_t len);
+int udp_batch_send(struct udp_batch *b, int fd);
+int udp_batch_recv(struct udp_batch *b, int fd);
+
+/* get received datagram number i */
+static inline uint8_t *udp_batch_rx_buf(struct udp_batch *b, unsigned int i,
+					unsigned int *len)
+{
+	*len = b->len[i];
+	return b->buf + i * b->buf_len;
+}
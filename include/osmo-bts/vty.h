@@ -20,6 +20,10 @@ extern struct cmd_element ournode_end_cmd;
 extern struct cmd_element cfg_bts_auto_band_cmd;
 extern struct cmd_element cfg_bts_no_auto_band_cmd;
 
+extern struct cmd_element cfg_phy_l1_rx_thread_cmd;
+extern struct cmd_element cfg_phy_l1_rx_thread_rt_cmd;
+extern struct cmd_element cfg_phy_no_l1_rx_thread_cmd;
+
 struct phy_instance *vty_get_phy_instance(struct vty *vty, int phy_nr, int inst_nr);
 
 int bts_vty_go_parent(struct vty *vty);
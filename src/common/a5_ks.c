@@ -0,0 +1,261 @@
+/* Batched generation of A5/x keystreams */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Ciphering needs the keystream of every burst of a ciphered channel.
+ * Instead of running osmo_a5() for each burst, the keystreams of the next
+ * frames of a channel are generated in one batch of up to 64 frames.
+ *
+ * For A5/1, the batch is computed bit-sliced: every register bit is a
+ * 64 bit word holding that bit for all 64 frames, so one pass over the
+ * registers clocks all frames at once.  The majority clocking becomes a
+ * per-lane mask.  Other algorithms are generated by osmo_a5() frame by
+ * frame, but still ahead of time. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/a5.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/a5_ks.h>
+
+#define A5_R1_LEN	19
+#define A5_R2_LEN	22
+#define A5_R3_LEN	23
+
+/* bit-sliced A5/1 registers, bit 0 is the input of the register */
+struct a5_1_bs {
+	uint64_t r1[A5_R1_LEN];
+	uint64_t r2[A5_R2_LEN];
+	uint64_t r3[A5_R3_LEN];
+};
+
+static int bitsliced_ok;
+
+static uint32_t a5_fn_count(uint32_t fn)
+{
+	int t1 = fn / (26 * 51);
+	int t2 = fn % 26;
+	int t3 = fn % 51;
+	return (t1 << 11) | (t3 << 5) | t2;
+}
+
+/* shift register of given length, where mask selects the lanes to clock */
+static inline void a5_1_shift(uint64_t *r, int len, uint64_t fb, uint64_t mask)
+{
+	int i;
+
+	for (i = len - 1; i > 0; i--)
+		r[i] ^= (r[i] ^ r[i - 1]) & mask;
+	r[0] ^= (r[0] ^ fb) & mask;
+}
+
+static inline void a5_1_clock(struct a5_1_bs *s, uint64_t m1, uint64_t m2,
+			      uint64_t m3)
+{
+	/* x^19 + x^18 + x^17 + x^14 + 1 */
+	a5_1_shift(s->r1, A5_R1_LEN,
+		s->r1[13] ^ s->r1[16] ^ s->r1[17] ^ s->r1[18], m1);
+	/* x^22 + x^21 + 1 */
+	a5_1_shift(s->r2, A5_R2_LEN, s->r2[20] ^ s->r2[21], m2);
+	/* x^23 + x^22 + x^21 + x^8 + 1 */
+	a5_1_shift(s->r3, A5_R3_LEN,
+		s->r3[7] ^ s->r3[20] ^ s->r3[21] ^ s->r3[22], m3);
+}
+
+static inline void a5_1_clock_majority(struct a5_1_bs *s)
+{
+	uint64_t c1 = s->r1[8], c2 = s->r2[10], c3 = s->r3[10];
+	uint64_t maj = (c1 & c2) | (c1 & c3) | (c2 & c3);
+
+	a5_1_clock(s, ~(c1 ^ maj), ~(c2 ^ maj), ~(c3 ^ maj));
+}
+
+static inline void a5_1_xor_input(struct a5_1_bs *s, uint64_t b)
+{
+	s->r1[0] ^= b;
+	s->r2[0] ^= b;
+	s->r3[0] ^= b;
+}
+
+static inline uint64_t a5_1_output(const struct a5_1_bs *s)
+{
+	return s->r1[A5_R1_LEN - 1] ^ s->r2[A5_R2_LEN - 1]
+		^ s->r3[A5_R3_LEN - 1];
+}
+
+/* A5/1 for up to 64 frames at once, as in osmo_a5(1, ...) */
+static void a5_1_bitsliced(const uint8_t *key, const uint32_t *fn,
+			   unsigned int num, uint64_t *dl, uint64_t *ul)
+{
+	struct a5_1_bs s;
+	uint32_t count[A5_KS_LANES];
+	uint64_t b;
+	unsigned int j;
+	int i;
+
+	memset(&s, 0, sizeof(s));
+
+	/* the key is the same in all lanes, so the state after loading it is
+	 * too. load it in all lanes at once, with every word 0 or ~0. */
+	for (i = 0; i < 64; i++) {
+		b = (key[7 - (i >> 3)] >> (i & 7)) & 1;
+		a5_1_clock(&s, ~0ULL, ~0ULL, ~0ULL);
+		a5_1_xor_input(&s, -b);
+	}
+
+	for (j = 0; j < num; j++)
+		count[j] = a5_fn_count(fn[j]);
+	for (i = 0; i < 22; i++) {
+		b = 0;
+		for (j = 0; j < num; j++)
+			b |= (uint64_t)((count[j] >> i) & 1) << j;
+		a5_1_clock(&s, ~0ULL, ~0ULL, ~0ULL);
+		a5_1_xor_input(&s, b);
+	}
+
+	for (i = 0; i < 100; i++)
+		a5_1_clock_majority(&s);
+
+	for (i = 0; i < 114; i++) {
+		a5_1_clock_majority(&s);
+		if (dl)
+			dl[i] = a5_1_output(&s);
+	}
+	if (!ul)
+		return;
+	for (i = 0; i < 114; i++) {
+		a5_1_clock_majority(&s);
+		ul[i] = a5_1_output(&s);
+	}
+}
+
+/*! \brief check bit-sliced A5/1 against osmo_a5(), enable it if equal */
+void a5_ks_init(void)
+{
+	static const uint8_t key[8] = {
+		0x12, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+	uint32_t fn[A5_KS_LANES];
+	uint64_t dl[114], ul[114];
+	ubit_t ref_dl[114], ref_ul[114];
+	unsigned int j;
+	int i;
+
+	for (j = 0; j < A5_KS_LANES; j++)
+		fn[j] = (j * 1237 + 13) % GSM_HYPERFRAME;
+	a5_1_bitsliced(key, fn, A5_KS_LANES, dl, ul);
+
+	bitsliced_ok = 1;
+	for (j = 0; j < A5_KS_LANES; j += 7) {
+		osmo_a5(1, key, fn[j], ref_dl, ref_ul);
+		for (i = 0; i < 114; i++) {
+			if (((dl[i] >> j) & 1) != ref_dl[i]
+			 || ((ul[i] >> j) & 1) != ref_ul[i])
+				bitsliced_ok = 0;
+		}
+	}
+
+	if (!bitsliced_ok)
+		LOGP(DL1C, LOGL_ERROR, "Bit-sliced A5/1 does not match "
+			"osmo_a5(), using osmo_a5() instead\n");
+}
+
+int a5_ks_bitsliced(void)
+{
+	return bitsliced_ok;
+}
+
+/*! \brief generate the keystream of up to A5_KS_LANES frames
+ *  \param[in] algo A5/x algorithm
+ *  \param[in] key Kc
+ *  \param[in] fn frame number of each lane
+ *  \param[in] num number of lanes
+ *  \param[in] ul generate the uplink instead of the downlink keystream
+ *  \param[out] ks 114 words of bit-sliced keystream */
+void a5_ks_gen(int algo, const uint8_t *key, const uint32_t *fn,
+	       unsigned int num, int ul, uint64_t *ks)
+{
+	ubit_t bits[114];
+	unsigned int j;
+	int i;
+
+	OSMO_ASSERT(num <= A5_KS_LANES);
+
+	if (algo == 1 && bitsliced_ok) {
+		if (ul)
+			a5_1_bitsliced(key, fn, num, NULL, ks);
+		else
+			a5_1_bitsliced(key, fn, num, ks, NULL);
+		return;
+	}
+
+	memset(ks, 0, 114 * sizeof(*ks));
+	for (j = 0; j < num; j++) {
+		/* algorithms unknown to osmo_a5() leave the output as is */
+		memset(bits, 0, sizeof(bits));
+		if (ul)
+			osmo_a5(algo, key, fn[j], NULL, bits);
+		else
+			osmo_a5(algo, key, fn[j], bits, NULL);
+		for (i = 0; i < 114; i++)
+			ks[i] |= (uint64_t)bits[i] << j;
+	}
+}
+
+/*! \brief generate the keystreams of the given frames into a cache */
+void a5_ks_fill(struct a5_ks_cache *c, int algo, const uint8_t *key,
+		const uint32_t *fn, unsigned int num, int ul)
+{
+	c->algo = algo;
+	memcpy(c->key, key, sizeof(c->key));
+	c->num = num;
+	c->pos = 0;
+	memcpy(c->fn, fn, num * sizeof(*fn));
+	a5_ks_gen(algo, key, fn, num, ul, c->ks);
+}
+
+/*! \brief find the lane holding the keystream of fn
+ *
+ * Frames are looked up in ascending order, so lanes before the one found
+ * are not looked at again.
+ *  \returns lane number, or -1 if the keystream must be generated */
+int a5_ks_lookup(struct a5_ks_cache *c, int algo, const uint8_t *key,
+		 uint32_t fn)
+{
+	uint32_t d;
+
+	if (c->algo != algo || memcmp(c->key, key, sizeof(c->key)))
+		return -1;
+
+	while (c->pos < c->num) {
+		d = (fn + GSM_HYPERFRAME - c->fn[c->pos]) % GSM_HYPERFRAME;
+		if (d == 0)
+			return c->pos;
+		/* lane is later than fn */
+		if (d >= GSM_HYPERFRAME / 2)
+			return -1;
+		c->pos++;
+	}
+
+	return -1;
+}
@@ -44,6 +44,7 @@
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/oml.h>
 #include <osmo-bts/signal.h>
+#include <osmo-bts/cbch.h>
 
 #define MIN_QUAL_RACH    5.0f   /* at least  5 dB C/I */
 #define MIN_QUAL_NORM   -0.5f   /* at least -1 dB C/I */
@@ -94,7 +95,8 @@ int bts_init(struct gsm_bts *bts)
 
 	bts->role = btsb = talloc_zero(bts, struct gsm_bts_role_bts);
 
-	INIT_LLIST_HEAD(&btsb->agch_queue);
+	for (i = 0; i < ARRAY_SIZE(btsb->agch_queue); i++)
+		INIT_LLIST_HEAD(&btsb->agch_queue[i]);
 	btsb->agch_queue_length = 0;
 
 	/* enable management with default levels,
@@ -138,17 +140,7 @@ int bts_init(struct gsm_bts *bts)
 	/* initialize bts data structure */
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		struct trx_power_params *tpp = &trx->power_params;
-		int i;
 
-		for (i = 0; i < ARRAY_SIZE(trx->ts); i++) {
-			struct gsm_bts_trx_ts *ts = &trx->ts[i];
-			int k;
-
-			for (k = 0; k < ARRAY_SIZE(ts->lchan); k++) {
-				struct gsm_lchan *lchan = &ts->lchan[k];
-				INIT_LLIST_HEAD(&lchan->dl_tch_queue);
-			}
-		}
 		/* Default values for the power adjustments */
 		tpp->ramp.max_initial_pout_mdBm = to_mdB(23);
 		tpp->ramp.step_size_mdB = to_mdB(2);
@@ -173,7 +165,7 @@ int bts_init(struct gsm_bts *bts)
 		initialized = 1;
 	}
 
-	INIT_LLIST_HEAD(&btsb->smscb_state.queue);
+	bts_cbch_init(bts);
 	INIT_LLIST_HEAD(&btsb->oml_queue);
 
 	return rc;
@@ -447,49 +439,108 @@ static int extract_imm_ass_rej_refs(struct gsm48_imm_ass_rej *rej,
 	return count;
 }
 
-static int try_merge_imm_ass_rej(struct gsm48_imm_ass_rej *old_rej,
-				 struct gsm48_imm_ass_rej *new_rej)
+/* CCCH blocks needed for the pending rejects */
+static int agch_rej_blocks(struct gsm_bts_role_bts *btsb)
 {
-	struct gsm48_req_ref req_refs[2 * REQ_REFS_PER_IMM_ASS_REJ];
-	uint8_t wait_inds[2 * REQ_REFS_PER_IMM_ASS_REJ];
-	int count = 0;
-	int stored = 0;
+	return (btsb->agch_rej_num + REQ_REFS_PER_IMM_ASS_REJ - 1)
+		/ REQ_REFS_PER_IMM_ASS_REJ;
+}
 
-	if (new_rej->msg_type != GSM48_MT_RR_IMM_ASS_REJ)
-		return 0;
-	if (old_rej->msg_type != GSM48_MT_RR_IMM_ASS_REJ)
-		return 0;
+static struct gsm_bts_agch_rej *agch_rej_at(struct gsm_bts_role_bts *btsb,
+					    unsigned int i)
+{
+	return &btsb->agch_rej[(btsb->agch_rej_head + i)
+			       % GSM_BTS_AGCH_REJ_REFS];
+}
 
-	/* GSM 08.58, 5.7
-	 * -> The BTS may combine serveral IMM.ASS.REJ messages
-	 * -> Identical request refs in one message may be squeezed
-	 *
-	 * GSM 04.08, 9.1.20.2
-	 * -> Request ref and wait ind are duplicated to fill the message
-	 */
+/*
+ * Add the request references of an IMMEDIATE ASSIGN REJECT to the pending
+ * rejects.  They are merged with the rejects of the block being filled,
+ * wherever the messages were in the queue.
+ *
+ * \return 1 if all were merged, 0 if a new block was started, -ENOMEM if
+ *         there is no room left
+ */
+static int agch_rej_add(struct gsm_bts_role_bts *btsb,
+			struct gsm48_imm_ass_rej *rej)
+{
+	struct gsm48_req_ref req_refs[REQ_REFS_PER_IMM_ASS_REJ];
+	uint8_t wait_inds[REQ_REFS_PER_IMM_ASS_REJ];
+	struct gsm_bts_agch_rej *pend;
+	int blocks = agch_rej_blocks(btsb);
+	int count, fill, i, j;
+
+	count = extract_imm_ass_rej_refs(rej, req_refs, wait_inds);
+	if (btsb->agch_rej_num + count > GSM_BTS_AGCH_REJ_REFS)
+		return -ENOMEM;
 
-	/* Extract all entries */
-	count = extract_imm_ass_rej_refs(old_rej,
-					 &req_refs[count], &wait_inds[count]);
-	if (count == REQ_REFS_PER_IMM_ASS_REJ)
-		return 0;
+	for (i = 0; i < count; i++) {
+		/* GSM 08.58, 5.7: identical request refs in one message
+		 * may be squeezed */
+		fill = btsb->agch_rej_num % REQ_REFS_PER_IMM_ASS_REJ;
+		for (j = 1; j <= fill; j++) {
+			pend = agch_rej_at(btsb, btsb->agch_rej_num - j);
+			if (!memcmp(&pend->req_ref, &req_refs[i],
+				    sizeof(req_refs[i])))
+				break;
+		}
+		if (j <= fill)
+			continue;
+
+		pend = agch_rej_at(btsb, btsb->agch_rej_num++);
+		pend->req_ref = req_refs[i];
+		pend->wait_ind = wait_inds[i];
+		pend->page_mode = rej->page_mode;
+	}
+
+	blocks = agch_rej_blocks(btsb) - blocks;
+	btsb->agch_queue_length += blocks;
+
+	return blocks == 0;
+}
 
-	count += extract_imm_ass_rej_refs(new_rej,
-					  &req_refs[count], &wait_inds[count]);
+/* remove the n oldest pending rejects */
+static void agch_rej_drop(struct gsm_bts_role_bts *btsb, unsigned int n)
+{
+	int blocks = agch_rej_blocks(btsb);
+
+	if (n > btsb->agch_rej_num)
+		n = btsb->agch_rej_num;
+	btsb->agch_rej_head = (btsb->agch_rej_head + n) % GSM_BTS_AGCH_REJ_REFS;
+	btsb->agch_rej_num -= n;
+
+	btsb->agch_queue_length -= blocks - agch_rej_blocks(btsb);
+}
+
+/* write an IMMEDIATE ASSIGN REJECT of up to four pending rejects */
+static int agch_rej_gen(struct gsm_bts_role_bts *btsb, uint8_t *out_buf)
+{
+	struct gsm48_imm_ass_rej *rej = (struct gsm48_imm_ass_rej *) out_buf;
+	struct gsm48_req_ref req_refs[REQ_REFS_PER_IMM_ASS_REJ];
+	uint8_t wait_inds[REQ_REFS_PER_IMM_ASS_REJ];
+	int count, i;
 
-	/* Store entries into old message */
-	stored = store_imm_ass_rej_refs(old_rej,
-					&req_refs[stored], &wait_inds[stored],
-					count);
-	count -= stored;
+	count = OSMO_MIN(btsb->agch_rej_num, REQ_REFS_PER_IMM_ASS_REJ);
 	if (count == 0)
-		return 1;
+		return 0;
 
-	/* Store remaining entries into new message */
-	stored += store_imm_ass_rej_refs(new_rej,
-					 &req_refs[stored], &wait_inds[stored],
-					 count);
-	return 0;
+	for (i = 0; i < count; i++) {
+		req_refs[i] = agch_rej_at(btsb, i)->req_ref;
+		wait_inds[i] = agch_rej_at(btsb, i)->wait_ind;
+	}
+
+	/* GSM 04.08, 9.1.20: without IAR rest octets */
+	memset(out_buf, GSM_MACBLOCK_PADDING, GSM_MACBLOCK_LEN);
+	rej->l2_plen = ((sizeof(*rej) - 1) << 2) | 1;
+	rej->proto_discr = GSM48_PDISC_RR;
+	rej->msg_type = GSM48_MT_RR_IMM_ASS_REJ;
+	rej->page_mode = agch_rej_at(btsb, 0)->page_mode;
+	store_imm_ass_rej_refs(rej, req_refs, wait_inds, count);
+
+	agch_rej_drop(btsb, count);
+	btsb->agch_rej_skipped = 0;
+
+	return GSM_MACBLOCK_LEN;
 }
 
 int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
@@ -497,6 +548,9 @@ int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
 	int hard_limit = 1000;
 	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
+	int prio, rc;
+
+	btsb->ccch_sched.agch_arrivals++;
 
 	if (btsb->agch_queue_length > hard_limit) {
 		LOGP(DSUM, LOGL_ERROR,
@@ -509,46 +563,94 @@ int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
 		return -ENOMEM;
 	}
 
-	if (btsb->agch_queue_length > 0) {
-		struct msgb *last_msg =
-			llist_entry(btsb->agch_queue.prev, struct msgb, list);
-		struct gsm48_imm_ass_rej *last_imm_ass_rej = msgb_l3(last_msg);
-
-		if (try_merge_imm_ass_rej(last_imm_ass_rej, imm_ass_cmd)) {
-			btsb->agch_queue_merged_msgs++;
-			msgb_free(msg);
-			return 0;
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_REJ
+	 && msgb_l3len(msg) >= sizeof(*imm_ass_cmd)) {
+		rc = agch_rej_add(btsb, imm_ass_cmd);
+		if (rc < 0) {
+			LOGP(DSUM, LOGL_ERROR, "AGCH: too many pending "
+			     "rejects, refusing IMM ASS REJ\n");
+			btsb->agch_queue_rejected_msgs++;
+			return rc;
 		}
+		if (rc)
+			btsb->agch_queue_merged_msgs++;
+		msgb_free(msg);
+		return 0;
 	}
 
-	msgb_enqueue(&btsb->agch_queue, msg);
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_EXT)
+		prio = AGCH_PRIO_IMM_ASS_EXT;
+	else
+		prio = AGCH_PRIO_IMM_ASS;
+
+	msgb_enqueue(&btsb->agch_queue[prio], msg);
 	btsb->agch_queue_length++;
 
 	return 0;
 }
 
+/* dequeue the next message, but not the pending rejects */
+static struct msgb *agch_dequeue_msg(struct gsm_bts_role_bts *btsb)
+{
+	struct msgb *msg;
+	int prio;
+
+	for (prio = 0; prio < _NUM_AGCH_PRIO; prio++) {
+		msg = msgb_dequeue(&btsb->agch_queue[prio]);
+		if (msg) {
+			btsb->agch_queue_length--;
+			if (btsb->agch_rej_num)
+				btsb->agch_rej_skipped++;
+			return msg;
+		}
+	}
+
+	return NULL;
+}
+
+/* Is it the turn of the pending rejects?  Assignments go first, but the
+ * rejects get at least one of GSM_BTS_AGCH_REJ_SHARE blocks, so that MSs
+ * get their wait indication even while the assignments keep the AGCH
+ * busy, instead of retrying the RACH until T3126. */
+static int agch_rej_due(struct gsm_bts_role_bts *btsb)
+{
+	return btsb->agch_rej_num
+		&& btsb->agch_rej_skipped >= GSM_BTS_AGCH_REJ_SHARE - 1;
+}
+
 struct msgb *bts_agch_dequeue(struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	struct msgb *msg = msgb_dequeue(&btsb->agch_queue);
+	struct msgb *msg = NULL;
+
+	if (!agch_rej_due(btsb))
+		msg = agch_dequeue_msg(btsb);
+
+	if (msg || !btsb->agch_rej_num)
+		return msg;
+
+	msg = msgb_alloc(GSM_MACBLOCK_LEN, "agch_rej");
 	if (!msg)
 		return NULL;
+	msg->l3h = msgb_put(msg, GSM_MACBLOCK_LEN);
+	agch_rej_gen(btsb, msg->l3h);
 
-	btsb->agch_queue_length--;
 	return msg;
 }
 
 /*
  * Remove lower prio messages if the queue has grown too long.
  *
- * \return 0 iff the number of messages in the queue would fit into the AGCH
- *         reserved part of the CCCH.
+ * Only rejects are dropped, the oldest first.  Above the high water mark,
+ * as many are dropped at once as needed to get below it.  Between the low
+ * and the high water mark, one block of rejects is dropped with a
+ * probability rising from 0 to 1.  The rejects that their share of the
+ * AGCH blocks sends within the maximum queue length are kept.
  */
 static void compact_agch_queue(struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	struct msgb *msg, *msg2;
-	int max_len, slope, offs;
+	int max_len, slope, offs, high, p_drop, excess, keep;
 	int level_low = btsb->agch_queue_low_level;
 	int level_high = btsb->agch_queue_high_level;
 	int level_thres = btsb->agch_queue_thresh_level;
@@ -561,6 +663,10 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	if (btsb->agch_queue_length < max_len * level_thres / 100)
 		return;
 
+	keep = max_len / GSM_BTS_AGCH_REJ_SHARE;
+	if (agch_rej_blocks(btsb) <= keep)
+		return;
+
 	/* p^
 	 * 1+      /'''''
 	 *  |     /
@@ -570,32 +676,78 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	 */
 
 	offs = max_len * level_low / 100;
-	if (level_high > level_low)
+	if (level_high > level_low) {
 		slope = 0x10000 * 100 / (level_high - level_low);
-	else
+		high = offs + ((level_high - level_low) * max_len + 99) / 100;
+	} else {
 		slope = 0x10000 * max_len; /* p_drop >= 1 if len > offs */
+		high = offs + 1;
+	}
+
+	excess = btsb->agch_queue_length - high + 1;
+	if (excess > 0) {
+		excess = OSMO_MIN(excess, agch_rej_blocks(btsb) - keep);
+		agch_rej_drop(btsb, excess * REQ_REFS_PER_IMM_ASS_REJ);
+		btsb->agch_queue_dropped_msgs += excess;
+	}
+
+	if (agch_rej_blocks(btsb) <= keep)
+		return;
 
-	llist_for_each_entry_safe(msg, msg2, &btsb->agch_queue, list) {
-		struct gsm48_imm_ass *imm_ass_cmd = msgb_l3(msg);
-		int p_drop;
+	p_drop = (btsb->agch_queue_length - offs) * slope / max_len;
+	if (p_drop <= 0 || (random() & 0xffff) >= p_drop)
+		return;
 
-		if (imm_ass_cmd->msg_type != GSM48_MT_RR_IMM_ASS_REJ)
-			return;
+	agch_rej_drop(btsb, REQ_REFS_PER_IMM_ASS_REJ);
+	btsb->agch_queue_dropped_msgs++;
+}
 
-		/* IMMEDIATE ASSIGN REJECT */
+/* moving average over about eight multiframes, rounded away from the
+ * old value so that it does reach a constant input */
+static void ccch_sched_avg(int *avg256, int val256)
+{
+	int diff = val256 - *avg256;
 
-		p_drop = (btsb->agch_queue_length - offs) * slope / max_len;
+	*avg256 += (diff + (diff > 0 ? 7 : -7)) / 8;
+}
 
-		if ((random() & 0xffff) >= p_drop)
-			return;
+/* fold the counts of the past multiframe into the predictions */
+static void ccch_sched_update(struct gsm_bts_role_bts *btsb, uint32_t fn)
+{
+	struct gsm_bts_ccch_sched *cs = &btsb->ccch_sched;
+	uint32_t mf = fn / 51;
 
-		llist_del(&msg->list);
-		btsb->agch_queue_length--;
-		msgb_free(msg);
+	if (mf == cs->mf)
+		return;
 
-		btsb->agch_queue_dropped_msgs++;
+	if (cs->blocks) {
+		ccch_sched_avg(&cs->pag_rate256, cs->pag_arrivals * 256);
+		ccch_sched_avg(&cs->agch_rate256, cs->agch_arrivals * 256);
+		ccch_sched_avg(&cs->ag_blocks256, cs->ag_blocks * 256);
+		ccch_sched_avg(&cs->util256,
+			       cs->blocks_used * 256 / cs->blocks);
 	}
-	return;
+
+	cs->mf = mf;
+	cs->pag_arrivals = 0;
+	cs->agch_arrivals = 0;
+	cs->ag_blocks = 0;
+	cs->blocks = 0;
+	cs->blocks_used = 0;
+}
+
+/* Will the AGCH reserved blocks fall behind?  That is the case if more
+ * AGCH messages are expected per multiframe than there are reserved
+ * blocks, or if the backlog alone takes more than a multiframe. */
+static int ccch_agch_congested(struct gsm_bts_role_bts *btsb)
+{
+	struct gsm_bts_ccch_sched *cs = &btsb->ccch_sched;
+
+	if (btsb->agch_queue_length == 0)
+		return 0;
+
+	return cs->agch_rate256 > cs->ag_blocks256 ||
+		btsb->agch_queue_length * 256 > cs->ag_blocks256;
 }
 
 int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt,
@@ -603,6 +755,7 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 {
 	struct msgb *msg = NULL;
 	struct gsm_bts_role_bts *btsb = bts->role;
+	struct gsm_bts_ccch_sched *cs = &btsb->ccch_sched;
 	int rc = 0;
 	int is_empty = 1;
 
@@ -612,29 +765,52 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 	 * PCH messages also reduce the drain of the AGCH queue.
 	 */
 	compact_agch_queue(bts);
+	ccch_sched_update(btsb, gt->fn);
+	cs->blocks++;
+	cs->blocks_total++;
 
-	/* Check for paging messages first if this is PCH */
-	if (!is_ag_res)
+	/* Check for paging messages first if this is PCH.  A paging that
+	 * has been sent already may wait for its next block, if the AGCH
+	 * blocks cannot keep up on their own. */
+	if (is_ag_res)
+		cs->ag_blocks++;
+	else if (paging_block_pending(btsb->paging_state, gt) ==
+						PAGING_PENDING_REPEAT
+	      && ccch_agch_congested(btsb)) {
+		/* the block carries AGCH or nothing, not PCH, so it is left
+		 * out of the PCH load */
+		cs->pag_deferred++;
+	} else
 		rc = paging_gen_msg(btsb->paging_state, out_buf, gt, &is_empty);
 
 	/* Check whether the block may be overwritten */
-	if (!is_empty)
-		return rc;
+	if (!is_empty) {
+		if (rc < 0)
+			return rc;
+		goto used;
+	}
 
-	msg = bts_agch_dequeue(bts);
-	if (!msg)
+	if (!agch_rej_due(btsb))
+		msg = agch_dequeue_msg(btsb);
+	if (msg) {
+		/* Copy AGCH message */
+		memcpy(out_buf, msgb_l3(msg), msgb_l3len(msg));
+		rc = msgb_l3len(msg);
+		msgb_free(msg);
+	} else if (btsb->agch_rej_num) {
+		/* IMM ASS REJ of the oldest pending rejects */
+		rc = agch_rej_gen(btsb, out_buf);
+	} else
 		return rc;
 
-	/* Copy AGCH message */
-	memcpy(out_buf, msgb_l3(msg), msgb_l3len(msg));
-	rc = msgb_l3len(msg);
-	msgb_free(msg);
-
 	if (is_ag_res)
 		btsb->agch_queue_agch_msgs++;
 	else
 		btsb->agch_queue_pch_msgs++;
 
+used:
+	cs->blocks_used++;
+	cs->blocks_used_total++;
 	return rc;
 }
 
@@ -19,78 +19,86 @@
  */
 
 #include <errno.h>
+#include <string.h>
 
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/talloc.h>
 #include <osmocom/gsm/protocol/gsm_04_12.h>
 
 #include <osmo-bts/bts.h>
 #include <osmo-bts/cbch.h>
 #include <osmo-bts/logging.h>
 
+/* An SMS-CB message is cut into its blocks when it is received from RSL,
+ * including the block type octet, so that every CBCH slot only copies a
+ * ready block.  Each CBCH has a table of the four blocks to be sent in
+ * the current four multiframes, which is filled from the queue at TB 0
+ * (basic) or TB 4 (extended).  If nothing is queued, the default message
+ * of that CBCH is broadcast over and over, or a NULL message if there is
+ * none. */
+
+#define SMSCB_MAX_BLOCKS	4
+
 struct smscb_msg {
 	struct llist_head list;		/* list in smscb_state.queue */
 
-	uint8_t msg[GSM412_MSG_LEN];	/* message buffer */
-	uint8_t next_seg;		/* next segment number */
 	uint8_t num_segs;		/* total number of segments */
+	uint8_t blocks[SMSCB_MAX_BLOCKS][GSM_MACBLOCK_LEN];
 };
 
-static int get_smscb_null_block(uint8_t *out)
-{
-	struct gsm412_block_type *block_type = (struct gsm412_block_type *) out;
-
-	block_type->spare = 0;
-	block_type->lpd = 1;
-	block_type->seq_nr = GSM412_SEQ_NULL_MSG;
-	block_type->lb = 0;
-	memset(out+1, GSM_MACBLOCK_PADDING, GSM412_BLOCK_LEN);
+/* LPD 01, sequence number NULL message, followed by padding */
+static const uint8_t smscb_null_block[GSM_MACBLOCK_LEN] = {
+	0x2f, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b
+};
 
-	return 0;
+static void smscb_state_init(struct bts_smscb_state *st)
+{
+	unsigned int i;
+
+	INIT_LLIST_HEAD(&st->queue);
+	st->queue_len = 0;
+	st->cur_msg = NULL;
+	st->default_msg = NULL;
+	for (i = 0; i < ARRAY_SIZE(st->sched); i++)
+		st->sched[i] = smscb_null_block;
 }
 
-/* get the next block of the current CB message */
-static int get_smscb_block(struct gsm_bts *bts, uint8_t *out)
+void bts_cbch_init(struct gsm_bts *bts)
 {
-	int to_copy;
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	struct gsm412_block_type *block_type;
-	struct smscb_msg *msg = btsb->smscb_state.cur_msg;
-
-	if (!msg) {
-		/* No message: Send NULL mesage */
-		return get_smscb_null_block(out);
-	}
 
-	block_type = (struct gsm412_block_type *) out++;
-
-	/* LPD is always 01 */
-	block_type->spare = 0;
-	block_type->lpd = 1;
-
-	/* determine how much data to copy */
-	to_copy = GSM412_MSG_LEN - (msg->next_seg * GSM412_BLOCK_LEN);
-	if (to_copy > GSM412_BLOCK_LEN)
-		to_copy = GSM412_BLOCK_LEN;
-
-	/* copy data and increment index */
-	memcpy(out, &msg->msg[msg->next_seg * GSM412_BLOCK_LEN], to_copy);
-
-	/* set + increment sequence number */
-	block_type->seq_nr = msg->next_seg++;
-
-	/* determine if this is the last block */
-	if (block_type->seq_nr + 1 == msg->num_segs)
-		block_type->lb = 1;
-	else
-		block_type->lb = 0;
+	smscb_state_init(&btsb->smscb_basic);
+	smscb_state_init(&btsb->smscb_extended);
+}
 
-	if (block_type->lb == 1) {
-		/* remove/release the message memory */
-		talloc_free(btsb->smscb_state.cur_msg);
-		btsb->smscb_state.cur_msg = NULL;
+/* cut the message into blocks of GSM 04.12 */
+static void smscb_segment(struct smscb_msg *scm, const uint8_t *msg,
+			  uint8_t msg_len, uint8_t first_seq_nr)
+{
+	struct gsm412_block_type *block_type;
+	unsigned int i, offs, to_copy;
+
+	for (i = 0; i < scm->num_segs; i++) {
+		block_type = (struct gsm412_block_type *) scm->blocks[i];
+
+		/* LPD is always 01 */
+		block_type->spare = 0;
+		block_type->lpd = 1;
+		block_type->seq_nr = i == 0 ? first_seq_nr : i;
+		block_type->lb = i + 1 == scm->num_segs;
+
+		memset(scm->blocks[i] + 1, GSM_MACBLOCK_PADDING,
+		       GSM412_BLOCK_LEN);
+		offs = i * GSM412_BLOCK_LEN;
+		if (offs >= msg_len)
+			continue;
+		to_copy = msg_len - offs;
+		if (to_copy > GSM412_BLOCK_LEN)
+			to_copy = GSM412_BLOCK_LEN;
+		memcpy(scm->blocks[i] + 1, msg + offs, to_copy);
 	}
-
-	return block_type->lb;
 }
 
 static const uint8_t last_block_rsl2um[4] = {
@@ -100,62 +108,95 @@ static const uint8_t last_block_rsl2um[4] = {
 	[RSL_CB_CMD_LASTBLOCK_3]	= 3,
 };
 
+/* replace the default message, the current one may still be sent */
+static void smscb_set_default(struct bts_smscb_state *st,
+			      struct smscb_msg *scm)
+{
+	if (st->default_msg && st->default_msg != st->cur_msg)
+		talloc_free(st->default_msg);
+	st->default_msg = scm;
+}
 
 /* incoming SMS broadcast command from RSL */
 int bts_process_smscb_cmd(struct gsm_bts *bts,
-			  struct rsl_ie_cb_cmd_type cmd_type,
+			  struct rsl_ie_cb_cmd_type cmd_type, int extended,
 			  uint8_t msg_len, const uint8_t *msg)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct bts_smscb_state *st;
 	struct smscb_msg *scm;
 
-	if (msg_len > sizeof(scm->msg)) {
+	if (msg_len > SMSCB_MAX_BLOCKS * GSM412_BLOCK_LEN) {
 		LOGP(DLSMS, LOGL_ERROR,
-		     "Cannot process SMSCB of %u bytes (max %zu)\n",
-		     msg_len, sizeof(scm->msg));
+		     "Cannot process SMSCB of %u bytes (max %u)\n",
+		     msg_len, SMSCB_MAX_BLOCKS * GSM412_BLOCK_LEN);
 		return -EINVAL;
 	}
 
-	scm = talloc_zero_size(bts, sizeof(*scm));
+	st = extended ? &btsb->smscb_extended : &btsb->smscb_basic;
+
+	/* default broadcast of a NULL message */
+	if (cmd_type.command == RSL_CB_CMD_TYPE_DEFAULT && cmd_type.def_bcast) {
+		smscb_set_default(st, NULL);
+		return 0;
+	}
 
-	/* initialize entire message with default padding */
-	memset(scm->msg, GSM_MACBLOCK_PADDING, sizeof(scm->msg));
-	/* next segment is first segment */
-	scm->next_seg = 0;
+	scm = talloc_zero(bts, struct smscb_msg);
+	if (!scm)
+		return -ENOMEM;
+
+	scm->num_segs = last_block_rsl2um[cmd_type.last_block&3];
 
 	switch (cmd_type.command) {
-	case RSL_CB_CMD_TYPE_NORMAL:
 	case RSL_CB_CMD_TYPE_SCHEDULE:
+		smscb_segment(scm, msg, msg_len, GSM412_SEQ_FST_SCHED_BLOCK);
+		break;
 	case RSL_CB_CMD_TYPE_NULL:
-		scm->num_segs = last_block_rsl2um[cmd_type.last_block&3];
-		memcpy(scm->msg, msg, msg_len);
-		/* def_bcast is ignored */
+		scm->num_segs = 1;
+		memcpy(scm->blocks[0], smscb_null_block, GSM_MACBLOCK_LEN);
 		break;
+	case RSL_CB_CMD_TYPE_NORMAL:
 	case RSL_CB_CMD_TYPE_DEFAULT:
-		/* use def_bcast, ignore command  */
-		/* def_bcast == 0: normal mess */
+	default:
+		smscb_segment(scm, msg, msg_len, GSM412_SEQ_FST_BLOCK);
 		break;
 	}
 
-	llist_add_tail(&scm->list, &btsb->smscb_state.queue);
+	if (cmd_type.command == RSL_CB_CMD_TYPE_DEFAULT) {
+		smscb_set_default(st, scm);
+		return 0;
+	}
+
+	llist_add_tail(&scm->list, &st->queue);
+	st->queue_len++;
 
 	return 0;
 }
 
-static struct smscb_msg *select_next_smscb(struct gsm_bts *bts)
+/* fill the table of the next four multiframes */
+static void smscb_schedule(struct bts_smscb_state *st)
 {
 	struct smscb_msg *msg;
-	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-
-	if (llist_empty(&btsb->smscb_state.queue))
-		return NULL;
-
-	msg = llist_entry(btsb->smscb_state.queue.next,
-			  struct smscb_msg, list);
-
-	llist_del(&msg->list);
-
-	return msg;
+	unsigned int i;
+
+	/* the message of the last four multiframes is done */
+	if (st->cur_msg && st->cur_msg != st->default_msg)
+		talloc_free(st->cur_msg);
+
+	if (!llist_empty(&st->queue)) {
+		msg = llist_entry(st->queue.next, struct smscb_msg, list);
+		llist_del(&msg->list);
+		st->queue_len--;
+	} else
+		msg = st->default_msg;
+
+	st->cur_msg = msg;
+	for (i = 0; i < ARRAY_SIZE(st->sched); i++) {
+		if (msg && i < msg->num_segs)
+			st->sched[i] = msg->blocks[i];
+		else
+			st->sched[i] = smscb_null_block;
+	}
 }
 
 /* call-back from bts model specific code when it wants to obtain a CBCH
@@ -166,31 +207,21 @@ int bts_cbch_get(struct gsm_bts *bts, uint8_t *outbuf, struct gsm_time *g_time)
 	uint32_t fn = gsm_gsmtime2fn(g_time);
 	/* According to 05.02 Section 6.5.4 */
 	uint32_t tb = (fn / 51) % 8;
-	int rc = 0;
+	struct bts_smscb_state *st;
 
 	/* The multiframes used for the basic cell broadcast channel
 	 * shall be those in * which TB = 0,1,2 and 3. The multiframes
 	 * used for the extended cell broadcast channel shall be those
 	 * in which TB = 4, 5, 6 and 7 */
+	st = tb < 4 ? &btsb->smscb_basic : &btsb->smscb_extended;
 
 	/* The SMSCB header shall be sent in the multiframe in which TB
 	 * = 0 for the basic, and TB = 4 for the extended cell
 	 * broadcast channel. */
+	if (tb % 4 == 0)
+		smscb_schedule(st);
 
-	switch (tb) {
-	case 0:
-		/* select a new SMSCB message */
-		btsb->smscb_state.cur_msg = select_next_smscb(bts);
-		rc = get_smscb_block(bts, outbuf);
-		break;
-	case 1: case 2: case 3:
-		rc = get_smscb_block(bts, outbuf);
-		break;
-	case 4: case 5: case 6: case 7:
-		/* always send NULL frame in extended CBCH for now */
-		rc = get_smscb_null_block(outbuf);
-		break;
-	}
+	memcpy(outbuf, st->sched[tb % 4], GSM_MACBLOCK_LEN);
 
-	return rc;
+	return 0;
 }
@@ -0,0 +1,179 @@
+/* Downlink TCH jitter ring of a logical channel */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Speech frames received by RTP are written into a ring of fixed size
+ * slots of their lchan, at the slot of their playout timestamp.  At every
+ * TCH-RTS.ind, the frame of the current timestamp is taken from its slot.
+ * This replaces a list of msgbs per lchan, which had to be walked to be
+ * trimmed and needed an allocation for every received packet.
+ *
+ * A frame that arrives after its playout time is dropped.  A lost frame
+ * may be replaced by the previous one, if that one is still in the ring.
+ * Otherwise nothing is sent and the PHY fills in its idle pattern. */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/dl_tch_ring.h>
+
+static inline struct dl_tch_slot *ring_slot(struct dl_tch_ring *r,
+					    uint32_t ts)
+{
+	return &r->slots[(ts / DL_TCH_RING_TS_STEP) % DL_TCH_RING_SLOTS];
+}
+
+/* is timestamp a before timestamp b, with wrap-around */
+static inline int ts_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+void dl_tch_ring_init(struct dl_tch_ring *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+/*! \brief write a frame into the slot of its playout timestamp
+ *  \returns 0 on success, negative errno if the frame was dropped */
+int dl_tch_ring_put(struct dl_tch_ring *r, uint32_t ts, const uint8_t *data,
+		    unsigned int len)
+{
+	struct dl_tch_slot *slot = ring_slot(r, ts);
+
+	if (len > DL_TCH_RING_MAX_LEN) {
+		r->stats.oversize++;
+		return -EMSGSIZE;
+	}
+	if (r->started && ts_before(ts, r->next_ts)) {
+		r->stats.late++;
+		return -ETIME;
+	}
+
+	if (slot->len) {
+		if (slot->ts == ts)
+			r->stats.dup++;
+		else if (!r->started || !ts_before(slot->ts, r->next_ts))
+			r->stats.stale++;
+	}
+
+	memcpy(slot->data, data, len);
+	slot->len = len;
+	slot->ts = ts;
+	r->stats.rx++;
+
+	return 0;
+}
+
+/*! \brief get the frame to be played out at given timestamp
+ *  \param[in] conceal repeat the previous frame if this one is lost
+ *  \param[out] len length of the frame
+ *  \returns frame data, valid until the next dl_tch_ring_put(), or NULL */
+const uint8_t *dl_tch_ring_pop(struct dl_tch_ring *r, uint32_t ts,
+			       int conceal, unsigned int *len)
+{
+	struct dl_tch_slot *slot = ring_slot(r, ts);
+	struct dl_tch_slot *prev;
+	int started = r->started;
+
+	r->next_ts = ts + DL_TCH_RING_TS_STEP;
+	r->started = 1;
+
+	if (slot->len && slot->ts == ts) {
+		r->lost = 0;
+		r->stats.tx++;
+		*len = slot->len;
+		return slot->data;
+	}
+
+	/* nothing ever received, this is not a loss */
+	if (!started || !r->stats.rx)
+		return NULL;
+
+	r->lost++;
+	prev = ring_slot(r, ts - DL_TCH_RING_TS_STEP);
+	/* the slot may already hold a frame far ahead, keep that */
+	if (slot->len && ts_before(ts, slot->ts))
+		conceal = 0;
+	if (conceal && r->lost <= DL_TCH_RING_MAX_CONCEAL && prev->len
+	 && prev->ts == ts - DL_TCH_RING_TS_STEP) {
+		/* keep it as the previous frame of the next timestamp */
+		if (slot != prev) {
+			memcpy(slot->data, prev->data, prev->len);
+			slot->len = prev->len;
+		}
+		slot->ts = ts;
+		r->stats.concealed++;
+		*len = slot->len;
+		return slot->data;
+	}
+
+	r->stats.underrun++;
+	return NULL;
+}
+
+/*! \brief get the ring of an lchan
+ *  \param[in] create allocate it if there is none yet */
+struct dl_tch_ring *lchan_dl_tch_ring(struct gsm_lchan *lchan, int create)
+{
+	struct gsm_bts_trx_ts *ts = lchan->ts;
+	struct gsm_bts_trx *trx = ts->trx;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(trx->bts);
+	struct dl_tch_ring **rings;
+	unsigned int idx, num;
+
+	idx = (trx->nr * ARRAY_SIZE(trx->ts) + ts->nr) * ARRAY_SIZE(ts->lchan)
+		+ lchan->nr;
+
+	if (idx >= btsb->num_dl_tch_rings) {
+		if (!create)
+			return NULL;
+		num = (trx->nr + 1) * ARRAY_SIZE(trx->ts)
+			* ARRAY_SIZE(ts->lchan);
+		rings = talloc_realloc(trx->bts, btsb->dl_tch_rings,
+				       struct dl_tch_ring *, num);
+		if (!rings)
+			return NULL;
+		memset(rings + btsb->num_dl_tch_rings, 0,
+		       (num - btsb->num_dl_tch_rings) * sizeof(*rings));
+		btsb->dl_tch_rings = rings;
+		btsb->num_dl_tch_rings = num;
+	}
+
+	/* kept for the lifetime of the BTS, so that RTP never allocates */
+	if (!btsb->dl_tch_rings[idx] && create)
+		btsb->dl_tch_rings[idx] = talloc_zero(btsb->dl_tch_rings,
+						      struct dl_tch_ring);
+
+	return btsb->dl_tch_rings[idx];
+}
+
+/*! \brief drop all frames of an lchan, e.g. when its RTP stream ends */
+void lchan_dl_tch_ring_reset(struct gsm_lchan *lchan)
+{
+	struct dl_tch_ring *r = lchan_dl_tch_ring(lchan, 0);
+
+	if (r)
+		dl_tch_ring_init(r);
+}
@@ -0,0 +1,304 @@
+/* Rate limited GSMTAP export through a ring and a sender thread */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* With gsmtap_send(), every traced block costs a msgb allocation and a
+ * write from the main loop, at the rate of the scheduler.  Instead, the
+ * main loop writes the complete datagram into a free slot of a ring, and
+ * a sender thread drains the ring once per TDMA frame with sendmmsg():
+ *
+ *  - if the ring is full, the datagram is dropped, the main loop never
+ *    waits for the sender thread or the network,
+ *  - a token bucket limits the rate of datagrams, so that tracing all
+ *    channels of a loaded BTS cannot flood the link to the capture host,
+ *  - drops are counted and reported in the log and on the VTY.
+ *
+ * The sender thread never allocates or logs, as talloc and the logging
+ * code are not thread safe.  It runs without real-time priority, even if
+ * the main loop has one. */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/gsmtap.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/udp_batch.h>
+#include <osmo-bts/gsmtap_ring.h>
+
+/*! \brief allocate a ring
+ *  \param[in] num_slots number of slots, rounded up to a power of two */
+struct gsmtap_ring *gsmtap_ring_alloc(void *ctx, unsigned int num_slots)
+{
+	struct gsmtap_ring *r;
+	unsigned int n = 1;
+
+	while (n < num_slots)
+		n <<= 1;
+
+	r = talloc_zero(ctx, struct gsmtap_ring);
+	if (!r)
+		return NULL;
+	r->num_slots = n;
+	r->buf = talloc_zero_size(r, n * GSMTAP_RING_SLOT_SIZE);
+	r->len = talloc_zero_array(r, uint16_t, n);
+	if (!r->buf || !r->len) {
+		talloc_free(r);
+		return NULL;
+	}
+	r->fd = -1;
+
+	return r;
+}
+
+void gsmtap_ring_free(struct gsmtap_ring *r)
+{
+	if (!r)
+		return;
+	gsmtap_ring_stop(r);
+	talloc_free(r);
+}
+
+/*! \brief limit the datagrams written into the ring
+ *  \param[in] rate datagrams per second, 0 for no limit
+ *  \param[in] burst datagrams that may be written at once */
+void gsmtap_ring_set_rate(struct gsmtap_ring *r, unsigned int rate,
+			  unsigned int burst)
+{
+	if (!burst)
+		burst = 1;
+
+	r->rate = rate;
+	r->burst = burst;
+	r->interval_ns = rate ? 1000000000ULL / rate : 0;
+	r->tau_ns = r->interval_ns * (burst - 1);
+	r->tat_ns = 0;
+}
+
+/* take a token from the bucket, returns 0 if it is empty */
+static int ring_rate_conform(struct gsmtap_ring *r)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	if (!r->rate)
+		return 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	if (r->tat_ns < now)
+		r->tat_ns = now;
+	if (r->tat_ns - now > r->tau_ns)
+		return 0;
+	r->tat_ns += r->interval_ns;
+
+	return 1;
+}
+
+static void ring_report_drops(struct gsmtap_ring *r)
+{
+	uint32_t drops = r->stats.full + r->stats.rate_limited;
+
+	/* report the first time and then every 1000 times */
+	if ((drops && !r->drops_reported) || drops - r->drops_reported >= 1000) {
+		LOGP(DL1P, LOGL_NOTICE, "GSMTAP: dropped %u datagrams, "
+			"%u with the ring full, %u by the rate limit\n",
+			drops, r->stats.full, r->stats.rate_limited);
+		r->drops_reported = drops;
+	}
+}
+
+/*! \brief write a GSMTAP datagram into the ring, from the main loop
+ *
+ * The arguments are those of gsmtap_send().
+ *  \returns 0 on success, negative errno if the datagram was dropped */
+int gsmtap_ring_enqueue(struct gsmtap_ring *r, uint16_t arfcn, uint8_t ts,
+			uint8_t chan_type, uint8_t ss, uint32_t fn,
+			int8_t signal_dbm, uint8_t snr,
+			const uint8_t *data, unsigned int len)
+{
+	struct gsmtap_hdr *gh;
+	unsigned int tail, idx;
+	uint8_t *slot;
+
+	if (sizeof(*gh) + len > GSMTAP_RING_SLOT_SIZE) {
+		r->stats.oversize++;
+		return -EMSGSIZE;
+	}
+
+	tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	if (r->head - tail >= r->num_slots) {
+		r->stats.full++;
+		ring_report_drops(r);
+		return -ENOBUFS;
+	}
+	if (!ring_rate_conform(r)) {
+		r->stats.rate_limited++;
+		ring_report_drops(r);
+		return -EBUSY;
+	}
+
+	idx = r->head & (r->num_slots - 1);
+	slot = r->buf + idx * GSMTAP_RING_SLOT_SIZE;
+
+	/* as gsmtap_makemsg() */
+	gh = (struct gsmtap_hdr *) slot;
+	memset(gh, 0, sizeof(*gh));
+	gh->version = GSMTAP_VERSION;
+	gh->hdr_len = sizeof(*gh) / 4;
+	gh->type = GSMTAP_TYPE_UM;
+	gh->timeslot = ts;
+	gh->sub_slot = ss;
+	gh->arfcn = htons(arfcn);
+	gh->snr_db = snr;
+	gh->signal_dbm = signal_dbm;
+	gh->frame_number = htonl(fn);
+	gh->sub_type = chan_type;
+	memcpy(slot + sizeof(*gh), data, len);
+	r->len[idx] = sizeof(*gh) + len;
+
+	r->stats.queued++;
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void ring_flush(struct gsmtap_ring *r)
+{
+	struct udp_batch *b = r->batch;
+	unsigned long datagrams = b->datagrams, syscalls = b->syscalls;
+	unsigned int num = b->num, sent;
+
+	/* a failed batch is dropped, the next one is tried again */
+	udp_batch_send(b, r->fd);
+
+	sent = b->datagrams - datagrams;
+	__atomic_add_fetch(&r->stats.sent, sent, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&r->stats.tx_errors, num - sent, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&r->stats.syscalls, b->syscalls - syscalls,
+			   __ATOMIC_RELAXED);
+}
+
+/* send all datagrams of the ring, returns their number */
+static unsigned int ring_drain(struct gsmtap_ring *r)
+{
+	unsigned int head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	unsigned int idx, count = 0;
+
+	if (head - r->tail > r->stats.max_fill)
+		__atomic_store_n(&r->stats.max_fill, head - r->tail,
+				 __ATOMIC_RELAXED);
+
+	while (r->tail != head) {
+		idx = r->tail & (r->num_slots - 1);
+		memcpy(udp_batch_tx_buf(r->batch),
+		       r->buf + idx * GSMTAP_RING_SLOT_SIZE, r->len[idx]);
+		udp_batch_tx_commit(r->batch, r->len[idx]);
+		__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+		count++;
+
+		if (r->batch->num == r->batch->size)
+			ring_flush(r);
+	}
+	if (r->batch->num)
+		ring_flush(r);
+
+	return count;
+}
+
+static void *ring_tx_thread(void *arg)
+{
+	struct gsmtap_ring *r = arg;
+	struct timespec poll = {
+		.tv_sec = 0,
+		.tv_nsec = GSMTAP_RING_POLL_US * 1000,
+	};
+
+	while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+		ring_drain(r);
+		/* polling rather than a doorbell keeps system calls out of
+		 * the main loop, and collects a batch per TDMA frame */
+		nanosleep(&poll, NULL);
+	}
+
+	return NULL;
+}
+
+/*! \brief start the sender thread
+ *  \param[in] fd socket connected to the capture host */
+int gsmtap_ring_start(struct gsmtap_ring *r, int fd)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	int rc;
+
+	if (r->running)
+		return -EBUSY;
+
+	if (!r->batch) {
+		r->batch = udp_batch_alloc(r, GSMTAP_RING_BATCH,
+					   GSMTAP_RING_SLOT_SIZE);
+		if (!r->batch)
+			return -ENOMEM;
+	}
+	r->fd = fd;
+	r->head = r->tail = 0;
+	r->stop = 0;
+
+	/* do not inherit the real-time priority of the main loop */
+	memset(&param, 0, sizeof(param));
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+
+	rc = pthread_create(&r->thread, &attr, ring_tx_thread, r);
+	pthread_attr_destroy(&attr);
+	if (rc) {
+		LOGP(DL1P, LOGL_ERROR, "Cannot start GSMTAP sender thread: "
+			"%s\n", strerror(rc));
+		return -rc;
+	}
+	r->running = 1;
+
+	LOGP(DL1P, LOGL_NOTICE, "Sending GSMTAP on a separate thread "
+		"(%u slots)\n", r->num_slots);
+
+	return 0;
+}
+
+/*! \brief stop the sender thread, unsent datagrams are dropped */
+void gsmtap_ring_stop(struct gsmtap_ring *r)
+{
+	if (!r->running)
+		return;
+
+	__atomic_store_n(&r->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(r->thread, NULL);
+	r->running = 0;
+	r->head = r->tail = 0;
+}
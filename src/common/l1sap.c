@@ -46,6 +46,8 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/handover.h>
 #include <osmo-bts/power_control.h>
+#include <osmo-bts/dl_tch_ring.h>
+#include <osmo-bts/gsmtap_ring.h>
 
 static struct gsm_lchan *
 get_lchan_by_chan_nr(struct gsm_bts_trx *trx, unsigned int chan_nr)
@@ -187,6 +189,8 @@ int bts_check_for_ciph_cmd(struct msgb *msg, struct gsm_lchan *lchan,
 struct gsmtap_inst *gsmtap = NULL;
 uint32_t gsmtap_sapi_mask = 0;
 uint8_t gsmtap_sapi_acch = 0;
+struct gsmtap_ring *gsmtap_ring = NULL;
+unsigned int gsmtap_rate_limit = 0;
 
 const struct value_string gsmtap_sapi_names[] = {
 	{ GSMTAP_CHANNEL_BCCH,	"BCCH" },
@@ -339,8 +343,12 @@ static int to_gsmtap(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 			return 0;
 	}
 
-	gsmtap_send(gsmtap, trx->arfcn | uplink, tn, chan_type, ss, fn, 0, 0,
-		data, len);
+	if (gsmtap_ring)
+		gsmtap_ring_enqueue(gsmtap_ring, trx->arfcn | uplink, tn,
+			chan_type, ss, fn, 0, 0, data, len);
+	else
+		gsmtap_send(gsmtap, trx->arfcn | uplink, tn, chan_type, ss, fn,
+			0, 0, data, len);
 
 	return 0;
 }
@@ -655,12 +663,15 @@ static int l1sap_handover_rach(struct gsm_bts_trx *trx,
 static int l1sap_tch_rts_ind(struct gsm_bts_trx *trx,
 	struct osmo_phsap_prim *l1sap, struct ph_tch_param *rts_ind)
 {
-	struct msgb *resp_msg;
+	struct msgb *resp_msg = NULL;
 	struct osmo_phsap_prim *resp_l1sap, empty_l1sap;
 	struct gsm_time g_time;
 	struct gsm_lchan *lchan;
+	struct dl_tch_ring *ring;
+	const uint8_t *data = NULL;
+	unsigned int len;
 	uint8_t chan_nr;
-	uint32_t fn;
+	uint32_t fn, ts;
 
 	chan_nr = rts_ind->chan_nr;
 	fn = rts_ind->fn;
@@ -674,7 +685,12 @@ static int l1sap_tch_rts_ind(struct gsm_bts_trx *trx,
 	if (!lchan)
 		return 0;
 
+	ring = lchan_dl_tch_ring(lchan, 0);
+	ts = ring ? ring->next_ts : 0;
+
 	if (!lchan->loopback && lchan->abis_ip.rtp_socket) {
+		/* the frame polled now is written at this timestamp */
+		ts = lchan->abis_ip.rtp_socket->rx_user_ts;
 		osmo_rtp_socket_poll(lchan->abis_ip.rtp_socket);
 		/* FIXME: we _assume_ that we never miss TDMA
 		 * frames and that we always get to this point
@@ -684,16 +700,21 @@ static int l1sap_tch_rts_ind(struct gsm_bts_trx *trx,
 		 * elapsed since the last call */
 		lchan->abis_ip.rtp_socket->rx_user_ts += GSM_RTP_DURATION;
 	}
-	/* get a msgb from the dl_tx_queue */
-	resp_msg = msgb_dequeue(&lchan->dl_tch_queue);
+	/* get the frame of this timestamp from the jitter ring, a lost
+	 * FR/EFR/HR frame may be replaced by the previous one */
+	if (ring)
+		data = dl_tch_ring_pop(ring, ts,
+			lchan->tch_mode == GSM48_CMODE_SPEECH_V1 ||
+			lchan->tch_mode == GSM48_CMODE_SPEECH_EFR, &len);
+	if (data)
+		resp_msg = l1sap_msgb_alloc(len);
 	if (!resp_msg) {
 		LOGP(DL1P, LOGL_DEBUG, "%s DL TCH Tx queue underrun\n",
 			gsm_lchan_name(lchan));
 		resp_l1sap = &empty_l1sap;
 	} else {
-		resp_msg->l2h = resp_msg->data;
-		msgb_push(resp_msg, sizeof(*resp_l1sap));
-		resp_msg->l1h = resp_msg->data;
+		resp_msg->l2h = msgb_put(resp_msg, len);
+		memcpy(resp_msg->l2h, data, len);
 		resp_l1sap = msgb_l1sap_prim(resp_msg);
 	}
 
@@ -901,21 +922,14 @@ static int l1sap_tch_ind(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap,
 		osmo_rtp_send_frame_ext(lchan->abis_ip.rtp_socket,
 			msg->data, msg->len, fn_ms_adj(fn, lchan->tch.last_fn), lchan->rtp_tx_marker);
 
-	/* if loopback is enabled, also queue received RTP data */
+	/* if loopback is enabled, also play out the received data at the
+	 * next TCH-RTS.ind */
 	if (lchan->loopback) {
-		struct msgb *tmp;
-		int count = 0;
-
-		/* make sure the queue doesn't get too long */
-		llist_for_each_entry(tmp, &lchan->dl_tch_queue, list)
-			count++;
-		while (count >= 1) {
-			tmp = msgb_dequeue(&lchan->dl_tch_queue);
-			msgb_free(tmp);
-			count--;
-		}
+		struct dl_tch_ring *ring = lchan_dl_tch_ring(lchan, 1);
 
-		msgb_enqueue(&lchan->dl_tch_queue, msg);
+		if (ring)
+			dl_tch_ring_put(ring, ring->next_ts, msg->data,
+					msg->len);
 	}
 
 	lchan->rtp_tx_marker = false;
@@ -1047,27 +1061,20 @@ void l1sap_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
                      unsigned int rtp_pl_len)
 {
 	struct gsm_lchan *lchan = rs->priv;
-	struct msgb *msg, *tmp;
-	struct osmo_phsap_prim *l1sap;
-	int count = 0;
+	struct dl_tch_ring *ring;
+	int rc;
 
-	msg = l1sap_msgb_alloc(rtp_pl_len);
-	if (!msg)
+	/* allocated when the RTP socket was created */
+	ring = lchan_dl_tch_ring(lchan, 1);
+	if (!ring)
 		return;
-	memcpy(msgb_put(msg, rtp_pl_len), rtp_pl, rtp_pl_len);
-	msgb_pull(msg, sizeof(*l1sap));
-
-
-	 /* make sure the queue doesn't get too long */
-	llist_for_each_entry(tmp, &lchan->dl_tch_queue, list)
-	count++;
-	while (count >= 2) {
-		tmp = msgb_dequeue(&lchan->dl_tch_queue);
-		msgb_free(tmp);
-		count--;
-	}
 
-	msgb_enqueue(&lchan->dl_tch_queue, msg);
+	/* in poll mode, we are called from l1sap_tch_rts_ind() with the
+	 * frame that ortp has sorted into its jitter buffer for rx_user_ts */
+	rc = dl_tch_ring_put(ring, rs->rx_user_ts, rtp_pl, rtp_pl_len);
+	if (rc < 0)
+		LOGP(DL1P, LOGL_DEBUG, "%s dropping DL TCH frame of %u "
+			"bytes (%d)\n", gsm_lchan_name(lchan), rtp_pl_len, rc);
 }
 
 static int l1sap_chan_act_dact_modify(struct gsm_bts_trx *trx, uint8_t chan_nr,
@@ -50,6 +50,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/control_if.h>
+#include <osmo-bts/gsmtap_ring.h>
 
 int quit = 0;
 static const char *config_file = "osmo-bts.cfg";
@@ -269,6 +270,14 @@ int bts_main(int argc, char **argv)
 			exit(1);
 		}
 		gsmtap_source_add_sink(gsmtap);
+
+		/* without the sender thread, gsmtap_send() is used */
+		gsmtap_ring = gsmtap_ring_alloc(tall_bts_ctx, GSMTAP_RING_SLOTS);
+		if (gsmtap_ring && gsmtap_ring_start(gsmtap_ring,
+					gsmtap_inst_fd(gsmtap)) < 0) {
+			gsmtap_ring_free(gsmtap_ring);
+			gsmtap_ring = NULL;
+		}
 	}
 
 	if (bts_init(bts) < 0) {
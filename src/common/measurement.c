@@ -1,7 +1,10 @@
 
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/gsm_data.h>
@@ -41,56 +44,90 @@ static const uint8_t tchh1_meas_rep_fn104[] = {
 	[7] =	90,
 };
 
-/* determine if a measurement period ends at the given frame number */
-static int is_meas_complete(enum gsm_phys_chan_config pchan, unsigned int ts,
-			    unsigned int subch, uint32_t fn)
+/* maximum number of TCH lchans of a TRX whose measurement period ends in the
+ * same frame: TCH/F on TS1 and TCH/H on TS0 and TS1, all at fn % 104 == 12 */
+#define MEAS_REP_PER_FN	3
+
+struct meas_rep {
+	uint8_t ts;
+	uint8_t subch;
+	uint8_t pchan;
+};
+
+/* the inverse of the tables above: TCH lchans whose measurement period ends
+ * at fn % 104 */
+static struct {
+	unsigned int num;
+	struct meas_rep rep[MEAS_REP_PER_FN];
+} tch_meas_rep[104];
+
+static void tch_meas_rep_add(uint8_t fn_mod, uint8_t ts, uint8_t subch,
+			     enum gsm_phys_chan_config pchan)
 {
-	unsigned int fn_mod;
-	const uint8_t *tbl;
-	int rc = 0;
-
-	if (ts >= 8)
-		return -EINVAL;
-	if (pchan >= _GSM_PCHAN_MAX)
-		return -EINVAL;
-
-	switch (pchan) {
-	case GSM_PCHAN_TCH_F:
-		fn_mod = fn % 104;
-		if (tchf_meas_rep_fn104[ts] == fn_mod)
-			rc = 1;
-		break;
-	case GSM_PCHAN_TCH_H:
-		fn_mod = fn % 104;
-		if (subch == 0)	
-			tbl = tchh0_meas_rep_fn104;
-		else
-			tbl = tchh1_meas_rep_fn104;
-		if (tbl[ts] == fn_mod)
-			rc = 1;
-		break;
-	case GSM_PCHAN_SDCCH8_SACCH8C:
-	case GSM_PCHAN_SDCCH8_SACCH8C_CBCH:
-		fn_mod = fn % 102;
-		if (fn_mod == 11)
-			rc = 1;
-		break;
-	case GSM_PCHAN_CCCH_SDCCH4:
-	case GSM_PCHAN_CCCH_SDCCH4_CBCH:
-		fn_mod = fn % 102;
-		if (fn_mod == 36)
-			rc = 1;
-		break;
-	default:
-		rc = 0;
-		break;
+	unsigned int n = tch_meas_rep[fn_mod].num++;
+
+	OSMO_ASSERT(n < MEAS_REP_PER_FN);
+	tch_meas_rep[fn_mod].rep[n].ts = ts;
+	tch_meas_rep[fn_mod].rep[n].subch = subch;
+	tch_meas_rep[fn_mod].rep[n].pchan = pchan;
+}
+
+static void tch_meas_rep_init(void)
+{
+	static int initialized = 0;
+	uint8_t ts;
+
+	if (initialized)
+		return;
+
+	for (ts = 0; ts < 8; ts++) {
+		tch_meas_rep_add(tchf_meas_rep_fn104[ts], ts, 0,
+				 GSM_PCHAN_TCH_F);
+		tch_meas_rep_add(tchh0_meas_rep_fn104[ts], ts, 0,
+				 GSM_PCHAN_TCH_H);
+		tch_meas_rep_add(tchh1_meas_rep_fn104[ts], ts, 1,
+				 GSM_PCHAN_TCH_H);
 	}
-	return rc;
+	initialized = 1;
+}
+
+/*! \brief get the running sums of the uplink measurements of an lchan
+ *  \param[in] create allocate them if there are none yet */
+static struct ul_meas_acc *lchan_ul_meas_acc(struct gsm_lchan *lchan,
+					     int create)
+{
+	struct gsm_bts_trx_ts *ts = lchan->ts;
+	struct gsm_bts_trx *trx = ts->trx;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(trx->bts);
+	struct ul_meas_acc *acc;
+	unsigned int idx, num;
+
+	idx = (trx->nr * ARRAY_SIZE(trx->ts) + ts->nr) * ARRAY_SIZE(ts->lchan)
+		+ lchan->nr;
+
+	if (idx >= btsb->num_ul_meas_acc) {
+		if (!create)
+			return NULL;
+		num = (trx->nr + 1) * ARRAY_SIZE(trx->ts)
+			* ARRAY_SIZE(ts->lchan);
+		acc = talloc_realloc(trx->bts, btsb->ul_meas_acc,
+				     struct ul_meas_acc, num);
+		if (!acc)
+			return NULL;
+		memset(acc + btsb->num_ul_meas_acc, 0,
+		       (num - btsb->num_ul_meas_acc) * sizeof(*acc));
+		btsb->ul_meas_acc = acc;
+		btsb->num_ul_meas_acc = num;
+	}
+
+	return &btsb->ul_meas_acc[idx];
 }
 
 /* receive a L1 uplink measurement from L1 */
 int lchan_new_ul_meas(struct gsm_lchan *lchan, struct bts_ul_meas *ulm)
 {
+	struct ul_meas_acc *acc;
+
 	DEBUGP(DMEAS, "%s adding measurement, num_ul_meas=%d\n",
 		gsm_lchan_name(lchan), lchan->meas.num_ul_meas);
 
@@ -105,8 +142,23 @@ int lchan_new_ul_meas(struct gsm_lchan *lchan, struct bts_ul_meas *ulm)
 		return -ENOSPC;
 	}
 
-	memcpy(&lchan->meas.uplink[lchan->meas.num_ul_meas++], ulm,
-		sizeof(*ulm));
+	acc = lchan_ul_meas_acc(lchan, 1);
+	if (!acc)
+		return -ENOMEM;
+
+	/* the measurements are only summed up, not kept */
+	if (lchan->meas.num_ul_meas == 0)
+		memset(acc, 0, sizeof(*acc));
+	lchan->meas.num_ul_meas++;
+
+	acc->ber_full_sum += ulm->ber10k;
+	acc->irssi_full_sum += ulm->inv_rssi;
+	acc->taqb_sum += ulm->ta_offs_qbits;
+	if (ulm->is_sub) {
+		acc->num_sub++;
+		acc->ber_sub_sum += ulm->ber10k;
+		acc->irssi_sub_sum += ulm->inv_rssi;
+	}
 
 	return 0;
 }
@@ -132,51 +184,33 @@ static uint8_t ber10k_to_rxqual(uint32_t ber10k)
 	return 7;
 }
 
-static int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
+/* compute the measurement results of an lchan whose period has ended */
+static int lchan_meas_check_compute(struct gsm_lchan *lchan)
 {
 	struct gsm_meas_rep_unidir *mru;
-	uint32_t ber_full_sum = 0;
-	uint32_t irssi_full_sum = 0;
+	struct ul_meas_acc *acc;
+	uint32_t ber_full_sum, irssi_full_sum;
 	uint32_t ber_sub_sum = 0;
 	uint32_t irssi_sub_sum = 0;
-	int32_t taqb_sum = 0;
-	unsigned int num_meas_sub = 0;
-	int i;
-
-	/* if measurement period is not complete, abort */
-	if (!is_meas_complete(lchan->ts->pchan, lchan->ts->nr,
-			      lchan->nr, fn))
-		return 0;
+	int32_t taqb_sum;
+	unsigned int num = lchan->meas.num_ul_meas;
 
 	/* if there are no measurements, skip computation */
-	if (lchan->meas.num_ul_meas == 0)
+	if (num == 0)
 		return 0;
 
-	/* compute the actual measurements */
-
-	/* step 1: add up */
-	for (i = 0; i < lchan->meas.num_ul_meas; i++) {
-		struct bts_ul_meas *m = &lchan->meas.uplink[i];
-
-		ber_full_sum += m->ber10k;
-		irssi_full_sum += m->inv_rssi;
-		taqb_sum += m->ta_offs_qbits;
-
-		if (m->is_sub) {
-			num_meas_sub++;
-			ber_sub_sum += m->ber10k;
-			irssi_sub_sum += m->inv_rssi;
-		}
-	}
+	acc = lchan_ul_meas_acc(lchan, 0);
+	if (!acc)
+		return 0;
 
-	/* step 2: divide */
-	ber_full_sum = ber_full_sum / lchan->meas.num_ul_meas;
-	irssi_full_sum = irssi_full_sum / lchan->meas.num_ul_meas;
-	taqb_sum = taqb_sum / lchan->meas.num_ul_meas;
+	/* compute the actual measurements from the running sums */
+	ber_full_sum = acc->ber_full_sum / num;
+	irssi_full_sum = acc->irssi_full_sum / num;
+	taqb_sum = acc->taqb_sum / (int32_t) num;
 
-	if (num_meas_sub) {
-		ber_sub_sum = ber_sub_sum / num_meas_sub;
-		irssi_sub_sum = irssi_sub_sum / num_meas_sub;
+	if (acc->num_sub) {
+		ber_sub_sum = acc->ber_sub_sum / acc->num_sub;
+		irssi_sub_sum = acc->irssi_sub_sum / acc->num_sub;
 	}
 
 	DEBUGP(DMEAS, "%s Computed TA(% 4dqb) BER-FULL(%2u.%02u%%), RSSI-FULL(-%3udBm), "
@@ -214,39 +248,68 @@ static const uint8_t subslots_per_pchan[_GSM_PCHAN_MAX] = {
 	[GSM_PCHAN_TCH_F_PDCH] = 1,
 };
 
-static int ts_meas_check_compute(struct gsm_bts_trx_ts *ts, uint32_t fn)
+static void lchan_meas_check(struct gsm_lchan *lchan)
 {
-	int i;
-	const int num_subslots = subslots_per_pchan[ts->pchan];
+	if (lchan->state != LCHAN_S_ACTIVE)
+		return;
+
+	switch (lchan->type) {
+	case GSM_LCHAN_SDCCH:
+	case GSM_LCHAN_TCH_F:
+	case GSM_LCHAN_TCH_H:
+	case GSM_LCHAN_PDTCH:
+		lchan_meas_check_compute(lchan);
+		break;
+	default:
+		break;
+	}
+}
 
-	for (i = 0; i < num_subslots; ++i) {
-		struct gsm_lchan *lchan = &ts->lchan[i];
+/* all SDCCHs of the timeslots of given pchan */
+static void sdcch_meas_check(struct gsm_bts_trx *trx,
+			     enum gsm_phys_chan_config pchan,
+			     enum gsm_phys_chan_config pchan_cbch)
+{
+	struct gsm_bts_trx_ts *ts;
+	int i, j;
 
-		if (lchan->state != LCHAN_S_ACTIVE)
+	for (i = 0; i < ARRAY_SIZE(trx->ts); i++) {
+		ts = &trx->ts[i];
+		if (ts->pchan != pchan && ts->pchan != pchan_cbch)
 			continue;
-
-		switch (lchan->type) {
-		case GSM_LCHAN_SDCCH:
-		case GSM_LCHAN_TCH_F:
-		case GSM_LCHAN_TCH_H:
-		case GSM_LCHAN_PDTCH:
-			lchan_meas_check_compute(lchan, fn);
-			break;
-		default:
-			break;
-		}
+		for (j = 0; j < subslots_per_pchan[ts->pchan]; j++)
+			lchan_meas_check(&ts->lchan[j]);
 	}
-	return 0;
 }
 
 /* needs to be called once every TDMA frame ! */
 int trx_meas_check_compute(struct gsm_bts_trx *trx, uint32_t fn)
 {
-	int i;
+	const struct meas_rep *rep;
+	struct gsm_bts_trx_ts *ts;
+	unsigned int i, fn_mod = fn % 104;
+
+	tch_meas_rep_init();
+
+	/* TS 05.08, Chapter 8.4.1: only visit the lchans that end their
+	 * measurement period in this frame */
+	for (i = 0; i < tch_meas_rep[fn_mod].num; i++) {
+		rep = &tch_meas_rep[fn_mod].rep[i];
+		ts = &trx->ts[rep->ts];
+		if (ts->pchan == rep->pchan)
+			lchan_meas_check(&ts->lchan[rep->subch]);
+	}
 
-	for (i = 0; i < ARRAY_SIZE(trx->ts); i++) {
-		struct gsm_bts_trx_ts *ts = &trx->ts[i];
-		ts_meas_check_compute(ts, fn);
+	switch (fn % 102) {
+	case 11:
+		sdcch_meas_check(trx, GSM_PCHAN_SDCCH8_SACCH8C,
+				 GSM_PCHAN_SDCCH8_SACCH8C_CBCH);
+		break;
+	case 36:
+		sdcch_meas_check(trx, GSM_PCHAN_CCCH_SDCCH4,
+				 GSM_PCHAN_CCCH_SDCCH4_CBCH);
+		break;
 	}
+
 	return 0;
 }
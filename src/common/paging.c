@@ -28,10 +28,10 @@
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
-#include <time.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/timer.h>
 
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/gsm/gsm0502.h>
@@ -45,6 +45,12 @@
 
 #define MAX_PAGING_BLOCKS_CCCH	9
 #define MAX_BS_PA_MFRMS		9
+#define MAX_PAGING_GROUPS	(MAX_PAGING_BLOCKS_CCCH*MAX_BS_PA_MFRMS)
+
+/* buckets of the identity index, a power of two */
+#define PAGING_HASH_SIZE	256
+/* one slot per second, must be above the maximum lifetime of 60s */
+#define PAGING_WHEEL_SLOTS	64
 
 enum paging_record_type {
 	PAGING_RECORD_PAGING,
@@ -56,7 +62,11 @@ struct paging_record {
 	enum paging_record_type type;
 	union {
 		struct {
-			time_t expiration_time;
+			struct llist_head hash_list;
+			struct llist_head wheel_list;
+			uint8_t group;
+			uint8_t sent;		/* paged at least once */
+			uint8_t expired;	/* free after next paging */
 			uint8_t chan_needed;
 			uint8_t identity_lv[9];
 		} paging;
@@ -66,6 +76,11 @@ struct paging_record {
 	} u;
 };
 
+/* Paging records are indexed by their identity, so that a repeated
+ * PAGING CMD of the BSC is found without walking the group queue.  Their
+ * expiry is kept in a wheel of one second slots, which is advanced by a
+ * timer and drops all records of a slot at once.  A record is paged at
+ * least once, one that expires before is freed when it has been sent. */
 struct paging_state {
 	struct gsm_bts_role_bts *btsb;
 
@@ -78,7 +93,21 @@ struct paging_state {
 
 	/* total number of currently active paging records in queue */
 	unsigned int num_paging;
-	struct llist_head paging_queue[MAX_PAGING_BLOCKS_CCCH*MAX_BS_PA_MFRMS];
+	struct llist_head paging_queue[MAX_PAGING_GROUPS];
+	/* number of records (incl. IMM.ASS) in each group queue */
+	uint16_t group_occupancy[MAX_PAGING_GROUPS];
+
+	struct llist_head hash[PAGING_HASH_SIZE];
+
+	struct llist_head wheel[PAGING_WHEEL_SLOTS];
+	unsigned int wheel_pos;
+	unsigned int num_wheel;
+	struct osmo_timer_list wheel_timer;
+
+	struct {
+		unsigned int duplicates;
+		unsigned int expired;
+	} stats;
 };
 
 unsigned int paging_get_lifetime(struct paging_state *ps)
@@ -172,54 +201,159 @@ int paging_buffer_space(struct paging_state *ps)
 		return ps->num_paging_max - ps->num_paging;
 }
 
+static unsigned int identity_hash(const uint8_t *identity_lv)
+{
+	uint32_t h = 2166136261u;
+	unsigned int i;
+
+	/* FNV-1a, the digits of a TMSI/IMSI are spread well enough */
+	for (i = 0; i <= identity_lv[0]; i++)
+		h = (h ^ identity_lv[i]) * 16777619u;
+
+	return h & (PAGING_HASH_SIZE - 1);
+}
+
+static struct paging_record *find_identity(struct paging_state *ps,
+					   uint8_t paging_group,
+					   const uint8_t *identity_lv)
+{
+	struct llist_head *bucket = &ps->hash[identity_hash(identity_lv)];
+	struct paging_record *pr;
+
+	llist_for_each_entry(pr, bucket, u.paging.hash_list) {
+		if (pr->u.paging.group == paging_group &&
+		    identity_lv[0] == pr->u.paging.identity_lv[0] &&
+		    !memcmp(identity_lv+1, pr->u.paging.identity_lv+1,
+							identity_lv[0]))
+			return pr;
+	}
+
+	return NULL;
+}
+
+/* (re)start the lifetime of a paging record */
+static void wheel_add(struct paging_state *ps, struct paging_record *pr)
+{
+	unsigned int lifetime = ps->paging_lifetime;
+
+	if (!llist_empty(&pr->u.paging.wheel_list)) {
+		llist_del_init(&pr->u.paging.wheel_list);
+		ps->num_wheel--;
+	}
+	pr->u.paging.expired = 0;
+
+	/* page it once and forget about it */
+	if (lifetime == 0) {
+		pr->u.paging.expired = 1;
+		return;
+	}
+	if (lifetime >= PAGING_WHEEL_SLOTS)
+		lifetime = PAGING_WHEEL_SLOTS - 1;
+
+	llist_add_tail(&pr->u.paging.wheel_list,
+		&ps->wheel[(ps->wheel_pos + lifetime) % PAGING_WHEEL_SLOTS]);
+	if (ps->num_wheel++ == 0)
+		osmo_timer_schedule(&ps->wheel_timer, 1, 0);
+}
+
+static void free_paging_record(struct paging_state *ps,
+			       struct paging_record *pr)
+{
+	llist_del(&pr->list);
+	llist_del(&pr->u.paging.hash_list);
+	if (!llist_empty(&pr->u.paging.wheel_list)) {
+		llist_del(&pr->u.paging.wheel_list);
+		ps->num_wheel--;
+	}
+	ps->group_occupancy[pr->u.paging.group]--;
+	ps->num_paging--;
+	talloc_free(pr);
+}
+
+/* advance the wheel by one second and drop what has expired */
+static void paging_wheel_cb(void *data)
+{
+	struct paging_state *ps = data;
+	struct llist_head *slot;
+	struct paging_record *pr, *pr2;
+	unsigned int freed = 0;
+
+	ps->wheel_pos = (ps->wheel_pos + 1) % PAGING_WHEEL_SLOTS;
+	slot = &ps->wheel[ps->wheel_pos];
+
+	llist_for_each_entry_safe(pr, pr2, slot, u.paging.wheel_list) {
+		ps->stats.expired++;
+		if (pr->u.paging.sent) {
+			free_paging_record(ps, pr);
+			freed++;
+		} else {
+			/* not paged yet, leave that to paging_gen_msg() */
+			llist_del_init(&pr->u.paging.wheel_list);
+			ps->num_wheel--;
+			pr->u.paging.expired = 1;
+		}
+	}
+
+	if (freed)
+		LOGP(DPAG, LOGL_INFO, "Removed %u expired paging records, "
+			"queue_len=%u\n", freed, ps->num_paging);
+
+	if (ps->num_wheel)
+		osmo_timer_schedule(&ps->wheel_timer, 1, 0);
+}
+
 /* Add an identity to the paging queue */
 int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 			const uint8_t *identity_lv, uint8_t chan_needed)
 {
-	struct llist_head *group_q = &ps->paging_queue[paging_group];
+	struct llist_head *group_q;
 	struct paging_record *pr;
 
+	if (paging_group >= ARRAY_SIZE(ps->paging_queue))
+		return -EINVAL;
+	group_q = &ps->paging_queue[paging_group];
+
+	/* Check if we already have this identity */
+	pr = find_identity(ps, paging_group, identity_lv);
+	if (pr) {
+		LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
+		ps->stats.duplicates++;
+		wheel_add(ps, pr);
+		return -EEXIST;
+	}
+
 	if (ps->num_paging >= ps->num_paging_max) {
 		LOGP(DPAG, LOGL_NOTICE, "Dropping paging, queue full (%u)\n",
 			ps->num_paging);
 		return -ENOSPC;
 	}
 
-	/* Check if we already have this identity */
-	llist_for_each_entry(pr, group_q, list) {
-		if (pr->type != PAGING_RECORD_PAGING)
-			continue;
-		if (identity_lv[0] == pr->u.paging.identity_lv[0] &&
-		    !memcmp(identity_lv+1, pr->u.paging.identity_lv+1,
-							identity_lv[0])) {
-			LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
-			pr->u.paging.expiration_time =
-					time(NULL) + ps->paging_lifetime;
-			return -EEXIST;
-		}
-	}
+	if (*identity_lv + 1 > sizeof(pr->u.paging.identity_lv))
+		return -E2BIG;
 
 	pr = talloc_zero(ps, struct paging_record);
 	if (!pr)
 		return -ENOMEM;
 	pr->type = PAGING_RECORD_PAGING;
 
-	if (*identity_lv + 1 > sizeof(pr->u.paging.identity_lv)) {
-		talloc_free(pr);
-		return -E2BIG;
-	}
-
 	LOGP(DPAG, LOGL_INFO, "Add paging to queue (group=%u, queue_len=%u)\n",
 		paging_group, ps->num_paging+1);
 
-	pr->u.paging.expiration_time = time(NULL) + ps->paging_lifetime;
+	pr->u.paging.group = paging_group;
 	pr->u.paging.chan_needed = chan_needed;
 	memcpy(&pr->u.paging.identity_lv, identity_lv, identity_lv[0]+1);
 
+	llist_add(&pr->u.paging.hash_list,
+		  &ps->hash[identity_hash(identity_lv)]);
+	INIT_LLIST_HEAD(&pr->u.paging.wheel_list);
+	wheel_add(ps, pr);
+
 	/* enqueue the new identity to the HEAD of the queue,
 	 * to ensure it will be paged quickly at least once.  */
 	llist_add(&pr->list, group_q);
+	ps->group_occupancy[paging_group]++;
 	ps->num_paging++;
+	ps->btsb->ccch_sched.pag_arrivals++;
 
 	return 0;
 }
@@ -256,6 +390,8 @@ int paging_add_imm_ass(struct paging_state *ps, const uint8_t *data,
 
 	/* enqueue the new message to the HEAD of the queue */
 	llist_add(&pr->list, group_q);
+	ps->group_occupancy[paging_group]++;
+	ps->btsb->ccch_sched.pag_arrivals++;
 
 	return 0;
 }
@@ -376,6 +512,30 @@ static void sort_pr_tmsi_imsi(struct paging_record *pr[], unsigned int n)
 	}
 }
 
+/* Only the head of the queue is checked: new records and IMM.ASS are
+ * added there, records that have been paged are moved to the tail. */
+enum paging_pending paging_block_pending(struct paging_state *ps,
+					 struct gsm_time *gt)
+{
+	struct llist_head *group_q;
+	struct paging_record *pr;
+	int group;
+
+	group = get_pag_subch_nr(ps, gt);
+	if (group < 0)
+		return PAGING_PENDING_NONE;
+
+	group_q = &ps->paging_queue[group];
+	if (llist_empty(group_q))
+		return PAGING_PENDING_NONE;
+
+	pr = llist_entry(group_q->next, struct paging_record, list);
+	if (pr->type == PAGING_RECORD_IMM_ASS || !pr->u.paging.sent)
+		return PAGING_PENDING_NEW;
+
+	return PAGING_PENDING_REPEAT;
+}
+
 /* generate paging message for given gsm time */
 int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *gt,
 		   int *is_empty)
@@ -406,7 +566,6 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 	} else {
 		struct paging_record *pr[4];
 		unsigned int num_pr = 0, imm_ass = 0;
-		time_t now = time(NULL);
 		unsigned int i, num_imsi = 0;
 
 		ps->btsb->load.ccch.pch_used += 1;
@@ -442,6 +601,7 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 			pcu_tx_pch_data_cnf(gt->fn, pr[num_pr]->u.imm_ass.msg,
 							GSM_MACBLOCK_LEN);
 			talloc_free(pr[num_pr]);
+			ps->group_occupancy[group]--;
 			return GSM_MACBLOCK_LEN;
 		}
 
@@ -503,15 +663,15 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 			/* skip those that we might have re-added above */
 			if (pr[i] == NULL)
 				continue;
-			/* check if we can expire the paging record,
-			 * or if we need to re-queue it */
-			if (pr[i]->u.paging.expiration_time <= now) {
-				talloc_free(pr[i]);
-				ps->num_paging--;
+			/* re-queue it, unless it expired before it could
+			 * be paged for the first time */
+			llist_add_tail(&pr[i]->list, group_q);
+			pr[i]->u.paging.sent = 1;
+			if (pr[i]->u.paging.expired) {
+				free_paging_record(ps, pr[i]);
 				LOGP(DPAG, LOGL_INFO, "Removed paging record, queue_len=%u\n",
 					ps->num_paging);
-			} else
-				llist_add_tail(&pr[i]->list, group_q);
+			}
 		}
 	}
 	memset(out_buf+len, 0x2B, GSM_MACBLOCK_LEN-len);
@@ -568,6 +728,12 @@ struct paging_state *paging_init(struct gsm_bts_role_bts *btsb,
 
 	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++)
 		INIT_LLIST_HEAD(&ps->paging_queue[i]);
+	for (i = 0; i < ARRAY_SIZE(ps->hash); i++)
+		INIT_LLIST_HEAD(&ps->hash[i]);
+	for (i = 0; i < ARRAY_SIZE(ps->wheel); i++)
+		INIT_LLIST_HEAD(&ps->wheel[i]);
+	ps->wheel_timer.cb = paging_wheel_cb;
+	ps->wheel_timer.data = ps;
 
 	if (!initialized) {
 		osmo_signal_register_handler(SS_GLOBAL, paging_signal_cbfn, NULL);
@@ -592,9 +758,13 @@ void paging_reset(struct paging_state *ps)
 		struct llist_head *queue = &ps->paging_queue[i];
 		struct paging_record *pr, *pr2;
 		llist_for_each_entry_safe(pr, pr2, queue, list) {
+			if (pr->type == PAGING_RECORD_PAGING) {
+				free_paging_record(ps, pr);
+				continue;
+			}
 			llist_del(&pr->list);
 			talloc_free(pr);
-			ps->num_paging--;
+			ps->group_occupancy[i]--;
 		}
 	}
 
@@ -602,6 +772,7 @@ void paging_reset(struct paging_state *ps)
 		LOGP(DPAG, LOGL_NOTICE, "num_paging != 0 after flushing all records?!?\n");
 
 	ps->num_paging = 0;
+	osmo_timer_del(&ps->wheel_timer);
 }
 
 /**
@@ -618,3 +789,36 @@ int paging_queue_length(struct paging_state *ps)
 {
 	return ps->num_paging;
 }
+
+/* number of records waiting in a paging group */
+unsigned int paging_group_occupancy(struct paging_state *ps, uint8_t grp)
+{
+	if (grp >= ARRAY_SIZE(ps->group_occupancy))
+		return 0;
+	return ps->group_occupancy[grp];
+}
+
+/* the paging group with most records waiting */
+unsigned int paging_busiest_group(struct paging_state *ps,
+				  unsigned int *occupancy)
+{
+	unsigned int i, grp = 0;
+
+	for (i = 1; i < ARRAY_SIZE(ps->group_occupancy); i++) {
+		if (ps->group_occupancy[i] > ps->group_occupancy[grp])
+			grp = i;
+	}
+	*occupancy = ps->group_occupancy[grp];
+
+	return grp;
+}
+
+unsigned int paging_get_duplicates(struct paging_state *ps)
+{
+	return ps->stats.duplicates;
+}
+
+unsigned int paging_get_expired(struct paging_state *ps)
+{
+	return ps->stats.expired;
+}
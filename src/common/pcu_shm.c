@@ -0,0 +1,239 @@
+/* Shared memory transport of the PCU interface */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* On the socket, every primitive exchanged with the PCU costs a write()
+ * and a read() on both sides, plus a msgb.  With the shared memory, both
+ * sides copy fixed size records in and out of two rings, see
+ * pcuif_proto.h, and a system call is only needed to wake up a side that
+ * has nothing left to do. */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+
+#include "btsconfig.h"
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/pcu_shm.h>
+
+static void eventfd_signal(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0) {
+		/* the counter can only overflow after 2^64 - 1 signals */
+	}
+}
+
+static int shm_create(size_t size)
+{
+	int fd;
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("osmo-bts-pcu", MFD_CLOEXEC);
+#else
+	char path[] = "/dev/shm/osmo-bts-pcu-XXXXXX";
+
+	fd = mkstemp(path);
+	if (fd >= 0)
+		unlink(path);
+#endif
+	if (fd < 0)
+		return -errno;
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	return fd;
+}
+
+/*! \brief create the shared memory and the doorbells */
+struct pcu_shm *pcu_shm_alloc(void *ctx)
+{
+	struct pcu_shm *shm;
+	void *mem;
+
+	shm = talloc_zero(ctx, struct pcu_shm);
+	if (!shm)
+		return NULL;
+	shm->to_pcu_fd = -1;
+	shm->from_pcu_ofd.fd = -1;
+
+	shm->mem_fd = shm_create(sizeof(*shm->mem));
+	if (shm->mem_fd < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Cannot create shared memory: %s\n",
+			strerror(-shm->mem_fd));
+		talloc_free(shm);
+		return NULL;
+	}
+
+	mem = mmap(NULL, sizeof(*shm->mem), PROT_READ | PROT_WRITE,
+		   MAP_SHARED, shm->mem_fd, 0);
+	if (mem == MAP_FAILED) {
+		LOGP(DPCU, LOGL_ERROR, "Cannot map shared memory: %s\n",
+			strerror(errno));
+		close(shm->mem_fd);
+		talloc_free(shm);
+		return NULL;
+	}
+	shm->mem = mem;
+
+	shm->to_pcu_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	shm->from_pcu_ofd.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (shm->to_pcu_fd < 0 || shm->from_pcu_ofd.fd < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Cannot create doorbells: %s\n",
+			strerror(errno));
+		pcu_shm_free(shm);
+		return NULL;
+	}
+
+	/* ftruncate() zeroed the memory, and the BTS waits for records */
+	shm->mem->version = PCU_IF_SHM_VERSION;
+	shm->mem->num_slots = PCU_IF_SHM_SLOTS;
+	shm->mem->from_pcu.wait = 1;
+
+	return shm;
+}
+
+void pcu_shm_free(struct pcu_shm *shm)
+{
+	if (shm->from_pcu_ofd.fd >= 0) {
+		if (shm->rx_cb)
+			osmo_fd_unregister(&shm->from_pcu_ofd);
+		close(shm->from_pcu_ofd.fd);
+	}
+	if (shm->to_pcu_fd >= 0)
+		close(shm->to_pcu_fd);
+	munmap(shm->mem, sizeof(*shm->mem));
+	close(shm->mem_fd);
+	talloc_free(shm);
+}
+
+static int shm_doorbell_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct pcu_shm *shm = ofd->data;
+	uint64_t count;
+	int rc;
+
+	if (read(ofd->fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return -errno;
+
+	rc = pcu_shm_rx(shm);
+	/* stop reading a corrupt ring until the PCU disconnects */
+	if (rc < 0)
+		ofd->when &= ~BSC_FD_READ;
+
+	return rc;
+}
+
+/*! \brief receive records from the PCU in the main loop
+ *  \param[in] rx_cb called for every record */
+int pcu_shm_start(struct pcu_shm *shm, pcu_shm_rx_cb *rx_cb, void *data)
+{
+	int rc;
+
+	shm->rx_cb = rx_cb;
+	shm->data = data;
+
+	shm->from_pcu_ofd.when = BSC_FD_READ;
+	shm->from_pcu_ofd.cb = shm_doorbell_cb;
+	shm->from_pcu_ofd.data = shm;
+	rc = osmo_fd_register(&shm->from_pcu_ofd);
+	if (rc < 0)
+		shm->rx_cb = NULL;
+
+	return rc;
+}
+
+/*! \brief get the next free record of the ring to the PCU
+ *  \returns record to be filled in and passed to pcu_shm_tx_commit(), or
+ *	     NULL if the ring is full */
+struct gsm_pcu_if *pcu_shm_tx_slot(struct pcu_shm *shm)
+{
+	struct gsm_pcu_if_shm_ring *r = &shm->mem->to_pcu;
+	uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	if (r->head - tail >= PCU_IF_SHM_SLOTS) {
+		shm->stats.tx_full++;
+		return NULL;
+	}
+
+	return &r->rec[r->head % PCU_IF_SHM_SLOTS];
+}
+
+/*! \brief pass the record of pcu_shm_tx_slot() to the PCU */
+void pcu_shm_tx_commit(struct pcu_shm *shm)
+{
+	struct gsm_pcu_if_shm_ring *r = &shm->mem->to_pcu;
+
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+	shm->stats.tx++;
+
+	/* pairs with the fence of the PCU between setting wait and checking
+	 * head: either it sees the record, or we see wait */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->wait, __ATOMIC_RELAXED)
+	 && __atomic_exchange_n(&r->wait, 0, __ATOMIC_ACQ_REL)) {
+		eventfd_signal(shm->to_pcu_fd);
+		shm->stats.doorbells++;
+	}
+}
+
+/*! \brief handle all records received from the PCU
+ *  \returns number of records, or negative errno */
+int pcu_shm_rx(struct pcu_shm *shm)
+{
+	struct gsm_pcu_if_shm_ring *r = &shm->mem->from_pcu;
+	uint32_t head, tail = r->tail;
+	int count = 0;
+
+	do {
+		while ((head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+		       != tail) {
+			/* head is written by the PCU, don't trust it */
+			if (head - tail > PCU_IF_SHM_SLOTS) {
+				LOGP(DPCU, LOGL_ERROR, "PCU shared memory ring "
+					"corrupt (head=%u tail=%u)\n",
+					head, tail);
+				return -EIO;
+			}
+			shm->rx_cb(shm, &r->rec[tail % PCU_IF_SHM_SLOTS]);
+			shm->stats.rx++;
+			count++;
+			/* the record may be reused once tail has passed it */
+			__atomic_store_n(&r->tail, ++tail, __ATOMIC_RELEASE);
+		}
+
+		/* ask for the doorbell, then check once more */
+		__atomic_store_n(&r->wait, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != tail);
+
+	return count;
+}
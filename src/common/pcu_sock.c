@@ -22,6 +22,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,8 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/pcu_if.h>
@@ -40,6 +43,7 @@
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/signal.h>
 #include <osmo-bts/l1sap.h>
+#include <osmo-bts/pcu_shm.h>
 
 uint32_t trx_get_hlayer1(struct gsm_bts_trx *trx);
 
@@ -58,6 +62,11 @@ static const char *sapi_string[] = {
 };
 
 static int pcu_sock_send(struct gsm_network *net, struct msgb *msg);
+static struct gsm_pcu_if *pcu_prim_alloc(uint8_t msg_type, uint8_t bts_nr,
+	struct msgb **msg);
+static int pcu_prim_send(struct gsm_network *net, struct msgb *msg);
+static struct gsm_pcu_if_fn_ind *pcu_fn_ind_get(int is_time,
+	uint32_t rts_fn);
 /* FIXME: move this to libosmocore */
 int osmo_unixsock_listen(struct osmo_fd *bfd, int type, const char *path);
 
@@ -132,10 +141,9 @@ int pcu_tx_info_ind(void)
 	bts = llist_entry(net->bts_list.next, struct gsm_bts, list);
 	rlcc = &bts->gprs.cell.rlc_cfg;
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_INFO_IND, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_INFO_IND, bts->nr, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	info_ind = &pcu_prim->u.info_ind;
 	info_ind->version = PCU_IF_VERSION;
 
@@ -147,6 +155,7 @@ int pcu_tx_info_ind(void)
 
 	if (pcu_direct)
 		info_ind->flags |= PCU_IF_FLAG_SYSMO;
+	info_ind->flags |= PCU_IF_FLAG_SHM | PCU_IF_FLAG_FN_IND;
 
 	/* RAI */
 	info_ind->mcc = net->mcc;
@@ -238,7 +247,7 @@ int pcu_tx_info_ind(void)
 		}
 	}
 
-	return pcu_sock_send(net, msg);
+	return pcu_prim_send(net, msg);
 }
 
 static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
@@ -307,15 +316,30 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 	struct gsm_pcu_if_rts_req *rts_req;
+	struct gsm_pcu_if_fn_ind *fn_ind;
+	struct gsm_pcu_if_fn_rts *fn_rts;
 	struct gsm_bts *bts = ts->trx->bts;
 
 	LOGP(DPCU, LOGL_DEBUG, "Sending rts request: is_ptcch=%d arfcn=%d "
 		"block=%d\n", is_ptcch, arfcn, block_nr);
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_RTS_REQ, bts->nr);
-	if (!msg)
+	/* add it to the FN.ind of this frame, if the PCU wants one */
+	fn_ind = pcu_fn_ind_get(0, fn);
+	if (fn_ind) {
+		fn_ind->rts_fn = fn;
+		fn_rts = &fn_ind->rts[fn_ind->num_rts++];
+		fn_rts->sapi = (is_ptcch) ? PCU_IF_SAPI_PTCCH :
+			PCU_IF_SAPI_PDTCH;
+		fn_rts->trx_nr = ts->trx->nr;
+		fn_rts->ts_nr = ts->nr;
+		fn_rts->block_nr = block_nr;
+		fn_rts->arfcn = arfcn;
+		return 0;
+	}
+
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_RTS_REQ, bts->nr, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	rts_req = &pcu_prim->u.rts_req;
 
 	rts_req->sapi = (is_ptcch) ? PCU_IF_SAPI_PTCCH : PCU_IF_SAPI_PDTCH;
@@ -325,7 +349,7 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	rts_req->ts_nr = ts->nr;
 	rts_req->block_nr = block_nr;
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
@@ -341,10 +365,9 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 		"block=%d data=%s\n", is_ptcch, arfcn, block_nr,
 		osmo_hexdump(data, len));
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_DATA_IND, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_DATA_IND, bts->nr, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	data_ind = &pcu_prim->u.data_ind;
 
 	data_ind->sapi = (is_ptcch) ? PCU_IF_SAPI_PTCCH : PCU_IF_SAPI_PDTCH;
@@ -358,7 +381,7 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	memcpy(data_ind->data, data, len);
 	data_ind->len = len;
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 int pcu_tx_rach_ind(struct gsm_bts *bts, int16_t qta, uint8_t ra, uint32_t fn)
@@ -370,10 +393,9 @@ int pcu_tx_rach_ind(struct gsm_bts *bts, int16_t qta, uint8_t ra, uint32_t fn)
 	LOGP(DPCU, LOGL_INFO, "Sending RACH indication: qta=%d, ra=%d, "
 		"fn=%d\n", qta, ra, fn);
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_RACH_IND, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_RACH_IND, bts->nr, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	rach_ind = &pcu_prim->u.rach_ind;
 
 	rach_ind->sapi = PCU_IF_SAPI_RACH;
@@ -381,7 +403,7 @@ int pcu_tx_rach_ind(struct gsm_bts *bts, int16_t qta, uint8_t ra, uint32_t fn)
 	rach_ind->qta = qta;
 	rach_ind->fn = fn;
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 int pcu_tx_time_ind(uint32_t fn)
@@ -389,21 +411,29 @@ int pcu_tx_time_ind(uint32_t fn)
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 	struct gsm_pcu_if_time_ind *time_ind;
+	struct gsm_pcu_if_fn_ind *fn_ind;
 	uint8_t fn13 = fn % 13;
 
 	/* omit frame numbers not starting at a MAC block */
 	if (fn13 != 0 && fn13 != 4 && fn13 != 8)
 		return 0;
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_TIME_IND, 0);
-	if (!msg)
+	/* add it to the FN.ind, if the PCU wants one */
+	fn_ind = pcu_fn_ind_get(1, 0);
+	if (fn_ind) {
+		fn_ind->flags |= PCU_IF_FN_IND_F_TIME;
+		fn_ind->time_fn = fn;
+		return 0;
+	}
+
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_TIME_IND, 0, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	time_ind = &pcu_prim->u.time_ind;
 
 	time_ind->fn = fn;
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
@@ -427,16 +457,15 @@ int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
 		return 0;
 	}
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_PAG_REQ, 0);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_PAG_REQ, 0, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	pag_req = &pcu_prim->u.pag_req;
 
 	pag_req->chan_needed = chan_needed;
 	memcpy(pag_req->identity_lv, identity_lv, identity_lv[0] + 1);
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 int pcu_tx_pch_data_cnf(uint32_t fn, uint8_t *data, uint8_t len)
@@ -452,10 +481,9 @@ int pcu_tx_pch_data_cnf(uint32_t fn, uint8_t *data, uint8_t len)
 
 	LOGP(DPCU, LOGL_INFO, "Sending PCH confirm\n");
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_DATA_CNF, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_DATA_CNF, bts->nr, &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	data_cnf = &pcu_prim->u.data_cnf;
 
 	data_cnf->sapi = PCU_IF_SAPI_PCH;
@@ -463,7 +491,7 @@ int pcu_tx_pch_data_cnf(uint32_t fn, uint8_t *data, uint8_t len)
 	memcpy(data_cnf->data, data, len);
 	data_cnf->len = len;
 
-	return pcu_sock_send(&bts_gsmnet, msg);
+	return pcu_prim_send(&bts_gsmnet, msg);
 }
 
 static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
@@ -570,6 +598,11 @@ static int pcu_rx_act_req(struct gsm_bts *bts,
 	return 0;
 }
 
+static int pcu_rx_shm_req(struct gsm_network *net,
+	struct gsm_pcu_if_shm_req *shm_req);
+static int pcu_rx_feat_req(struct gsm_network *net,
+	struct gsm_pcu_if_feat_req *feat_req);
+
 static int pcu_rx(struct gsm_network *net, uint8_t msg_type,
 	struct gsm_pcu_if *pcu_prim)
 {
@@ -587,6 +620,12 @@ static int pcu_rx(struct gsm_network *net, uint8_t msg_type,
 	case PCU_IF_MSG_ACT_REQ:
 		rc = pcu_rx_act_req(bts, &pcu_prim->u.act_req);
 		break;
+	case PCU_IF_MSG_SHM_REQ:
+		rc = pcu_rx_shm_req(net, &pcu_prim->u.shm_req);
+		break;
+	case PCU_IF_MSG_FEAT_REQ:
+		rc = pcu_rx_feat_req(net, &pcu_prim->u.feat_req);
+		break;
 	default:
 		LOGP(DPCU, LOGL_ERROR, "Received unknwon PCU msg type %d\n",
 			msg_type);
@@ -605,8 +644,56 @@ struct pcu_sock_state {
 	struct osmo_fd listen_bfd;	/* fd for listen socket */
 	struct osmo_fd conn_bfd;	/* fd for connection to lcr */
 	struct llist_head upqueue;	/* queue for sending messages */
+	struct pcu_shm *shm;		/* shared memory, if requested */
+	int shm_active;			/* SHM.cnf was sent */
+	struct rate_ctr_group *ctrs;
+
+	/* FN.ind being collected, sent at the end of this main loop
+	 * iteration or before any other primitive */
+	int fn_ind_active;		/* PCU selected PCU_IF_FLAG_FN_IND */
+	int fn_ind_pending;		/* fn_ind has content */
+	struct gsm_pcu_if_fn_ind fn_ind;
+	struct osmo_timer_list fn_ind_timer;
+};
+
+enum pcu_ctr {
+	PCU_CTR_SHM_OVERFLOW,
+};
+
+static const struct rate_ctr_desc pcu_ctr_desc[] = {
+	[PCU_CTR_SHM_OVERFLOW] = { "shm:overflow",
+		"Messages queued behind a full shared memory ring" },
 };
 
+static const struct rate_ctr_group_desc pcu_ctrg_desc = {
+	.group_name_prefix = "pcu",
+	.group_description = "PCU interface",
+	.num_ctr = ARRAY_SIZE(pcu_ctr_desc),
+	.ctr_desc = pcu_ctr_desc,
+};
+
+static void pcu_fn_ind_flush(struct pcu_sock_state *state);
+
+/* move the queued messages into the shared memory, in order, as long as
+ * the ring has room */
+static void pcu_shm_drain(struct pcu_sock_state *state)
+{
+	struct gsm_pcu_if *pcu_prim;
+	struct msgb *msg;
+
+	while (!llist_empty(&state->upqueue)) {
+		pcu_prim = pcu_shm_tx_slot(state->shm);
+		if (!pcu_prim)
+			return;
+		msg = msgb_dequeue(&state->upqueue);
+		memset(pcu_prim, 0, sizeof(*pcu_prim));
+		memcpy(pcu_prim, msgb_data(msg),
+			OSMO_MIN(msgb_length(msg), sizeof(*pcu_prim)));
+		pcu_shm_tx_commit(state->shm);
+		msgb_free(msg);
+	}
+}
+
 static int pcu_sock_send(struct gsm_network *net, struct msgb *msg)
 {
 	struct pcu_sock_state *state = net->pcu_state;
@@ -629,11 +716,188 @@ static int pcu_sock_send(struct gsm_network *net, struct msgb *msg)
 		return -EIO;
 	}
 	msgb_enqueue(&state->upqueue, msg);
-	conn_bfd->when |= BSC_FD_WRITE;
+	if (state->shm_active)
+		pcu_shm_drain(state);
+	else
+		conn_bfd->when |= BSC_FD_WRITE;
+
+	return 0;
+}
+
+/* Get a primitive to be filled in: the next record of the shared memory,
+ * if the PCU uses it, or else a new msgb.  While messages are queued, new
+ * ones are queued behind them.  Once the PCU uses the shared memory, the
+ * queue is moved into the ring as the PCU frees its records. */
+static struct gsm_pcu_if *pcu_prim_alloc(uint8_t msg_type, uint8_t bts_nr,
+	struct msgb **msg)
+{
+	struct pcu_sock_state *state = bts_gsmnet.pcu_state;
+	struct gsm_pcu_if *pcu_prim;
+
+	/* don't let anything overtake the pending FN.ind */
+	if (state && state->fn_ind_pending && msg_type != PCU_IF_MSG_FN_IND)
+		pcu_fn_ind_flush(state);
+
+	if (state && state->shm_active) {
+		pcu_shm_drain(state);
+		pcu_prim = llist_empty(&state->upqueue) ?
+			pcu_shm_tx_slot(state->shm) : NULL;
+		if (pcu_prim) {
+			memset(pcu_prim, 0, sizeof(*pcu_prim));
+			pcu_prim->msg_type = msg_type;
+			pcu_prim->bts_nr = bts_nr;
+			*msg = NULL;
+			return pcu_prim;
+		}
+		rate_ctr_inc(&state->ctrs->ctr[PCU_CTR_SHM_OVERFLOW]);
+	}
+
+	*msg = pcu_msgb_alloc(msg_type, bts_nr);
+	if (!*msg)
+		return NULL;
+
+	return (struct gsm_pcu_if *) (*msg)->data;
+}
 
+/* send a primitive of pcu_prim_alloc() */
+static int pcu_prim_send(struct gsm_network *net, struct msgb *msg)
+{
+	struct pcu_sock_state *state = net->pcu_state;
+
+	if (msg)
+		return pcu_sock_send(net, msg);
+
+	pcu_shm_tx_commit(state->shm);
 	return 0;
 }
 
+static void pcu_fn_ind_flush(struct pcu_sock_state *state)
+{
+	struct gsm_pcu_if *pcu_prim;
+	struct msgb *msg;
+
+	if (!state->fn_ind_pending)
+		return;
+	state->fn_ind_pending = 0;
+	osmo_timer_del(&state->fn_ind_timer);
+
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_FN_IND, 0, &msg);
+	if (!pcu_prim)
+		return;
+	memcpy(&pcu_prim->u.fn_ind, &state->fn_ind, sizeof(state->fn_ind));
+	if (msg)
+		msgb_trim(msg, PCU_IF_FN_IND_LEN(state->fn_ind.num_rts));
+
+	pcu_prim_send(state->net, msg);
+}
+
+static void pcu_fn_ind_timer_cb(void *data)
+{
+	pcu_fn_ind_flush(data);
+}
+
+/* Get the FN.ind to add a TIME.ind or RTS.req to.  A pending FN.ind is
+ * sent first if it has no room left, already has a time indication or
+ * has RTS.req of another frame.
+ *  \returns NULL if the PCU doesn't use FN.ind */
+static struct gsm_pcu_if_fn_ind *pcu_fn_ind_get(int is_time,
+	uint32_t rts_fn)
+{
+	struct pcu_sock_state *state = bts_gsmnet.pcu_state;
+	struct gsm_pcu_if_fn_ind *fn_ind;
+
+	if (!state || !state->fn_ind_active)
+		return NULL;
+	fn_ind = &state->fn_ind;
+
+	if (state->fn_ind_pending) {
+		if (is_time && (fn_ind->flags & PCU_IF_FN_IND_F_TIME))
+			pcu_fn_ind_flush(state);
+		else if (!is_time && fn_ind->num_rts
+		      && (fn_ind->rts_fn != rts_fn
+		       || fn_ind->num_rts == PCU_IF_FN_IND_MAX_RTS))
+			pcu_fn_ind_flush(state);
+	}
+
+	if (!state->fn_ind_pending) {
+		memset(fn_ind, 0, offsetof(struct gsm_pcu_if_fn_ind, rts));
+		state->fn_ind_pending = 1;
+		/* expires once the main loop is done with this iteration */
+		osmo_timer_schedule(&state->fn_ind_timer, 0, 0);
+	}
+
+	return fn_ind;
+}
+
+static int pcu_rx_feat_req(struct gsm_network *net,
+	struct gsm_pcu_if_feat_req *feat_req)
+{
+	struct pcu_sock_state *state = net->pcu_state;
+
+	LOGP(DPCU, LOGL_INFO, "PCU selects features 0x%08x\n",
+		feat_req->flags);
+
+	state->fn_ind_active = !!(feat_req->flags & PCU_IF_FLAG_FN_IND);
+
+	return 0;
+}
+
+static int pcu_shm_rx_cb(struct pcu_shm *shm, struct gsm_pcu_if *pcu_prim)
+{
+	struct pcu_sock_state *state = shm->data;
+
+	/* the shared memory can't be requested from within itself */
+	if (pcu_prim->msg_type == PCU_IF_MSG_SHM_REQ)
+		return -EINVAL;
+
+	return pcu_rx(state->net, pcu_prim->msg_type, pcu_prim);
+}
+
+static int pcu_rx_shm_req(struct gsm_network *net,
+	struct gsm_pcu_if_shm_req *shm_req)
+{
+	struct pcu_sock_state *state = net->pcu_state;
+	struct gsm_pcu_if_shm_cnf *shm_cnf;
+	struct gsm_pcu_if *pcu_prim;
+	struct msgb *msg;
+
+	if (shm_req->version != PCU_IF_SHM_VERSION) {
+		LOGP(DPCU, LOGL_NOTICE, "PCU requests shared memory version "
+			"%u, we have %u, staying on the socket\n",
+			shm_req->version, PCU_IF_SHM_VERSION);
+		return -EINVAL;
+	}
+	if (state->shm) {
+		LOGP(DPCU, LOGL_NOTICE, "PCU requests shared memory again\n");
+		return -EBUSY;
+	}
+
+	msg = pcu_msgb_alloc(PCU_IF_MSG_SHM_CNF, 0);
+	if (!msg)
+		return -ENOMEM;
+
+	state->shm = pcu_shm_alloc(state);
+	if (!state->shm) {
+		msgb_free(msg);
+		return -ENOMEM;
+	}
+	if (pcu_shm_start(state->shm, pcu_shm_rx_cb, state) < 0) {
+		pcu_shm_free(state->shm);
+		state->shm = NULL;
+		msgb_free(msg);
+		return -EIO;
+	}
+
+	pcu_prim = (struct gsm_pcu_if *) msg->data;
+	shm_cnf = &pcu_prim->u.shm_cnf;
+	shm_cnf->version = PCU_IF_SHM_VERSION;
+	shm_cnf->size = sizeof(struct gsm_pcu_if_shm);
+	shm_cnf->num_slots = PCU_IF_SHM_SLOTS;
+
+	/* the file descriptors are attached in pcu_sock_write() */
+	return pcu_sock_send(net, msg);
+}
+
 static void pcu_sock_close(struct pcu_sock_state *state)
 {
 	struct osmo_fd *bfd = &state->conn_bfd;
@@ -681,22 +945,31 @@ static void pcu_sock_close(struct pcu_sock_state *state)
 		struct msgb *msg = msgb_dequeue(&state->upqueue);
 		msgb_free(msg);
 	}
+
+	state->fn_ind_active = 0;
+	state->fn_ind_pending = 0;
+	osmo_timer_del(&state->fn_ind_timer);
+
+	if (state->shm) {
+		LOGP(DPCU, LOGL_INFO, "PCU shared memory: %u records sent, "
+			"%u received, %u doorbells, ring full %u times\n",
+			state->shm->stats.tx, state->shm->stats.rx,
+			state->shm->stats.doorbells, state->shm->stats.tx_full);
+		pcu_shm_free(state->shm);
+		state->shm = NULL;
+		state->shm_active = 0;
+	}
 }
 
 static int pcu_sock_read(struct osmo_fd *bfd)
 {
 	struct pcu_sock_state *state = (struct pcu_sock_state *)bfd->data;
-	struct gsm_pcu_if *pcu_prim;
-	struct msgb *msg;
+	struct gsm_pcu_if pcu_prim;
 	int rc;
 
-	msg = msgb_alloc(sizeof(*pcu_prim), "pcu_sock_rx");
-	if (!msg)
-		return -ENOMEM;
-
-	pcu_prim = (struct gsm_pcu_if *) msg->tail;
-
-	rc = recv(bfd->fd, msg->tail, msgb_tailroom(msg), 0);
+	/* as we always synchronously process the message in pcu_rx() and
+	 * its callbacks, it can be received on the stack */
+	rc = recv(bfd->fd, &pcu_prim, sizeof(pcu_prim), 0);
 	if (rc == 0)
 		goto close;
 
@@ -706,20 +979,41 @@ static int pcu_sock_read(struct osmo_fd *bfd)
 		goto close;
 	}
 
-	rc = pcu_rx(state->net, pcu_prim->msg_type, pcu_prim);
-
-	/* as we always synchronously process the message in pcu_rx() and
-	 * its callbacks, we can free the message here. */
-	msgb_free(msg);
-
-	return rc;
+	return pcu_rx(state->net, pcu_prim.msg_type, &pcu_prim);
 
 close:
-	msgb_free(msg);
 	pcu_sock_close(state);
 	return -1;
 }
 
+/* send SHM.cnf along with the shared memory and the doorbells */
+static int pcu_sock_write_shm_cnf(struct osmo_fd *bfd, struct msgb *msg,
+	struct pcu_shm *shm)
+{
+	int fds[3] = { shm->mem_fd, shm->to_pcu_fd, shm->from_pcu_ofd.fd };
+	char cbuf[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = {
+		.iov_base = msgb_data(msg),
+		.iov_len = msgb_length(msg),
+	};
+	struct msghdr mh = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+
+	memset(cbuf, 0, sizeof(cbuf));
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	return sendmsg(bfd->fd, &mh, 0);
+}
+
 static int pcu_sock_write(struct osmo_fd *bfd)
 {
 	struct pcu_sock_state *state = bfd->data;
@@ -735,6 +1029,12 @@ static int pcu_sock_write(struct osmo_fd *bfd)
 
 		bfd->when &= ~BSC_FD_WRITE;
 
+		/* the rest of the queue goes into the shared memory */
+		if (state->shm_active) {
+			pcu_shm_drain(state);
+			break;
+		}
+
 		/* bug hunter 8-): maybe someone forgot msgb_put(...) ? */
 		if (!msgb_length(msg)) {
 			LOGP(DPCU, LOGL_ERROR, "message type (%d) with ZERO "
@@ -743,7 +1043,10 @@ static int pcu_sock_write(struct osmo_fd *bfd)
 		}
 
 		/* try to send it over the socket */
-		rc = write(bfd->fd, msgb_data(msg), msgb_length(msg));
+		if (pcu_prim->msg_type == PCU_IF_MSG_SHM_CNF && state->shm)
+			rc = pcu_sock_write_shm_cnf(bfd, msg, state->shm);
+		else
+			rc = write(bfd->fd, msgb_data(msg), msgb_length(msg));
 		if (rc == 0)
 			goto close;
 		if (rc < 0) {
@@ -754,6 +1057,12 @@ static int pcu_sock_write(struct osmo_fd *bfd)
 			goto close;
 		}
 
+		/* from now on, the PCU also reads the shared memory */
+		if (pcu_prim->msg_type == PCU_IF_MSG_SHM_CNF && state->shm) {
+			LOGP(DPCU, LOGL_NOTICE, "PCU uses shared memory\n");
+			state->shm_active = 1;
+		}
+
 dontsend:
 		/* _after_ we send it, we can deueue */
 		msg2 = msgb_dequeue(&state->upqueue);
@@ -842,6 +1151,13 @@ int pcu_sock_init(const char *path)
 	INIT_LLIST_HEAD(&state->upqueue);
 	state->net = &bts_gsmnet;
 	state->conn_bfd.fd = -1;
+	state->fn_ind_timer.cb = pcu_fn_ind_timer_cb;
+	state->fn_ind_timer.data = state;
+	state->ctrs = rate_ctr_group_alloc(state, &pcu_ctrg_desc, 0);
+	if (!state->ctrs) {
+		talloc_free(state);
+		return -ENOMEM;
+	}
 
 	bfd = &state->listen_bfd;
 
@@ -849,6 +1165,7 @@ int pcu_sock_init(const char *path)
 	if (rc < 0) {
 		LOGP(DPCU, LOGL_ERROR, "Could not create unix socket: %s\n",
 			strerror(errno));
+		rate_ctr_group_free(state->ctrs);
 		talloc_free(state);
 		return rc;
 	}
@@ -862,6 +1179,7 @@ int pcu_sock_init(const char *path)
 		LOGP(DPCU, LOGL_ERROR, "Could not register listen fd: %d\n",
 			rc);
 		close(bfd->fd);
+		rate_ctr_group_free(state->ctrs);
 		talloc_free(state);
 		return rc;
 	}
@@ -888,6 +1206,7 @@ void pcu_sock_exit(void)
 	bfd = &state->listen_bfd;
 	close(bfd->fd);
 	osmo_fd_unregister(bfd);
+	rate_ctr_group_free(state->ctrs);
 	talloc_free(state);
 	bts_gsmnet.pcu_state = NULL;
 }
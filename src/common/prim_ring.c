@@ -0,0 +1,388 @@
+/* Lock-free ring for handing L1 primitives from a receive thread to the
+ * main loop */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* When the main loop is busy (RSL, OML, PCU, VTY), primitives of the PHY
+ * wait in the kernel queues of the DSP until it gets back to select().  With
+ * a receive thread, the queues of the PHY are drained as soon as data
+ * arrives, optionally at real-time priority:
+ *
+ *  - the thread waits in poll() on the file descriptors of the PHY and
+ *    reads the primitives straight into the free slots of the ring,
+ *  - it rings an eventfd doorbell once per wakeup,
+ *  - the main loop copies each slot into a msgb and hands it to the usual
+ *    primitive handler.
+ *
+ * The handlers touch all of the BTS state, so they stay in the main loop.
+ * This includes PH-RTS.ind, which goes up through L1SAP to RSL and the PCU:
+ * the thread keeps the DSP queues from backing up while the main loop is
+ * busy, but a slow main loop still delays the reply to a PH-RTS.ind.
+ *
+ * The receive thread never allocates or logs, as talloc and the logging
+ * code are not thread safe.  If the ring is full, the thread waits for the
+ * main loop to free a slot rather than dropping a primitive.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/prim_ring.h>
+
+static void eventfd_signal(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0) {
+		/* the counter can only overflow after 2^64 - 1 signals */
+	}
+}
+
+/*! \brief allocate a ring
+ *  \param[in] num_slots number of slots, rounded up to a power of two
+ *  \param[in] slot_size maximum size of one primitive */
+struct prim_ring *prim_ring_alloc(void *ctx, unsigned int num_slots,
+				  unsigned int slot_size)
+{
+	struct prim_ring *r;
+	unsigned int n = 1;
+
+	while (n < num_slots)
+		n <<= 1;
+
+	r = talloc_zero(ctx, struct prim_ring);
+	if (!r)
+		return NULL;
+	r->num_slots = n;
+	r->slot_size = slot_size;
+	r->buf = talloc_zero_size(r, n * slot_size);
+	r->slots = talloc_zero_array(r, struct prim_ring_slot, n);
+	if (!r->buf || !r->slots) {
+		talloc_free(r);
+		return NULL;
+	}
+	r->wake_fd = -1;
+	r->doorbell.fd = -1;
+
+	return r;
+}
+
+void prim_ring_free(struct prim_ring *r)
+{
+	if (!r)
+		return;
+	prim_ring_stop(r);
+	talloc_free(r);
+}
+
+/*! \brief add a file descriptor to be read by the receive thread */
+int prim_ring_add_fd(struct prim_ring *r, int fd, int tag)
+{
+	if (r->running)
+		return -EBUSY;
+	if (r->num_fds >= PRIM_RING_MAX_FDS)
+		return -ENOSPC;
+
+	r->fds[r->num_fds] = fd;
+	r->tags[r->num_fds] = tag;
+	r->num_fds++;
+
+	return 0;
+}
+
+/*! \brief number of free slots, as seen by the receive thread */
+unsigned int prim_ring_space(struct prim_ring *r)
+{
+	unsigned int tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	return r->num_slots - (r->head - tail);
+}
+
+/*! \brief buffer of the i-th free slot, i < prim_ring_space() */
+uint8_t *prim_ring_slot_buf(struct prim_ring *r, unsigned int i)
+{
+	return r->buf + ((r->head + i) & (r->num_slots - 1)) * r->slot_size;
+}
+
+/*! \brief publish the first free slot to the main loop */
+void prim_ring_produce(struct prim_ring *r, unsigned int len, int tag)
+{
+	struct prim_ring_slot *slot = &r->slots[r->head & (r->num_slots - 1)];
+
+	slot->len = len;
+	slot->tag = tag;
+	r->stats.produced++;
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+/*! \brief oldest primitive not yet consumed, NULL if there is none */
+const uint8_t *prim_ring_peek(struct prim_ring *r, unsigned int *len,
+			      int *tag)
+{
+	unsigned int head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	unsigned int idx;
+
+	if (head == r->tail)
+		return NULL;
+	if (head - r->tail > r->stats.max_fill)
+		r->stats.max_fill = head - r->tail;
+
+	idx = r->tail & (r->num_slots - 1);
+	*len = r->slots[idx].len;
+	*tag = r->slots[idx].tag;
+
+	return r->buf + idx * r->slot_size;
+}
+
+/*! \brief release the slot returned by prim_ring_peek() */
+void prim_ring_consume(struct prim_ring *r)
+{
+	__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+	r->stats.dispatched++;
+
+	/* pairs with the fence in ring_wait_space() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->space_wait, __ATOMIC_RELAXED))
+		eventfd_signal(r->wake_fd);
+}
+
+/*! \brief dispatch all received primitives
+ *  \returns number of primitives dispatched */
+int prim_ring_drain(struct prim_ring *r)
+{
+	const uint8_t *data;
+	unsigned int len;
+	int tag, count = 0;
+	uint32_t full;
+
+	while ((data = prim_ring_peek(r, &len, &tag))) {
+		r->dispatch_cb(r, data, len, tag);
+		prim_ring_consume(r);
+		count++;
+	}
+
+	/* report the first time and then every 1000 times */
+	full = __atomic_load_n(&r->stats.full, __ATOMIC_RELAXED);
+	if ((full && !r->full_reported) || full - r->full_reported >= 1000) {
+		LOGP(DL1C, LOGL_NOTICE, "L1 receive ring was full %u times, "
+			"main loop is lagging behind the PHY\n", full);
+		r->full_reported = full;
+	}
+
+	return count;
+}
+
+static int ring_doorbell_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct prim_ring *r = ofd->data;
+	uint64_t count;
+
+	if (read(ofd->fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return -errno;
+
+	prim_ring_drain(r);
+
+	return 0;
+}
+
+/* wait until the main loop has freed a slot. returns 0 if stopped */
+static int ring_wait_space(struct prim_ring *r)
+{
+	uint64_t count;
+
+	while (!prim_ring_space(r)) {
+		__atomic_store_n(&r->space_wait, 1, __ATOMIC_RELAXED);
+		/* pairs with the fence in prim_ring_consume() */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (!prim_ring_space(r)) {
+			__atomic_add_fetch(&r->stats.full, 1, __ATOMIC_RELAXED);
+			if (read(r->wake_fd, &count, sizeof(count)) < 0
+			 && errno != EINTR)
+				return 0;
+		}
+		__atomic_store_n(&r->space_wait, 0, __ATOMIC_RELAXED);
+		if (__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void *ring_rx_thread(void *arg)
+{
+	struct prim_ring *r = arg;
+	struct pollfd pfd[PRIM_RING_MAX_FDS + 1];
+	uint64_t count;
+	unsigned int i;
+	int rc, produced;
+
+	for (i = 0; i < r->num_fds; i++) {
+		pfd[i].fd = r->fds[i];
+		pfd[i].events = POLLIN;
+	}
+	pfd[r->num_fds].fd = r->wake_fd;
+	pfd[r->num_fds].events = POLLIN;
+
+	while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+		if (!ring_wait_space(r))
+			break;
+
+		rc = poll(pfd, r->num_fds + 1, -1);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		/* a stale wakeup from the main loop, or a stop request */
+		if (pfd[r->num_fds].revents & POLLIN) {
+			if (read(r->wake_fd, &count, sizeof(count)) < 0) {
+				/* nothing to do, re-check stop and space */
+			}
+		}
+
+		produced = 0;
+		for (i = 0; i < r->num_fds; i++) {
+			if (!(pfd[i].revents & (POLLIN | POLLERR)))
+				continue;
+			if (!ring_wait_space(r))
+				break;
+			rc = r->rx_cb(r, pfd[i].fd, r->tags[i]);
+			if (rc < 0)
+				__atomic_add_fetch(&r->stats.rx_errors, 1,
+					__ATOMIC_RELAXED);
+			else
+				produced += rc;
+		}
+
+		if (produced)
+			eventfd_signal(r->doorbell.fd);
+	}
+
+	return NULL;
+}
+
+/*! \brief start the receive thread
+ *  \param[in] rx_cb reads from one fd on the receive thread
+ *  \param[in] dispatch_cb handles one primitive in the main loop
+ *  \param[in] rt_prio SCHED_FIFO priority of the thread, 0 for none */
+int prim_ring_start(struct prim_ring *r, prim_ring_rx_cb *rx_cb,
+		    prim_ring_dispatch_cb *dispatch_cb, void *data,
+		    int rt_prio)
+{
+	struct sched_param param;
+	int rc;
+
+	if (r->running)
+		return -EBUSY;
+
+	r->rx_cb = rx_cb;
+	r->dispatch_cb = dispatch_cb;
+	r->data = data;
+	r->rt_prio = rt_prio;
+	r->head = r->tail = 0;
+	r->stop = 0;
+	r->space_wait = 0;
+
+	r->wake_fd = eventfd(0, 0);
+	if (r->wake_fd < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot create eventfd for L1 receive "
+			"thread: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	rc = eventfd(0, EFD_NONBLOCK);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot create eventfd for L1 receive "
+			"thread: %s\n", strerror(errno));
+		rc = -errno;
+		goto out_wake;
+	}
+	r->doorbell.fd = rc;
+	r->doorbell.when = BSC_FD_READ;
+	r->doorbell.cb = ring_doorbell_cb;
+	r->doorbell.data = r;
+	r->doorbell.priv_nr = 0;
+	rc = osmo_fd_register(&r->doorbell);
+	if (rc < 0)
+		goto out_doorbell;
+
+	rc = pthread_create(&r->thread, NULL, ring_rx_thread, r);
+	if (rc) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot start L1 receive thread: %s\n",
+			strerror(rc));
+		rc = -rc;
+		osmo_fd_unregister(&r->doorbell);
+		goto out_doorbell;
+	}
+	r->running = 1;
+
+	if (rt_prio > 0) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = rt_prio;
+		rc = pthread_setschedparam(r->thread, SCHED_FIFO, &param);
+		if (rc)
+			LOGP(DL1C, LOGL_ERROR, "Cannot set real-time priority "
+				"%d of L1 receive thread: %s\n", rt_prio,
+				strerror(rc));
+	}
+
+	LOGP(DL1C, LOGL_NOTICE, "Receiving L1 primitives on a separate thread "
+		"(%u slots, priority %d)\n", r->num_slots, rt_prio);
+
+	return 0;
+
+out_doorbell:
+	close(r->doorbell.fd);
+	r->doorbell.fd = -1;
+out_wake:
+	close(r->wake_fd);
+	r->wake_fd = -1;
+	return rc;
+}
+
+/*! \brief stop the receive thread, undispatched primitives are dropped */
+void prim_ring_stop(struct prim_ring *r)
+{
+	if (!r->running)
+		return;
+
+	__atomic_store_n(&r->stop, 1, __ATOMIC_RELEASE);
+	eventfd_signal(r->wake_fd);
+	pthread_join(r->thread, NULL);
+	r->running = 0;
+	r->head = r->tail = 0;
+
+	osmo_fd_unregister(&r->doorbell);
+	close(r->doorbell.fd);
+	r->doorbell.fd = -1;
+	close(r->wake_fd);
+	r->wake_fd = -1;
+}
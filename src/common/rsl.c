@@ -49,6 +49,7 @@
 #include <osmo-bts/handover.h>
 #include <osmo-bts/cbch.h>
 #include <osmo-bts/l1sap.h>
+#include <osmo-bts/dl_tch_ring.h>
 #include <osmo-bts/bts_model.h>
 
 //#define FAKE_CIPH_MODE_COMPL
@@ -444,6 +445,7 @@ static int rsl_rx_sms_bcast_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 {
 	struct tlv_parsed tp;
 	struct rsl_ie_cb_cmd_type *cb_cmd_type;
+	int extended = 0;
 
 	rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg));
 
@@ -454,7 +456,11 @@ static int rsl_rx_sms_bcast_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 	cb_cmd_type = (struct rsl_ie_cb_cmd_type *)
 					TLVP_VAL(&tp, RSL_IE_CB_CMD_TYPE);
 
-	return bts_process_smscb_cmd(trx->bts, *cb_cmd_type,
+	/* 9.3.44 SMSCB Channel Indicator, basic CBCH if absent */
+	if (TLVP_PRESENT(&tp, RSL_IE_SMSCB_CHAN_INDICATOR))
+		extended = (*TLVP_VAL(&tp, RSL_IE_SMSCB_CHAN_INDICATOR) & 0x0f) == 1;
+
+	return bts_process_smscb_cmd(trx->bts, *cb_cmd_type, extended,
 				     TLVP_LEN(&tp, RSL_IE_SMSCB_MSG),
 				     TLVP_VAL(&tp, RSL_IE_SMSCB_MSG));
 }
@@ -895,7 +901,7 @@ static int rsl_rx_rf_chan_rel(struct gsm_lchan *lchan, uint8_t chan_nr)
 		rsl_tx_ipac_dlcx_ind(lchan, RSL_ERR_NORMAL_UNSPEC);
 		osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 		lchan->abis_ip.rtp_socket = NULL;
-		msgb_queue_flush(&lchan->dl_tch_queue);
+		lchan_dl_tch_ring_reset(lchan);
 	}
 
 	/* release handover state */
@@ -1505,6 +1511,8 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 					  btsb->rtp_jitter_buf_ms);
 		lchan->abis_ip.rtp_socket->priv = lchan;
 		lchan->abis_ip.rtp_socket->rx_cb = &l1sap_rtp_rx_cb;
+		/* allocate the jitter ring now, not on the first frame */
+		lchan_dl_tch_ring(lchan, 1);
 
 		if (connect_ip && connect_port) {
 			/* if CRCX specifies a remote IP, we can bind()
@@ -1528,7 +1536,7 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 			     gsm_lchan_name(lchan));
 			osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 			lchan->abis_ip.rtp_socket = NULL;
-			msgb_queue_flush(&lchan->dl_tch_queue);
+			lchan_dl_tch_ring_reset(lchan);
 			return tx_ipac_XXcx_nack(lchan, RSL_ERR_RES_UNAVAIL,
 						 inc_ip_port, dch->c.msg_type);
 		}
@@ -1562,7 +1570,7 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 		     gsm_lchan_name(lchan));
 		osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 		lchan->abis_ip.rtp_socket = NULL;
-		msgb_queue_flush(&lchan->dl_tch_queue);
+		lchan_dl_tch_ring_reset(lchan);
 		return tx_ipac_XXcx_nack(lchan, RSL_ERR_RES_UNAVAIL,
 					 inc_ip_port, dch->c.msg_type);
 	}
@@ -1617,7 +1625,7 @@ static int rsl_rx_ipac_dlcx(struct msgb *msg)
 	rc = rsl_tx_ipac_dlcx_ack(lchan, inc_conn_id);
 	osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 	lchan->abis_ip.rtp_socket = NULL;
-	msgb_queue_flush(&lchan->dl_tch_queue);
+	lchan_dl_tch_ring_reset(lchan);
 	return rc;
 }
 
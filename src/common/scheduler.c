@@ -25,11 +25,11 @@
 #include <errno.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <string.h>
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/bits.h>
-#include <osmocom/gsm/a5.h>
 
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/logging.h>
@@ -130,6 +130,240 @@ const struct trx_chan_desc trx_chan_desc[_TRX_CHAN_MAX] = {
 };
 
 
+/* Each TX primitive is queued to the logical channel that owns its
+ * chan_nr / link_id, so that a channel only looks at its own queue.  The
+ * owner is the first entry of trx_chan_desc[] with matching chan_nr and
+ * link_id, channels sharing the same values (TCH/F, PDTCH and PTCCH) share
+ * the same queue.  The map is indexed by chan_nr >> 3 and link_id >> 6. */
+static uint8_t dl_queue_map[32][4];
+static int dl_queue_map_valid;
+
+static void dl_queue_map_init(void)
+{
+	int i;
+
+	if (dl_queue_map_valid)
+		return;
+
+	for (i = _TRX_CHAN_MAX - 1; i > TRXC_IDLE; i--) {
+		if (!trx_chan_desc[i].dl_fn || !trx_chan_desc[i].chan_nr)
+			continue;
+		dl_queue_map[trx_chan_desc[i].chan_nr >> 3]
+			[trx_chan_desc[i].link_id >> 6] = i;
+	}
+	dl_queue_map_valid = 1;
+}
+
+struct l1sched_dl_queue *trx_sched_dl_queue(struct l1sched_ts *l1ts,
+	uint8_t chan_nr, uint8_t link_id)
+{
+	uint8_t chan = dl_queue_map[chan_nr >> 3][link_id >> 6];
+
+	if (chan == TRXC_IDLE)
+		return NULL;
+
+	return &l1ts->dl_queue[chan];
+}
+
+static void dl_queue_flush(struct l1sched_dl_queue *queue)
+{
+	msgb_queue_flush(&queue->prims);
+	queue->depth = 0;
+}
+
+/* get chan_nr, link_id and fn of a TX primitive */
+static int dl_prim_info(struct msgb *msg, uint8_t *chan_nr, uint8_t *link_id,
+	uint32_t *fn)
+{
+	struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+
+	if (l1sap->oph.operation != PRIM_OP_REQUEST)
+		return -EINVAL;
+
+	switch (l1sap->oph.primitive) {
+	case PRIM_PH_DATA:
+		*chan_nr = l1sap->u.data.chan_nr;
+		*link_id = l1sap->u.data.link_id;
+		*fn = l1sap->u.data.fn;
+		return 0;
+	case PRIM_TCH:
+		*chan_nr = l1sap->u.tch.chan_nr;
+		*link_id = 0;
+		*fn = l1sap->u.tch.fn;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* queue primitive, keeping the queue ordered by fn. upper layers send
+ * in order of fn, so this normally appends without walking the queue. */
+static int dl_queue_prim(struct l1sched_trx *l1t, struct l1sched_ts *l1ts,
+	struct msgb *msg)
+{
+	struct l1sched_dl_queue *queue;
+	struct msgb *prev;
+	uint8_t chan_nr, link_id, prev_chan_nr, prev_link_id;
+	uint32_t fn, prev_fn;
+
+	if (dl_prim_info(msg, &chan_nr, &link_id, &fn) < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Prim for trx=%u has wrong type.\n",
+			l1t->trx->nr);
+		msgb_free(msg);
+		return -EINVAL;
+	}
+
+	queue = trx_sched_dl_queue(l1ts, chan_nr, link_id);
+	if (!queue) {
+		LOGP(DL1C, LOGL_ERROR, "Prim for trx=%u has invalid "
+			"chan_nr=%02x link_id=%02x.\n", l1t->trx->nr, chan_nr,
+			link_id);
+		msgb_free(msg);
+		return -EINVAL;
+	}
+
+	llist_for_each_entry_reverse(prev, &queue->prims, list) {
+		dl_prim_info(prev, &prev_chan_nr, &prev_link_id, &prev_fn);
+		/* stop at the first primitive not later than this one */
+		if ((prev_fn + GSM_HYPERFRAME - fn) % GSM_HYPERFRAME
+						>= GSM_HYPERFRAME / 2
+		 || prev_fn == fn)
+			break;
+	}
+	llist_add(&msg->list, &prev->list);
+
+	queue->depth++;
+	if (queue->depth > queue->depth_max)
+		queue->depth_max = queue->depth;
+
+	return 0;
+}
+
+
+/*
+ * burst buffers
+ */
+
+/* size of the burst buffer of a logical channel, as the TX / RX functions
+ * of the backend use it: TCH/F interleaves over 8 bursts, TCH/H over 6,
+ * the other channels over 4 */
+static size_t sched_bursts_len(enum trx_chan_type chan)
+{
+	switch (chan) {
+	case TRXC_IDLE:
+	case TRXC_FCCH:
+	case TRXC_SCH:
+	case TRXC_RACH:
+		return 0;
+	case TRXC_TCHF:
+		return 928;
+	case TRXC_TCHH_0:
+	case TRXC_TCHH_1:
+		return 696;
+	default:
+		/* SACCH keeps its last bad block, to combine a repetition */
+		if (L1SAP_IS_LINK_SACCH(trx_chan_desc[chan].link_id))
+			return 2 * 464;
+		return 464;
+	}
+}
+
+static size_t sched_bursts_align(size_t len)
+{
+	return (len + TRX_SCHED_BURSTS_ALIGN - 1)
+		& ~(size_t)(TRX_SCHED_BURSTS_ALIGN - 1);
+}
+
+/* allocate the burst buffers of all logical channels of all timeslots at
+ * once, so that activating a channel never allocates memory */
+static int sched_bursts_slab_alloc(struct l1sched_trx *l1t)
+{
+	uint8_t *buf;
+	size_t size = 0, len;
+	uint8_t tn;
+	int i;
+
+	for (i = 0; i < _TRX_CHAN_MAX; i++) {
+		len = sched_bursts_align(sched_bursts_len(i));
+		if (trx_chan_desc[i].dl_fn)
+			size += len;
+		if (trx_chan_desc[i].ul_fn)
+			size += len;
+	}
+	size *= ARRAY_SIZE(l1t->ts);
+
+	l1t->bursts_slab = talloc_zero_size(tall_bts_ctx,
+					    size + TRX_SCHED_BURSTS_ALIGN - 1);
+	if (!l1t->bursts_slab)
+		return -ENOMEM;
+	l1t->bursts_slab_size = size;
+
+	buf = (uint8_t *) sched_bursts_align((size_t) l1t->bursts_slab);
+	for (tn = 0; tn < ARRAY_SIZE(l1t->ts); tn++) {
+		struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+		for (i = 0; i < _TRX_CHAN_MAX; i++) {
+			len = sched_bursts_align(sched_bursts_len(i));
+			if (len && trx_chan_desc[i].dl_fn) {
+				l1ts->dl_bursts_buf[i] = buf;
+				buf += len;
+			}
+			if (len && trx_chan_desc[i].ul_fn) {
+				l1ts->ul_bursts_buf[i] = (sbit_t *) buf;
+				buf += len;
+			}
+		}
+	}
+
+	LOGP(DL1C, LOGL_INFO, "Allocated %zu bytes of burst buffers for "
+		"trx=%u\n", size, l1t->trx->nr);
+
+	return 0;
+}
+
+/*! \brief get the cleared TX burst buffer of a logical channel */
+ubit_t *_sched_dl_bursts(struct l1sched_trx *l1t, uint8_t tn,
+			 enum trx_chan_type chan)
+{
+	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+	ubit_t *bursts = l1ts->dl_bursts_buf[chan];
+
+	if (bursts)
+		memset(bursts, 0, sched_bursts_len(chan));
+	return bursts;
+}
+
+/*! \brief get the cleared RX burst buffer of a logical channel */
+sbit_t *_sched_ul_bursts(struct l1sched_trx *l1t, uint8_t tn,
+			 enum trx_chan_type chan)
+{
+	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+	sbit_t *bursts = l1ts->ul_bursts_buf[chan];
+
+	if (bursts)
+		memset(bursts, 0, sched_bursts_len(chan));
+	return bursts;
+}
+
+unsigned int trx_sched_bursts_in_use(struct l1sched_trx *l1t)
+{
+	unsigned int num = 0;
+	uint8_t tn;
+	int i;
+
+	for (tn = 0; tn < ARRAY_SIZE(l1t->ts); tn++) {
+		struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+		for (i = 0; i < _TRX_CHAN_MAX; i++) {
+			if (l1ts->chan_state[i].dl_bursts)
+				num++;
+			if (l1ts->chan_state[i].ul_bursts)
+				num++;
+		}
+	}
+
+	return num;
+}
+
+
 /*
  * init / exit
  */
@@ -143,12 +377,27 @@ int trx_sched_init(struct l1sched_trx *l1t, struct gsm_bts_trx *trx)
 
 	LOGP(DL1C, LOGL_NOTICE, "Init scheduler for trx=%u\n", l1t->trx->nr);
 
+	dl_queue_map_init();
+	a5_ks_init();
+
+	/* kept over resets, see trx_sched_reset() */
+	if (!l1t->bursts_slab && sched_bursts_slab_alloc(l1t) < 0) {
+		LOGP(DL1C, LOGL_FATAL, "Cannot allocate burst buffers for "
+			"trx=%u\n", l1t->trx->nr);
+		return -ENOMEM;
+	}
+
 	for (tn = 0; tn < ARRAY_SIZE(l1t->ts); tn++) {
 		struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
 
 		l1ts->mf_index = 0;
 		l1ts->mf_last_fn = 0;
-		INIT_LLIST_HEAD(&l1ts->dl_prims);
+		for (i = 0; i < ARRAY_SIZE(l1ts->dl_queue); i++) {
+			INIT_LLIST_HEAD(&l1ts->dl_queue[i].prims);
+			l1ts->dl_queue[i].depth = 0;
+			l1ts->dl_queue[i].depth_max = 0;
+			l1ts->dl_queue[i].dropped = 0;
+		}
 		for (i = 0; i < ARRAY_SIZE(l1ts->chan_state); i++) {
 			struct l1sched_chan_state *chan_state;
 			chan_state = &l1ts->chan_state[i];
@@ -159,28 +408,25 @@ int trx_sched_init(struct l1sched_trx *l1t, struct gsm_bts_trx *trx)
 	return 0;
 }
 
-void trx_sched_exit(struct l1sched_trx *l1t)
+/* close all logical channels, the burst buffers are kept */
+static void sched_close(struct l1sched_trx *l1t)
 {
 	struct gsm_bts_trx_ts *ts;
 	uint8_t tn;
 	int i;
 
-	LOGP(DL1C, LOGL_NOTICE, "Exit scheduler for trx=%u\n", l1t->trx->nr);
-
 	for (tn = 0; tn < ARRAY_SIZE(l1t->ts); tn++) {
 		struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
-		msgb_queue_flush(&l1ts->dl_prims);
 		for (i = 0; i < _TRX_CHAN_MAX; i++) {
 			struct l1sched_chan_state *chan_state;
+			dl_queue_flush(&l1ts->dl_queue[i]);
 			chan_state = &l1ts->chan_state[i];
-			if (chan_state->dl_bursts) {
-				talloc_free(chan_state->dl_bursts);
-				chan_state->dl_bursts = NULL;
-			}
-			if (chan_state->ul_bursts) {
-				talloc_free(chan_state->ul_bursts);
-				chan_state->ul_bursts = NULL;
-			}
+			chan_state->dl_bursts = NULL;
+			chan_state->ul_bursts = NULL;
+			talloc_free(chan_state->dl_ks);
+			chan_state->dl_ks = NULL;
+			talloc_free(chan_state->ul_ks);
+			chan_state->ul_ks = NULL;
 		}
 		/* clear lchan channel states */
 		ts = &l1t->trx->ts[tn];
@@ -189,62 +435,67 @@ void trx_sched_exit(struct l1sched_trx *l1t)
 	}
 }
 
+void trx_sched_exit(struct l1sched_trx *l1t)
+{
+	uint8_t tn;
+
+	LOGP(DL1C, LOGL_NOTICE, "Exit scheduler for trx=%u\n", l1t->trx->nr);
+
+	sched_close(l1t);
+
+	for (tn = 0; tn < ARRAY_SIZE(l1t->ts); tn++) {
+		struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+		memset(l1ts->dl_bursts_buf, 0, sizeof(l1ts->dl_bursts_buf));
+		memset(l1ts->ul_bursts_buf, 0, sizeof(l1ts->ul_bursts_buf));
+	}
+	talloc_free(l1t->bursts_slab);
+	l1t->bursts_slab = NULL;
+	l1t->bursts_slab_size = 0;
+}
+
 /* close all logical channels and reset timeslots */
 void trx_sched_reset(struct l1sched_trx *l1t)
 {
-	trx_sched_exit(l1t);
+	LOGP(DL1C, LOGL_NOTICE, "Reset scheduler for trx=%u\n", l1t->trx->nr);
+
+	sched_close(l1t);
 	trx_sched_init(l1t, l1t->trx);
 }
 
 struct msgb *_sched_dequeue_prim(struct l1sched_trx *l1t, int8_t tn, uint32_t fn,
 				 enum trx_chan_type chan)
 {
-	struct msgb *msg, *msg2;
-	struct osmo_phsap_prim *l1sap;
-	uint32_t prim_fn;
+	struct msgb *msg;
+	uint32_t prim_fn, distance;
 	uint8_t chan_nr, link_id;
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
-
-	/* get prim of current fn from queue */
-	llist_for_each_entry_safe(msg, msg2, &l1ts->dl_prims, list) {
-		l1sap = msgb_l1sap_prim(msg);
-		if (l1sap->oph.operation != PRIM_OP_REQUEST) {
-wrong_type:
-			LOGP(DL1C, LOGL_ERROR, "Prim for ts=%u at fn=%u has "
-				"wrong type.\n", tn, fn);
-free_msg:
-			/* unlink and free message */
-			llist_del(&msg->list);
-			msgb_free(msg);
-			return NULL;
-		}
-		switch (l1sap->oph.primitive) {
-		case PRIM_PH_DATA:
-			chan_nr = l1sap->u.data.chan_nr;
-			link_id = l1sap->u.data.link_id;
-			prim_fn = ((l1sap->u.data.fn + GSM_HYPERFRAME - fn) % GSM_HYPERFRAME);
-			break;
-		case PRIM_TCH:
-			chan_nr = l1sap->u.tch.chan_nr;
-			link_id = 0;
-			prim_fn = ((l1sap->u.tch.fn + GSM_HYPERFRAME - fn) % GSM_HYPERFRAME);
-			break;
-		default:
-			goto wrong_type;
-		}
-		if (prim_fn > 100) {
+	struct l1sched_dl_queue *queue;
+
+	queue = trx_sched_dl_queue(l1ts, trx_chan_desc[chan].chan_nr,
+		trx_chan_desc[chan].link_id);
+	if (!queue)
+		return NULL;
+
+	/* the queue is ordered by fn, so only the head is of interest */
+	while (!llist_empty(&queue->prims)) {
+		msg = llist_entry(queue->prims.next, struct msgb, list);
+		dl_prim_info(msg, &chan_nr, &link_id, &prim_fn);
+		distance = ((prim_fn + GSM_HYPERFRAME - fn) % GSM_HYPERFRAME);
+		if (distance > 100) {
 			LOGP(DL1C, LOGL_NOTICE, "Prim for trx=%u ts=%u at fn=%u "
 				"is out of range, or channel already disabled. "
 				"If this happens in conjunction with PCU, "
 				"increase 'rts-advance' by 5. (current fn=%u)\n",
-				l1t->trx->nr, tn, l1sap->u.data.fn, fn);
+				l1t->trx->nr, tn, prim_fn, fn);
 			/* unlink and free message */
 			llist_del(&msg->list);
+			queue->depth--;
+			queue->dropped++;
 			msgb_free(msg);
 			continue;
 		}
-		if (prim_fn > 0)
-			continue;
+		if (distance > 0)
+			return NULL;
 
 		goto found_msg;
 	}
@@ -252,6 +503,10 @@ free_msg:
 	return NULL;
 
 found_msg:
+	/* unlink and return message */
+	llist_del(&msg->list);
+	queue->depth--;
+
 	if ((chan_nr ^ (trx_chan_desc[chan].chan_nr | tn))
 	 || ((link_id & 0xc0) ^ trx_chan_desc[chan].link_id)) {
 		LOGP(DL1C, LOGL_ERROR, "Prim for ts=%u at fn=%u has wrong "
@@ -259,11 +514,10 @@ found_msg:
 			"link_id=%02x.\n", tn, fn, chan_nr, link_id,
 			trx_chan_desc[chan].chan_nr | tn,
 			trx_chan_desc[chan].link_id);
-		goto free_msg;
+		msgb_free(msg);
+		return NULL;
 	}
 
-	/* unlink and return message */
-	llist_del(&msg->list);
 	return msg;
 }
 
@@ -349,9 +603,7 @@ int trx_sched_ph_data_req(struct l1sched_trx *l1t, struct osmo_phsap_prim *l1sap
 		return 0;
 	}
 
-	msgb_enqueue(&l1ts->dl_prims, l1sap->oph.msg);
-
-	return 0;
+	return dl_queue_prim(l1t, l1ts, l1sap->oph.msg);
 }
 
 int trx_sched_tch_req(struct l1sched_trx *l1t, struct osmo_phsap_prim *l1sap)
@@ -372,9 +624,7 @@ int trx_sched_tch_req(struct l1sched_trx *l1t, struct osmo_phsap_prim *l1sap)
 		return 0;
 	}
 
-	msgb_enqueue(&l1ts->dl_prims, l1sap->oph.msg);
-
-	return 0;
+	return dl_queue_prim(l1t, l1ts, l1sap->oph.msg);
 }
 
 
@@ -1254,6 +1504,41 @@ static const struct trx_sched_multiframe trx_sched_multiframes[] = {
  * scheduler functions
  */
 
+/* compile the multiframe of a timeslot into its slots, this must be done
+ * whenever the multiframe or the activation of a channel changes */
+static void sched_compile_ts(struct l1sched_ts *l1ts)
+{
+	const struct trx_sched_frame *frame;
+	const struct trx_chan_desc *desc;
+	struct l1sched_slot *slot;
+	int i, active;
+
+	OSMO_ASSERT(l1ts->mf_period <= ARRAY_SIZE(l1ts->mf_slots));
+
+	for (i = 0; i < l1ts->mf_period; i++) {
+		frame = &l1ts->mf_frames[i];
+		slot = &l1ts->mf_slots[i];
+
+		desc = &trx_chan_desc[frame->dl_chan];
+		active = desc->auto_active
+			|| l1ts->chan_state[frame->dl_chan].active;
+		slot->dl_chan = frame->dl_chan;
+		slot->dl_bid = frame->dl_bid;
+		slot->dl_active = active;
+		slot->dl_cs = &l1ts->chan_state[frame->dl_chan];
+		slot->dl_fn = active ? desc->dl_fn : NULL;
+		slot->rts_fn = (frame->dl_bid == 0) ? desc->rts_fn : NULL;
+
+		desc = &trx_chan_desc[frame->ul_chan];
+		active = desc->auto_active
+			|| l1ts->chan_state[frame->ul_chan].active;
+		slot->ul_chan = frame->ul_chan;
+		slot->ul_bid = frame->ul_bid;
+		slot->ul_cs = &l1ts->chan_state[frame->ul_chan];
+		slot->ul_fn = active ? desc->ul_fn : NULL;
+	}
+}
+
 /* set multiframe scheduler to given pchan */
 int trx_sched_set_pchan(struct l1sched_trx *l1t, uint8_t tn,
 	enum gsm_phys_chan_config pchan)
@@ -1267,6 +1552,7 @@ int trx_sched_set_pchan(struct l1sched_trx *l1t, uint8_t tn,
 			l1ts->mf_index = i;
 			l1ts->mf_period = trx_sched_multiframes[i].period;
 			l1ts->mf_frames = trx_sched_multiframes[i].frames;
+			sched_compile_ts(l1ts);
 			LOGP(DL1C, LOGL_NOTICE, "Configuring multiframe with "
 				"%s trx=%d ts=%d\n",
 				trx_sched_multiframes[i].name,
@@ -1288,6 +1574,7 @@ int trx_sched_set_lchan(struct l1sched_trx *l1t, uint8_t chan_nr, uint8_t link_i
 	uint8_t tn = L1SAP_CHAN2TS(chan_nr);
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
 	uint8_t ss = l1sap_chan2ss(chan_nr);
+	struct l1sched_dl_queue *queue;
 	int i;
 	int rc = -EINVAL;
 
@@ -1311,20 +1598,26 @@ int trx_sched_set_lchan(struct l1sched_trx *l1t, uint8_t chan_nr, uint8_t link_i
 			if (active)
 				memset(chan_state, 0, sizeof(*chan_state));
 			chan_state->active = active;
-			/* free burst memory, to cleanly start with burst 0 */
-			if (chan_state->dl_bursts) {
-				talloc_free(chan_state->dl_bursts);
-				chan_state->dl_bursts = NULL;
-			}
-			if (chan_state->ul_bursts) {
-				talloc_free(chan_state->ul_bursts);
-				chan_state->ul_bursts = NULL;
-			}
-			if (!active)
+			/* release burst memory, to cleanly start with burst 0 */
+			chan_state->dl_bursts = NULL;
+			chan_state->ul_bursts = NULL;
+			if (!active) {
+				talloc_free(chan_state->dl_ks);
+				chan_state->dl_ks = NULL;
+				talloc_free(chan_state->ul_ks);
+				chan_state->ul_ks = NULL;
 				chan_state->ho_rach_detect = 0;
+				queue = trx_sched_dl_queue(l1ts,
+					trx_chan_desc[i].chan_nr,
+					trx_chan_desc[i].link_id);
+				if (queue)
+					dl_queue_flush(queue);
+			}
 		}
 	}
 
+	sched_compile_ts(l1ts);
+
 	/* disable handover detection (on deactivation) */
 	if (!active)
 		_sched_act_rach_det(l1t, tn, ss, 0);
@@ -1340,6 +1633,7 @@ int trx_sched_set_mode(struct l1sched_trx *l1t, uint8_t chan_nr, uint8_t rsl_cmo
 	uint8_t tn = L1SAP_CHAN2TS(chan_nr);
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
 	uint8_t ss = l1sap_chan2ss(chan_nr);
+	struct l1sched_dl_queue *queue;
 	int i;
 	int rc = -EINVAL;
 	struct l1sched_chan_state *chan_state;
@@ -1442,38 +1736,61 @@ int trx_sched_set_cipher(struct l1sched_trx *l1t, uint8_t chan_nr, int downlink,
 int _sched_rts(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn)
 {
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period, bid;
-	trx_sched_rts_func *func;
-	enum trx_chan_type chan;
+	const struct l1sched_slot *slot;
 
 	/* no multiframe set */
 	if (!l1ts->mf_index)
 		return 0;
 
-	/* get frame from multiframe */
-	period = l1ts->mf_period;
-	offset = fn % period;
-	frame = l1ts->mf_frames + offset;
+	/* only set on bid == 0 of channels with RTS function */
+	slot = &l1ts->mf_slots[fn % l1ts->mf_period];
+	if (!slot->rts_fn)
+		return 0;
 
-	chan = frame->dl_chan;
-	bid = frame->dl_bid;
-	func = trx_chan_desc[frame->dl_chan].rts_fn;
+	/* check if channel is active */
+	if (!slot->dl_active)
+		return -EINVAL;
 
-	/* only on bid == 0 */
-	if (bid != 0)
-		return 0;
+	return slot->rts_fn(l1t, tn, fn, slot->dl_chan);
+}
 
-	/* no RTS function */
-	if (!func)
-		return 0;
+/* number of frames to look ahead for the frames of a ciphered channel */
+#define KS_WINDOW	(4 * 104)
 
-	/* check if channel is active */
-	if (!trx_chan_desc[chan].auto_active
-	 && !l1ts->chan_state[chan].active)
-	 	return -EINVAL;
+/* get the keystream of the burst at fn, generating the keystreams for the
+ * next frames of the channel in one batch if it is not yet available.
+ * returns the lane of the keystream in the cache, or -ENOMEM */
+static int sched_ks_get(struct l1sched_ts *l1ts, enum trx_chan_type chan,
+	struct a5_ks_cache **cache, int algo, const uint8_t *key, uint32_t fn,
+	int ul)
+{
+	const struct trx_sched_frame *frame;
+	uint32_t lanes[A5_KS_LANES];
+	unsigned int num = 0;
+	uint32_t f;
+	int i, lane;
+
+	if (!*cache) {
+		*cache = talloc_zero(tall_bts_ctx, struct a5_ks_cache);
+		if (!*cache)
+			return -ENOMEM;
+	}
 
-	return func(l1t, tn, fn, frame->dl_chan);
+	lane = a5_ks_lookup(*cache, algo, key, fn);
+	if (lane >= 0)
+		return lane;
+
+	/* collect the frames of this channel, starting with fn */
+	lanes[num++] = fn;
+	for (i = 1; i < KS_WINDOW && num < A5_KS_LANES; i++) {
+		f = (fn + i) % GSM_HYPERFRAME;
+		frame = l1ts->mf_frames + f % l1ts->mf_period;
+		if ((ul ? frame->ul_chan : frame->dl_chan) == chan)
+			lanes[num++] = f;
+	}
+	a5_ks_fill(*cache, algo, key, lanes, num, ul);
+
+	return 0;
 }
 
 /* process downlink burst */
@@ -1481,42 +1798,38 @@ const ubit_t *_sched_dl_burst(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn)
 {
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
 	struct l1sched_chan_state *l1cs;
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period, bid;
-	trx_sched_dl_func *func;
-	enum trx_chan_type chan;
+	const struct l1sched_slot *slot;
+	enum trx_chan_type chan = TRXC_IDLE;
+	uint8_t bid = 0;
 	ubit_t *bits = NULL;
 
 	if (!l1ts->mf_index)
 		goto no_data;
 
-	/* get frame from multiframe */
-	period = l1ts->mf_period;
-	offset = fn % period;
-	frame = l1ts->mf_frames + offset;
-
-	chan = frame->dl_chan;
-	bid = frame->dl_bid;
-	func = trx_chan_desc[chan].dl_fn;
-
-	l1cs = &l1ts->chan_state[chan];
-
-	/* check if channel is active */
-	if (!trx_chan_desc[chan].auto_active && !l1cs->active)
-	 	goto no_data;
+	/* get frame from multiframe, no handler if channel is inactive */
+	slot = &l1ts->mf_slots[fn % l1ts->mf_period];
+	chan = slot->dl_chan;
+	bid = slot->dl_bid;
+	if (!slot->dl_fn)
+		goto no_data;
+	l1cs = slot->dl_cs;
 
 	/* get burst from function */
-	bits = func(l1t, tn, fn, chan, bid);
+	bits = slot->dl_fn(l1t, tn, fn, chan, bid);
 
 	/* encrypt */
 	if (bits && l1cs->dl_encr_algo) {
-		ubit_t ks[114];
-		int i;
+		int i, lane;
 
-		osmo_a5(l1cs->dl_encr_algo, l1cs->dl_encr_key, fn, ks, NULL);
+		lane = sched_ks_get(l1ts, chan, &l1cs->dl_ks,
+			l1cs->dl_encr_algo, l1cs->dl_encr_key, fn, 0);
+		if (lane < 0) {
+			bits = NULL;
+			goto no_data;
+		}
 		for (i = 0; i < 57; i++) {
-			bits[i + 3] ^= ks[i];
-			bits[i + 88] ^= ks[i + 57];
+			bits[i + 3] ^= a5_ks_bit(l1cs->dl_ks, lane, i);
+			bits[i + 88] ^= a5_ks_bit(l1cs->dl_ks, lane, i + 57);
 		}
 	}
 
@@ -1539,9 +1852,8 @@ int trx_sched_ul_burst(struct l1sched_trx *l1t, uint8_t tn, uint32_t current_fn,
 {
 	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
 	struct l1sched_chan_state *l1cs;
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period, bid;
-	trx_sched_ul_func *func;
+	const struct l1sched_slot *slot;
+	uint8_t bid;
 	enum trx_chan_type chan;
 	uint32_t fn, elapsed;
 
@@ -1559,49 +1871,44 @@ int trx_sched_ul_burst(struct l1sched_trx *l1t, uint8_t tn, uint32_t current_fn,
 		fn = current_fn;
 
 	while (42) {
-		/* get frame from multiframe */
-		period = l1ts->mf_period;
-		offset = fn % period;
-		frame = l1ts->mf_frames + offset;
-
-		chan = frame->ul_chan;
-		bid = frame->ul_bid;
-		func = trx_chan_desc[chan].ul_fn;
-
-		l1cs = &l1ts->chan_state[chan];
-
-		/* check if channel is active */
-		if (!trx_chan_desc[chan].auto_active && !l1cs->active)
+		/* get frame from multiframe, there is no handler for
+		 * inactive channels and for IDLE bursts */
+		slot = &l1ts->mf_slots[fn % l1ts->mf_period];
+		if (!slot->ul_fn)
 			goto next_frame;
 
-		/* omit bursts which have no handler, like IDLE bursts */
-		if (!func)
-			goto next_frame;
+		chan = slot->ul_chan;
+		bid = slot->ul_bid;
+		l1cs = slot->ul_cs;
 
 		/* put burst to function */
 		if (fn == current_fn) {
 			/* decrypt */
 			if (bits && l1cs->ul_encr_algo) {
-				ubit_t ks[114];
-				int i;
-
-				osmo_a5(l1cs->ul_encr_algo,
-					l1cs->ul_encr_key,
-					fn, NULL, ks);
+				sbit_t m;
+				int i, lane;
+
+				lane = sched_ks_get(l1ts, chan, &l1cs->ul_ks,
+					l1cs->ul_encr_algo, l1cs->ul_encr_key,
+					fn, 1);
+				if (lane < 0)
+					goto next_frame;
+				/* negate soft bits where the keystream is 1 */
 				for (i = 0; i < 57; i++) {
-					if (ks[i])
-						bits[i + 3] = - bits[i + 3];
-					if (ks[i + 57])
-						bits[i + 88] = - bits[i + 88];
+					m = -a5_ks_bit(l1cs->ul_ks, lane, i);
+					bits[i + 3] = (bits[i + 3] ^ m) - m;
+					m = -a5_ks_bit(l1cs->ul_ks, lane,
+						i + 57);
+					bits[i + 88] = (bits[i + 88] ^ m) - m;
 				}
 			}
 
-			func(l1t, tn, fn, chan, bid, bits, rssi, toa);
+			slot->ul_fn(l1t, tn, fn, chan, bid, bits, rssi, toa);
 		} else if (chan != TRXC_RACH && !l1cs->ho_rach_detect) {
 			sbit_t spare[148];
 
 			memset(spare, 0, 148);
-			func(l1t, tn, fn, chan, bid, spare, -128, 0);
+			slot->ul_fn(l1t, tn, fn, chan, bid, spare, -128, 0);
 		}
 
 next_frame:
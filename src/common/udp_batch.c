@@ -0,0 +1,205 @@
+/* Batching of datagrams with sendmmsg() / recvmmsg() */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <osmocom/core/talloc.h>
+
+#include "btsconfig.h"
+
+#include <osmo-bts/udp_batch.h>
+
+struct udp_batch *udp_batch_alloc(void *ctx, unsigned int size,
+				  unsigned int buf_len)
+{
+	struct udp_batch *b;
+	unsigned int i;
+
+	b = talloc_zero(ctx, struct udp_batch);
+	if (!b)
+		return NULL;
+	b->size = size;
+	b->buf_len = buf_len;
+	b->buf = talloc_zero_size(b, size * buf_len);
+	b->len = talloc_zero_array(b, unsigned int, size);
+	b->iov = talloc_zero_array(b, struct iovec, size);
+	if (!b->buf || !b->len || !b->iov)
+		goto err;
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+	b->msg = talloc_zero_array(b, struct mmsghdr, size);
+	if (!b->msg)
+		goto err;
+#endif
+
+	for (i = 0; i < size; i++) {
+		b->iov[i].iov_base = b->buf + i * buf_len;
+		b->iov[i].iov_len = buf_len;
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+		b->msg[i].msg_hdr.msg_iov = &b->iov[i];
+		b->msg[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+
+	return b;
+
+err:
+	talloc_free(b);
+	return NULL;
+}
+
+/*! \brief get the buffer for the next datagram to transmit
+ *  \returns NULL if the batch is full */
+uint8_t *udp_batch_tx_buf(struct udp_batch *b)
+{
+	if (b->num >= b->size)
+		return NULL;
+	return b->buf + b->num * b->buf_len;
+}
+
+/*! \brief queue the datagram written to udp_batch_tx_buf() */
+void udp_batch_tx_commit(struct udp_batch *b, unsigned int len)
+{
+	b->iov[b->num].iov_len = len;
+	b->len[b->num] = len;
+	b->num++;
+}
+
+/*! \brief send the datagrams to sa, for use on an unconnected socket */
+void udp_batch_set_dest(struct udp_batch *b, const struct sockaddr *sa,
+			socklen_t len)
+{
+#ifdef HAVE_SENDMMSG
+	unsigned int i;
+#endif
+
+	if (len > sizeof(b->dest))
+		len = sizeof(b->dest);
+	memcpy(&b->dest, sa, len);
+	b->dest_len = len;
+#ifdef HAVE_SENDMMSG
+	for (i = 0; i < b->size; i++) {
+		b->msg[i].msg_hdr.msg_name = &b->dest;
+		b->msg[i].msg_hdr.msg_namelen = len;
+	}
+#endif
+}
+
+/*! \brief send all queued datagrams, see udp_batch_set_dest()
+ *  \returns number of datagrams sent or negative errno
+ *
+ * Datagrams that cannot be sent are dropped, the batch is empty after
+ * return in any case. */
+int udp_batch_send(struct udp_batch *b, int fd)
+{
+	unsigned int sent = 0;
+	int rc = 0;
+
+	while (sent < b->num) {
+#ifdef HAVE_SENDMMSG
+		rc = sendmmsg(fd, b->msg + sent, b->num - sent, 0);
+#else
+		rc = sendto(fd, b->iov[sent].iov_base, b->iov[sent].iov_len, 0,
+			    b->dest_len ? (struct sockaddr *) &b->dest : NULL,
+			    b->dest_len);
+		if (rc >= 0)
+			rc = 1;
+#endif
+		b->syscalls++;
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+		sent += rc;
+	}
+
+	b->datagrams += sent;
+	b->num = 0;
+
+	return (rc < 0) ? rc : sent;
+}
+
+/*! \brief receive all pending datagrams, up to the size of the batch
+ *  \returns number of datagrams received or negative errno
+ *
+ * The socket is not blocked on; if the batch is full, more datagrams may
+ * be pending. */
+int udp_batch_recv(struct udp_batch *b, int fd)
+{
+	unsigned int i;
+#ifndef HAVE_RECVMMSG
+	socklen_t src_len;
+#endif
+	int rc;
+
+	b->num = 0;
+
+#ifdef HAVE_RECVMMSG
+	/* all datagrams write their source to b->src, the last one stays */
+	for (i = 0; i < b->size; i++) {
+		b->iov[i].iov_len = b->buf_len;
+		b->msg[i].msg_hdr.msg_name = &b->src;
+		b->msg[i].msg_hdr.msg_namelen = sizeof(b->src);
+	}
+	do {
+		rc = recvmmsg(fd, b->msg, b->size, MSG_DONTWAIT, NULL);
+		b->syscalls++;
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
+	b->num = rc;
+	for (i = 0; i < b->num; i++)
+		b->len[i] = b->msg[i].msg_len;
+	if (b->num)
+		b->src_len = b->msg[b->num - 1].msg_hdr.msg_namelen;
+#else
+	for (i = 0; i < b->size; i++) {
+		src_len = sizeof(b->src);
+		rc = recvfrom(fd, b->buf + i * b->buf_len, b->buf_len,
+			      MSG_DONTWAIT, (struct sockaddr *) &b->src,
+			      &src_len);
+		b->syscalls++;
+		if (rc < 0) {
+			if (errno == EINTR) {
+				i--;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (!b->num)
+				return -errno;
+			break;
+		}
+		b->len[i] = rc;
+		b->src_len = src_len;
+		b->num++;
+	}
+#endif
+
+	b->datagrams += b->num;
+
+	return b->num;
+}
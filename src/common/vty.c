@@ -52,6 +52,7 @@
 #include <osmo-bts/measurement.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/l1sap.h>
+#include <osmo-bts/gsmtap_ring.h>
 
 #define VTY_STR	"Configure the VTY\n"
 
@@ -211,6 +212,43 @@ gDEFUN(cfg_bts_no_auto_band, cfg_bts_no_auto_band_cmd,
 	return CMD_SUCCESS;
 }
 
+#define L1_RX_THREAD_STR "Receive L1 primitives on a separate thread\n"
+
+gDEFUN(cfg_phy_l1_rx_thread, cfg_phy_l1_rx_thread_cmd,
+	"l1-rx-thread",
+	L1_RX_THREAD_STR)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->l1_rx_thread = 1;
+	plink->l1_rx_prio = 0;
+	return CMD_SUCCESS;
+}
+
+gDEFUN(cfg_phy_l1_rx_thread_rt, cfg_phy_l1_rx_thread_rt_cmd,
+	"l1-rx-thread realtime <1-99>",
+	L1_RX_THREAD_STR
+	"Run the thread with SCHED_FIFO real-time scheduling\n"
+	"Real-time priority\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->l1_rx_thread = 1;
+	plink->l1_rx_prio = atoi(argv[0]);
+	return CMD_SUCCESS;
+}
+
+gDEFUN(cfg_phy_no_l1_rx_thread, cfg_phy_no_l1_rx_thread_cmd,
+	"no l1-rx-thread",
+	NO_STR L1_RX_THREAD_STR)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->l1_rx_thread = 0;
+	plink->l1_rx_prio = 0;
+	return CMD_SUCCESS;
+}
+
 
 DEFUN(cfg_bts_trx, cfg_bts_trx_cmd,
 	"trx <0-254>",
@@ -300,6 +338,9 @@ static void config_write_bts_single(struct vty *vty, struct gsm_bts *bts)
 		const char *name = get_value_string(gsmtap_sapi_names, GSMTAP_CHANNEL_ACCH);
 		vty_out(vty, " gsmtap-sapi %s%s", osmo_str_tolower(name), VTY_NEWLINE);
 	}
+	if (gsmtap_rate_limit)
+		vty_out(vty, " gsmtap-rate-limit %u%s", gsmtap_rate_limit,
+			VTY_NEWLINE);
 	vty_out(vty, " min-qual-rach %.0f%s", btsb->min_qual_rach * 10.0f,
 		VTY_NEWLINE);
 	vty_out(vty, " min-qual-norm %.0f%s", btsb->min_qual_norm * 10.0f,
@@ -350,6 +391,11 @@ static void config_write_phy_single(struct vty *vty, struct phy_link *plink)
 
 	vty_out(vty, "phy %u%s", plink->num, VTY_NEWLINE);
 	bts_model_config_write_phy(vty, plink);
+	if (plink->l1_rx_thread && plink->l1_rx_prio)
+		vty_out(vty, " l1-rx-thread realtime %d%s",
+			plink->l1_rx_prio, VTY_NEWLINE);
+	else if (plink->l1_rx_thread)
+		vty_out(vty, " l1-rx-thread%s", VTY_NEWLINE);
 
 	for (i = 0; i < 255; i++) {
 		struct phy_instance *pinst = phy_instance_by_num(plink, i);
@@ -735,20 +781,11 @@ static void net_dump_nmstate(struct vty *vty, struct gsm_nm_state *nms)
 		abis_nm_avail_name(nms->availability), VTY_NEWLINE);
 }
 
-static unsigned int llist_length(struct llist_head *list)
-{
-	unsigned int len = 0;
-	struct llist_head *pos;
-
-	llist_for_each(pos, list)
-		len++;
-
-	return len;
-}
-
 static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts->role;
+	struct gsm_bts_ccch_sched *cs;
+	unsigned int pag_grp, pag_occ;
 
 	vty_out(vty, "BTS %u is of %s type in band %s, has CI %u LAC %u, "
 		"BSIC %u and %u TRX%s",
@@ -768,6 +805,12 @@ static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 	vty_out(vty, "  Paging: Queue size %u, occupied %u, lifetime %us%s",
 		paging_get_queue_max(btsb->paging_state), paging_queue_length(btsb->paging_state),
 		paging_get_lifetime(btsb->paging_state), VTY_NEWLINE);
+	pag_grp = paging_busiest_group(btsb->paging_state, &pag_occ);
+	vty_out(vty, "  Paging: duplicates %u, expired %u, "
+		"busiest group %u with %u records%s",
+		paging_get_duplicates(btsb->paging_state),
+		paging_get_expired(btsb->paging_state), pag_grp, pag_occ,
+		VTY_NEWLINE);
 	vty_out(vty, "  AGCH: Queue limit %u, occupied %d, "
 		"dropped %"PRIu64", merged %"PRIu64", rejected %"PRIu64", "
 		"ag-res %"PRIu64", non-res %"PRIu64"%s",
@@ -776,8 +819,31 @@ static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 		btsb->agch_queue_rejected_msgs, btsb->agch_queue_agch_msgs,
 		btsb->agch_queue_pch_msgs,
 		VTY_NEWLINE);
-	vty_out(vty, "  CBCH backlog queue length: %u%s",
-		llist_length(&btsb->smscb_state.queue), VTY_NEWLINE);
+	cs = &btsb->ccch_sched;
+	vty_out(vty, "  CCCH: %d%% of blocks used (%"PRIu64" of %"PRIu64"), "
+		"paging repeats deferred %"PRIu64"%s",
+		cs->util256 * 100 / 256, cs->blocks_used_total,
+		cs->blocks_total, cs->pag_deferred, VTY_NEWLINE);
+	vty_out(vty, "  CCCH: per multiframe expecting %d.%02d paging, "
+		"%d.%02d AGCH, for %d.%02d AGCH blocks%s",
+		cs->pag_rate256 / 256, (cs->pag_rate256 % 256) * 100 / 256,
+		cs->agch_rate256 / 256, (cs->agch_rate256 % 256) * 100 / 256,
+		cs->ag_blocks256 / 256, (cs->ag_blocks256 % 256) * 100 / 256,
+		VTY_NEWLINE);
+	vty_out(vty, "  CBCH backlog queue length: %u, extended %u%s",
+		btsb->smscb_basic.queue_len, btsb->smscb_extended.queue_len,
+		VTY_NEWLINE);
+	if (gsmtap_ring) {
+		struct gsmtap_ring_stats *st = &gsmtap_ring->stats;
+
+		vty_out(vty, "  GSMTAP: queued %u, sent %u in %u calls, "
+			"send errors %u, max fill %u of %u%s",
+			st->queued, st->sent, st->syscalls, st->tx_errors,
+			st->max_fill, gsmtap_ring->num_slots, VTY_NEWLINE);
+		vty_out(vty, "  GSMTAP: dropped %u with the ring full, "
+			"%u by the rate limit, %u oversize%s",
+			st->full, st->rate_limited, st->oversize, VTY_NEWLINE);
+	}
 #if 0
 	vty_out(vty, "  Paging: %u pending requests, %u free slots%s",
 		paging_pending_requests_nr(bts),
@@ -893,6 +959,31 @@ DEFUN(cfg_trx_no_gsmtap_sapi, cfg_trx_no_gsmtap_sapi_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_gsmtap_rate_limit, cfg_bts_gsmtap_rate_limit_cmd,
+	"gsmtap-rate-limit <1-1000000>",
+	"Limit the rate of GSMTAP datagrams, excess ones are dropped\n"
+	"Datagrams per second\n")
+{
+	gsmtap_rate_limit = atoi(argv[0]);
+	/* allow bursts of 100ms worth of datagrams */
+	if (gsmtap_ring)
+		gsmtap_ring_set_rate(gsmtap_ring, gsmtap_rate_limit,
+				     gsmtap_rate_limit / 10);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_gsmtap_rate_limit, cfg_bts_no_gsmtap_rate_limit_cmd,
+	"no gsmtap-rate-limit",
+	NO_STR "Do not limit the rate of GSMTAP datagrams\n")
+{
+	gsmtap_rate_limit = 0;
+	if (gsmtap_ring)
+		gsmtap_ring_set_rate(gsmtap_ring, 0, 0);
+
+	return CMD_SUCCESS;
+}
+
 static struct cmd_node phy_node = {
 	PHY_NODE,
 	"%s(phy)#",
@@ -1097,6 +1188,8 @@ int bts_vty_init(struct gsm_bts *bts, const struct log_info *cat)
 
 	install_element(BTS_NODE, &cfg_trx_gsmtap_sapi_cmd);
 	install_element(BTS_NODE, &cfg_trx_no_gsmtap_sapi_cmd);
+	install_element(BTS_NODE, &cfg_bts_gsmtap_rate_limit_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_gsmtap_rate_limit_cmd);
 
 	/* add and link to TRX config node */
 	install_element(BTS_NODE, &cfg_bts_trx_cmd);
@@ -1357,6 +1357,10 @@ struct lc15l1_hdl *l1if_open(struct phy_instance *pinst)
 
 	get_hwinfo(fl1h);
 
+	if (pinst->phy_link->l1_rx_thread)
+		fl1h->rx_ring = prim_ring_alloc(fl1h, L1_RX_RING_SLOTS,
+						LC15BTS_PRIM_SIZE);
+
 	rc = l1if_transport_open(MQ_SYS_WRITE, fl1h);
 	if (rc < 0) {
 		talloc_free(fl1h);
@@ -1370,13 +1374,26 @@ struct lc15l1_hdl *l1if_open(struct phy_instance *pinst)
 		return NULL;
 	}
 
+	if (fl1h->rx_ring && l1if_transport_rx_start(fl1h,
+					pinst->phy_link->l1_rx_prio) < 0) {
+		LOGP(DL1C, LOGL_NOTICE, "Receiving L1 primitives in the "
+			"main loop\n");
+		prim_ring_free(fl1h->rx_ring);
+		fl1h->rx_ring = NULL;
+	}
+
 	return fl1h;
 }
 
 int l1if_close(struct lc15l1_hdl *fl1h)
 {
+	/* stop the receive thread before its queues are closed */
+	if (fl1h->rx_ring)
+		prim_ring_stop(fl1h->rx_ring);
 	l1if_transport_close(MQ_L1_WRITE, fl1h);
 	l1if_transport_close(MQ_SYS_WRITE, fl1h);
+	prim_ring_free(fl1h->rx_ring);
+	fl1h->rx_ring = NULL;
 	return 0;
 }
 
@@ -8,6 +8,7 @@
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/prim_ring.h>
 
 #include <nrw/litecell15/gsml1prim.h>
 
@@ -33,6 +34,9 @@ struct calib_send_state {
 	int last_file_idx;
 };
 
+/* primitives buffered between the receive thread and the main loop */
+#define L1_RX_RING_SLOTS	64
+
 struct lc15l1_hdl {
 	struct gsm_time gsm_time;
 	uint32_t hLayer1;			/* handle to the L1 instance in the DSP */
@@ -46,6 +50,7 @@ struct lc15l1_hdl {
 
 	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
+	struct prim_ring *rx_ring;		/* NULL without receive thread */
 
 	struct {
 		/* from DSP/FPGA after L1 Init */
@@ -10,5 +10,6 @@ int l1if_handle_sysprim(struct lc15l1_hdl *fl1h, struct msgb *msg);
 /* functions exported by a transport */
 int l1if_transport_open(int q, struct lc15l1_hdl *fl1h);
 int l1if_transport_close(int q, struct lc15l1_hdl *fl1h);
+int l1if_transport_rx_start(struct lc15l1_hdl *fl1h, int rt_prio);
 
 #endif /* _L1_TRANSP_H */
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -40,6 +41,7 @@
 
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/prim_ring.h>
 
 #include <nrw/litecell15/litecell15.h>
 #include <nrw/litecell15/gsml1prim.h>
@@ -219,6 +221,49 @@ static int l1if_fd_cb(struct osmo_fd *ofd, unsigned int what)
 	return 1;
 }
 
+/* receive thread: read up to three primitives into the free slots */
+static int l1if_ring_rx_cb(struct prim_ring *r, int fd, int q)
+{
+	const uint32_t prim_size = prim_size_for_queue(q);
+	struct iovec iov[3];
+	unsigned int i, num;
+	int rc, count;
+
+	num = prim_ring_space(r);
+	if (num > ARRAY_SIZE(iov))
+		num = ARRAY_SIZE(iov);
+
+	for (i = 0; i < num; ++i) {
+		iov[i].iov_base = prim_ring_slot_buf(r, i);
+		iov[i].iov_len = prim_size;
+	}
+
+	rc = readv(fd, iov, num);
+	if (rc < 0)
+		return -errno;
+	count = rc / prim_size;
+
+	for (i = 0; i < count; ++i)
+		prim_ring_produce(r, prim_size, q);
+
+	return count;
+}
+
+/* main loop: hand a primitive from the ring to the L1 handlers */
+static void l1if_ring_dispatch_cb(struct prim_ring *r, const uint8_t *data,
+				  unsigned int len, int q)
+{
+	struct msgb *msg;
+
+	msg = msgb_alloc_headroom(prim_size_for_queue(q) + 128, 128, "1l_fd");
+	if (!msg)
+		return;
+	msg->l1h = msg->data;
+	memcpy(msgb_put(msg, len), data, len);
+
+	read_dispatch_one(r->data, msg, q);
+}
+
 /* callback when we can write to one of the l1 msg_queue devices */
 static int l1fd_write_cb(struct osmo_fd *ofd, struct msgb *msg)
 {
@@ -263,7 +308,12 @@ int l1if_transport_open(int q, struct lc15l1_hdl *hdl)
 	read_ofd->data = hdl;
 	read_ofd->cb = l1if_fd_cb;
 	read_ofd->when = BSC_FD_READ;
-	rc = osmo_fd_register(read_ofd);
+	/* with a receive thread, it reads the queue instead of the main loop,
+	 * see l1if_transport_rx_start() */
+	if (hdl->rx_ring)
+		rc = prim_ring_add_fd(hdl->rx_ring, read_ofd->fd, q);
+	else
+		rc = osmo_fd_register(read_ofd);
 	if (rc < 0) {
 		close(read_ofd->fd);
 		read_ofd->fd = -1;
@@ -297,7 +347,8 @@ int l1if_transport_open(int q, struct lc15l1_hdl *hdl)
 
 out_read:
 	close(hdl->read_ofd[q].fd);
-	osmo_fd_unregister(&hdl->read_ofd[q]);
+	if (!hdl->rx_ring)
+		osmo_fd_unregister(&hdl->read_ofd[q]);
 
 	return rc;
 }
@@ -307,7 +358,8 @@ int l1if_transport_close(int q, struct lc15l1_hdl *hdl)
 	struct osmo_fd *read_ofd = &hdl->read_ofd[q];
 	struct osmo_fd *write_ofd = &hdl->write_q[q].bfd;
 
-	osmo_fd_unregister(read_ofd);
+	if (!hdl->rx_ring)
+		osmo_fd_unregister(read_ofd);
 	close(read_ofd->fd);
 	read_ofd->fd = -1;
 
@@ -317,3 +369,25 @@ int l1if_transport_close(int q, struct lc15l1_hdl *hdl)
 
 	return 0;
 }
+
+/*! \brief start the receive thread for the queues opened so far
+ *
+ * The queues must have been opened with hdl->rx_ring allocated.  If the
+ * thread cannot be started, they are read from the main loop again and the
+ * caller frees the ring. */
+int l1if_transport_rx_start(struct lc15l1_hdl *hdl, int rt_prio)
+{
+	unsigned int i;
+	int rc;
+
+	rc = prim_ring_start(hdl->rx_ring, l1if_ring_rx_cb,
+			     l1if_ring_dispatch_cb, hdl, rt_prio);
+	if (rc == 0)
+		return 0;
+
+	for (i = 0; i < hdl->rx_ring->num_fds; i++)
+		osmo_fd_register(&hdl->read_ofd[hdl->rx_ring->tags[i]]);
+	hdl->rx_ring->num_fds = 0;
+
+	return rc;
+}
@@ -62,8 +62,8 @@
 
 #define cPKTAPI_FIFO_ID_MSG                                0xAAAA0001
 
-/* maximum window of unacknowledged commands */
-#define UNACK_CMD_WINDOW	8
+/* default window of unacknowledged commands */
+#define DEFAULT_CMD_WINDOW	32
 /* maximum number of re-transmissions of a command */
 #define MAX_RETRANS		3
 /* timeout until which we expect PHY to respond */
@@ -159,7 +159,7 @@ struct gsm_lchan *get_lchan_by_lchid(struct gsm_bts_trx *trx,
 
 /* TODO: Unify with sysmobts? */
 struct wait_l1_conf {
-	/* list of wait_l1_conf in the phy handle */
+	/* list of wait_l1_conf in the window, oldest first */
 	struct llist_head list;
 	/* expiration timer */
 	struct osmo_timer_list timer;
@@ -167,7 +167,7 @@ struct wait_l1_conf {
 	uint32_t prim_id;
 	/* transaction ID */
 	uint32_t trans_id;
-	/* copy of the msgb containing the command */
+	/* msgb containing the command, NULL if the slot is free */
 	struct msgb *cmd_msg;
 	/* call-back to call on response */
 	l1if_compl_cb *cb;
@@ -177,11 +177,33 @@ struct wait_l1_conf {
 	uint32_t num_retrans;
 };
 
-static void release_wlc(struct wait_l1_conf *wlc)
+/* state of a postponed command, kept in the control buffer of its msgb */
+struct wlc_msg_cb {
+	l1if_compl_cb *cb;
+	void *cb_data;
+	uint32_t prim_id;
+	uint32_t trans_id;
+};
+
+#define WLC_MSG_CB(msg) ((struct wlc_msg_cb *) &(msg)->cb[0])
+
+osmo_static_assert(sizeof(struct wlc_msg_cb) <= sizeof(((struct msgb *) 0)->cb),
+		   wlc_msg_cb_fits);
+
+/* slot of a transaction ID in the window */
+static inline struct wait_l1_conf *wlc_slot(struct octphy_hdl *fl1h,
+					    uint32_t trans_id)
+{
+	return &fl1h->wlc_slots[trans_id & (fl1h->wlc_num_slots - 1)];
+}
+
+static void release_wlc(struct octphy_hdl *fl1h, struct wait_l1_conf *wlc)
 {
 	osmo_timer_del(&wlc->timer);
 	msgb_free(wlc->cmd_msg);
-	talloc_free(wlc);
+	wlc->cmd_msg = NULL;
+	llist_del(&wlc->list);
+	fl1h->wlc_list_len--;
 }
 
 static void l1if_req_timeout(void *data)
@@ -203,46 +225,114 @@ static struct llist_head *llist_first(struct llist_head *head)
 	return head->next;
 }
 
-static void check_refill_window(struct octphy_hdl *fl1h, struct wait_l1_conf *recent)
+/* allocate the slots of the unacknowledged command window, indexed by
+ * transaction ID.  Twice as many slots as the window is large, so that a
+ * gap in the transaction IDs rarely makes two commands share a slot. */
+static int wlc_slots_alloc(struct octphy_hdl *fl1h, unsigned int window)
+{
+	unsigned int i, num = 1;
+
+	while (num < 2 * window)
+		num <<= 1;
+
+	fl1h->wlc_slots = talloc_zero_array(fl1h, struct wait_l1_conf, num);
+	if (!fl1h->wlc_slots)
+		return -ENOMEM;
+	fl1h->wlc_num_slots = num;
+	fl1h->wlc_window = window;
+
+	for (i = 0; i < num; i++) {
+		INIT_LLIST_HEAD(&fl1h->wlc_slots[i].list);
+		fl1h->wlc_slots[i].timer.data = &fl1h->wlc_slots[i];
+		fl1h->wlc_slots[i].timer.cb = l1if_req_timeout;
+	}
+
+	return 0;
+}
+
+/* send a command that stays in the window.  Unless something is waiting in
+ * the write queue, it is sent right away without copying it; otherwise a
+ * copy is queued, as the write queue frees what it has sent. */
+static int wlc_tx(struct octphy_hdl *fl1h, struct msgb *cmd_msg)
+{
+	struct msgb *msg;
+	int rc;
+
+	if (llist_empty(&fl1h->phy_wq.msg_queue)) {
+		rc = sendto(fl1h->phy_wq.bfd.fd, cmd_msg->data,
+			    msgb_length(cmd_msg), 0,
+			    (struct sockaddr *) &fl1h->phy_addr,
+			    sizeof(fl1h->phy_addr));
+		if (rc >= 0)
+			return 0;
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			/* like octphy_write_cb(), leave it to the timeout */
+			LOGP(DL1P, LOGL_ERROR, "Tx to PHY has failed: %s\n",
+				strerror(errno));
+			return 0;
+		}
+	}
+
+	msg = msgb_copy(cmd_msg, "PHY CMD Tx");
+	if (!msg)
+		return -ENOMEM;
+	if (osmo_wqueue_enqueue(&fl1h->phy_wq, msg) != 0) {
+		msgb_free(msg);
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+static void check_refill_window(struct octphy_hdl *fl1h, struct msgb *recent)
 {
 	struct wait_l1_conf *wlc;
-	int space = UNACK_CMD_WINDOW - fl1h->wlc_list_len;
-	int i;
+	struct wlc_msg_cb *mcb;
+	struct msgb *msg;
 
-	for (i = 0; i < space; i++) {
+	while (fl1h->wlc_list_len < fl1h->wlc_window) {
 		/* get head of queue */
 		struct llist_head *first = llist_first(&fl1h->wlc_postponed);
-		struct msgb *msg;
 		if (!first)
 			break;
-		wlc = llist_entry(first, struct wait_l1_conf, list);
+		msg = llist_entry(first, struct msgb, list);
+		mcb = WLC_MSG_CB(msg);
+
+		/* commands are sent in order, so the head has to wait for
+		 * the response that frees its slot */
+		wlc = wlc_slot(fl1h, mcb->trans_id);
+		if (wlc->cmd_msg)
+			break;
 
 		/* remove from head of postponed queue */
-		llist_del(&wlc->list);
+		llist_del(&msg->list);
 		fl1h->wlc_postponed_len--;
 
 		/* add to window */
+		wlc->cmd_msg = msg;
+		wlc->cb = mcb->cb;
+		wlc->cb_data = mcb->cb_data;
+		wlc->prim_id = mcb->prim_id;
+		wlc->trans_id = mcb->trans_id;
+		wlc->num_retrans = 0;
 		llist_add_tail(&wlc->list, &fl1h->wlc_list);
 		fl1h->wlc_list_len++;
 
-		if (wlc != recent) {
+		if (msg != recent) {
 			LOGP(DL1C, LOGL_INFO, "Txing formerly postponed "
 			     "command %s (trans_id=%u)\n",
 			     get_value_string(octphy_cid_vals, wlc->prim_id),
 			     wlc->trans_id);
 		}
-		msg = msgb_copy(wlc->cmd_msg, "Tx from wlc_postponed");
-		/* queue for execution and response handling */
-		if (osmo_wqueue_enqueue(&fl1h->phy_wq, msg) != 0) {
+		/* send for execution and response handling */
+		if (wlc_tx(fl1h, msg) != 0) {
 			LOGP(DL1C, LOGL_ERROR, "Tx Write queue full. dropping msg\n");
-			llist_del(&wlc->list);
-			msgb_free(msg);
+			release_wlc(fl1h, wlc);
 			exit(24);
 		}
 		/* schedule a timer for CMD_TIMEOUT seconds. If PHY fails to
 		 * respond, we terminate */
 		osmo_timer_schedule(&wlc->timer, CMD_TIMEOUT, 0);
-
 	}
 }
 
@@ -251,7 +341,7 @@ static void check_refill_window(struct octphy_hdl *fl1h, struct wait_l1_conf *re
 int l1if_req_compl(struct octphy_hdl *fl1h, struct msgb *msg,
 		   l1if_compl_cb *cb, void *data)
 {
-	struct wait_l1_conf *wlc;
+	struct wlc_msg_cb *mcb = WLC_MSG_CB(msg);
 
 	/* assume that there is a VC1 Message header and that it
 	 * contains a command ID in network byte order */
@@ -269,28 +359,24 @@ int l1if_req_compl(struct octphy_hdl *fl1h, struct msgb *msg,
 	octpkt_push_common_hdr(msg, cOCTVOCNET_PKT_FORMAT_CTRL, 0,
 			       cOCTPKT_HDR_CONTROL_PROTOCOL_TYPE_ENUM_OCTVOCNET);
 
-	wlc = talloc_zero(fl1h, struct wait_l1_conf);
-	wlc->cmd_msg = msg;
-	wlc->cb = cb;
-	wlc->cb_data = data;
-	wlc->prim_id = cmd_id;
-	wlc->trans_id = ntohl(msg_hdr->ulTransactionId);
-	wlc->timer.data = wlc;
-	wlc->timer.cb = l1if_req_timeout;
+	mcb->cb = cb;
+	mcb->cb_data = data;
+	mcb->prim_id = cmd_id;
+	mcb->trans_id = ntohl(msg_hdr->ulTransactionId);
 
 	/* unconditionally add t to the tail of postponed commands */
-	llist_add_tail(&wlc->list, &fl1h->wlc_postponed);
+	msgb_enqueue(&fl1h->wlc_postponed, msg);
 	fl1h->wlc_postponed_len++;
 
 	/* check if the unacknowledged window has some space to transmit */
-	check_refill_window(fl1h, wlc);
+	check_refill_window(fl1h, msg);
 
 	/* if any messages are in the queue, it must be at least 'our' message,
 	 * as we always enqueue from the tail */
 	if (fl1h->wlc_postponed_len) {
 		fl1h->stats.wlc_postponed++;
 		LOGP(DL1C, LOGL_INFO, "Postponed command %s (trans_id=%u)\n",
-		     get_value_string(octphy_cid_vals, cmd_id), wlc->trans_id);
+		     get_value_string(octphy_cid_vals, cmd_id), mcb->trans_id);
 	}
 
 	return 0;
@@ -1135,28 +1221,30 @@ static int retransmit_wlc_upto(struct octphy_hdl *fl1h, uint32_t trans_id)
 	LOGP(DL1C, LOGL_INFO, "Retransmitting up to trans_id=%u\n", trans_id);
 
 	/* trans_id represents the trans_id of the just-received response, we
-	 * therefore need to re-send any commands with a lower trans_id */
+	 * therefore need to re-send any commands with a lower trans_id.  The
+	 * window is in order of transaction IDs. */
 	llist_for_each_entry(wlc, &fl1h->wlc_list, list) {
-		if (wlc->trans_id <= trans_id) {
-			struct msgb *msg;
-			if (wlc->num_retrans >= MAX_RETRANS) {
-				LOGP(DL1C, LOGL_ERROR, "Command %s: maximum "
-				     "number of retransmissions reached\n",
-				     get_value_string(octphy_cid_vals,
-						      wlc->prim_id));
-				exit(24);
-			}
-			wlc->num_retrans++;
-			msg = msgb_copy(wlc->cmd_msg, "PHY CMD Retrans");
-			msg_set_retrans_flag(msg);
-			osmo_wqueue_enqueue(&fl1h->phy_wq, msg);
-			osmo_timer_schedule(&wlc->timer, CMD_TIMEOUT, 0);
-			count++;
-			LOGP(DL1C, LOGL_INFO, "Re-transmitting %s "
-			     "(trans_id=%u, attempt %u)\n",
-			     get_value_string(octphy_cid_vals, wlc->prim_id),
-			     wlc->trans_id, wlc->num_retrans);
+		if ((int32_t)(wlc->trans_id - trans_id) > 0)
+			break;
+		if (wlc->num_retrans >= MAX_RETRANS) {
+			LOGP(DL1C, LOGL_ERROR, "Command %s: maximum "
+			     "number of retransmissions reached\n",
+			     get_value_string(octphy_cid_vals,
+					      wlc->prim_id));
+			exit(24);
 		}
+		wlc->num_retrans++;
+		/* every further transmission is a retransmission */
+		msg_set_retrans_flag(wlc->cmd_msg);
+		if (wlc_tx(fl1h, wlc->cmd_msg) != 0)
+			LOGP(DL1C, LOGL_ERROR, "Tx Write queue full. "
+			     "not re-transmitting\n");
+		osmo_timer_schedule(&wlc->timer, CMD_TIMEOUT, 0);
+		count++;
+		LOGP(DL1C, LOGL_INFO, "Re-transmitting %s "
+		     "(trans_id=%u, attempt %u)\n",
+		     get_value_string(octphy_cid_vals, wlc->prim_id),
+		     wlc->trans_id, wlc->num_retrans);
 	}
 
 	return count;
@@ -1169,53 +1257,52 @@ static int rx_octvc1_resp(struct msgb *msg, uint32_t msg_id, uint32_t trans_id)
 	struct llist_head *first;
 	uint32_t return_code = ntohl(mh->ulReturnCode);
 	struct octphy_hdl *fl1h = msg->dst;
-	struct wait_l1_conf *wlc = NULL;
+	struct wait_l1_conf *oldest = NULL;
+	struct wait_l1_conf *wlc = wlc_slot(fl1h, trans_id);
 	int rc;
 
 	LOGP(DL1C, LOGL_DEBUG, "rx_octvc1_resp(msg_id=%s, trans_id=%u)\n",
 		octvc1_rc2string(msg_id), trans_id);
 
+	if (!wlc->cmd_msg || wlc->trans_id != trans_id)
+		wlc = NULL;
+
 	/* check if the response is for the oldest (first) entry in wlc_list */
 	first = llist_first(&fl1h->wlc_list);
-	if (first) {
-		wlc = llist_entry(first, struct wait_l1_conf, list);
-		if (wlc->trans_id == trans_id) {
-			/* process the received response */
-			llist_del(&wlc->list);
-			fl1h->wlc_list_len--;
-			if (wlc->cb) {
-				/* call-back function must take msgb
-				 * ownership. */
-				rc = wlc->cb(fl1h, msg, wlc->cb_data);
-			} else {
-				rc = 0;
-				msgb_free(msg);
-			}
-			release_wlc(wlc);
-			/* check if there are postponed wlcs and re-fill the window */
-			check_refill_window(fl1h, NULL);
-			return rc;
+	if (first)
+		oldest = llist_entry(first, struct wait_l1_conf, list);
+	if (wlc && wlc == oldest) {
+		/* process the received response */
+		if (wlc->cb) {
+			/* call-back function must take msgb
+			 * ownership. */
+			rc = wlc->cb(fl1h, msg, wlc->cb_data);
+		} else {
+			rc = 0;
+			msgb_free(msg);
 		}
+		release_wlc(fl1h, wlc);
+		/* check if there are postponed wlcs and re-fill the window */
+		check_refill_window(fl1h, NULL);
+		return rc;
 	}
 
 	LOGP(DL1C, LOGL_NOTICE, "Sequence error: Rx response (cmd=%s, trans_id=%u) "
 	     "for cmd != oldest entry in window (trans_id=%u)!!\n",
 	     get_value_string(octphy_cid_vals, msg_id), trans_id,
-	     wlc ? wlc->trans_id : 0);
+	     oldest ? oldest->trans_id : 0);
 
 	/* check if the response is for any of the other entries in wlc_list */
-	llist_for_each_entry(wlc, &fl1h->wlc_list, list) {
-		if (wlc->prim_id == msg_id && wlc->trans_id == trans_id) {
-			/* it is assumed that all of the previous response
-			 * message(s) have been lost, and we need to
-			 * re-transmit older messages from the window */
-			rc = retransmit_wlc_upto(fl1h, trans_id);
-			fl1h->stats.retrans_cmds_trans_id += rc;
-			/* do not process the received response, we rather wait
-			 * for the in-order retransmissions to arrive */
-			msgb_free(msg);
-			return 0;
-		}
+	if (wlc && wlc->prim_id == msg_id) {
+		/* it is assumed that all of the previous response
+		 * message(s) have been lost, and we need to
+		 * re-transmit older messages from the window */
+		rc = retransmit_wlc_upto(fl1h, trans_id);
+		fl1h->stats.retrans_cmds_trans_id += rc;
+		/* do not process the received response, we rather wait
+		 * for the in-order retransmissions to arrive */
+		msgb_free(msg);
+		return 0;
 	}
 
 	/* ignore unhandled responses that went ok, but let the user know about
@@ -1546,6 +1633,7 @@ void bts_model_phy_link_set_defaults(struct phy_link *plink)
 	plink->u.octphy.rf_port_index = 0;
 	plink->u.octphy.rx_gain_db = 70;
 	plink->u.octphy.tx_atten_db = 0;
+	plink->u.octphy.cmd_window = DEFAULT_CMD_WINDOW;
 }
 
 void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
@@ -1562,7 +1650,7 @@ static int octphy_read_cb(struct osmo_fd *ofd)
 	struct sockaddr_ll sll;
 	socklen_t sll_len = sizeof(sll);
 	int rc;
-	struct msgb *msg = msgb_alloc_headroom(1500, 24, "PHY Rx");
+	struct msgb *msg = msgb_alloc_headroom(PHY_RX_MSG_SIZE, 24, "PHY Rx");
 
 	if (!msg)
 		return -ENOMEM;
@@ -1583,6 +1671,68 @@ static int octphy_read_cb(struct osmo_fd *ofd)
 	return rx_octphy_msg(msg);
 }
 
+/* receive thread: read all pending messages of the non-blocking socket */
+static int octphy_ring_rx_cb(struct prim_ring *r, int fd, int tag)
+{
+	unsigned int i, space = prim_ring_space(r);
+	int rc;
+
+	for (i = 0; i < space; i++) {
+		rc = recv(fd, prim_ring_slot_buf(r, 0), r->slot_size, 0);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || i)
+				break;
+			return -errno;
+		}
+		prim_ring_produce(r, rc, tag);
+	}
+
+	return i;
+}
+
+/* main loop: hand a message from the ring to the PHY message handler */
+static void octphy_ring_dispatch_cb(struct prim_ring *r, const uint8_t *data,
+				    unsigned int len, int tag)
+{
+	struct msgb *msg = msgb_alloc_headroom(PHY_RX_MSG_SIZE, 24, "PHY Rx");
+
+	if (!msg)
+		return;
+
+	/* this is the fl1h over which the message was received */
+	msg->dst = r->data;
+	memcpy(msgb_put(msg, len), data, len);
+
+	rx_octphy_msg(msg);
+}
+
+/* read the PHY socket on a separate thread, the write queue stays in the
+ * main loop */
+static int octphy_rx_thread_start(struct octphy_hdl *fl1h)
+{
+	struct phy_link *plink = fl1h->phy_link;
+	int rc;
+
+	fl1h->rx_ring = prim_ring_alloc(fl1h, L1_RX_RING_SLOTS,
+					PHY_RX_MSG_SIZE);
+	if (!fl1h->rx_ring)
+		return -ENOMEM;
+
+	prim_ring_add_fd(fl1h->rx_ring, fl1h->phy_wq.bfd.fd, 0);
+	rc = prim_ring_start(fl1h->rx_ring, octphy_ring_rx_cb,
+			     octphy_ring_dispatch_cb, fl1h, plink->l1_rx_prio);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_NOTICE, "Receiving from PHY in the main "
+			"loop\n");
+		prim_ring_free(fl1h->rx_ring);
+		fl1h->rx_ring = NULL;
+		return rc;
+	}
+	fl1h->phy_wq.bfd.when &= ~BSC_FD_READ;
+
+	return 0;
+}
+
 static int octphy_write_cb(struct osmo_fd *fd, struct msgb *msg)
 {
 	struct octphy_hdl *fl1h = fd->data;
@@ -1617,6 +1767,11 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 	INIT_LLIST_HEAD(&fl1h->wlc_postponed);
 	fl1h->phy_link = plink;
 
+	if (wlc_slots_alloc(fl1h, plink->u.octphy.cmd_window) < 0) {
+		talloc_free(fl1h);
+		return NULL;
+	}
+
 	if (!phy_dev) {
 		LOGP(DL1C, LOGL_ERROR, "You have to specify a octphy net-device\n");
 		talloc_free(fl1h);
@@ -1660,7 +1815,8 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 		ETH_ALEN);
 
 	/* Write queue / osmo_fd registration */
-	osmo_wqueue_init(&fl1h->phy_wq, 10);
+	/* room for retransmitting the whole window */
+	osmo_wqueue_init(&fl1h->phy_wq, 10 + fl1h->wlc_window);
 	fl1h->phy_wq.write_cb = octphy_write_cb;
 	fl1h->phy_wq.read_cb = octphy_read_cb;
 	fl1h->phy_wq.bfd.fd = sfd;
@@ -1674,13 +1830,29 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 		return NULL;
 	}
 
+	if (plink->l1_rx_thread)
+		octphy_rx_thread_start(fl1h);
+
 	return fl1h;
 }
 
 int l1if_close(struct octphy_hdl *fl1h)
 {
+	struct wait_l1_conf *wlc, *wlc2;
+	struct msgb *msg;
+
+	/* stop the receive thread before the socket is closed */
+	prim_ring_free(fl1h->rx_ring);
+	fl1h->rx_ring = NULL;
 	osmo_fd_unregister(&fl1h->phy_wq.bfd);
 	close(fl1h->phy_wq.bfd.fd);
+
+	/* the slots go with fl1h, but not the commands in them */
+	llist_for_each_entry_safe(wlc, wlc2, &fl1h->wlc_list, list)
+		release_wlc(fl1h, wlc);
+	while ((msg = msgb_dequeue(&fl1h->wlc_postponed)))
+		msgb_free(msg);
+	osmo_wqueue_clear(&fl1h->phy_wq);
 	talloc_free(fl1h);
 
 	return 0;
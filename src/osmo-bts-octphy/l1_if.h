@@ -14,9 +14,15 @@
 
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/prim_ring.h>
 
 #include <octphy/octvc1/gsm/octvc1_gsm_api.h>
 
+/* maximum size of a message from the PHY */
+#define PHY_RX_MSG_SIZE		1500
+/* messages buffered between the receive thread and the main loop */
+#define L1_RX_RING_SLOTS	64
+
 struct octphy_hdl {
 	/* MAC address of the PHY */
 	struct sockaddr_ll phy_addr;
@@ -24,6 +30,9 @@ struct octphy_hdl {
 	/* packet socket to talk with PHY */
 	struct osmo_wqueue phy_wq;
 
+	/* messages from the receive thread, NULL if read by the main loop */
+	struct prim_ring *rx_ring;
+
 	/* address parameters of the PHY */
 	uint32_t session_id;
 	uint32_t next_trans_id;
@@ -50,6 +59,12 @@ struct octphy_hdl {
 	 * Command Window' */
 	struct llist_head wlc_list;
 	int wlc_list_len;
+	/* the entries of wlc_list, indexed by transaction ID modulo the
+	 * number of slots, so that a response needs no search */
+	struct wait_l1_conf *wlc_slots;
+	unsigned int wlc_num_slots;
+	/* maximum number of commands in wlc_list */
+	int wlc_window;
 	struct {
 		/* messages retransmitted due to discontinuity of transaction
 		 * ID in responses from PHY */
@@ -60,7 +75,7 @@ struct octphy_hdl {
 		uint32_t wlc_postponed;
 	} stats;
 
-	/* This is a list of wait_la_conf that OsmoBTS wanted to transmit to
+	/* This is a queue of command msgbs that OsmoBTS wanted to transmit to
 	 * the PHY, but which couldn't yet been sent as the unacknowledged
 	 * command window was full. */
 	struct llist_head wlc_postponed;
@@ -311,8 +311,9 @@ err_payload_match:
  *  \param[in] rtp_pl buffer containing RTP payload
  *  \param[in] rtp_pl_len length of \a rtp_pl
  *
- * This function prepares a msgb with a L1 PH-DATA.req primitive and
- * queues it into lchan->dl_tch_queue.
+ * This function converts the RTP payload of a frame popped from the
+ * jitter ring of the lchan (see dl_tch_ring.c) into the payload of a L1
+ * PH-DATA.req primitive.
  *
  * Note that the actual L1 primitive header is not fully initialized
  * yet, as things like the frame number, etc. are unknown at the time we
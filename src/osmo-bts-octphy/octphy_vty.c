@@ -153,6 +153,24 @@ DEFUN(cfg_phy_tx_atten_db, cfg_phy_tx_atten_db_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_phy_cmd_window, cfg_phy_cmd_window_cmd,
+	"octphy cmd-window <1-256>",
+	OCT_STR "Configure the window of unacknowledged commands\n"
+	"Number of commands sent before waiting for a response\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (plink->state != PHY_LINK_SHUTDOWN) {
+		vty_out(vty, "Can only reconfigure a PHY link that is down%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.octphy.cmd_window = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_rf_port_stats, show_rf_port_stats_cmd,
 	"show phy <0-255> rf-port-stats <0-1>",
 	"Show statistics for the RF Port\n"
@@ -206,6 +224,8 @@ void bts_model_config_write_phy(struct vty *vty, struct phy_link *plink)
 		VTY_NEWLINE);
 	vty_out(vty, "  rf-port-index %u%s", plink->u.octphy.rf_port_index,
 		VTY_NEWLINE);
+	vty_out(vty, "  octphy cmd-window %u%s", plink->u.octphy.cmd_window,
+		VTY_NEWLINE);
 }
 
 void bts_model_config_write_bts(struct vty *vty, struct gsm_bts *bts)
@@ -251,6 +271,10 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	install_element(PHY_NODE, &cfg_phy_rf_port_idx_cmd);
 	install_element(PHY_NODE, &cfg_phy_rx_gain_db_cmd);
 	install_element(PHY_NODE, &cfg_phy_tx_atten_db_cmd);
+	install_element(PHY_NODE, &cfg_phy_cmd_window_cmd);
+	install_element(PHY_NODE, &cfg_phy_l1_rx_thread_cmd);
+	install_element(PHY_NODE, &cfg_phy_l1_rx_thread_rt_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_l1_rx_thread_cmd);
 
 	install_element_ve(&show_rf_port_stats_cmd);
 	install_element_ve(&show_clk_sync_stats_cmd);
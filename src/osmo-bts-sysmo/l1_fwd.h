@@ -1,5 +1,67 @@
+#ifndef _L1_FWD_H
+#define _L1_FWD_H
+
+#include <stdint.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/write_queue.h>
+
 #define L1FWD_L1_PORT	9999
 #define L1FWD_SYS_PORT	9998
 #define L1FWD_TCH_PORT	9997
 #define L1FWD_PDTCH_PORT 9996
 
+/* set in the environment of both l1fwd-proxy and osmo-bts-sysmo-remote to
+ * pack several primitives into one datagram */
+#define L1FWD_BATCH_ENV	"L1FWD_BATCH"
+
+struct l1fwd_batch;
+
+/*! \brief called for every primitive unpacked from a received datagram,
+ *  takes ownership of msg */
+typedef int l1fwd_batch_rx_cb(struct l1fwd_batch *b, struct msgb *msg);
+
+struct l1fwd_batch_stats {
+	unsigned long tx_prims;		/* primitives sent */
+	unsigned long tx_dgrams;	/* datagrams sent */
+	unsigned long tx_drops;		/* primitives not sent */
+	unsigned long rx_prims;		/* primitives received */
+	unsigned long rx_dgrams;	/* datagrams received */
+	unsigned long rx_drops;		/* primitives not delivered */
+};
+
+/* The primitives of one write queue, sent in as few datagrams as possible
+ * once per round of the main loop, and received with one recvmmsg(). */
+struct l1fwd_batch {
+	struct osmo_wqueue *wq;
+	/* send to the source of the last received datagram */
+	int learn_peer;
+
+	struct udp_batch *tx;
+	struct udp_batch *rx;
+	uint8_t *cur;			/* datagram being filled */
+	unsigned int cur_len;
+	unsigned int cur_prims;		/* primitives in the tx batch */
+
+	l1fwd_batch_rx_cb *rx_cb;
+	void *data;
+
+	struct l1fwd_batch_stats stats;
+	struct l1fwd_batch_stats reported;
+	/* time primitives waited in the write queue, since the last report */
+	uint64_t lat_sum_us;
+	unsigned long lat_num;
+	uint32_t lat_max_us;
+	struct osmo_timer_list report_timer;
+};
+
+int l1fwd_batch_enabled(void);
+struct l1fwd_batch *l1fwd_batch_alloc(void *ctx, struct osmo_wqueue *wq,
+				      int learn_peer, l1fwd_batch_rx_cb *rx_cb,
+				      void *data);
+void l1fwd_batch_free(struct l1fwd_batch *b);
+struct l1fwd_batch *l1fwd_batch_get(struct osmo_wqueue *wq);
+void l1fwd_batch_stamp(struct msgb *msg);
+
+#endif /* _L1_FWD_H */
@@ -0,0 +1,371 @@
+/* Batching of L1 primitives between l1fwd-proxy and the remote BTS */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Without batching, every primitive is a datagram of its own, sent by one
+ * write of the write queue per round of the main loop.  With batching, a
+ * write queue is drained completely once it becomes writable, and its
+ * primitives are packed into datagrams of up to L1FWD_BATCH_MTU bytes that
+ * are all sent with one sendmmsg().  Received datagrams are fetched with
+ * one recvmmsg().
+ *
+ * A batched datagram starts with L1FWD_BATCH_MAGIC, followed by the
+ * primitives, each with a 16 bit length in network byte order in front. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/write_queue.h>
+#include <osmocom/core/msgb.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/udp_batch.h>
+
+#include <sysmocom/femtobts/superfemto.h>
+#include <sysmocom/femtobts/gsml1prim.h>
+#include <sysmocom/femtobts/gsml1const.h>
+#include <sysmocom/femtobts/gsml1types.h>
+
+#include "femtobts.h"
+#include "l1_if.h"
+#include "l1_fwd.h"
+
+#define L1FWD_BATCH_MAGIC	"L1FB"
+#define L1FWD_BATCH_HDR_LEN	4
+/* stay below the Ethernet MTU, a bigger primitive goes alone */
+#define L1FWD_BATCH_MTU		1472
+#define L1FWD_BATCH_BUF_LEN \
+	OSMO_MAX(L1FWD_BATCH_MTU, L1FWD_BATCH_HDR_LEN + 2 + SYSMOBTS_PRIM_SIZE)
+/* datagrams per sendmmsg() / recvmmsg() */
+#define L1FWD_BATCH_DGRAMS	16
+/* a write queue is drained only once per round of the main loop */
+#define L1FWD_BATCH_QUEUE_LEN	256
+#define L1FWD_BATCH_REPORT_SECS	10
+
+/* the read queues of the proxy have the same numbers */
+static const char *queue_names[_NUM_MQ_WRITE] = {
+	[MQ_SYS_WRITE]		= "SYS",
+	[MQ_L1_WRITE]		= "L1",
+#ifndef HW_SYSMOBTS_V1
+	[MQ_TCH_WRITE]		= "TCH",
+	[MQ_PDTCH_WRITE]	= "PDTCH",
+#endif
+};
+
+static uint32_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int l1fwd_batch_enabled(void)
+{
+	char *env = getenv(L1FWD_BATCH_ENV);
+
+	return env && strcmp(env, "0");
+}
+
+/*! \brief remember when a primitive was put into a write queue, for the
+ *  latency reported by the batch of that queue */
+void l1fwd_batch_stamp(struct msgb *msg)
+{
+	msg->cb[0] = now_us();
+	msg->cb[1] = 1;
+}
+
+/* finish the datagram being filled */
+static void batch_commit(struct l1fwd_batch *b)
+{
+	if (!b->cur)
+		return;
+	udp_batch_tx_commit(b->tx, b->cur_len);
+	b->cur = NULL;
+}
+
+static void batch_send(struct l1fwd_batch *b)
+{
+	int rc;
+
+	batch_commit(b);
+	if (!b->tx->num)
+		return;
+
+	if (b->learn_peer && !b->tx->dest_len) {
+		/* nobody has talked to us yet */
+		b->tx->num = 0;
+		b->stats.tx_drops += b->cur_prims;
+		b->cur_prims = 0;
+		return;
+	}
+
+	rc = udp_batch_send(b->tx, b->wq->bfd.fd);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Error sending %s primitives: %s\n",
+			queue_names[b->wq->bfd.priv_nr], strerror(-rc));
+		b->stats.tx_drops += b->cur_prims;
+	} else {
+		b->stats.tx_dgrams += rc;
+		b->stats.tx_prims += b->cur_prims;
+	}
+	b->cur_prims = 0;
+}
+
+/* append a primitive to the datagram being filled */
+static void batch_put(struct l1fwd_batch *b, const uint8_t *data,
+		      unsigned int len)
+{
+	/* an empty datagram takes any primitive */
+	if (b->cur && b->cur_len > L1FWD_BATCH_HDR_LEN
+	 && b->cur_len + 2 + len > L1FWD_BATCH_MTU)
+		batch_commit(b);
+
+	if (!b->cur) {
+		b->cur = udp_batch_tx_buf(b->tx);
+		if (!b->cur) {
+			batch_send(b);
+			b->cur = udp_batch_tx_buf(b->tx);
+		}
+		memcpy(b->cur, L1FWD_BATCH_MAGIC, L1FWD_BATCH_HDR_LEN);
+		b->cur_len = L1FWD_BATCH_HDR_LEN;
+	}
+
+	b->cur[b->cur_len++] = len >> 8;
+	b->cur[b->cur_len++] = len & 0xff;
+	memcpy(b->cur + b->cur_len, data, len);
+	b->cur_len += len;
+	b->cur_prims++;
+}
+
+/* drain the write queue into as few datagrams as possible */
+static void batch_flush(struct l1fwd_batch *b)
+{
+	struct osmo_wqueue *wq = b->wq;
+	struct msgb *msg;
+	uint32_t now = now_us(), lat;
+
+	while ((msg = msgb_dequeue(&wq->msg_queue))) {
+		wq->current_length--;
+
+		if (msgb_l1len(msg) + L1FWD_BATCH_HDR_LEN + 2
+						> L1FWD_BATCH_BUF_LEN) {
+			LOGP(DL1C, LOGL_ERROR, "%s primitive of %u bytes is "
+				"too long\n", queue_names[wq->bfd.priv_nr],
+				msgb_l1len(msg));
+			b->stats.tx_drops++;
+			msgb_free(msg);
+			continue;
+		}
+
+		if (msg->cb[1]) {
+			lat = now - msg->cb[0];
+			b->lat_sum_us += lat;
+			b->lat_num++;
+			if (lat > b->lat_max_us)
+				b->lat_max_us = lat;
+		}
+
+		batch_put(b, msg->l1h, msgb_l1len(msg));
+		msgb_free(msg);
+	}
+
+	batch_send(b);
+}
+
+/* unpack the primitives of a received datagram */
+static void batch_unpack(struct l1fwd_batch *b, const uint8_t *buf,
+			 unsigned int len)
+{
+	struct msgb *msg;
+	unsigned int off, plen;
+
+	if (len < L1FWD_BATCH_HDR_LEN
+	 || memcmp(buf, L1FWD_BATCH_MAGIC, L1FWD_BATCH_HDR_LEN)) {
+		LOGP(DL1C, LOGL_ERROR, "Unbatched %s datagram, is %s set at "
+			"both ends?\n", queue_names[b->wq->bfd.priv_nr],
+			L1FWD_BATCH_ENV);
+		b->stats.rx_drops++;
+		return;
+	}
+
+	for (off = L1FWD_BATCH_HDR_LEN; off + 2 <= len; off += plen) {
+		plen = (buf[off] << 8) | buf[off + 1];
+		off += 2;
+		if (!plen || plen > len - off || plen > SYSMOBTS_PRIM_SIZE) {
+			LOGP(DL1C, LOGL_ERROR, "Malformed %s datagram\n",
+				queue_names[b->wq->bfd.priv_nr]);
+			b->stats.rx_drops++;
+			return;
+		}
+
+		msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
+		if (!msg) {
+			b->stats.rx_drops++;
+			return;
+		}
+		msg->l1h = msgb_put(msg, plen);
+		memcpy(msg->l1h, buf + off, plen);
+
+		if (b->rx_cb(b, msg) < 0)
+			b->stats.rx_drops++;
+		else
+			b->stats.rx_prims++;
+	}
+}
+
+static void batch_recv(struct l1fwd_batch *b)
+{
+	struct udp_batch *rx = b->rx;
+	unsigned int i, len;
+	uint8_t *buf;
+	int rc;
+
+	rc = udp_batch_recv(rx, b->wq->bfd.fd);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Error receiving %s primitives: %s\n",
+			queue_names[b->wq->bfd.priv_nr], strerror(-rc));
+		return;
+	}
+	if (!rc)
+		return;
+
+	if (b->learn_peer && (rx->src_len != b->tx->dest_len
+	 || memcmp(&rx->src, &b->tx->dest, rx->src_len))) {
+		LOGP(DL1C, LOGL_NOTICE, "Sending %s primitives to a new "
+			"peer\n", queue_names[b->wq->bfd.priv_nr]);
+		udp_batch_set_dest(b->tx, (struct sockaddr *) &rx->src,
+				   rx->src_len);
+	}
+
+	b->stats.rx_dgrams += rx->num;
+	for (i = 0; i < rx->num; i++) {
+		buf = udp_batch_rx_buf(rx, i, &len);
+		batch_unpack(b, buf, len);
+	}
+}
+
+static int batch_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct l1fwd_batch *b = ofd->data;
+
+	if (what & BSC_FD_READ)
+		batch_recv(b);
+
+	if (what & BSC_FD_WRITE) {
+		/* osmo_wqueue_enqueue() asks for the next round again */
+		ofd->when &= ~BSC_FD_WRITE;
+		batch_flush(b);
+	}
+
+	return 0;
+}
+
+static void report_timer_cb(void *data)
+{
+	struct l1fwd_batch *b = data;
+	struct l1fwd_batch_stats *s = &b->stats;
+	struct l1fwd_batch_stats *r = &b->reported;
+
+	if (memcmp(s, r, sizeof(*s))) {
+		LOGP(DL1C, (s->tx_drops != r->tx_drops
+			    || s->rx_drops != r->rx_drops)
+				? LOGL_NOTICE : LOGL_INFO,
+			"%s: tx %lu prims in %lu datagrams, %lu dropped, "
+			"queued avg %u max %u us; rx %lu prims in %lu "
+			"datagrams, %lu dropped\n",
+			queue_names[b->wq->bfd.priv_nr],
+			s->tx_prims - r->tx_prims, s->tx_dgrams - r->tx_dgrams,
+			s->tx_drops - r->tx_drops,
+			b->lat_num ? (unsigned int)(b->lat_sum_us / b->lat_num)
+				   : 0,
+			b->lat_max_us,
+			s->rx_prims - r->rx_prims, s->rx_dgrams - r->rx_dgrams,
+			s->rx_drops - r->rx_drops);
+		*r = *s;
+		b->lat_sum_us = 0;
+		b->lat_num = 0;
+		b->lat_max_us = 0;
+	}
+
+	osmo_timer_schedule(&b->report_timer, L1FWD_BATCH_REPORT_SECS, 0);
+}
+
+/*! \brief batch the primitives of a write queue on a UDP socket
+ *
+ * Takes over the osmo_fd of the write queue, whose data must not be used by
+ * the caller anymore.  Primitives still go into the write queue with
+ * osmo_wqueue_enqueue().
+ *  \param[in] learn_peer send to where the last datagram came from, for an
+ *  unconnected socket */
+struct l1fwd_batch *l1fwd_batch_alloc(void *ctx, struct osmo_wqueue *wq,
+				      int learn_peer, l1fwd_batch_rx_cb *rx_cb,
+				      void *data)
+{
+	struct l1fwd_batch *b;
+
+	b = talloc_zero(ctx, struct l1fwd_batch);
+	if (!b)
+		return NULL;
+
+	b->tx = udp_batch_alloc(b, L1FWD_BATCH_DGRAMS, L1FWD_BATCH_BUF_LEN);
+	b->rx = udp_batch_alloc(b, L1FWD_BATCH_DGRAMS, L1FWD_BATCH_BUF_LEN);
+	if (!b->tx || !b->rx) {
+		talloc_free(b);
+		return NULL;
+	}
+
+	b->wq = wq;
+	b->learn_peer = learn_peer;
+	b->rx_cb = rx_cb;
+	b->data = data;
+
+	wq->max_length = L1FWD_BATCH_QUEUE_LEN;
+	wq->bfd.cb = batch_fd_cb;
+	wq->bfd.data = b;
+
+	b->report_timer.cb = report_timer_cb;
+	b->report_timer.data = b;
+	osmo_timer_schedule(&b->report_timer, L1FWD_BATCH_REPORT_SECS, 0);
+
+	LOGP(DL1C, LOGL_NOTICE, "Batching %s primitives\n",
+		queue_names[wq->bfd.priv_nr]);
+
+	return b;
+}
+
+void l1fwd_batch_free(struct l1fwd_batch *b)
+{
+	osmo_timer_del(&b->report_timer);
+	talloc_free(b);
+}
+
+/*! \brief get the batch of a write queue, or NULL if it is not batched */
+struct l1fwd_batch *l1fwd_batch_get(struct osmo_wqueue *wq)
+{
+	if (wq->bfd.cb != batch_fd_cb)
+		return NULL;
+	return wq->bfd.data;
+}
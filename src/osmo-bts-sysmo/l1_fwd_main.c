@@ -66,46 +66,75 @@ struct l1fwd_hdl {
 	socklen_t remote_sa_len[_NUM_MQ_WRITE];
 
 	struct osmo_wqueue udp_wq[_NUM_MQ_WRITE];
+	/* NULL unless L1FWD_BATCH_ENV is set */
+	struct l1fwd_batch *batch[_NUM_MQ_WRITE];
 
 	struct femtol1_hdl *fl1h;
 };
 
-
-/* callback when there's a new L1 primitive coming in from the HW */
-int l1if_handle_l1prim(int wq, struct femtol1_hdl *fl1h, struct msgb *msg)
+/* put a primitive from the HW into the write queue of its UDP socket */
+static int udp_enqueue(struct l1fwd_hdl *l1fh, int wq, struct msgb *msg)
 {
-	struct l1fwd_hdl *l1fh = fl1h->priv;
+	struct l1fwd_batch *b = l1fh->batch[wq];
+
+	if (b)
+		l1fwd_batch_stamp(msg);
 
-	/* Enqueue message to UDP socket */
 	if (osmo_wqueue_enqueue(&l1fh->udp_wq[wq], msg) != 0) {
 		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n", wq);
+		if (b)
+			b->stats.tx_drops++;
 		msgb_free(msg);
 		return -EAGAIN;
 	}
 	return 0;
 }
 
+
+/* callback when there's a new L1 primitive coming in from the HW */
+int l1if_handle_l1prim(int wq, struct femtol1_hdl *fl1h, struct msgb *msg)
+{
+	struct l1fwd_hdl *l1fh = fl1h->priv;
+
+	/* Enqueue message to UDP socket */
+	return udp_enqueue(l1fh, wq, msg);
+}
+
 /* callback when there's a new SYS primitive coming in from the HW */
 int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 {
 	struct l1fwd_hdl *l1fh = fl1h->priv;
 
 	/* Enqueue message to UDP socket */
-	if (osmo_wqueue_enqueue(&l1fh->udp_wq[MQ_SYS_WRITE], msg) != 0) {
-		LOGP(DL1C, LOGL_ERROR, "MQ_SYS_WRITE ful. dropping msg\n");
+	return udp_enqueue(l1fh, MQ_SYS_WRITE, msg);
+}
+
+
+/* put a primitive from the BTS into the right queue towards the HW */
+static int udp_handle_prim(struct l1fwd_hdl *l1fh, int q, struct msgb *msg)
+{
+	struct femtol1_hdl *fl1h = l1fh->fl1h;
+
+	if (osmo_wqueue_enqueue(&fl1h->write_q[q], msg) != 0) {
+		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n",
+			q);
 		msgb_free(msg);
 		return -EAGAIN;
 	}
 	return 0;
 }
 
+/* primitive unpacked from a batched datagram */
+static int udp_batch_rx_cb(struct l1fwd_batch *b, struct msgb *msg)
+{
+	return udp_handle_prim(b->data, b->wq->bfd.priv_nr, msg);
+}
 
 /* data has arrived on the udp socket */
 static int udp_read_cb(struct osmo_fd *ofd)
 {
 	struct msgb *msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
 	struct l1fwd_hdl *l1fh = ofd->data;
-	struct femtol1_hdl *fl1h = l1fh->fl1h;
 	int rc;
 
 	if (!msg)
@@ -131,13 +160,7 @@ static int udp_read_cb(struct osmo_fd *ofd)
 		ofd->priv_nr);
 
 	/* put the message into the right queue */
-	if (osmo_wqueue_enqueue(&fl1h->write_q[ofd->priv_nr], msg) != 0) {
-		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n",
-			ofd->priv_nr);
-		msgb_free(msg);
-		return -EAGAIN;
-	}
-	return 0;
+	return udp_handle_prim(l1fh, ofd->priv_nr, msg);
 }
 
 /* callback when we can write to the UDP socket */
@@ -221,6 +244,14 @@ int main(int argc, char **argv)
 			perror("sock_init");
 			exit(1);
 		}
+
+		if (l1fwd_batch_enabled()) {
+			l1fh->batch[i] = l1fwd_batch_alloc(l1fh, wq, 1,
+							   udp_batch_rx_cb,
+							   l1fh);
+			if (!l1fh->batch[i])
+				exit(1);
+		}
 	}
 
 	while (1) {
@@ -1564,6 +1564,10 @@ struct femtol1_hdl *l1if_open(struct phy_instance *pinst)
 	fl1h->clk_src = SF_CLKSRC_OCXO;
 #endif
 
+	if (pinst->phy_link->l1_rx_thread)
+		fl1h->rx_ring = prim_ring_alloc(fl1h, L1_RX_RING_SLOTS,
+						SYSMOBTS_PRIM_SIZE);
+
 	rc = l1if_transport_open(MQ_SYS_WRITE, fl1h);
 	if (rc < 0) {
 		talloc_free(fl1h);
@@ -1577,6 +1581,14 @@ struct femtol1_hdl *l1if_open(struct phy_instance *pinst)
 		return NULL;
 	}
 
+	if (fl1h->rx_ring && l1if_transport_rx_start(fl1h,
+					pinst->phy_link->l1_rx_prio) < 0) {
+		LOGP(DL1C, LOGL_NOTICE, "Receiving L1 primitives in the "
+			"main loop\n");
+		prim_ring_free(fl1h->rx_ring);
+		fl1h->rx_ring = NULL;
+	}
+
 	l1if_reset(fl1h);
 
 	return fl1h;
@@ -1584,8 +1596,13 @@ struct femtol1_hdl *l1if_open(struct phy_instance *pinst)
 
 int l1if_close(struct femtol1_hdl *fl1h)
 {
+	/* stop the receive thread before its queues are closed */
+	if (fl1h->rx_ring)
+		prim_ring_stop(fl1h->rx_ring);
 	l1if_transport_close(MQ_L1_WRITE, fl1h);
 	l1if_transport_close(MQ_SYS_WRITE, fl1h);
+	prim_ring_free(fl1h->rx_ring);
+	fl1h->rx_ring = NULL;
 	return 0;
 }
 
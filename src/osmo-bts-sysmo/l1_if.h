@@ -8,6 +8,7 @@
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/prim_ring.h>
 
 #include <sysmocom/femtobts/gsml1prim.h>
 
@@ -42,6 +43,9 @@ enum {
 	FIXUP_NOT_NEEDED,
 };
 
+/* primitives buffered between the receive thread and the main loop */
+#define L1_RX_RING_SLOTS	64
+
 struct femtol1_hdl {
 	struct gsm_time gsm_time;
 	uint32_t hLayer1;			/* handle to the L1 instance in the DSP */
@@ -57,6 +61,7 @@ struct femtol1_hdl {
 
 	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
+	struct prim_ring *rx_ring;		/* NULL without receive thread */
 
 	struct {
 		/* from DSP/FPGA after L1 Init */
@@ -10,5 +10,6 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg);
 /* functions exported by a transport */
 int l1if_transport_open(int q, struct femtol1_hdl *fl1h);
 int l1if_transport_close(int q, struct femtol1_hdl *fl1h);
+int l1if_transport_rx_start(struct femtol1_hdl *fl1h, int rt_prio);
 
 #endif /* _FEMTOL1_TRANSP_H */
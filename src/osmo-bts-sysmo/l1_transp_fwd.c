@@ -62,6 +62,21 @@ static const uint16_t fwd_udp_ports[] = {
 #endif
 };
 
+/* hand a primitive received from the proxy to the L1 interface */
+static int fwd_handle_prim(struct femtol1_hdl *fl1h, int q, struct msgb *msg)
+{
+	if (q == MQ_SYS_WRITE)
+		return l1if_handle_sysprim(fl1h, msg);
+	else
+		return l1if_handle_l1prim(q, fl1h, msg);
+}
+
+/* primitive unpacked from a batched datagram */
+static int fwd_batch_rx_cb(struct l1fwd_batch *b, struct msgb *msg)
+{
+	return fwd_handle_prim(b->data, b->wq->bfd.priv_nr, msg);
+}
+
 static int fwd_read_cb(struct osmo_fd *ofd)
 {
 	struct msgb *msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
@@ -84,12 +99,7 @@ static int fwd_read_cb(struct osmo_fd *ofd)
 	}
 	msgb_put(msg, rc);
 
-	if (ofd->priv_nr == MQ_SYS_WRITE)
-		rc = l1if_handle_sysprim(fl1h, msg);
-	else
-		rc = l1if_handle_l1prim(ofd->priv_nr, fl1h, msg);
-
-	return rc;
+	return fwd_handle_prim(fl1h, ofd->priv_nr, msg);
 }
 
 static int prim_write_cb(struct osmo_fd *ofd, struct msgb *msg)
@@ -136,6 +146,10 @@ int l1if_transport_open(int q, struct femtol1_hdl *fl1h)
 	if (rc < 0)
 		return rc;
 
+	if (l1fwd_batch_enabled()
+	 && !l1fwd_batch_alloc(fl1h, wq, 0, fwd_batch_rx_cb, fl1h))
+		return -ENOMEM;
+
 	return 0;
 }
 
@@ -143,10 +157,22 @@ int l1if_transport_close(int q, struct femtol1_hdl *fl1h)
 {
 	struct osmo_wqueue *wq = &fl1h->write_q[q];
 	struct osmo_fd *ofd = &wq->bfd;
+	struct l1fwd_batch *b = l1fwd_batch_get(wq);
 
+	if (b)
+		l1fwd_batch_free(b);
 	osmo_wqueue_clear(wq);
 	osmo_fd_unregister(ofd);
 	close(ofd->fd);
 	
 	return 0;
 }
+
+int l1if_transport_rx_start(struct femtol1_hdl *fl1h, int rt_prio)
+{
+	/* the UDP sockets are read by the main loop, see
+	 * l1if_transport_open() */
+	LOGP(DL1C, LOGL_NOTICE, "No L1 receive thread with the L1 forwarding "
+		"transport\n");
+	return -ENOTSUP;
+}
@@ -517,6 +517,10 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	install_element(TRX_NODE, &cfg_trx_ul_power_target_cmd);
 	install_element(TRX_NODE, &cfg_trx_nominal_power_cmd);
 
+	install_element(PHY_NODE, &cfg_phy_l1_rx_thread_cmd);
+	install_element(PHY_NODE, &cfg_phy_l1_rx_thread_rt_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_l1_rx_thread_cmd);
+
 	install_element(PHY_INST_NODE, &cfg_phy_dsp_trace_f_cmd);
 	install_element(PHY_INST_NODE, &cfg_phy_no_dsp_trace_f_cmd);
 	install_element(PHY_INST_NODE, &cfg_phy_clkcal_cmd);
@@ -38,6 +38,15 @@
 #include "gsm0503_interleaving.h"
 #include "gsm0503_tables.h"
 #include "gsm0503_coding.h"
+#include "gsm0503_viterbi.h"
+
+const struct value_string gsm0503_dec_err_names[] = {
+	{ GSM0503_DEC_ERR_FACCH,	"error decoding FACCH frame" },
+	{ GSM0503_DEC_ERR_CRC,		"error checking CRC of speech frame" },
+	{ GSM0503_DEC_ERR_CRC_EFR,	"error checking CRC8 of EFR part" },
+	{ GSM0503_DEC_ERR_MODE,		"unknown frame type" },
+	{ 0, NULL }
+};
 
 int osmo_conv_decode_ber(const struct osmo_conv_code *code,
 	const sbit_t *input, ubit_t *output,
@@ -46,7 +55,7 @@ int osmo_conv_decode_ber(const struct osmo_conv_code *code,
 	int res, i;
 	ubit_t recoded[1024]; /* TODO: We can do smaller, I guess */
 
-	res = osmo_conv_decode(code, input, output);
+	res = gsm0503_conv_decode(code, input, output);
 
 	*n_bits_total = osmo_conv_encode(code, output, recoded);
 	OSMO_ASSERT(sizeof(recoded)/sizeof(recoded[0]) >= *n_bits_total);
@@ -101,30 +110,47 @@ static int _xcch_encode_cB(ubit_t *cB, uint8_t *l2_data)
 int xcch_decode(uint8_t *l2_data, sbit_t *bursts,
 	int *n_errors, int *n_bits_total)
 {
-	sbit_t iB[456], cB[456];
-	int i;
+	sbit_t cB[456];
 
-	for (i=0; i<4; i++)
-		gsm0503_xcch_burst_unmap(&iB[i * 114], &bursts[i * 116], NULL,
-			NULL);
+	gsm0503_xcch_deinterleave(cB, bursts);
+
+	return _xcch_decode_cB(l2_data, cB, n_errors, n_bits_total);
+}
 
-	gsm0503_xcch_deinterleave(cB, iB);
+/*! \brief decode an xCCH block that repeats one that failed to decode
+ *
+ * The soft bits of both blocks are added, saturating, before they are
+ * deinterleaved, so that a single Viterbi pass sees the energy of both
+ * transmissions.
+ *  \param[in] bursts the soft bits of the repetition
+ *  \param[in] prev the soft bits of the previous block */
+int xcch_decode_combined(uint8_t *l2_data, const sbit_t *bursts,
+	const sbit_t *prev, int *n_errors, int *n_bits_total)
+{
+	sbit_t sum[464], cB[456];
+	int i, v;
+
+	for (i = 0; i < 464; i++) {
+		v = bursts[i] + prev[i];
+		sum[i] = (v > 127) ? 127 : (v < -127) ? -127 : v;
+	}
+
+	gsm0503_xcch_deinterleave(cB, sum);
 
 	return _xcch_decode_cB(l2_data, cB, n_errors, n_bits_total);
 }
 
 int xcch_encode(ubit_t *bursts, uint8_t *l2_data)
 {
-	ubit_t iB[456], cB[456], hl = 1, hn = 1;
+	ubit_t cB[456], hl = 1, hn = 1;
 	int i;
 
 	_xcch_encode_cB(cB, l2_data);
 
-	gsm0503_xcch_interleave(cB, iB);
+	gsm0503_xcch_interleave(cB, bursts);
 
 	for (i=0; i<4; i++)
-		gsm0503_xcch_burst_map(&iB[i * 114], &bursts[i * 116], &hl,
-			&hn);
+		gsm0503_xcch_burst_map(NULL, &bursts[i * 116], &hl, &hn);
 
 	return 0;
 }
@@ -137,12 +163,12 @@ int xcch_encode(ubit_t *bursts, uint8_t *l2_data)
 int pdtch_decode(uint8_t *l2_data, sbit_t *bursts, uint8_t *usf_p,
 	int *n_errors, int *n_bits_total)
 {
-	sbit_t iB[456], cB[676], hl_hn[8];
+	sbit_t cB[676], hl_hn[8];
 	ubit_t conv[456];
 	int i, j, k, rv, best = 0, cs = 0, usf = 0; /* make GCC happy */
 
 	for (i=0; i<4; i++)
-		gsm0503_xcch_burst_unmap(&iB[i * 114], &bursts[i * 116],
+		gsm0503_xcch_burst_unmap(NULL, &bursts[i * 116],
 			hl_hn + i*2, hl_hn + i*2 + 1);
 
 	for (i=0; i<4; i++) {
@@ -155,7 +181,7 @@ int pdtch_decode(uint8_t *l2_data, sbit_t *bursts, uint8_t *usf_p,
 		}
 	}
 
-	gsm0503_xcch_deinterleave(cB, iB);
+	gsm0503_xcch_deinterleave(cB, bursts);
 
 	switch (cs) {
 	case 1:
@@ -280,7 +306,7 @@ int pdtch_decode(uint8_t *l2_data, sbit_t *bursts, uint8_t *usf_p,
 
 int pdtch_encode(ubit_t *bursts, uint8_t *l2_data, uint8_t l2_len)
 {
-	ubit_t iB[456], cB[676];
+	ubit_t cB[676];
 	const ubit_t *hl_hn;
 	ubit_t conv[334];
 	int i, j, usf;
@@ -349,10 +375,10 @@ int pdtch_encode(ubit_t *bursts, uint8_t *l2_data, uint8_t l2_len)
 		return -1;
 	}
 
-	gsm0503_xcch_interleave(cB, iB);
+	gsm0503_xcch_interleave(cB, bursts);
 
 	for (i=0; i<4; i++)
-		gsm0503_xcch_burst_map(&iB[i * 114], &bursts[i * 116],
+		gsm0503_xcch_burst_map(NULL, &bursts[i * 116],
 			hl_hn + i*2, hl_hn + i*2 + 1);
 
 	return 0;
@@ -671,24 +697,21 @@ static void tch_amr_unmerge(ubit_t *d, ubit_t *p, ubit_t *u, int len, int prot)
 int tch_fr_decode(uint8_t *tch_data, sbit_t *bursts, int net_order, int efr,
 	int *n_errors, int *n_bits_total)
 {
-	sbit_t iB[912], cB[456], h;
+	sbit_t cB[456], h;
 	ubit_t conv[185], s[244], w[260], b[65], d[260], p[8];
 	int i, rv, len, steal = 0;
 
 	for (i=0; i<8; i++) {
-		gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116], &h,
-			i>>2);
+		gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, i>>2);
 		steal -= h;
 	}
 
-	gsm0503_tch_fr_deinterleave(cB, iB);
+	gsm0503_tch_fr_deinterleave(cB, bursts);
 
 	if (steal > 0) {
 		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_fr_decode(): error decoding  FACCH frame (%d/%d bits)\n", *n_errors, *n_bits_total);
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_FACCH;
 
 		return 23;
 	}
@@ -701,10 +724,8 @@ int tch_fr_decode(uint8_t *tch_data, sbit_t *bursts, int net_order, int efr,
 		d[i+182] = (cB[i+378] < 0) ? 1:0;
 
 	rv = osmo_crc8gen_check_bits(&gsm0503_tch_fr_crc3, d, 50, p);
-	if (rv) {
-		LOGP(DL1C, LOGL_NOTICE, "tch_fr_decode(): error checking CRC8 for the FR part of an %s frame\n", efr?"EFR":"FR");
-		return -1;
-	}
+	if (rv)
+		return -GSM0503_DEC_ERR_CRC;
 
 
 	if (efr) {
@@ -716,10 +737,8 @@ int tch_fr_decode(uint8_t *tch_data, sbit_t *bursts, int net_order, int efr,
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_tch_efr_crc8, b,
 			65, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_fr_decode(): error checking CRC8 for the EFR part of an EFR frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC_EFR;
 
 		tch_efr_reassemble(tch_data, s);
 
@@ -737,7 +756,7 @@ int tch_fr_decode(uint8_t *tch_data, sbit_t *bursts, int net_order, int efr,
 
 int tch_fr_encode(ubit_t *bursts, uint8_t *tch_data, int len, int net_order)
 {
-	ubit_t iB[912], cB[456], h;
+	ubit_t cB[456], h;
 	ubit_t conv[185], w[260], b[65], s[244], d[260], p[8];
 	int i;
 
@@ -782,10 +801,10 @@ coding_efr_fr:
 		return -1;
 	}
 
-	gsm0503_tch_fr_interleave(cB, iB);
+	gsm0503_tch_fr_interleave(cB, bursts);
 
 	for (i=0; i<8; i++)
-		gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116], &h, i>>2);
+		gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>2);
 
 	return 0;
 }
@@ -793,7 +812,7 @@ coding_efr_fr:
 int tch_hr_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 	int *n_errors, int *n_bits_total)
 {
-	sbit_t iB[912], cB[456], h;
+	sbit_t cB[456], h;
 	ubit_t conv[98], b[112], d[112], p[3];
 	int i, rv, steal = 0;
 
@@ -811,29 +830,16 @@ int tch_hr_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 
 	/* if we found a stole FACCH, but only at correct alignment */
 	if (steal > 0) {
-		for (i=0; i<6; i++)
-			gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116],
-				NULL, i>>2);
-		for (i=2; i<4; i++)
-			gsm0503_tch_burst_unmap(&iB[i * 114 + 456],
-				&bursts[i * 116], NULL, 1);
-
-		gsm0503_tch_fr_deinterleave(cB, iB);
+		gsm0503_facch_h_deinterleave(cB, bursts);
 
 		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_hr_decode(): error decoding  FACCH frame (%d/%d bits)\n", *n_errors, *n_bits_total);
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_FACCH;
 
 		return GSM_MACBLOCK_LEN;
 	}
 
-	for (i=0; i<4; i++)
-		gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116], NULL,
-			i>>1);
-
-	gsm0503_tch_hr_deinterleave(cB, iB);
+	gsm0503_tch_hr_deinterleave(cB, bursts);
 
 	osmo_conv_decode_ber(&gsm0503_conv_tch_hr, cB, conv, n_errors, n_bits_total);
 
@@ -843,10 +849,8 @@ int tch_hr_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		d[i+95] = (cB[i+211] < 0) ? 1:0;
 
 	rv = osmo_crc8gen_check_bits(&gsm0503_tch_fr_crc3, d + 73, 22, p);
-	if (rv) {
-		LOGP(DL1C, LOGL_NOTICE, "tch_fr_decode(): error checking CRC8 for an HR frame\n");
-		return -1;
-	}
+	if (rv)
+		return -GSM0503_DEC_ERR_CRC;
 
 	tch_hr_d_to_b(b, d);
 
@@ -857,7 +861,7 @@ int tch_hr_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 
 int tch_hr_encode(ubit_t *bursts, uint8_t *tch_data, int len)
 {
-	ubit_t iB[912], cB[456], h;
+	ubit_t cB[456], h;
 	ubit_t conv[98], b[112], d[112], p[3];
 	int i;
 
@@ -877,11 +881,10 @@ int tch_hr_encode(ubit_t *bursts, uint8_t *tch_data, int len)
 
 		h = 0;
 
-		gsm0503_tch_hr_interleave(cB, iB);
+		gsm0503_tch_hr_interleave(cB, bursts);
 
 		for (i=0; i<4; i++)
-			gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116],
-				&h, i>>1);
+			gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>1);
 
 		break;
 	case GSM_MACBLOCK_LEN: /* FACCH */
@@ -889,14 +892,12 @@ int tch_hr_encode(ubit_t *bursts, uint8_t *tch_data, int len)
 
 		h = 1;
 
-		gsm0503_tch_fr_interleave(cB, iB);
+		gsm0503_facch_h_interleave(cB, bursts);
 
 		for (i=0; i<6; i++)
-			gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116],
-				&h, i>>2);
+			gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>2);
 		for (i=2; i<4; i++)
-			gsm0503_tch_burst_map(&iB[i * 114 + 456],
-				&bursts[i * 116], &h, 1);
+			gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, 1);
 
 		break;
 	default:
@@ -906,60 +907,139 @@ int tch_hr_encode(ubit_t *bursts, uint8_t *tch_data, int len)
 	return 0;
 }
 
-int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
-	uint8_t *codec, int codecs, uint8_t *ft, uint8_t *cmr,
-	int *n_errors, int *n_bits_total)
+/* soft decision decoding of the in-band data of an AMR speech frame: the
+ * most likely code word has the highest correlation with the soft bits.
+ * The confidence is the distance between the two most likely code words,
+ * in percent of their minimum distance without noise. */
+static int _tch_amr_ic_decode(const sbit_t *cB, const sbit_t *ic, int n,
+	int d_min, int *second, int *confidence)
 {
-	sbit_t iB[912], cB[456], h;
-	ubit_t d[244], p[6], conv[250];
-	int i, j, k, best = 0, rv, len, steal = 0, id = 0;
-	*n_errors = 0; *n_bits_total = 0;
-
-	for (i=0; i<8; i++) {
-		gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116], &h,
-			i>>2);
-		steal -= h;
-	}
-
-	gsm0503_tch_fr_deinterleave(cB, iB);
-
-	if (steal > 0) {
-		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error decoding  FACCH frame (%d/%d bits)\n", *n_errors, *n_bits_total);
-			return -1;
-		}
+	int i, j, k, best = 0, next = 0, id = 0, id2 = 0, sum = 0;
 
-		return GSM_MACBLOCK_LEN;
-	}
+	for (j=0; j<n; j++)
+		sum += abs(cB[j]);
 
 	for (i=0; i<4; i++) {
-		for (j=0, k=0; j<8; j++)
-			k += abs(((int)gsm0503_afs_ic_sbit[i][j]) -
-							((int)cB[j]));
-		if (i == 0 || k < best) {
+		for (j=0, k=0; j<n; j++)
+			k += (ic[i * n + j] < 0) ? -cB[j] : cB[j];
+		if (i == 0 || k > best) {
+			next = best;
+			id2 = id;
 			best = k;
 			id = i;
+		} else if (i == 1 || k > next) {
+			next = k;
+			id2 = i;
 		}
 	}
 
+	if (second)
+		*second = id2;
+	if (confidence) {
+		k = sum ? 100 * (best - next) * n / (2 * d_min * sum) : 0;
+		*confidence = (k > 100) ? 100 : k;
+	}
+
+	return id;
+}
+
+/*! \brief decode the in-band data of a TCH/AFS speech frame
+ *  \param[in] cB deinterleaved soft bits of the frame
+ *  \param[out] second second most likely ID, or NULL
+ *  \param[out] confidence 0..100, or NULL
+ *  \returns most likely ID */
+int gsm0503_afs_ic_decode(const sbit_t *cB, int *second, int *confidence)
+{
+	return _tch_amr_ic_decode(cB, &gsm0503_afs_ic_sbit[0][0], 8, 5,
+		second, confidence);
+}
+
+/*! \brief decode the in-band data of a TCH/AHS speech frame
+ *  \param[in] cB deinterleaved soft bits of the frame
+ *  \param[out] second second most likely ID, or NULL
+ *  \param[out] confidence 0..100, or NULL
+ *  \returns most likely ID */
+int gsm0503_ahs_ic_decode(const sbit_t *cB, int *second, int *confidence)
+{
+	return _tch_amr_ic_decode(cB, &gsm0503_ahs_ic_sbit[0][0], 4, 2,
+		second, confidence);
+}
+
+/* decode the speech part of an AMR frame, with the codec mode of the
+ * in-band data of a CMI frame, or of the last CMI of a CMR frame.
+ * If the in-band data is unreliable and the CRC fails, the frame is
+ * decoded again with the second most likely codec mode. If that
+ * succeeds, the confidence of the in-band data is stored in *second_conf,
+ * otherwise it is set to -1. */
+static int _tch_amr_decode(uint8_t *tch_data, const sbit_t *cB,
+	int (*decode_mode)(uint8_t *tch_data, const sbit_t *cB, uint8_t mode,
+		int *n_errors, int *n_bits_total),
+	int id, int id2, int confidence, int codec_mode_req, uint8_t *codec,
+	int codecs, uint8_t *ft, uint8_t *cmr, int *n_errors,
+	int *n_bits_total, int *second_conf)
+{
+	int len, n_errors2, n_bits_total2;
+	int reliable = (confidence >= GSM0503_AMR_IC_CONF_LOW);
+
+	if (second_conf)
+		*second_conf = -1;
+
 	/* check if indicated codec fits into range of codecs */
 	if (id >= codecs) {
-		/* codec mode out of range, return id */
-		return id;
+		if (reliable || id2 >= codecs) {
+			/* codec mode out of range, return id */
+			return id;
+		}
+		id = id2;
+		id2 = codecs;
+	}
+
+	if (codec_mode_req) {
+		len = decode_mode(tch_data, cB, codec[*ft], n_errors,
+			n_bits_total);
+		/* change codec request, if frame is valid and the request is
+		 * reliable, otherwise keep the last one */
+		if (len >= 0 && reliable)
+			*cmr = id;
+		return len;
+	}
+
+	len = decode_mode(tch_data, cB, codec[id], n_errors, n_bits_total);
+	if (len < 0 && !reliable && id2 < codecs && codec[id2] != codec[id]) {
+		len = decode_mode(tch_data, cB, codec[id2], &n_errors2,
+			&n_bits_total2);
+		if (len >= 0) {
+			if (second_conf)
+				*second_conf = confidence;
+			id = id2;
+			*n_errors = n_errors2;
+			*n_bits_total = n_bits_total2;
+		}
 	}
 
-	switch ((codec_mode_req) ? codec[*ft] : codec[id]) {
+	/* change codec indication, if frame is valid */
+	if (len >= 0)
+		*ft = id;
+
+	return len;
+}
+
+/* decode the speech part of a frame with the given codec mode */
+static int _tch_afs_decode_mode(uint8_t *tch_data, const sbit_t *cB,
+	uint8_t mode, int *n_errors, int *n_bits_total)
+{
+	ubit_t d[244], p[6], conv[250];
+	int rv, len;
+
+	switch (mode) {
 	case 7: /* TCH/AFS12.2 */
 		osmo_conv_decode_ber(&gsm0503_conv_tch_afs_12_2, cB+8, conv, n_errors, n_bits_total);
 
 		tch_amr_unmerge(d, p, conv, 244, 81);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 81, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 12.2 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 244);
 
@@ -972,10 +1052,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 204, 65);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 65, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 10.2 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 204);
 
@@ -988,10 +1066,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 159, 75);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 75, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 7.95 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 159);
 
@@ -1004,10 +1080,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 148, 61);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 61, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 7.4 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 148);
 
@@ -1020,10 +1094,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 134, 55);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 55, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 6.7 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 134);
 
@@ -1036,10 +1108,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 118, 55);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 55, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 5.9 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 118);
 
@@ -1052,10 +1122,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 103, 49);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 49, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 5.15 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 103);
 
@@ -1068,10 +1136,8 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 		tch_amr_unmerge(d, p, conv, 95, 39);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 39, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_afs_decode(): error checking CRC8 for an AMR 4.75 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		tch_amr_reassemble(tch_data, d, 95);
 
@@ -1079,27 +1145,49 @@ int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 
 		break;
 	default:
-		LOGP(DL1C, LOGL_ERROR, "tch_afs_decode(): Unknown frame type\n");
-		fprintf(stderr, "FIXME: FT %d not supported!\n", *ft);
 		*n_bits_total = 448;
 		*n_errors = *n_bits_total;
-		return -1;
+		return -GSM0503_DEC_ERR_MODE;
 	}
 
-	/* change codec request / indication, if frame is valid */
-	if (codec_mode_req)
-		*cmr = id;
-	else
-		*ft = id;
-
 	return len;
 }
 
+int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
+	uint8_t *codec, int codecs, uint8_t *ft, uint8_t *cmr,
+	int *n_errors, int *n_bits_total, int *second_conf)
+{
+	sbit_t cB[456], h;
+	int i, rv, steal = 0, id, id2, confidence;
+	*n_errors = 0; *n_bits_total = 0;
+
+	for (i=0; i<8; i++) {
+		gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, i>>2);
+		steal -= h;
+	}
+
+	gsm0503_tch_fr_deinterleave(cB, bursts);
+
+	if (steal > 0) {
+		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
+		if (rv)
+			return -GSM0503_DEC_ERR_FACCH;
+
+		return GSM_MACBLOCK_LEN;
+	}
+
+	id = gsm0503_afs_ic_decode(cB, &id2, &confidence);
+
+	return _tch_amr_decode(tch_data, cB, _tch_afs_decode_mode, id, id2,
+		confidence, codec_mode_req, codec, codecs, ft, cmr, n_errors,
+		n_bits_total, second_conf);
+}
+
 int tch_afs_encode(ubit_t *bursts, uint8_t *tch_data, int len,
 	int codec_mode_req, uint8_t *codec, int codecs, uint8_t ft,
 	uint8_t cmr)
 {
-	ubit_t iB[912], cB[456], h;
+	ubit_t cB[456], h;
 	ubit_t d[244], p[6], conv[250];
 	int i;
 	uint8_t id;
@@ -1248,87 +1336,30 @@ invalid_length:
 	memcpy(cB, gsm0503_afs_ic_ubit[id], 8);
 
 facch:
-	gsm0503_tch_fr_interleave(cB, iB);
+	gsm0503_tch_fr_interleave(cB, bursts);
 
 	for (i=0; i<8; i++)
-		gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116], &h, i>>2);
+		gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>2);
 
 	return 0;
 }
 
-int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
-	int codec_mode_req, uint8_t *codec, int codecs, uint8_t *ft,
-	uint8_t *cmr, int *n_errors, int *n_bits_total)
+/* decode the speech part of a frame with the given codec mode */
+static int _tch_ahs_decode_mode(uint8_t *tch_data, const sbit_t *cB,
+	uint8_t mode, int *n_errors, int *n_bits_total)
 {
-	sbit_t iB[912], cB[456], h;
 	ubit_t d[244], p[6], conv[135];
-	int i, j, k, best = 0, rv, len, steal = 0, id = 0;
-
-	/* only unmap the stealing bits */
-	if (!odd) {
-		for (i=0; i<4; i++) {
-			gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, 0);
-			steal -= h;
-		}
-		for (i=2; i<5; i++) {
-			gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, 1);
-			steal -= h;
-		}
-	}
-
-	/* if we found a stole FACCH, but only at correct alignment */
-	if (steal > 0) {
-		for (i=0; i<6; i++)
-			gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116],
-				NULL, i>>2);
-		for (i=2; i<4; i++)
-			gsm0503_tch_burst_unmap(&iB[i * 114 + 456],
-				&bursts[i * 116], NULL, 1);
-
-		gsm0503_tch_fr_deinterleave(cB, iB);
-
-		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error decoding  FACCH frame (%d/%d bits)\n", *n_errors, *n_bits_total);
-			return -1;
-		}
-
-		return GSM_MACBLOCK_LEN;
-	}
-
-	for (i=0; i<4; i++)
-		gsm0503_tch_burst_unmap(&iB[i * 114], &bursts[i * 116], NULL,
-			i>>1);
+	int i, rv, len;
 
-	gsm0503_tch_hr_deinterleave(cB, iB);
-
-	for (i=0; i<4; i++) {
-		for (j=0, k=0; j<4; j++)
-			k += abs(((int)gsm0503_ahs_ic_sbit[i][j]) -
-							((int)cB[j]));
-		if (i == 0 || k < best) {
-			best = k;
-			id = i;
-		}
-	}
-
-	/* check if indicated codec fits into range of codecs */
-	if (id >= codecs) {
-		/* codec mode out of range, return id */
-		return id;
-	}
-
-	switch ((codec_mode_req) ? codec[*ft] : codec[id]) {
+	switch (mode) {
 	case 5: /* TCH/AHS7.95 */
 		osmo_conv_decode_ber(&gsm0503_conv_tch_ahs_7_95, cB+4, conv, n_errors, n_bits_total);
 
 		tch_amr_unmerge(d, p, conv, 123, 67);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 67, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 7.95 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<36;i++)
 			d[i+123] = (cB[i+192] < 0) ? 1:0;
@@ -1344,10 +1375,8 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		tch_amr_unmerge(d, p, conv, 120, 61);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 61, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 7.4 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<28;i++)
 			d[i+120] = (cB[i+200] < 0) ? 1:0;
@@ -1363,10 +1392,8 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		tch_amr_unmerge(d, p, conv, 110, 55);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 55, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 6.7 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<24;i++)
 			d[i+110] = (cB[i+204] < 0) ? 1:0;
@@ -1382,10 +1409,8 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		tch_amr_unmerge(d, p, conv, 102, 55);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 55, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 5.9 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<16;i++)
 			d[i+102] = (cB[i+212] < 0) ? 1:0;
@@ -1401,10 +1426,8 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		tch_amr_unmerge(d, p, conv, 91, 49);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 49, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 5.15 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<12;i++)
 			d[i+91] = (cB[i+216] < 0) ? 1:0;
@@ -1420,10 +1443,8 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 		tch_amr_unmerge(d, p, conv, 83, 39);
 
 		rv = osmo_crc8gen_check_bits(&gsm0503_amr_crc6, d, 39, p);
-		if (rv) {
-			LOGP(DL1C, LOGL_NOTICE, "tch_ahs_decode(): error checking CRC8 for an AMR 4.75 frame\n");
-			return -1;
-		}
+		if (rv)
+			return -GSM0503_DEC_ERR_CRC;
 
 		for (i=0; i<12;i++)
 			d[i+83] = (cB[i+216] < 0) ? 1:0;
@@ -1434,27 +1455,58 @@ int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 
 		break;
 	default:
-		LOGP(DL1C, LOGL_ERROR, "tch_afs_decode(): Unknown frame type\n");
-		fprintf(stderr, "FIXME: FT %d not supported!\n", *ft);
 		*n_bits_total = 159;
 		*n_errors = *n_bits_total;
-		return -1;
+		return -GSM0503_DEC_ERR_MODE;
 	}
 
-	/* change codec request / indication, if frame is valid */
-	if (codec_mode_req)
-		*cmr = id;
-	else
-		*ft = id;
-
 	return len;
 }
 
+int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
+	int codec_mode_req, uint8_t *codec, int codecs, uint8_t *ft,
+	uint8_t *cmr, int *n_errors, int *n_bits_total, int *second_conf)
+{
+	sbit_t cB[456], h;
+	int i, rv, steal = 0, id, id2, confidence;
+
+	/* only unmap the stealing bits */
+	if (!odd) {
+		for (i=0; i<4; i++) {
+			gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, 0);
+			steal -= h;
+		}
+		for (i=2; i<5; i++) {
+			gsm0503_tch_burst_unmap(NULL, &bursts[i * 116], &h, 1);
+			steal -= h;
+		}
+	}
+
+	/* if we found a stole FACCH, but only at correct alignment */
+	if (steal > 0) {
+		gsm0503_facch_h_deinterleave(cB, bursts);
+
+		rv = _xcch_decode_cB(tch_data, cB, n_errors, n_bits_total);
+		if (rv)
+			return -GSM0503_DEC_ERR_FACCH;
+
+		return GSM_MACBLOCK_LEN;
+	}
+
+	gsm0503_tch_hr_deinterleave(cB, bursts);
+
+	id = gsm0503_ahs_ic_decode(cB, &id2, &confidence);
+
+	return _tch_amr_decode(tch_data, cB, _tch_ahs_decode_mode, id, id2,
+		confidence, codec_mode_req, codec, codecs, ft, cmr, n_errors,
+		n_bits_total, second_conf);
+}
+
 int tch_ahs_encode(ubit_t *bursts, uint8_t *tch_data, int len,
 	int codec_mode_req, uint8_t *codec, int codecs, uint8_t ft,
 	uint8_t cmr)
 {
-	ubit_t iB[912], cB[456], h;
+	ubit_t cB[456], h;
 	ubit_t d[244], p[6], conv[135];
 	int i;
 	uint8_t id;
@@ -1464,14 +1516,12 @@ int tch_ahs_encode(ubit_t *bursts, uint8_t *tch_data, int len,
 
 		h = 1;
 
-		gsm0503_tch_fr_interleave(cB, iB);
+		gsm0503_facch_h_interleave(cB, bursts);
 
 		for (i=0; i<6; i++)
-			gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116],
-				&h, i>>2);
+			gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>2);
 		for (i=2; i<4; i++)
-			gsm0503_tch_burst_map(&iB[i * 114 + 456],
-				&bursts[i * 116], &h, 1);
+			gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, 1);
 
 		return 0;
 	}
@@ -1595,12 +1645,12 @@ invalid_length:
 		return -1;
 	}
 
-	memcpy(cB, gsm0503_afs_ic_ubit[id], 4);
+	memcpy(cB, gsm0503_ahs_ic_ubit[id], 4);
 
-	gsm0503_tch_hr_interleave(cB, iB);
+	gsm0503_tch_hr_interleave(cB, bursts);
 
 	for (i=0; i<4; i++)
-		gsm0503_tch_burst_map(&iB[i * 114], &bursts[i * 116], &h, i>>1);
+		gsm0503_tch_burst_map(NULL, &bursts[i * 116], &h, i>>1);
 
 	return 0;
 }
@@ -1633,7 +1683,7 @@ int rach_decode(uint8_t *ra, sbit_t *burst, uint8_t bsic)
 	ubit_t conv[14];
 	int rv;
 
-	osmo_conv_decode(&gsm0503_conv_rach, burst, conv);
+	gsm0503_conv_decode(&gsm0503_conv_rach, burst, conv);
 
 	rach_apply_bsic(conv, bsic);
 
@@ -1671,7 +1721,7 @@ int sch_decode(uint8_t *sb_info, sbit_t *burst)
 	ubit_t conv[35];
 	int rv;
 
-	osmo_conv_decode(&gsm0503_conv_sch, burst, conv);
+	gsm0503_conv_decode(&gsm0503_conv_sch, burst, conv);
 
 	rv = osmo_crc16gen_check_bits(&gsm0503_sch_crc10, conv, 25, conv+25);
 	if (rv)
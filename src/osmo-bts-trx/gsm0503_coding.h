@@ -21,8 +21,30 @@
 #ifndef _0503_CODING_H
 #define _0503_CODING_H
 
+#include <osmocom/core/utils.h>
+
+/* below this confidence of the in-band data of an AMR frame, the second
+ * most likely codec mode is tried if the frame fails to decode */
+#define GSM0503_AMR_IC_CONF_LOW	50
+
+/* reason of a failed decode, returned negated by the TCH decoders; the
+ * decoders run on the UL decode pool and must not log themselves */
+enum gsm0503_dec_err {
+	GSM0503_DEC_ERR_FACCH = 1,	/* FACCH block failed to decode */
+	GSM0503_DEC_ERR_CRC,		/* CRC of the speech frame failed */
+	GSM0503_DEC_ERR_CRC_EFR,	/* CRC of the EFR part failed */
+	GSM0503_DEC_ERR_MODE,		/* codec mode is not supported */
+};
+
+extern const struct value_string gsm0503_dec_err_names[];
+
+int osmo_conv_decode_ber(const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output,
+	int *n_errors, int *n_bits_total);
 int xcch_decode(uint8_t *l2_data, sbit_t *bursts,
 	int *n_errors, int *n_bits_total);
+int xcch_decode_combined(uint8_t *l2_data, const sbit_t *bursts,
+	const sbit_t *prev, int *n_errors, int *n_bits_total);
 int xcch_encode(ubit_t *bursts, uint8_t *l2_data);
 int pdtch_decode(uint8_t *l2_data, sbit_t *bursts, uint8_t *usf_p,
 	int *n_errors, int *n_bits_total);
@@ -35,16 +57,18 @@ int tch_hr_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 int tch_hr_encode(ubit_t *bursts, uint8_t *tch_data, int len);
 int tch_afs_decode(uint8_t *tch_data, sbit_t *bursts, int codec_mode_req,
 	uint8_t *codec, int codecs, uint8_t *ft, uint8_t *cmr,
-	int *n_errors, int *n_bits_total);
+	int *n_errors, int *n_bits_total, int *second_conf);
 int tch_afs_encode(ubit_t *bursts, uint8_t *tch_data, int len,
 	int codec_mode_req, uint8_t *codec, int codecs, uint8_t ft,
 	uint8_t cmr);
 int tch_ahs_decode(uint8_t *tch_data, sbit_t *bursts, int odd,
 	int codec_mode_req, uint8_t *codec, int codecs, uint8_t *ft, 
-	uint8_t *cmr, int *n_errors, int *n_bits_total);
+	uint8_t *cmr, int *n_errors, int *n_bits_total, int *second_conf);
 int tch_ahs_encode(ubit_t *bursts, uint8_t *tch_data, int len,
 	int codec_mode_req, uint8_t *codec, int codecs, uint8_t ft,
 	uint8_t cmr);
+int gsm0503_afs_ic_decode(const sbit_t *cB, int *second, int *confidence);
+int gsm0503_ahs_ic_decode(const sbit_t *cB, int *second, int *confidence);
 int rach_decode(uint8_t *ra, sbit_t *burst, uint8_t bsic);
 int rach_encode(ubit_t *burst, uint8_t *ra, uint8_t bsic);
 int sch_decode(uint8_t *sb_info, sbit_t *burst);
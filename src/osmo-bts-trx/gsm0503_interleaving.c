@@ -6,6 +6,41 @@
 #include "gsm0503_tables.h"
 #include "gsm0503_interleaving.h"
 
+/*
+ * The position of every coded bit in the bursts is taken from the tables
+ * of gsm0503_tables.c, which hold the interleaving and the burst mapping
+ * below in one step, so neither is computed per bit, and the bursts are
+ * read and written directly, without an intermediate i(B, j).  The
+ * stealing flags are left alone, they are set and read with the
+ * gsm0503_*_burst_map() / _unmap() functions.
+ */
+
+static inline void burst_gather(sbit_t *cB, const sbit_t *bursts,
+	const uint16_t *idx, int n)
+{
+	int k;
+
+	for (k=0; k<n; k+=4) {
+		cB[k]   = bursts[idx[k]];
+		cB[k+1] = bursts[idx[k+1]];
+		cB[k+2] = bursts[idx[k+2]];
+		cB[k+3] = bursts[idx[k+3]];
+	}
+}
+
+static inline void burst_scatter(ubit_t *bursts, const ubit_t *cB,
+	const uint16_t *idx, int n)
+{
+	int k;
+
+	for (k=0; k<n; k+=4) {
+		bursts[idx[k]]   = cB[k];
+		bursts[idx[k+1]] = cB[k+1];
+		bursts[idx[k+2]] = cB[k+2];
+		bursts[idx[k+3]] = cB[k+3];
+	}
+}
+
 /*
  * GSM xCCH interleaving and burst mapping
  *
@@ -28,26 +63,14 @@
  * Where hl(B) and hn(B) are bits in burst B indicating flags.
  */
 
-void gsm0503_xcch_deinterleave(sbit_t *cB, sbit_t *iB)
+void gsm0503_xcch_deinterleave(sbit_t *cB, const sbit_t *bursts)
 {
-	int j, k, B;
-
-	for (k=0; k<456; k++) {
-		B = k & 3;
-		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
-		cB[k] = iB[B * 114 + j];
-	}
+	burst_gather(cB, bursts, gsm0503_xcch_burst_idx, 456);
 }
 
-void gsm0503_xcch_interleave(ubit_t *cB, ubit_t *iB)
+void gsm0503_xcch_interleave(const ubit_t *cB, ubit_t *bursts)
 {
-	int j, k, B;
-
-	for (k=0; k<456; k++) {
-		B = k & 3;
-		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
-		iB[B * 114 + j] = cB[k];
-	}
+	burst_scatter(bursts, cB, gsm0503_xcch_burst_idx, 456);
 }
 
 /*
@@ -74,26 +97,32 @@ void gsm0503_xcch_interleave(ubit_t *cB, ubit_t *iB)
  * Where hl(B) and hn(B) are bits in burst B indicating flags.
  */
 
-void gsm0503_tch_fr_deinterleave(sbit_t *cB, sbit_t *iB)
+void gsm0503_tch_fr_deinterleave(sbit_t *cB, const sbit_t *bursts)
 {
-	int j, k, B;
+	burst_gather(cB, bursts, gsm0503_tch_fr_burst_idx, 456);
+}
 
-	for (k=0; k<456; k++) {
-		B = k & 7;
-		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
-		cB[k] = iB[B * 114 + j];
-	}
+void gsm0503_tch_fr_interleave(const ubit_t *cB, ubit_t *bursts)
+{
+	burst_scatter(bursts, cB, gsm0503_tch_fr_burst_idx, 456);
 }
 
-void gsm0503_tch_fr_interleave(ubit_t *cB, ubit_t *iB)
+/*
+ * FACCH/H uses the TCH FR interleaver over 6 bursts, where blocks 6 and 7
+ * are the odd bits of bursts 2 and 3:
+ *
+ *      B = 0, ..., 5   -> bursts 0, ..., 5
+ *      B = 6, 7        -> bursts 2, 3
+ */
+
+void gsm0503_facch_h_deinterleave(sbit_t *cB, const sbit_t *bursts)
 {
-	int j, k, B;
+	burst_gather(cB, bursts, gsm0503_facch_h_burst_idx, 456);
+}
 
-	for (k=0; k<456; k++) {
-		B = k & 7;
-		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
-		iB[B * 114 + j] = cB[k];
-	}
+void gsm0503_facch_h_interleave(const ubit_t *cB, ubit_t *bursts)
+{
+	burst_scatter(bursts, cB, gsm0503_facch_h_burst_idx, 456);
 }
 
 /*
@@ -120,25 +149,12 @@ void gsm0503_tch_fr_interleave(ubit_t *cB, ubit_t *iB)
  * Where hl(B) and hn(B) are bits in burst B indicating flags.
  */
 
-void gsm0503_tch_hr_deinterleave(sbit_t *cB, sbit_t *iB)
+void gsm0503_tch_hr_deinterleave(sbit_t *cB, const sbit_t *bursts)
 {
-	int j, k, B;
-
-	for (k=0; k<228; k++) {
-		B = gsm0503_tch_hr_interleaving[k][1];
-		j = gsm0503_tch_hr_interleaving[k][0];
-		cB[k] = iB[B * 114 + j];
-	}
+	burst_gather(cB, bursts, gsm0503_tch_hr_burst_idx, 228);
 }
 
-void gsm0503_tch_hr_interleave(ubit_t *cB, ubit_t *iB)
+void gsm0503_tch_hr_interleave(const ubit_t *cB, ubit_t *bursts)
 {
-	int j, k, B;
-
-	for (k=0; k<228; k++) {
-		B = gsm0503_tch_hr_interleaving[k][1];
-		j = gsm0503_tch_hr_interleaving[k][0];
-		iB[B * 114 + j] = cB[k];
-	}
+	burst_scatter(bursts, cB, gsm0503_tch_hr_burst_idx, 228);
 }
-
@@ -1,11 +1,14 @@
 #ifndef _0503_INTERLEAVING_H
 #define _0503_INTERLEAVING_H
 
-void gsm0503_xcch_deinterleave(sbit_t *cB, sbit_t *iB);
-void gsm0503_xcch_interleave(ubit_t *cB, ubit_t *iB);
-void gsm0503_tch_fr_deinterleave(sbit_t *cB, sbit_t *iB);
-void gsm0503_tch_fr_interleave(ubit_t *cB, ubit_t *iB);
-void gsm0503_tch_hr_deinterleave(sbit_t *cB, sbit_t *iB);
-void gsm0503_tch_hr_interleave(ubit_t *cB, ubit_t *iB);
+/* (de)interleave and (un)map a block from / to its bursts of 116 bits */
+void gsm0503_xcch_deinterleave(sbit_t *cB, const sbit_t *bursts);
+void gsm0503_xcch_interleave(const ubit_t *cB, ubit_t *bursts);
+void gsm0503_tch_fr_deinterleave(sbit_t *cB, const sbit_t *bursts);
+void gsm0503_tch_fr_interleave(const ubit_t *cB, ubit_t *bursts);
+void gsm0503_facch_h_deinterleave(sbit_t *cB, const sbit_t *bursts);
+void gsm0503_facch_h_interleave(const ubit_t *cB, ubit_t *bursts);
+void gsm0503_tch_hr_deinterleave(sbit_t *cB, const sbit_t *bursts);
+void gsm0503_tch_hr_interleave(const ubit_t *cB, ubit_t *bursts);
 
 #endif /* _0503_INTERLEAVING_H */
@@ -8,8 +8,10 @@
 
 void gsm0503_xcch_burst_unmap(sbit_t *iB, sbit_t *eB, sbit_t *hl, sbit_t *hn)
 {
-	memcpy(iB,    eB,    57);
-	memcpy(iB+57, eB+59, 57);
+	if (iB) {
+		memcpy(iB,    eB,    57);
+		memcpy(iB+57, eB+59, 57);
+	}
 
 	if (hl)
 		*hl = eB[57];
@@ -21,8 +23,10 @@ void gsm0503_xcch_burst_unmap(sbit_t *iB, sbit_t *eB, sbit_t *hl, sbit_t *hn)
 void gsm0503_xcch_burst_map(ubit_t *iB, ubit_t *eB, const ubit_t *hl,
 	const ubit_t *hn)
 {
-	memcpy(eB,    iB,    57);
-	memcpy(eB+59, iB+57, 57);
+	if (iB) {
+		memcpy(eB,    iB,    57);
+		memcpy(eB+59, iB+57, 57);
+	}
 
 	if (hl)
 		eB[57] = *hl;
@@ -55,7 +59,7 @@ void gsm0503_tch_burst_map(ubit_t *iB, ubit_t *eB, const ubit_t *h, int odd)
 	int i;
 
 	/* brainfuck: only copy even or odd bits */
-	if (eB) {
+	if (iB) {
 		for (i=odd; i<57; i+=2)
 			eB[i] = iB[i];
 		for (i=58-odd; i<114; i+=2)
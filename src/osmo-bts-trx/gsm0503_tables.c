@@ -166,7 +166,7 @@ const uint8_t gsm0503_tch_hr_interleaving[228][2] = {
 	{ 86 ,0 }, { 87 ,2 }, { 110,0 }, { 111,2 }, { 4  ,0 }, { 5  ,2 },
 	{ 82 ,1 }, { 83 ,3 }, { 52 ,0 }, { 53 ,2 }, { 58 ,1 }, { 59 ,3 },
 	{ 28 ,0 }, { 29 ,2 }, { 34 ,1 }, { 35 ,3 }, { 76 ,0 }, { 77 ,2 },
-	{ 10 ,1 }, { 12 ,3 }, { 100,0 }, { 101,2 }, { 16 ,0 }, { 17 ,2 },
+	{ 10 ,1 }, { 11 ,3 }, { 100,0 }, { 101,2 }, { 16 ,0 }, { 17 ,2 },
 	{ 106,1 }, { 107,3 }, { 64 ,0 }, { 65 ,2 }, { 70 ,1 }, { 71 ,3 },
 	{ 94 ,1 }, { 95 ,3 }, { 40 ,0 }, { 41 ,2 }, { 46 ,1 }, { 47 ,3 },
 	{ 22 ,1 }, { 23 ,3 }, { 88 ,0 }, { 89 ,2 }, { 112,0 }, { 113,2 },
@@ -191,3 +191,156 @@ const uint8_t gsm0503_tch_hr_interleaving[228][2] = {
 	{ 28 ,1 }, { 29 ,3 }, { 94 ,0 }, { 95 ,2 }, { 4  ,1 }, { 5  ,3 },
 };
 
+/* Position of each coded bit c(k) in the bursts of a block, 116 bits per
+ * burst with the stealing flags at 57 and 58.  These are the interleaving
+ * and burst mapping rules of gsm0503_interleaving.c, evaluated once. */
+
+/* xCCH and PDTCH CS-1 to CS-4, 4 bursts */
+const uint16_t gsm0503_xcch_burst_idx[456] = {
+	  0, 216, 316, 416,  51, 151, 251, 351, 102, 202, 302, 400,
+	 37, 137, 237, 453,  88, 188, 286, 386,  23, 123, 339, 439,
+	 74, 172, 272, 372,   9, 225, 325, 425,  60, 158, 258, 358,
+	111, 211, 311, 411,  44, 144, 244, 460,  97, 197, 297, 395,
+	 30, 130, 346, 446,  83, 183, 281, 381,  16, 116, 332, 432,
+	 69, 167, 267, 367,   2, 218, 318, 418,  53, 153, 253, 353,
+	104, 204, 304, 402,  39, 139, 239, 455,  90, 190, 288, 388,
+	 25, 125, 341, 441,  76, 176, 274, 374,  11, 227, 327, 427,
+	 62, 160, 260, 360, 113, 213, 313, 413,  46, 146, 246, 462,
+	 99, 199, 299, 397,  32, 132, 232, 448,  85, 185, 283, 383,
+	 18, 118, 334, 434,  71, 169, 269, 369,   4, 220, 320, 420,
+	 55, 155, 255, 355, 106, 206, 306, 404,  41, 141, 241, 457,
+	 92, 192, 292, 390,  27, 127, 343, 443,  78, 178, 276, 376,
+	 13, 229, 329, 429,  64, 162, 262, 362, 115, 215, 315, 415,
+	 48, 148, 248, 348, 101, 201, 301, 399,  34, 134, 234, 450,
+	 87, 187, 285, 385,  20, 120, 336, 436,  73, 171, 271, 371,
+	  6, 222, 322, 422,  59, 157, 257, 357, 108, 208, 308, 408,
+	 43, 143, 243, 459,  94, 194, 294, 392,  29, 129, 345, 445,
+	 80, 180, 278, 378,  15, 231, 331, 431,  66, 164, 264, 364,
+	  1, 217, 317, 417,  50, 150, 250, 350, 103, 203, 303, 401,
+	 36, 136, 236, 452,  89, 189, 287, 387,  22, 122, 338, 438,
+	 75, 175, 273, 373,   8, 224, 324, 424,  61, 159, 259, 359,
+	110, 210, 310, 410,  45, 145, 245, 461,  96, 196, 296, 394,
+	 31, 131, 347, 447,  82, 182, 280, 380,  17, 117, 333, 433,
+	 68, 166, 266, 366,   3, 219, 319, 419,  52, 152, 252, 352,
+	105, 205, 305, 403,  38, 138, 238, 454,  91, 191, 291, 389,
+	 24, 124, 340, 440,  77, 177, 275, 375,  10, 226, 326, 426,
+	 63, 161, 261, 361, 112, 212, 312, 412,  47, 147, 247, 463,
+	 98, 198, 298, 396,  33, 133, 233, 449,  84, 184, 282, 382,
+	 19, 119, 335, 435,  70, 168, 268, 368,   5, 221, 321, 421,
+	 54, 154, 254, 354, 107, 207, 307, 407,  40, 140, 240, 456,
+	 93, 193, 293, 391,  26, 126, 342, 442,  79, 179, 277, 377,
+	 12, 228, 328, 428,  65, 163, 263, 363, 114, 214, 314, 414,
+	 49, 149, 249, 349, 100, 200, 300, 398,  35, 135, 235, 451,
+	 86, 186, 284, 384,  21, 121, 337, 437,  72, 170, 270, 370,
+	  7, 223, 323, 423,  56, 156, 256, 356, 109, 209, 309, 409,
+	 42, 142, 242, 458,  95, 195, 295, 393,  28, 128, 344, 444,
+	 81, 181, 279, 379,  14, 230, 330, 430,  67, 165, 265, 365,
+};
+
+/* TCH/FS, TCH/EFS, TCH/AFS and FACCH/F, 8 bursts */
+const uint16_t gsm0503_tch_fr_burst_idx[456] = {
+	  0, 216, 316, 416, 515, 615, 715, 815, 102, 202, 302, 400,
+	501, 601, 701, 917,  88, 188, 286, 386, 487, 587, 803, 903,
+	 74, 172, 272, 372, 473, 689, 789, 889,  60, 158, 258, 358,
+	575, 675, 775, 875,  44, 144, 244, 460, 561, 661, 761, 859,
+	 30, 130, 346, 446, 547, 647, 745, 845,  16, 116, 332, 432,
+	533, 631, 731, 831,   2, 218, 318, 418, 517, 617, 717, 817,
+	104, 204, 304, 402, 503, 603, 703, 919,  90, 190, 288, 388,
+	489, 589, 805, 905,  76, 176, 274, 374, 475, 691, 791, 891,
+	 62, 160, 260, 360, 577, 677, 777, 877,  46, 146, 246, 462,
+	563, 663, 763, 861,  32, 132, 232, 448, 549, 649, 747, 847,
+	 18, 118, 334, 434, 535, 633, 733, 833,   4, 220, 320, 420,
+	519, 619, 719, 819, 106, 206, 306, 404, 505, 605, 705, 921,
+	 92, 192, 292, 390, 491, 591, 807, 907,  78, 178, 276, 376,
+	477, 693, 793, 893,  64, 162, 262, 362, 579, 679, 779, 879,
+	 48, 148, 248, 348, 565, 665, 765, 863,  34, 134, 234, 450,
+	551, 651, 749, 849,  20, 120, 336, 436, 537, 635, 735, 835,
+	  6, 222, 322, 422, 523, 621, 721, 821, 108, 208, 308, 408,
+	507, 607, 707, 923,  94, 194, 294, 392, 493, 593, 809, 909,
+	 80, 180, 278, 378, 479, 695, 795, 895,  66, 164, 264, 364,
+	465, 681, 781, 881,  50, 150, 250, 350, 567, 667, 767, 865,
+	 36, 136, 236, 452, 553, 653, 751, 851,  22, 122, 338, 438,
+	539, 639, 737, 837,   8, 224, 324, 424, 525, 623, 723, 823,
+	110, 210, 310, 410, 509, 609, 709, 925,  96, 196, 296, 394,
+	495, 595, 811, 911,  82, 182, 280, 380, 481, 581, 797, 897,
+	 68, 166, 266, 366, 467, 683, 783, 883,  52, 152, 252, 352,
+	569, 669, 769, 867,  38, 138, 238, 454, 555, 655, 755, 853,
+	 24, 124, 340, 440, 541, 641, 739, 839,  10, 226, 326, 426,
+	527, 625, 725, 825, 112, 212, 312, 412, 511, 611, 711, 927,
+	 98, 198, 298, 396, 497, 597, 697, 913,  84, 184, 282, 382,
+	483, 583, 799, 899,  70, 168, 268, 368, 469, 685, 785, 885,
+	 54, 154, 254, 354, 571, 671, 771, 871,  40, 140, 240, 456,
+	557, 657, 757, 855,  26, 126, 342, 442, 543, 643, 741, 841,
+	 12, 228, 328, 428, 529, 627, 727, 827, 114, 214, 314, 414,
+	513, 613, 713, 813, 100, 200, 300, 398, 499, 599, 699, 915,
+	 86, 186, 284, 384, 485, 585, 801, 901,  72, 170, 270, 370,
+	471, 687, 787, 887,  56, 156, 256, 356, 573, 673, 773, 873,
+	 42, 142, 242, 458, 559, 659, 759, 857,  28, 128, 344, 444,
+	545, 645, 743, 843,  14, 230, 330, 430, 531, 629, 729, 829,
+};
+
+/* TCH/HS and TCH/AHS, 4 bursts, from gsm0503_tch_hr_interleaving */
+const uint16_t gsm0503_tch_hr_burst_idx[228] = {
+	  0, 233, 196, 429,  48, 281, 170, 403,  24, 257, 146, 379,
+	 74, 307, 122, 355,  98, 331,  12, 245, 220, 453,  62, 295,
+	184, 417, 208, 441,  36, 269, 158, 391, 134, 367,  86, 319,
+	110, 343,   2, 235, 198, 431,  50, 283, 172, 407,  26, 259,
+	148, 381,  76, 309, 124, 357, 100, 333,  14, 247, 222, 455,
+	 64, 297, 186, 419, 210, 443,  38, 271, 160, 393, 136, 369,
+	 88, 321, 112, 345,   4, 237, 200, 433,  52, 285, 176, 409,
+	 28, 261, 150, 383,  78, 311, 126, 359, 102, 335,  16, 249,
+	224, 457,  66, 299, 188, 421, 212, 445,  40, 273, 162, 395,
+	138, 371,  90, 323, 114, 347,   6, 239, 202, 435,  54, 287,
+	178, 411,  30, 263, 152, 385,  80, 313, 128, 361, 104, 337,
+	 18, 251, 226, 459,  68, 301, 190, 423, 214, 447,  42, 275,
+	164, 397, 140, 373,  92, 325, 116, 349,   8, 241, 204, 437,
+	 56, 291, 180, 413,  32, 265, 154, 387,  82, 315, 130, 363,
+	106, 339,  20, 253, 228, 461,  70, 303, 192, 425, 216, 449,
+	 44, 277, 166, 399, 142, 375,  94, 327, 118, 351,  10, 243,
+	206, 439,  60, 293, 182, 415,  34, 267, 156, 389,  84, 317,
+	132, 365, 108, 341,  22, 255, 230, 463,  72, 305, 194, 427,
+	218, 451,  46, 279, 168, 401, 144, 377,  96, 329, 120, 353,
+};
+
+/* FACCH/H, 6 bursts: blocks 6 and 7 of the TCH/FS interleaver are
+ * carried by the odd bits of bursts 2 and 3 */
+const uint16_t gsm0503_facch_h_burst_idx[456] = {
+	  0, 216, 316, 416, 515, 615, 251, 351, 102, 202, 302, 400,
+	501, 601, 237, 453,  88, 188, 286, 386, 487, 587, 339, 439,
+	 74, 172, 272, 372, 473, 689, 325, 425,  60, 158, 258, 358,
+	575, 675, 311, 411,  44, 144, 244, 460, 561, 661, 297, 395,
+	 30, 130, 346, 446, 547, 647, 281, 381,  16, 116, 332, 432,
+	533, 631, 267, 367,   2, 218, 318, 418, 517, 617, 253, 353,
+	104, 204, 304, 402, 503, 603, 239, 455,  90, 190, 288, 388,
+	489, 589, 341, 441,  76, 176, 274, 374, 475, 691, 327, 427,
+	 62, 160, 260, 360, 577, 677, 313, 413,  46, 146, 246, 462,
+	563, 663, 299, 397,  32, 132, 232, 448, 549, 649, 283, 383,
+	 18, 118, 334, 434, 535, 633, 269, 369,   4, 220, 320, 420,
+	519, 619, 255, 355, 106, 206, 306, 404, 505, 605, 241, 457,
+	 92, 192, 292, 390, 491, 591, 343, 443,  78, 178, 276, 376,
+	477, 693, 329, 429,  64, 162, 262, 362, 579, 679, 315, 415,
+	 48, 148, 248, 348, 565, 665, 301, 399,  34, 134, 234, 450,
+	551, 651, 285, 385,  20, 120, 336, 436, 537, 635, 271, 371,
+	  6, 222, 322, 422, 523, 621, 257, 357, 108, 208, 308, 408,
+	507, 607, 243, 459,  94, 194, 294, 392, 493, 593, 345, 445,
+	 80, 180, 278, 378, 479, 695, 331, 431,  66, 164, 264, 364,
+	465, 681, 317, 417,  50, 150, 250, 350, 567, 667, 303, 401,
+	 36, 136, 236, 452, 553, 653, 287, 387,  22, 122, 338, 438,
+	539, 639, 273, 373,   8, 224, 324, 424, 525, 623, 259, 359,
+	110, 210, 310, 410, 509, 609, 245, 461,  96, 196, 296, 394,
+	495, 595, 347, 447,  82, 182, 280, 380, 481, 581, 333, 433,
+	 68, 166, 266, 366, 467, 683, 319, 419,  52, 152, 252, 352,
+	569, 669, 305, 403,  38, 138, 238, 454, 555, 655, 291, 389,
+	 24, 124, 340, 440, 541, 641, 275, 375,  10, 226, 326, 426,
+	527, 625, 261, 361, 112, 212, 312, 412, 511, 611, 247, 463,
+	 98, 198, 298, 396, 497, 597, 233, 449,  84, 184, 282, 382,
+	483, 583, 335, 435,  70, 168, 268, 368, 469, 685, 321, 421,
+	 54, 154, 254, 354, 571, 671, 307, 407,  40, 140, 240, 456,
+	557, 657, 293, 391,  26, 126, 342, 442, 543, 643, 277, 377,
+	 12, 228, 328, 428, 529, 627, 263, 363, 114, 214, 314, 414,
+	513, 613, 249, 349, 100, 200, 300, 398, 499, 599, 235, 451,
+	 86, 186, 284, 384, 485, 585, 337, 437,  72, 170, 270, 370,
+	471, 687, 323, 423,  56, 156, 256, 356, 573, 673, 309, 409,
+	 42, 142, 242, 458, 559, 659, 295, 393,  28, 128, 344, 444,
+	545, 645, 279, 379,  14, 230, 330, 430, 531, 629, 265, 365,
+};
@@ -15,5 +15,9 @@ extern const sbit_t gsm0503_afs_ic_sbit[4][8];
 extern const ubit_t gsm0503_ahs_ic_ubit[4][4];
 extern const sbit_t gsm0503_ahs_ic_sbit[4][4];
 extern const uint8_t gsm0503_tch_hr_interleaving[228][2];
+extern const uint16_t gsm0503_xcch_burst_idx[456];
+extern const uint16_t gsm0503_tch_fr_burst_idx[456];
+extern const uint16_t gsm0503_tch_hr_burst_idx[228];
+extern const uint16_t gsm0503_facch_h_burst_idx[456];
 
 #endif /* _0503_TABLES_H */
@@ -0,0 +1,652 @@
+/* Vectorized Viterbi decoder for the GSM 05.03 convolutional codes */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+#include <osmocom/core/utils.h>
+
+#include "gsm0503_conv.h"
+#include "gsm0503_viterbi.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_VDEC_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_VDEC_NEON 1
+#endif
+
+/*
+ * All GSM 05.03 codes are either K=5 (16 states) or K=7 (64 states) and
+ * are built from a shift register, so state s always has the successors
+ * (s << 1) and (s << 1) | 1, no matter if the code is recursive or not.
+ * Each next state ns therefore has exactly the two predecessors
+ * (ns >> 1) and (ns >> 1) + n_states / 2, which is the butterfly all
+ * kernels below are built around.
+ *
+ * Path metrics are the correlation of the received soft bits with the
+ * expected code symbols, kept as int16 and renormalized to state 0 after
+ * every step. The spread of all path metrics is bounded by
+ * 2 * 127 * N * (K - 1), so nothing can overflow or saturate, and the
+ * generic and SIMD kernels are bit-exact against each other. On equal
+ * metrics, the lower predecessor wins.
+ */
+
+#define VDEC_MAX_N	5
+#define VDEC_MAX_STATES	64
+#define VDEC_MAX_STEPS	1024
+#define VDEC_NEG	-16384
+
+struct vdec_code {
+	const struct osmo_conv_code *code;
+	int valid;
+	int n_states;
+	/* expected symbol sign (+1: bit 0, -1: bit 1), indexed by the
+	 * predecessor (0: ns >> 1, 1: (ns >> 1) + n_states / 2), the
+	 * output bit number and the next state */
+	int16_t sign[2][VDEC_MAX_N][VDEC_MAX_STATES]
+		__attribute__((aligned(32)));
+	/* encoder input bit, indexed by state and LSB of next state */
+	uint8_t in_bit[VDEC_MAX_STATES][2];
+};
+
+/* forward pass over the non-terminated part of the trellis */
+typedef void (*vdec_fwd_fn)(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec);
+
+struct vdec_impl {
+	vdec_fwd_fn fwd_k5;
+	vdec_fwd_fn fwd_k7;
+};
+
+static const struct osmo_conv_code *vdec_code_list[] = {
+	&gsm0503_conv_xcch,
+	&gsm0503_conv_cs2,
+	&gsm0503_conv_cs3,
+	&gsm0503_conv_rach,
+	&gsm0503_conv_sch,
+	&gsm0503_conv_tch_fr,
+	&gsm0503_conv_tch_hr,
+	&gsm0503_conv_tch_afs_12_2,
+	&gsm0503_conv_tch_afs_10_2,
+	&gsm0503_conv_tch_afs_7_95,
+	&gsm0503_conv_tch_afs_7_4,
+	&gsm0503_conv_tch_afs_6_7,
+	&gsm0503_conv_tch_afs_5_9,
+	&gsm0503_conv_tch_afs_5_15,
+	&gsm0503_conv_tch_afs_4_75,
+	&gsm0503_conv_tch_ahs_7_95,
+	&gsm0503_conv_tch_ahs_7_4,
+	&gsm0503_conv_tch_ahs_6_7,
+	&gsm0503_conv_tch_ahs_5_9,
+	&gsm0503_conv_tch_ahs_5_15,
+	&gsm0503_conv_tch_ahs_4_75,
+};
+
+static struct vdec_code vdec_codes[ARRAY_SIZE(vdec_code_list)];
+static const struct vdec_impl *vdec_cur_impl = NULL;
+static enum gsm0503_viterbi_impl vdec_cur_impl_nr = GSM0503_VITERBI_GENERIC;
+
+const struct value_string gsm0503_viterbi_impl_names[] = {
+	{ GSM0503_VITERBI_GENERIC,	"generic" },
+	{ GSM0503_VITERBI_SSE2,		"sse2" },
+	{ GSM0503_VITERBI_AVX2,		"avx2" },
+	{ GSM0503_VITERBI_NEON,		"neon" },
+	{ 0, NULL }
+};
+
+static inline int vdec_term_output(const struct osmo_conv_code *code, int s)
+{
+	if (code->next_term_output)
+		return code->next_term_output[s];
+
+	/* non-recursive codes are flushed with zero bits */
+	return code->next_output[s][0];
+}
+
+static int vdec_code_init(struct vdec_code *vc,
+	const struct osmo_conv_code *code)
+{
+	int n_states, half, s, b, c, j, ns, p, ov, base;
+
+	memset(vc, 0, sizeof(*vc));
+	vc->code = code;
+
+	if (code->K != 5 && code->K != 7)
+		return -ENOTSUP;
+	if (code->N > VDEC_MAX_N || code->term != CONV_TERM_FLUSH)
+		return -ENOTSUP;
+	if (code->len + code->K - 1 > VDEC_MAX_STEPS)
+		return -ENOTSUP;
+
+	n_states = 1 << (code->K - 1);
+	half = n_states >> 1;
+
+	/* verify the shift register butterfly */
+	for (s = 0; s < n_states; s++) {
+		base = (s << 1) & (n_states - 1);
+		if (code->next_state[s][0] == code->next_state[s][1])
+			return -ENOTSUP;
+		for (b = 0; b < 2; b++) {
+			ns = code->next_state[s][b];
+			if ((ns & ~1) != base)
+				return -ENOTSUP;
+			vc->in_bit[s][ns & 1] = b;
+		}
+		if (code->next_term_state) {
+			if (code->next_term_state[s] != base)
+				return -ENOTSUP;
+		} else if (code->next_state[s][0] != base)
+			return -ENOTSUP;
+	}
+
+	for (ns = 0; ns < n_states; ns++) {
+		for (c = 0; c < 2; c++) {
+			p = (ns >> 1) + (c ? half : 0);
+			ov = code->next_output[p][vc->in_bit[p][ns & 1]];
+			for (j = 0; j < code->N; j++)
+				vc->sign[c][j][ns] =
+					((ov >> (code->N - j - 1)) & 1) ? -1 : 1;
+		}
+	}
+
+	vc->n_states = n_states;
+	vc->valid = 1;
+
+	return 0;
+}
+
+static const struct vdec_code *vdec_lookup(const struct osmo_conv_code *code)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(vdec_codes); i++) {
+		if (vdec_codes[i].code == code)
+			return vdec_codes[i].valid ? &vdec_codes[i] : NULL;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * generic C kernel
+ */
+
+static void vdec_fwd_gen(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	int16_t nm[VDEC_MAX_STATES];
+	int N = vc->code->N, n_states = vc->n_states, half = n_states >> 1;
+	int t, ns, j;
+
+	for (t = 0; t < steps; t++, sym += N) {
+		uint64_t d = 0;
+		int16_t norm;
+
+		for (ns = 0; ns < n_states; ns++) {
+			int16_t a = m[ns >> 1], b = m[(ns >> 1) + half];
+
+			for (j = 0; j < N; j++) {
+				a += vc->sign[0][j][ns] * sym[j];
+				b += vc->sign[1][j][ns] * sym[j];
+			}
+			if (b > a) {
+				nm[ns] = b;
+				d |= (uint64_t) 1 << ns;
+			} else
+				nm[ns] = a;
+		}
+
+		norm = nm[0];
+		for (ns = 0; ns < n_states; ns++)
+			m[ns] = nm[ns] - norm;
+		dec[t] = d;
+	}
+}
+
+static const struct vdec_impl vdec_impl_gen = {
+	.fwd_k5 = vdec_fwd_gen,
+	.fwd_k7 = vdec_fwd_gen,
+};
+
+
+/*
+ * SSE2 / AVX2 kernels
+ */
+
+#ifdef HAVE_VDEC_X86
+static inline __attribute__((always_inline, target("sse2")))
+void vdec_fwd_sse2_k(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec, const int nv)
+{
+	__m128i cur[8], nxt[8], s[VDEC_MAX_N], norm;
+	const int N = vc->code->N, hv = nv >> 1;
+	int t, v, j;
+
+	for (v = 0; v < nv; v++)
+		cur[v] = _mm_load_si128((const __m128i *) &m[v * 8]);
+
+	for (t = 0; t < steps; t++, sym += N) {
+		uint64_t d = 0;
+
+		for (j = 0; j < N; j++)
+			s[j] = _mm_set1_epi16(sym[j]);
+
+		for (v = 0; v < nv; v++) {
+			__m128i p0 = cur[v >> 1], p1 = cur[hv + (v >> 1)], gt;
+
+			/* duplicate each predecessor for its two successors */
+			if (v & 1) {
+				p0 = _mm_unpackhi_epi16(p0, p0);
+				p1 = _mm_unpackhi_epi16(p1, p1);
+			} else {
+				p0 = _mm_unpacklo_epi16(p0, p0);
+				p1 = _mm_unpacklo_epi16(p1, p1);
+			}
+
+			for (j = 0; j < N; j++) {
+				p0 = _mm_add_epi16(p0, _mm_mullo_epi16(s[j],
+					_mm_load_si128((const __m128i *)
+						&vc->sign[0][j][v * 8])));
+				p1 = _mm_add_epi16(p1, _mm_mullo_epi16(s[j],
+					_mm_load_si128((const __m128i *)
+						&vc->sign[1][j][v * 8])));
+			}
+
+			gt = _mm_cmpgt_epi16(p1, p0);
+			nxt[v] = _mm_max_epi16(p0, p1);
+			d |= (uint64_t) (_mm_movemask_epi8(
+				_mm_packs_epi16(gt, gt)) & 0xff) << (v * 8);
+		}
+
+		norm = _mm_shufflelo_epi16(nxt[0], 0);
+		norm = _mm_unpacklo_epi64(norm, norm);
+		for (v = 0; v < nv; v++)
+			cur[v] = _mm_sub_epi16(nxt[v], norm);
+		dec[t] = d;
+	}
+
+	for (v = 0; v < nv; v++)
+		_mm_store_si128((__m128i *) &m[v * 8], cur[v]);
+}
+
+static __attribute__((target("sse2")))
+void vdec_fwd_sse2_k5(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	vdec_fwd_sse2_k(vc, sym, steps, m, dec, 2);
+}
+
+static __attribute__((target("sse2")))
+void vdec_fwd_sse2_k7(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	vdec_fwd_sse2_k(vc, sym, steps, m, dec, 8);
+}
+
+/* duplicate each of the 8 metrics in a 128 bit half into 16 lanes */
+static inline __attribute__((always_inline, target("avx2")))
+__m256i vdec_dup_avx2(__m128i h)
+{
+	__m256i x = _mm256_cvtepu16_epi32(h);
+
+	return _mm256_or_si256(x, _mm256_slli_epi32(x, 16));
+}
+
+static __attribute__((target("avx2")))
+void vdec_fwd_avx2_k7(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	__m256i cur[4], nxt[4], gt[4], s[VDEC_MAX_N], norm;
+	const int N = vc->code->N;
+	uint32_t lo, hi;
+	int t, v, j;
+
+	for (v = 0; v < 4; v++)
+		cur[v] = _mm256_load_si256((const __m256i *) &m[v * 16]);
+
+	for (t = 0; t < steps; t++, sym += N) {
+		for (j = 0; j < N; j++)
+			s[j] = _mm256_set1_epi16(sym[j]);
+
+		for (v = 0; v < 4; v++) {
+			__m128i h0, h1;
+			__m256i p0, p1;
+
+			if (v & 1) {
+				h0 = _mm256_extracti128_si256(cur[v >> 1], 1);
+				h1 = _mm256_extracti128_si256(cur[2 + (v >> 1)], 1);
+			} else {
+				h0 = _mm256_castsi256_si128(cur[v >> 1]);
+				h1 = _mm256_castsi256_si128(cur[2 + (v >> 1)]);
+			}
+			p0 = vdec_dup_avx2(h0);
+			p1 = vdec_dup_avx2(h1);
+
+			for (j = 0; j < N; j++) {
+				p0 = _mm256_add_epi16(p0, _mm256_mullo_epi16(s[j],
+					_mm256_load_si256((const __m256i *)
+						&vc->sign[0][j][v * 16])));
+				p1 = _mm256_add_epi16(p1, _mm256_mullo_epi16(s[j],
+					_mm256_load_si256((const __m256i *)
+						&vc->sign[1][j][v * 16])));
+			}
+
+			gt[v] = _mm256_cmpgt_epi16(p1, p0);
+			nxt[v] = _mm256_max_epi16(p0, p1);
+		}
+
+		/* packs works per 128 bit lane, restore the state order */
+		lo = _mm256_movemask_epi8(_mm256_permute4x64_epi64(
+			_mm256_packs_epi16(gt[0], gt[1]), 0xd8));
+		hi = _mm256_movemask_epi8(_mm256_permute4x64_epi64(
+			_mm256_packs_epi16(gt[2], gt[3]), 0xd8));
+		dec[t] = lo | ((uint64_t) hi << 32);
+
+		norm = _mm256_broadcastw_epi16(_mm256_castsi256_si128(nxt[0]));
+		for (v = 0; v < 4; v++)
+			cur[v] = _mm256_sub_epi16(nxt[v], norm);
+	}
+
+	for (v = 0; v < 4; v++)
+		_mm256_store_si256((__m256i *) &m[v * 16], cur[v]);
+}
+
+static const struct vdec_impl vdec_impl_sse2 = {
+	.fwd_k5 = vdec_fwd_sse2_k5,
+	.fwd_k7 = vdec_fwd_sse2_k7,
+};
+
+/* 16 states fit into a single SSE register, no gain from AVX2 here */
+static const struct vdec_impl vdec_impl_avx2 = {
+	.fwd_k5 = vdec_fwd_sse2_k5,
+	.fwd_k7 = vdec_fwd_avx2_k7,
+};
+#endif /* HAVE_VDEC_X86 */
+
+
+/*
+ * NEON kernel
+ */
+
+#ifdef HAVE_VDEC_NEON
+static inline __attribute__((always_inline))
+void vdec_fwd_neon_k(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec, const int nv)
+{
+	static const uint16_t bitsel[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint16x8_t sel = vld1q_u16(bitsel);
+	int16x8_t cur[8], nxt[8], s[VDEC_MAX_N], norm;
+	const int N = vc->code->N, hv = nv >> 1;
+	int t, v, j;
+
+	for (v = 0; v < nv; v++)
+		cur[v] = vld1q_s16(&m[v * 8]);
+
+	for (t = 0; t < steps; t++, sym += N) {
+		uint64_t d = 0;
+
+		for (j = 0; j < N; j++)
+			s[j] = vdupq_n_s16(sym[j]);
+
+		for (v = 0; v < nv; v++) {
+			int16x8x2_t z0 = vzipq_s16(cur[v >> 1], cur[v >> 1]);
+			int16x8x2_t z1 = vzipq_s16(cur[hv + (v >> 1)],
+				cur[hv + (v >> 1)]);
+			int16x8_t p0 = z0.val[v & 1], p1 = z1.val[v & 1];
+			uint64x2_t bits;
+			uint16x8_t gt;
+
+			for (j = 0; j < N; j++) {
+				p0 = vmlaq_s16(p0, s[j],
+					vld1q_s16(&vc->sign[0][j][v * 8]));
+				p1 = vmlaq_s16(p1, s[j],
+					vld1q_s16(&vc->sign[1][j][v * 8]));
+			}
+
+			gt = vcgtq_s16(p1, p0);
+			nxt[v] = vmaxq_s16(p0, p1);
+			bits = vpaddlq_u32(vpaddlq_u16(vandq_u16(gt, sel)));
+			d |= (vgetq_lane_u64(bits, 0) +
+			      vgetq_lane_u64(bits, 1)) << (v * 8);
+		}
+
+		norm = vdupq_n_s16(vgetq_lane_s16(nxt[0], 0));
+		for (v = 0; v < nv; v++)
+			cur[v] = vsubq_s16(nxt[v], norm);
+		dec[t] = d;
+	}
+
+	for (v = 0; v < nv; v++)
+		vst1q_s16(&m[v * 8], cur[v]);
+}
+
+static void vdec_fwd_neon_k5(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	vdec_fwd_neon_k(vc, sym, steps, m, dec, 2);
+}
+
+static void vdec_fwd_neon_k7(const struct vdec_code *vc, const int16_t *sym,
+	int steps, int16_t *m, uint64_t *dec)
+{
+	vdec_fwd_neon_k(vc, sym, steps, m, dec, 8);
+}
+
+static const struct vdec_impl vdec_impl_neon = {
+	.fwd_k5 = vdec_fwd_neon_k5,
+	.fwd_k7 = vdec_fwd_neon_k7,
+};
+#endif /* HAVE_VDEC_NEON */
+
+
+/*
+ * common part
+ */
+
+/* termination steps: only even states are reachable, done in plain C with
+ * 32 bit metrics for all kernels */
+static void vdec_term(const struct vdec_code *vc, const int16_t *sym,
+	const int16_t *m16, uint64_t *dec)
+{
+	const struct osmo_conv_code *code = vc->code;
+	int m[VDEC_MAX_STATES], nm[VDEC_MAX_STATES];
+	int n_states = vc->n_states, half = n_states >> 1;
+	int t, ns, c, j;
+
+	for (ns = 0; ns < n_states; ns++)
+		m[ns] = m16[ns];
+
+	for (t = 0; t < code->K - 1; t++, sym += code->N) {
+		uint64_t d = 0;
+
+		for (ns = 0; ns < n_states; ns += 2) {
+			int metric[2];
+
+			for (c = 0; c < 2; c++) {
+				int p = (ns >> 1) + (c ? half : 0);
+				int ov = vdec_term_output(code, p);
+
+				metric[c] = m[p];
+				for (j = 0; j < code->N; j++) {
+					if ((ov >> (code->N - j - 1)) & 1)
+						metric[c] -= sym[j];
+					else
+						metric[c] += sym[j];
+				}
+			}
+			if (metric[1] > metric[0]) {
+				nm[ns] = metric[1];
+				d |= (uint64_t) 1 << ns;
+			} else
+				nm[ns] = metric[0];
+			nm[ns + 1] = VDEC_NEG * 65536;
+		}
+
+		memcpy(m, nm, sizeof(int) * n_states);
+		dec[t] = d;
+	}
+}
+
+/* expand the (punctured) input to one int16 symbol per code bit */
+static void vdec_depuncture(const struct osmo_conv_code *code,
+	const sbit_t *input, int16_t *sym, int n_sym)
+{
+	const int *puncture = code->puncture;
+	int i, p = 0;
+
+	for (i = 0; i < n_sym; i++) {
+		if (puncture && puncture[p] == i) {
+			sym[i] = 0;
+			p++;
+		} else
+			sym[i] = *input++;
+	}
+}
+
+/*! \brief Decode a GSM 05.03 convolutional code
+ *  Drop-in replacement for osmo_conv_decode(). Codes that are not handled
+ *  by the vectorized engine, or calls before gsm0503_viterbi_init(), are
+ *  passed on to osmo_conv_decode().
+ *  \returns non-negative value on success
+ */
+int gsm0503_conv_decode(const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output)
+{
+	const struct vdec_impl *impl = vdec_cur_impl;
+	const struct vdec_code *vc;
+	int16_t sym[VDEC_MAX_STEPS * VDEC_MAX_N] __attribute__((aligned(32)));
+	int16_t m[VDEC_MAX_STATES] __attribute__((aligned(32)));
+	uint64_t dec[VDEC_MAX_STEPS];
+	int steps, half, t, s, p;
+
+	vc = impl ? vdec_lookup(code) : NULL;
+	if (!vc)
+		return osmo_conv_decode(code, input, output);
+
+	steps = code->len + code->K - 1;
+	half = vc->n_states >> 1;
+
+	vdec_depuncture(code, input, sym, steps * code->N);
+
+	/* encoder always starts in state 0 */
+	m[0] = 0;
+	for (s = 1; s < vc->n_states; s++)
+		m[s] = VDEC_NEG;
+
+	if (code->K == 5)
+		impl->fwd_k5(vc, sym, code->len, m, dec);
+	else
+		impl->fwd_k7(vc, sym, code->len, m, dec);
+	vdec_term(vc, sym + code->len * code->N, m, dec + code->len);
+
+	/* trace back from state 0 that the flushed encoder ends in */
+	for (s = 0, t = steps - 1; t >= 0; t--) {
+		p = (s >> 1) + (((dec[t] >> s) & 1) ? half : 0);
+		if (t < code->len)
+			output[t] = vc->in_bit[p][s & 1];
+		s = p;
+	}
+
+	return 0;
+}
+
+int gsm0503_viterbi_impl_supported(enum gsm0503_viterbi_impl impl)
+{
+	switch (impl) {
+	case GSM0503_VITERBI_GENERIC:
+		return 1;
+#ifdef HAVE_VDEC_X86
+	case GSM0503_VITERBI_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case GSM0503_VITERBI_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_VDEC_NEON
+	case GSM0503_VITERBI_NEON:
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+}
+
+int gsm0503_viterbi_set_impl(enum gsm0503_viterbi_impl impl)
+{
+	const struct vdec_impl *vi;
+
+	if (!gsm0503_viterbi_impl_supported(impl))
+		return -ENOTSUP;
+
+	switch (impl) {
+#ifdef HAVE_VDEC_X86
+	case GSM0503_VITERBI_SSE2:
+		vi = &vdec_impl_sse2;
+		break;
+	case GSM0503_VITERBI_AVX2:
+		vi = &vdec_impl_avx2;
+		break;
+#endif
+#ifdef HAVE_VDEC_NEON
+	case GSM0503_VITERBI_NEON:
+		vi = &vdec_impl_neon;
+		break;
+#endif
+	default:
+		vi = &vdec_impl_gen;
+		break;
+	}
+
+	vdec_cur_impl = vi;
+	vdec_cur_impl_nr = impl;
+
+	return 0;
+}
+
+enum gsm0503_viterbi_impl gsm0503_viterbi_get_impl(void)
+{
+	return vdec_cur_impl_nr;
+}
+
+/*! \brief Build the trellis tables and select the fastest kernel
+ *  supported by the CPU we are running on */
+void gsm0503_viterbi_init(void)
+{
+	int i;
+
+#ifdef HAVE_VDEC_X86
+	__builtin_cpu_init();
+#endif
+
+	for (i = 0; i < ARRAY_SIZE(vdec_code_list); i++)
+		vdec_code_init(&vdec_codes[i], vdec_code_list[i]);
+
+	for (i = _NUM_GSM0503_VITERBI_IMPL - 1; i >= 0; i--) {
+		if (gsm0503_viterbi_set_impl(i) == 0)
+			break;
+	}
+}
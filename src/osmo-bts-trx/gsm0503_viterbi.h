@@ -0,0 +1,28 @@
+#ifndef _0503_VITERBI_H
+#define _0503_VITERBI_H
+
+#include <stdint.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+#include <osmocom/core/utils.h>
+
+enum gsm0503_viterbi_impl {
+	GSM0503_VITERBI_GENERIC,	/* plain C, used as scalar fallback */
+	GSM0503_VITERBI_SSE2,
+	GSM0503_VITERBI_AVX2,
+	GSM0503_VITERBI_NEON,
+	_NUM_GSM0503_VITERBI_IMPL
+};
+
+extern const struct value_string gsm0503_viterbi_impl_names[];
+
+void gsm0503_viterbi_init(void);
+int gsm0503_viterbi_impl_supported(enum gsm0503_viterbi_impl impl);
+int gsm0503_viterbi_set_impl(enum gsm0503_viterbi_impl impl);
+enum gsm0503_viterbi_impl gsm0503_viterbi_get_impl(void);
+
+int gsm0503_conv_decode(const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output);
+
+#endif /* _0503_VITERBI_H */
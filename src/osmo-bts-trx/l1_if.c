@@ -42,6 +42,7 @@
 
 #include "l1_if.h"
 #include "trx_if.h"
+#include "trx_ul_pool.h"
 
 
 static const uint8_t transceiver_chan_types[_GSM_PCHAN_MAX] = {
@@ -71,7 +72,11 @@ struct trx_l1h *l1if_open(struct phy_instance *pinst)
 		return NULL;
 	l1h->phy_inst = pinst;
 
-	trx_sched_init(&l1h->l1s, pinst->trx);
+	rc = trx_sched_init(&l1h->l1s, pinst->trx);
+	if (rc < 0) {
+		talloc_free(l1h);
+		return NULL;
+	}
 
 	rc = trx_if_open(l1h);
 	if (rc < 0) {
@@ -89,6 +94,7 @@ err:
 void l1if_close(struct trx_l1h *l1h)
 {
 	trx_if_close(l1h);
+	trx_ul_pool_flush();
 	trx_sched_exit(&l1h->l1s);
 	talloc_free(l1h);
 }
@@ -284,6 +290,7 @@ int bts_model_trx_close(struct gsm_bts_trx *trx)
 	enum gsm_phys_chan_config pchan = trx->ts[0].pchan;
 
 	/* close all logical channels and reset timeslots */
+	trx_ul_pool_flush();
 	trx_sched_reset(&l1h->l1s);
 
 	/* deactivate lchan for CCCH */
@@ -399,6 +406,7 @@ static uint8_t trx_set_ts(struct gsm_bts_trx_ts *ts)
 		return NM_NACK_RES_NOTAVAIL;
 
 	/* set physical channel */
+	trx_ul_pool_flush();
 	rc = trx_sched_set_pchan(&l1h->l1s, tn, pchan);
 	if (rc)
 		return NM_NACK_RES_NOTAVAIL;
@@ -561,6 +569,8 @@ int bts_model_l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 			tn = L1SAP_CHAN2TS(chan_nr);
 			ss = l1sap_chan2ss(chan_nr);
 			lchan = &trx->ts[tn].lchan[ss];
+			/* deliver decoded blocks before the channel changes */
+			trx_ul_pool_flush();
 			if (l1sap->u.info.type == PRIM_INFO_ACTIVATE) {
 				if ((chan_nr & 0x80)) {
 					LOGP(DL1C, LOGL_ERROR, "Cannot activate"
@@ -40,6 +40,8 @@ struct trx_l1h {
 	struct osmo_fd		trx_ofd_ctrl;
 	struct osmo_timer_list	trx_ctrl_timer;
 	struct osmo_fd		trx_ofd_data;
+	struct udp_batch	*data_tx;	/* bursts to send this FN */
+	struct udp_batch	*data_rx;
 
 	/* transceiver config */
 	struct trx_config	config;
@@ -58,6 +58,7 @@
 
 #include "l1_if.h"
 #include "trx_if.h"
+#include "gsm0503_viterbi.h"
 
 /* dummy, since no direct dsp support */
 uint32_t trx_get_hlayer1(struct gsm_bts_trx *trx)
@@ -105,6 +106,11 @@ int bts_model_init(struct gsm_bts *bts)
 	 * value */
 	bts->c0->nominal_power = 23;
 
+	gsm0503_viterbi_init();
+	LOGP(DL1C, LOGL_NOTICE, "Using %s Viterbi decoder\n",
+		get_value_string(gsm0503_viterbi_impl_names,
+				 gsm0503_viterbi_get_impl()));
+
 	bts_model_vty_init(bts);
 
 	return 0;
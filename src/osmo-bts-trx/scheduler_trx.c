@@ -46,15 +46,11 @@
 #include "trx_if.h"
 #include "loops.h"
 #include "amr.h"
+#include "trx_ul_pool.h"
+#include "trx_clock.h"
 
 extern void *tall_bts_ctx;
 
-/* clock states */
-static uint32_t transceiver_lost;
-uint32_t transceiver_last_fn;
-static struct timeval transceiver_clock_tv;
-static struct osmo_timer_list transceiver_clock_timer;
-
 /* Enable this to multiply TOA of RACH by 10.
  * This is usefull to check tenth of timing advances with RSSI test tool.
  * Note that regular phones will not work when using this test! */
@@ -160,11 +156,8 @@ ubit_t *tx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 		trx_chan_desc[chan].name, l1t->trx->nr, tn, fn);
 
 no_msg:
-	/* free burst memory */
-	if (*bursts_p) {
-		talloc_free(*bursts_p);
-		*bursts_p = NULL;
-	}
+	/* release burst memory */
+	*bursts_p = NULL;
 	return NULL;
 
 got_msg:
@@ -194,9 +187,9 @@ got_msg:
 		}
 	}
 
-	/* alloc burst memory, if not already */
+	/* take burst memory from the slab, if not already */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 464);
+		*bursts_p = _sched_dl_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return NULL;
 	}
@@ -249,19 +242,16 @@ ubit_t *tx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 		trx_chan_desc[chan].name, l1t->trx->nr, tn, fn);
 
 no_msg:
-	/* free burst memory */
-	if (*bursts_p) {
-		talloc_free(*bursts_p);
-		*bursts_p = NULL;
-	}
+	/* release burst memory */
+	*bursts_p = NULL;
 	return NULL;
 
 got_msg:
 	/* BURST BYPASS */
 
-	/* alloc burst memory, if not already */
+	/* take burst memory from the slab, if not already */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 464);
+		*bursts_p = _sched_dl_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return NULL;
 	}
@@ -547,10 +537,10 @@ ubit_t *tx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 
 	/* BURST BYPASS */
 
-	/* alloc burst memory, if not already,
+	/* take burst memory from the slab, if not already,
 	 * otherwise shift buffer by 4 bursts for interleaving */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 928);
+		*bursts_p = _sched_dl_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return NULL;
 	} else {
@@ -636,10 +626,10 @@ ubit_t *tx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 
 	/* BURST BYPASS */
 
-	/* alloc burst memory, if not already,
+	/* take burst memory from the slab, if not already,
 	 * otherwise shift buffer by 2 bursts for interleaving */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 696);
+		*bursts_p = _sched_dl_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return NULL;
 	} else {
@@ -702,28 +692,28 @@ send_burst:
 
 /*
  * RX on uplink (indication to upper layer)
+ *
+ * Each rx_*_fn collects the bursts of a block in the channel state. Once a
+ * block is complete, it is copied into a trx_ul_block and handed to the
+ * UL decoder pool, see trx_ul_pool.c. The *_decode_cb functions must not
+ * touch any state outside of the block, the *_finish_cb functions are
+ * called from the main loop and forward the result to the upper layers.
  */
 
-int rx_rach_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
-	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
-	float toa)
+static void rach_decode_cb(struct trx_ul_block *blk)
 {
-	uint8_t chan_nr;
-	struct osmo_phsap_prim l1sap;
-	uint8_t ra;
-	int rc;
-
-	chan_nr = trx_chan_desc[chan].chan_nr | tn;
+	blk->rc = rach_decode(&blk->data[0], blk->bursts, blk->bsic);
+}
 
-	LOGP(DL1C, LOGL_NOTICE, "Received Access Burst on %s fn=%u toa=%.2f\n",
-		trx_chan_desc[chan].name, fn, toa);
+static void rach_finish_cb(struct trx_ul_block *blk)
+{
+	struct osmo_phsap_prim l1sap;
+	float toa = blk->toa;
 
-	/* decode */
-	rc = rach_decode(&ra, bits + 8 + 41, l1t->trx->bts->bsic);
-	if (rc) {
+	if (blk->rc) {
 		LOGP(DL1C, LOGL_NOTICE, "Received bad AB frame at fn=%u "
-			"(%u/51)\n", fn, fn % 51);
-		return 0;
+			"(%u/51)\n", blk->fn, blk->fn % 51);
+		return;
 	}
 
 	/* compose primitive */
@@ -731,21 +721,106 @@ int rx_rach_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	memset(&l1sap, 0, sizeof(l1sap));
 	osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_PH_RACH, PRIM_OP_INDICATION,
 		NULL);
-	l1sap.u.rach_ind.chan_nr = chan_nr;
-	l1sap.u.rach_ind.ra = ra;
+	l1sap.u.rach_ind.chan_nr = trx_chan_desc[blk->chan].chan_nr | blk->tn;
+	l1sap.u.rach_ind.ra = blk->data[0];
 #ifdef TA_TEST
 #warning TIMING ADVANCE TEST-HACK IS ENABLED!!!
 	toa *= 10;
 #endif
 	l1sap.u.rach_ind.acc_delay = (toa >= 0) ? toa : 0;
-	l1sap.u.rach_ind.fn = fn;
+	l1sap.u.rach_ind.fn = blk->fn;
 
 	/* forward primitive */
-	l1sap_up(l1t->trx, &l1sap);
+	l1sap_up(blk->l1t->trx, &l1sap);
+}
+
+int rx_rach_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{
+	struct trx_ul_block stack_blk, *blk;
+
+	LOGP(DL1C, LOGL_NOTICE, "Received Access Burst on %s fn=%u toa=%.2f\n",
+		trx_chan_desc[chan].name, fn, toa);
+
+	/* decode */
+	blk = trx_ul_pool_get(NULL, &stack_blk);
+	blk->decode = rach_decode_cb;
+	blk->finish = rach_finish_cb;
+	blk->l1t = l1t;
+	blk->chan_state = NULL;
+	blk->tn = tn;
+	blk->fn = fn;
+	blk->chan = chan;
+	blk->rssi = rssi;
+	blk->toa = toa;
+	blk->bsic = l1t->trx->bts->bsic;
+	memcpy(blk->bursts, bits + 8 + 41, 36);
+	trx_ul_pool_run(blk);
 
 	return 0;
 }
 
+static void data_decode_cb(struct trx_ul_block *blk)
+{
+	int n_errors, n_bits_total;
+
+	blk->combined = 0;
+	blk->rc = xcch_decode(blk->data, blk->bursts, &blk->n_errors,
+		&blk->n_bits_total);
+	if (!blk->rc || !blk->combine)
+		return;
+
+	/* the block may repeat the previous bad one, the measurements
+	 * remain those of the block alone */
+	if (xcch_decode_combined(blk->data, blk->bursts, blk->bursts + 464,
+			&n_errors, &n_bits_total) == 0) {
+		blk->rc = 0;
+		blk->combined = 1;
+	}
+}
+
+static void data_finish_cb(struct trx_ul_block *blk)
+{
+	struct l1sched_trx *l1t = blk->l1t;
+	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, blk->tn);
+	struct l1sched_chan_state *chan_state = blk->chan_state;
+	uint8_t l2_len;
+
+	/* keep a bad SACCH block, the MS may repeat it (TS 44.006) */
+	if (L1SAP_IS_LINK_SACCH(trx_chan_desc[blk->chan].link_id)) {
+		if (blk->rc && chan_state->ul_bursts) {
+			memcpy(chan_state->ul_bursts + 464, blk->bursts, 464);
+			chan_state->ul_sacch_bad = 1;
+		} else
+			chan_state->ul_sacch_bad = 0;
+	}
+
+	if (blk->combined) {
+		LOGP(DL1C, LOGL_INFO, "Received repeated data frame at fn=%u "
+			"(%u/%u) for %s, decoded with the previous one\n",
+			blk->first_fn, blk->first_fn % l1ts->mf_period,
+			l1ts->mf_period, trx_chan_desc[blk->chan].name);
+	}
+
+	if (blk->rc) {
+		LOGP(DL1C, LOGL_NOTICE, "Received bad data frame at fn=%u "
+			"(%u/%u) for %s\n", blk->first_fn,
+			blk->first_fn % l1ts->mf_period, l1ts->mf_period,
+			trx_chan_desc[blk->chan].name);
+		l2_len = 0;
+	} else
+		l2_len = GSM_MACBLOCK_LEN;
+
+	/* Send uplnk measurement information to L2 */
+	l1if_process_meas_res(l1t->trx, blk->tn, blk->fn,
+		trx_chan_desc[blk->chan].chan_nr | blk->tn,
+		blk->n_errors, blk->n_bits_total, blk->rssi, blk->toa);
+
+	_sched_compose_ph_data_ind(l1t, blk->tn, blk->first_fn, blk->chan,
+		blk->data, l2_len, blk->rssi, PRES_INFO_UNKNOWN);
+}
+
 /*! \brief a single burst was received by the PHY, process it */
 int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
@@ -760,9 +835,8 @@ int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	uint8_t *rssi_num = &chan_state->rssi_num;
 	float *toa_sum = &chan_state->toa_sum;
 	uint8_t *toa_num = &chan_state->toa_num;
-	uint8_t l2[GSM_MACBLOCK_LEN], l2_len;
-	int n_errors, n_bits_total;
-	int rc;
+	struct trx_ul_block stack_blk, *blk;
+	int sacch = L1SAP_IS_LINK_SACCH(trx_chan_desc[chan].link_id);
 
 	/* handle rach, if handover rach detection is turned on */
 	if (chan_state->ho_rach_detect == 1)
@@ -771,9 +845,9 @@ int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	LOGP(DL1C, LOGL_DEBUG, "Data received %s fn=%u ts=%u trx=%u bid=%u\n",
 		trx_chan_desc[chan].name, fn, tn, l1t->trx->nr, bid);
 
-	/* alloc burst memory, if not already */
+	/* take burst memory from the slab, if not already */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 464);
+		*bursts_p = _sched_ul_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return -ENOMEM;
 	}
@@ -802,7 +876,7 @@ int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	memcpy(burst + 58, bits + 87, 58);
 
 	/* send burst information to loops process */
-	if (L1SAP_IS_LINK_SACCH(trx_chan_desc[chan].link_id)) {
+	if (sacch) {
 		trx_loop_sacch_input(l1t, trx_chan_desc[chan].chan_nr | tn,
 			chan_state, rssi, toa);
 	}
@@ -826,22 +900,53 @@ int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	}
 	*mask = 0x0;
 
-	/* decode */
-	rc = xcch_decode(l2, *bursts_p, &n_errors, &n_bits_total);
-	if (rc) {
-		LOGP(DL1C, LOGL_NOTICE, "Received bad data frame at fn=%u "
-			"(%u/%u) for %s\n", *first_fn,
-			(*first_fn) % l1ts->mf_period, l1ts->mf_period,
-			trx_chan_desc[chan].name);
-		l2_len = 0;
-	} else
-		l2_len = GSM_MACBLOCK_LEN;
+	/* decode, the previous SACCH block must be finished to know if
+	 * it is to be combined with this one */
+	blk = trx_ul_pool_get(sacch ? chan_state : NULL, &stack_blk);
+	blk->decode = data_decode_cb;
+	blk->finish = data_finish_cb;
+	blk->l1t = l1t;
+	blk->chan_state = chan_state;
+	blk->tn = tn;
+	blk->fn = fn;
+	blk->first_fn = *first_fn;
+	blk->chan = chan;
+	blk->rssi = *rssi_sum / *rssi_num;
+	blk->toa = *toa_sum / *toa_num;
+	blk->combine = sacch && chan_state->ul_sacch_bad;
+	memcpy(blk->bursts, *bursts_p, blk->combine ? 2 * 464 : 464);
+	trx_ul_pool_run(blk);
+
+	return 0;
+}
+
+static void pdtch_decode_cb(struct trx_ul_block *blk)
+{
+	blk->rc = pdtch_decode(blk->data, blk->bursts, NULL, &blk->n_errors,
+		&blk->n_bits_total);
+}
+
+static void pdtch_finish_cb(struct trx_ul_block *blk)
+{
+	struct l1sched_trx *l1t = blk->l1t;
+	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, blk->tn);
+	uint32_t fn = blk->fn;
 
 	/* Send uplnk measurement information to L2 */
-	l1if_process_meas_res(l1t->trx, tn, fn, trx_chan_desc[chan].chan_nr | tn,
-		n_errors, n_bits_total, *rssi_sum / *rssi_num, *toa_sum / *toa_num);
+	l1if_process_meas_res(l1t->trx, blk->tn, fn,
+		trx_chan_desc[blk->chan].chan_nr | blk->tn,
+		blk->n_errors, blk->n_bits_total, blk->rssi, blk->toa);
+
+	if (blk->rc <= 0) {
+		LOGP(DL1C, LOGL_NOTICE, "Received bad PDTCH block ending at "
+			"fn=%u (%u/%u) for %s\n", fn, fn % l1ts->mf_period,
+			l1ts->mf_period, trx_chan_desc[blk->chan].name);
+		return;
+	}
 
-	return _sched_compose_ph_data_ind(l1t, tn, *first_fn, chan, l2, l2_len, *rssi_sum / *rssi_num, PRES_INFO_UNKNOWN);
+	_sched_compose_ph_data_ind(l1t, blk->tn,
+		(fn + GSM_HYPERFRAME - 3) % GSM_HYPERFRAME, blk->chan,
+		blk->data, blk->rc, blk->rssi, PRES_INFO_BOTH);
 }
 
 int rx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
@@ -856,16 +961,14 @@ int rx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	uint8_t *rssi_num = &chan_state->rssi_num;
 	float *toa_sum = &chan_state->toa_sum;
 	uint8_t *toa_num = &chan_state->toa_num;
-	uint8_t l2[54];
-	int n_errors, n_bits_total;
-	int rc;
+	struct trx_ul_block stack_blk, *blk;
 
 	LOGP(DL1C, LOGL_DEBUG, "PDTCH received %s fn=%u ts=%u trx=%u bid=%u\n", 
 		trx_chan_desc[chan].name, fn, tn, l1t->trx->nr, bid);
 
-	/* alloc burst memory, if not already */
+	/* take burst memory from the slab, if not already */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 464);
+		*bursts_p = _sched_ul_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return -ENOMEM;
 	}
@@ -906,101 +1009,88 @@ int rx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	*mask = 0x0;
 
 	/* decode */
-	rc = pdtch_decode(l2, *bursts_p, NULL, &n_errors, &n_bits_total);
-
-	/* Send uplnk measurement information to L2 */
-	l1if_process_meas_res(l1t->trx, tn, fn, trx_chan_desc[chan].chan_nr | tn,
-		n_errors, n_bits_total, *rssi_sum / *rssi_num, *toa_sum / *toa_num);
-
-	if (rc <= 0) {
-		LOGP(DL1C, LOGL_NOTICE, "Received bad PDTCH block ending at "
-			"fn=%u (%u/%u) for %s\n", fn, fn % l1ts->mf_period,
-			l1ts->mf_period, trx_chan_desc[chan].name);
-		return 0;
-	}
+	blk = trx_ul_pool_get(NULL, &stack_blk);
+	blk->decode = pdtch_decode_cb;
+	blk->finish = pdtch_finish_cb;
+	blk->l1t = l1t;
+	blk->chan_state = chan_state;
+	blk->tn = tn;
+	blk->fn = fn;
+	blk->chan = chan;
+	blk->rssi = *rssi_sum / *rssi_num;
+	blk->toa = *toa_sum / *toa_num;
+	memcpy(blk->bursts, *bursts_p, 464);
+	trx_ul_pool_run(blk);
 
-	return _sched_compose_ph_data_ind(l1t, tn, (fn + GSM_HYPERFRAME - 3) % GSM_HYPERFRAME, chan,
-		l2, rc, *rssi_sum / *rssi_num, PRES_INFO_BOTH);
+	return 0;
 }
 
-int rx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
-	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
-	float toa)
+/* copy the mode of a TCH channel into the block for decoding */
+static void tch_block_set_mode(struct trx_ul_block *blk,
+	const struct l1sched_chan_state *chan_state)
 {
-	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
-	struct l1sched_chan_state *chan_state = &l1ts->chan_state[chan];
-	sbit_t *burst, **bursts_p = &chan_state->ul_bursts;
-	uint8_t *mask = &chan_state->ul_mask;
-	uint8_t rsl_cmode = chan_state->rsl_cmode;
-	uint8_t tch_mode = chan_state->tch_mode;
-	uint8_t tch_data[128]; /* just to be safe */
-	int rc, amr = 0;
-	int n_errors, n_bits_total;
-
-	/* handle rach, if handover rach detection is turned on */
-	if (chan_state->ho_rach_detect == 1)
-		return rx_rach_fn(l1t, tn, fn, chan, bid, bits, rssi, toa);
-
-	LOGP(DL1C, LOGL_DEBUG, "TCH/F received %s fn=%u ts=%u trx=%u bid=%u\n", 
-		trx_chan_desc[chan].name, fn, tn, l1t->trx->nr, bid);
-
-	/* alloc burst memory, if not already */
-	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 928);
-		if (!*bursts_p)
-			return -ENOMEM;
-	}
-
-	/* clear burst */
-	if (bid == 0) {
-		memset(*bursts_p + 464, 0, 464);
-		*mask = 0x0;
-	}
-
-	/* update mask */
-	*mask |= (1 << bid);
-
-	/* copy burst to end of buffer of 8 bursts */
-	burst = *bursts_p + bid * 116 + 464;
-	memcpy(burst, bits + 3, 58);
-	memcpy(burst + 58, bits + 87, 58);
-
-	/* wait until complete set of bursts */
-	if (bid != 3)
-		return 0;
+	blk->rsl_cmode = chan_state->rsl_cmode;
+	blk->tch_mode = chan_state->tch_mode;
+	memcpy(blk->codec, chan_state->codec, sizeof(blk->codec));
+	blk->codecs = chan_state->codecs;
+	blk->ul_ft = chan_state->ul_ft;
+	blk->ul_cmr = chan_state->ul_cmr;
+}
 
-	/* check for complete set of bursts */
-	if ((*mask & 0xf) != 0xf) {
-		LOGP(DL1C, LOGL_NOTICE, "Received incomplete TCH frame ending "
-			"at fn=%u (%u/%u) for %s\n", fn,
-			fn % l1ts->mf_period, l1ts->mf_period,
-			trx_chan_desc[chan].name);
-	}
-	*mask = 0x0;
+static void tchf_decode_cb(struct trx_ul_block *blk)
+{
+	uint32_t fn = blk->fn;
 
-	/* decode
-	 * also shift buffer by 4 bursts for interleaving */
-	switch ((rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
-								: tch_mode) {
+	switch ((blk->rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
+							: blk->tch_mode) {
 	case GSM48_CMODE_SPEECH_V1: /* FR */
-		rc = tch_fr_decode(tch_data, *bursts_p, 1, 0, &n_errors, &n_bits_total);
+		blk->rc = tch_fr_decode(blk->data, blk->bursts, 1, 0,
+			&blk->n_errors, &blk->n_bits_total);
 		break;
 	case GSM48_CMODE_SPEECH_EFR: /* EFR */
-		rc = tch_fr_decode(tch_data, *bursts_p, 1, 1, &n_errors, &n_bits_total);
+		blk->rc = tch_fr_decode(blk->data, blk->bursts, 1, 1,
+			&blk->n_errors, &blk->n_bits_total);
 		break;
 	case GSM48_CMODE_SPEECH_AMR: /* AMR */
 		/* the first FN 0,8,17 defines that CMI is included in frame,
 		 * the first FN 4,13,21 defines that CMR is included in frame.
 		 * NOTE: A frame ends 7 FN after start.
 		 */
-		rc = tch_afs_decode(tch_data + 2, *bursts_p,
-			(((fn + 26 - 7) % 26) >> 2) & 1, chan_state->codec,
-			chan_state->codecs, &chan_state->ul_ft,
-			&chan_state->ul_cmr, &n_errors, &n_bits_total);
+		blk->rc = tch_afs_decode(blk->data + 2, blk->bursts,
+			(((fn + 26 - 7) % 26) >> 2) & 1, blk->codec,
+			blk->codecs, &blk->ul_ft, &blk->ul_cmr,
+			&blk->n_errors, &blk->n_bits_total,
+			&blk->amr_second_conf);
+		break;
+	}
+}
+
+static void tchf_finish_cb(struct trx_ul_block *blk)
+{
+	struct l1sched_trx *l1t = blk->l1t;
+	struct l1sched_chan_state *chan_state = blk->chan_state;
+	uint8_t tn = blk->tn;
+	uint32_t fn = blk->fn;
+	enum trx_chan_type chan = blk->chan;
+	uint8_t rsl_cmode = blk->rsl_cmode;
+	uint8_t tch_mode = blk->tch_mode;
+	uint8_t *tch_data = blk->data;
+	int rc = blk->rc, amr = 0;
+
+	if (rsl_cmode == RSL_CMOD_SPD_SPEECH
+	 && tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		chan_state->ul_ft = blk->ul_ft;
+		chan_state->ul_cmr = blk->ul_cmr;
+		if (rc >= 0 && blk->amr_second_conf >= 0)
+			LOGP(DL1C, LOGL_DEBUG, "AMR frame ending at fn=%u for "
+				"%s decoded with second most likely codec "
+				"mode (confidence %d)\n", fn,
+				trx_chan_desc[chan].name,
+				blk->amr_second_conf);
 		if (rc)
 			trx_loop_amr_input(l1t,
 				trx_chan_desc[chan].chan_nr | tn, chan_state,
-				(float)n_errors/(float)n_bits_total);
+				(float)blk->n_errors/(float)blk->n_bits_total);
 		amr = 2; /* we store tch_data + 2 header bytes */
 		/* only good speech frames get rtp header */
 		if (rc != GSM_MACBLOCK_LEN && rc >= 4) {
@@ -1008,22 +1098,19 @@ int rx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 				chan_state->codec[chan_state->ul_cmr],
 				chan_state->codec[chan_state->ul_ft], 0);
 		}
-		break;
-	default:
-		LOGP(DL1C, LOGL_ERROR, "TCH mode %u invalid, please fix!\n",
-			tch_mode);
-		return -EINVAL;
 	}
-	memcpy(*bursts_p, *bursts_p + 464, 464);
 
 	/* Send uplnk measurement information to L2 */
 	l1if_process_meas_res(l1t->trx, tn, fn, trx_chan_desc[chan].chan_nr|tn,
-		n_errors, n_bits_total, rssi, toa);
+		blk->n_errors, blk->n_bits_total, blk->rssi, blk->toa);
 
 	/* Check if the frame is bad */
 	if (rc < 0) {
 		LOGP(DL1C, LOGL_NOTICE, "Received bad TCH frame ending at "
-			"fn=%u for %s\n", fn, trx_chan_desc[chan].name);
+			"fn=%u for %s (%s, %d/%d bits)\n", fn,
+			trx_chan_desc[chan].name,
+			get_value_string(gsm0503_dec_err_names, -rc),
+			blk->n_errors, blk->n_bits_total);
 		goto bfi;
 	}
 	if (rc < 4) {
@@ -1036,7 +1123,7 @@ int rx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	/* FACCH */
 	if (rc == GSM_MACBLOCK_LEN) {
 		_sched_compose_ph_data_ind(l1t, tn, (fn + GSM_HYPERFRAME - 7) % GSM_HYPERFRAME, chan,
-			tch_data + amr, GSM_MACBLOCK_LEN, rssi, PRES_INFO_UNKNOWN);
+			tch_data + amr, GSM_MACBLOCK_LEN, blk->rssi, PRES_INFO_UNKNOWN);
 bfi:
 		if (rsl_cmode == RSL_CMOD_SPD_SPEECH) {
 			/* indicate bad frame */
@@ -1061,20 +1148,20 @@ bfi:
 			default:
 				LOGP(DL1C, LOGL_ERROR, "TCH mode invalid, "
 					"please fix!\n");
-				return -EINVAL;
+				return;
 			}
 		}
 	}
 
 	if (rsl_cmode != RSL_CMOD_SPD_SPEECH)
-		return 0;
+		return;
 
 	/* TCH or BFI */
-	return _sched_compose_tch_ind(l1t, tn, (fn + GSM_HYPERFRAME - 7) % GSM_HYPERFRAME, chan,
+	_sched_compose_tch_ind(l1t, tn, (fn + GSM_HYPERFRAME - 7) % GSM_HYPERFRAME, chan,
 		tch_data, rc);
 }
 
-int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+int rx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
 	float toa)
 {
@@ -1084,44 +1171,42 @@ int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	uint8_t *mask = &chan_state->ul_mask;
 	uint8_t rsl_cmode = chan_state->rsl_cmode;
 	uint8_t tch_mode = chan_state->tch_mode;
-	uint8_t tch_data[128]; /* just to be safe */
-	int rc, amr = 0;
-	int n_errors, n_bits_total;
+	struct trx_ul_block stack_blk, *blk;
 
 	/* handle rach, if handover rach detection is turned on */
 	if (chan_state->ho_rach_detect == 1)
 		return rx_rach_fn(l1t, tn, fn, chan, bid, bits, rssi, toa);
 
-	LOGP(DL1C, LOGL_DEBUG, "TCH/H received %s fn=%u ts=%u trx=%u bid=%u\n",
+	LOGP(DL1C, LOGL_DEBUG, "TCH/F received %s fn=%u ts=%u trx=%u bid=%u\n", 
 		trx_chan_desc[chan].name, fn, tn, l1t->trx->nr, bid);
 
-	/* alloc burst memory, if not already */
+	/* take burst memory from the slab, if not already */
 	if (!*bursts_p) {
-		*bursts_p = talloc_zero_size(tall_bts_ctx, 696);
+		*bursts_p = _sched_ul_bursts(l1t, tn, chan);
 		if (!*bursts_p)
 			return -ENOMEM;
 	}
 
 	/* clear burst */
 	if (bid == 0) {
-		memset(*bursts_p + 464, 0, 232);
+		memset(*bursts_p + 464, 0, 464);
 		*mask = 0x0;
 	}
 
 	/* update mask */
 	*mask |= (1 << bid);
 
-	/* copy burst to end of buffer of 6 bursts */
+	/* copy burst to end of buffer of 8 bursts */
 	burst = *bursts_p + bid * 116 + 464;
 	memcpy(burst, bits + 3, 58);
 	memcpy(burst + 58, bits + 87, 58);
 
 	/* wait until complete set of bursts */
-	if (bid != 1)
+	if (bid != 3)
 		return 0;
 
 	/* check for complete set of bursts */
-	if ((*mask & 0x3) != 0x3) {
+	if ((*mask & 0xf) != 0xf) {
 		LOGP(DL1C, LOGL_NOTICE, "Received incomplete TCH frame ending "
 			"at fn=%u (%u/%u) for %s\n", fn,
 			fn % l1ts->mf_period, l1ts->mf_period,
@@ -1129,41 +1214,101 @@ int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 	}
 	*mask = 0x0;
 
-	/* skip second of two TCH frames of FACCH was received */
-	if (chan_state->ul_ongoing_facch) {
-		chan_state->ul_ongoing_facch = 0;
-		memcpy(*bursts_p, *bursts_p + 232, 232);
-		memcpy(*bursts_p + 232, *bursts_p + 464, 232);
-		goto bfi;
+	switch ((rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
+								: tch_mode) {
+	case GSM48_CMODE_SPEECH_V1: /* FR */
+	case GSM48_CMODE_SPEECH_EFR: /* EFR */
+	case GSM48_CMODE_SPEECH_AMR: /* AMR */
+		break;
+	default:
+		LOGP(DL1C, LOGL_ERROR, "TCH mode %u invalid, please fix!\n",
+			tch_mode);
+		return -EINVAL;
 	}
 
-	/* decode
+	/* decode, the AMR state depends on the previous frame
 	 * also shift buffer by 4 bursts for interleaving */
-	switch ((rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
-								: tch_mode) {
+	blk = trx_ul_pool_get(chan_state, &stack_blk);
+	blk->decode = tchf_decode_cb;
+	blk->finish = tchf_finish_cb;
+	blk->l1t = l1t;
+	blk->chan_state = chan_state;
+	blk->tn = tn;
+	blk->fn = fn;
+	blk->chan = chan;
+	blk->rssi = rssi;
+	blk->toa = toa;
+	tch_block_set_mode(blk, chan_state);
+	memcpy(blk->bursts, *bursts_p, 928);
+	memcpy(*bursts_p, *bursts_p + 464, 464);
+	trx_ul_pool_run(blk);
+
+	return 0;
+}
+
+static void tchh_decode_cb(struct trx_ul_block *blk)
+{
+	uint32_t fn = blk->fn;
+
+	if (blk->skip)
+		return;
+
+	switch ((blk->rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
+							: blk->tch_mode) {
 	case GSM48_CMODE_SPEECH_V1: /* HR or signalling */
 		/* Note on FN-10: If we are at FN 10, we decoded an even aligned
 		 * TCH/FACCH frame, because our burst buffer carries 6 bursts.
 		 * Even FN ending at: 10,11,19,20,2,3
 		 */
-		rc = tch_hr_decode(tch_data, *bursts_p,
+		blk->rc = tch_hr_decode(blk->data, blk->bursts,
 			(((fn + 26 - 10) % 26) >> 2) & 1,
-			&n_errors, &n_bits_total);
+			&blk->n_errors, &blk->n_bits_total);
 		break;
 	case GSM48_CMODE_SPEECH_AMR: /* AMR */
 		/* the first FN 0,8,17 or 1,9,18 defines that CMI is included
 		 * in frame, the first FN 4,13,21 or 5,14,22 defines that CMR
 		 * is included in frame.
 		 */
-		rc = tch_ahs_decode(tch_data + 2, *bursts_p,
+		blk->rc = tch_ahs_decode(blk->data + 2, blk->bursts,
 			(((fn + 26 - 10) % 26) >> 2) & 1,
-			(((fn + 26 - 10) % 26) >> 2) & 1, chan_state->codec,
-			chan_state->codecs, &chan_state->ul_ft,
-			&chan_state->ul_cmr, &n_errors, &n_bits_total);
+			(((fn + 26 - 10) % 26) >> 2) & 1, blk->codec,
+			blk->codecs, &blk->ul_ft, &blk->ul_cmr,
+			&blk->n_errors, &blk->n_bits_total,
+			&blk->amr_second_conf);
+		break;
+	}
+}
+
+static void tchh_finish_cb(struct trx_ul_block *blk)
+{
+	struct l1sched_trx *l1t = blk->l1t;
+	struct l1sched_chan_state *chan_state = blk->chan_state;
+	uint8_t tn = blk->tn;
+	uint32_t fn = blk->fn;
+	enum trx_chan_type chan = blk->chan;
+	uint8_t rsl_cmode = blk->rsl_cmode;
+	uint8_t tch_mode = blk->tch_mode;
+	uint8_t *tch_data = blk->data;
+	int rc = blk->rc, amr = 0;
+
+	/* skip second of two TCH frames of FACCH was received */
+	if (blk->skip)
+		goto bfi;
+
+	if (rsl_cmode == RSL_CMOD_SPD_SPEECH
+	 && tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		chan_state->ul_ft = blk->ul_ft;
+		chan_state->ul_cmr = blk->ul_cmr;
+		if (rc >= 0 && blk->amr_second_conf >= 0)
+			LOGP(DL1C, LOGL_DEBUG, "AMR frame ending at fn=%u for "
+				"%s decoded with second most likely codec "
+				"mode (confidence %d)\n", fn,
+				trx_chan_desc[chan].name,
+				blk->amr_second_conf);
 		if (rc)
 			trx_loop_amr_input(l1t,
 				trx_chan_desc[chan].chan_nr | tn, chan_state,
-				(float)n_errors/(float)n_bits_total);
+				(float)blk->n_errors/(float)blk->n_bits_total);
 		amr = 2; /* we store tch_data + 2 two */
 		/* only good speech frames get rtp header */
 		if (rc != GSM_MACBLOCK_LEN && rc >= 4) {
@@ -1171,23 +1316,19 @@ int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 				chan_state->codec[chan_state->ul_cmr],
 				chan_state->codec[chan_state->ul_ft], 0);
 		}
-		break;
-	default:
-		LOGP(DL1C, LOGL_ERROR, "TCH mode %u invalid, please fix!\n",
-			tch_mode);
-		return -EINVAL;
 	}
-	memcpy(*bursts_p, *bursts_p + 232, 232);
-	memcpy(*bursts_p + 232, *bursts_p + 464, 232);
 
 	/* Send uplnk measurement information to L2 */
 	l1if_process_meas_res(l1t->trx, tn, fn, trx_chan_desc[chan].chan_nr|tn,
-		n_errors, n_bits_total, rssi, toa);
+		blk->n_errors, blk->n_bits_total, blk->rssi, blk->toa);
 
 	/* Check if the frame is bad */
 	if (rc < 0) {
 		LOGP(DL1C, LOGL_NOTICE, "Received bad TCH frame ending at "
-			"fn=%u for %s\n", fn, trx_chan_desc[chan].name);
+			"fn=%u for %s (%s, %d/%d bits)\n", fn,
+			trx_chan_desc[chan].name,
+			get_value_string(gsm0503_dec_err_names, -rc),
+			blk->n_errors, blk->n_bits_total);
 		goto bfi;
 	}
 	if (rc < 4) {
@@ -1202,7 +1343,7 @@ int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
 		chan_state->ul_ongoing_facch = 1;
 		_sched_compose_ph_data_ind(l1t, tn,
 			(fn + GSM_HYPERFRAME - 10 - ((fn % 26) >= 19)) % GSM_HYPERFRAME, chan,
-			tch_data + amr, GSM_MACBLOCK_LEN, rssi, PRES_INFO_UNKNOWN);
+			tch_data + amr, GSM_MACBLOCK_LEN, blk->rssi, PRES_INFO_UNKNOWN);
 bfi:
 		if (rsl_cmode == RSL_CMOD_SPD_SPEECH) {
 			/* indicate bad frame */
@@ -1224,13 +1365,13 @@ bfi:
 			default:
 				LOGP(DL1C, LOGL_ERROR, "TCH mode invalid, "
 					"please fix!\n");
-				return -EINVAL;
+				return;
 			}
 		}
 	}
 
 	if (rsl_cmode != RSL_CMOD_SPD_SPEECH)
-		return 0;
+		return;
 
 	/* TCH or BFI */
 	/* Note on FN 19 or 20: If we received the last burst of a frame,
@@ -1238,13 +1379,103 @@ bfi:
 	 * with the slot 12, so an extra FN must be substracted to get correct
 	 * start of frame.
 	 */
-	return _sched_compose_tch_ind(l1t, tn,
+	_sched_compose_tch_ind(l1t, tn,
 		(fn + GSM_HYPERFRAME - 10 - ((fn%26)==19) - ((fn%26)==20)) % GSM_HYPERFRAME,
 		chan, tch_data, rc);
 }
 
+int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{
+	struct l1sched_ts *l1ts = l1sched_trx_get_ts(l1t, tn);
+	struct l1sched_chan_state *chan_state = &l1ts->chan_state[chan];
+	sbit_t *burst, **bursts_p = &chan_state->ul_bursts;
+	uint8_t *mask = &chan_state->ul_mask;
+	uint8_t rsl_cmode = chan_state->rsl_cmode;
+	uint8_t tch_mode = chan_state->tch_mode;
+	struct trx_ul_block stack_blk, *blk;
+
+	/* handle rach, if handover rach detection is turned on */
+	if (chan_state->ho_rach_detect == 1)
+		return rx_rach_fn(l1t, tn, fn, chan, bid, bits, rssi, toa);
+
+	LOGP(DL1C, LOGL_DEBUG, "TCH/H received %s fn=%u ts=%u trx=%u bid=%u\n",
+		trx_chan_desc[chan].name, fn, tn, l1t->trx->nr, bid);
+
+	/* take burst memory from the slab, if not already */
+	if (!*bursts_p) {
+		*bursts_p = _sched_ul_bursts(l1t, tn, chan);
+		if (!*bursts_p)
+			return -ENOMEM;
+	}
+
+	/* clear burst */
+	if (bid == 0) {
+		memset(*bursts_p + 464, 0, 232);
+		*mask = 0x0;
+	}
+
+	/* update mask */
+	*mask |= (1 << bid);
+
+	/* copy burst to end of buffer of 6 bursts */
+	burst = *bursts_p + bid * 116 + 464;
+	memcpy(burst, bits + 3, 58);
+	memcpy(burst + 58, bits + 87, 58);
+
+	/* wait until complete set of bursts */
+	if (bid != 1)
+		return 0;
+
+	/* check for complete set of bursts */
+	if ((*mask & 0x3) != 0x3) {
+		LOGP(DL1C, LOGL_NOTICE, "Received incomplete TCH frame ending "
+			"at fn=%u (%u/%u) for %s\n", fn,
+			fn % l1ts->mf_period, l1ts->mf_period,
+			trx_chan_desc[chan].name);
+	}
+	*mask = 0x0;
+
+	switch ((rsl_cmode != RSL_CMOD_SPD_SPEECH) ? GSM48_CMODE_SPEECH_V1
+								: tch_mode) {
+	case GSM48_CMODE_SPEECH_V1: /* HR or signalling */
+	case GSM48_CMODE_SPEECH_AMR: /* AMR */
+		break;
+	default:
+		LOGP(DL1C, LOGL_ERROR, "TCH mode %u invalid, please fix!\n",
+			tch_mode);
+		return -EINVAL;
+	}
+
+	/* decode, the AMR and FACCH state depends on the previous frame
+	 * also shift buffer by 4 bursts for interleaving */
+	blk = trx_ul_pool_get(chan_state, &stack_blk);
+	blk->decode = tchh_decode_cb;
+	blk->finish = tchh_finish_cb;
+	blk->l1t = l1t;
+	blk->chan_state = chan_state;
+	blk->tn = tn;
+	blk->fn = fn;
+	blk->chan = chan;
+	blk->rssi = rssi;
+	blk->toa = toa;
+	tch_block_set_mode(blk, chan_state);
+
+	/* skip second of two TCH frames of FACCH was received */
+	blk->skip = chan_state->ul_ongoing_facch;
+	chan_state->ul_ongoing_facch = 0;
+
+	memcpy(blk->bursts, *bursts_p, 696);
+	memcpy(*bursts_p, *bursts_p + 232, 232);
+	memcpy(*bursts_p + 232, *bursts_p + 464, 232);
+	trx_ul_pool_run(blk);
+
+	return 0;
+}
+
 /* schedule all frames of all TRX for given FN */
-static int trx_sched_fn(struct gsm_bts *bts, uint32_t fn)
+int trx_sched_fn(struct gsm_bts *bts, uint32_t fn)
 {
 	struct gsm_bts_trx *trx;
 	uint8_t tn;
@@ -1283,174 +1514,10 @@ static int trx_sched_fn(struct gsm_bts *bts, uint32_t fn)
 				gain = 0;
 			trx_if_data(l1h, tn, fn, gain, bits);
 		}
-	}
-
-	return 0;
-}
-
 
-/*
- * frame clock
- */
-
-#define FRAME_DURATION_uS	4615
-#define MAX_FN_SKEW		50
-#define TRX_LOSS_FRAMES		400
-
-extern int quit;
-/* this timer fires for every FN to be processed */
-static void trx_ctrl_timer_cb(void *data)
-{
-	struct gsm_bts *bts = data;
-	struct timeval tv_now, *tv_clock = &transceiver_clock_tv;
-	int32_t elapsed;
-
-	/* check if transceiver is still alive */
-	if (transceiver_lost++ == TRX_LOSS_FRAMES) {
-		struct gsm_bts_trx *trx;
-
-		LOGP(DL1C, LOGL_NOTICE, "No more clock from transceiver\n");
-
-no_clock:
-		transceiver_available = 0;
-
-		/* flush pending messages of transceiver */
-		/* close all logical channels and reset timeslots */
-		llist_for_each_entry(trx, &bts->trx_list, list) {
-			struct phy_instance *pinst = trx_phy_instance(trx);
-			struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
-			trx_if_flush(l1h);
-			trx_sched_reset(&l1h->l1s);
-			if (trx->nr == 0)
-				trx_if_cmd_poweroff(l1h);
-		}
-
-		/* tell BSC */
-		check_transceiver_availability(bts, 0);
-
-		return;
-	}
-
-	gettimeofday(&tv_now, NULL);
-
-	elapsed = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-		+ (tv_now.tv_usec - tv_clock->tv_usec);
-
-	/* if someone played with clock, or if the process stalled */
-	if (elapsed > FRAME_DURATION_uS * MAX_FN_SKEW || elapsed < 0) {
-		LOGP(DL1C, LOGL_NOTICE, "PC clock skew: elapsed uS %d\n",
-			elapsed);
-		goto no_clock;
-	}
-
-	/* schedule next FN clock */
-	while (elapsed > FRAME_DURATION_uS / 2) {
-		tv_clock->tv_usec += FRAME_DURATION_uS;
-		if (tv_clock->tv_usec >= 1000000) {
-			tv_clock->tv_sec++;
-			tv_clock->tv_usec -= 1000000;
-		}
-		transceiver_last_fn = (transceiver_last_fn + 1) % GSM_HYPERFRAME;
-		trx_sched_fn(bts, transceiver_last_fn);
-		elapsed -= FRAME_DURATION_uS;
+		/* send all bursts of this FN at once */
+		trx_if_data_flush(l1h);
 	}
-	osmo_timer_schedule(&transceiver_clock_timer, 0,
-		FRAME_DURATION_uS - elapsed);
-}
-
-
-/* receive clock from transceiver */
-int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
-{
-	struct timeval tv_now, *tv_clock = &transceiver_clock_tv;
-	int32_t elapsed;
-	int32_t elapsed_fn;
-
-	if (quit)
-		return 0;
-
-	/* reset lost counter */
-	transceiver_lost = 0;
-
-	gettimeofday(&tv_now, NULL);
-
-	/* clock becomes valid */
-	if (!transceiver_available) {
-		LOGP(DL1C, LOGL_NOTICE, "initial GSM clock received: fn=%u\n",
-			fn);
-
-		transceiver_available = 1;
-
-		/* start provisioning transceiver */
-		l1if_provision_transceiver(bts);
-
-		/* tell BSC */
-		check_transceiver_availability(bts, 1);
-
-new_clock:
-		transceiver_last_fn = fn;
-		trx_sched_fn(bts, transceiver_last_fn);
-
-		/* schedule first FN clock */
-		memcpy(tv_clock, &tv_now, sizeof(struct timeval));
-		memset(&transceiver_clock_timer, 0,
-			sizeof(transceiver_clock_timer));
-		transceiver_clock_timer.cb = trx_ctrl_timer_cb;
-	        transceiver_clock_timer.data = bts;
-		osmo_timer_schedule(&transceiver_clock_timer, 0,
-			FRAME_DURATION_uS);
-
-		return 0;
-	}
-
-	osmo_timer_del(&transceiver_clock_timer);
-
-	/* calculate elapsed time since last_fn */
-	elapsed = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-		+ (tv_now.tv_usec - tv_clock->tv_usec);
-
-	/* how much frames have been elapsed since last fn processed */
-	elapsed_fn = (fn + GSM_HYPERFRAME - transceiver_last_fn) % GSM_HYPERFRAME;
-	if (elapsed_fn >= 135774)
-		elapsed_fn -= GSM_HYPERFRAME;
-
-	/* check for max clock skew */
-	if (elapsed_fn > MAX_FN_SKEW || elapsed_fn < -MAX_FN_SKEW) {
-		LOGP(DL1C, LOGL_NOTICE, "GSM clock skew: old fn=%u, "
-			"new fn=%u\n", transceiver_last_fn, fn);
-		goto new_clock;
-	}
-
-	LOGP(DL1C, LOGL_INFO, "GSM clock jitter: %d\n",
-		elapsed_fn * FRAME_DURATION_uS - elapsed);
-
-	/* too many frames have been processed already */
-	if (elapsed_fn < 0) {
-		/* set clock to the time or last FN should have been
-		 * transmitted. */
-		tv_clock->tv_sec = tv_now.tv_sec;
-		tv_clock->tv_usec = tv_now.tv_usec +
-			(0 - elapsed_fn) * FRAME_DURATION_uS;
-		if (tv_clock->tv_usec >= 1000000) {
-			tv_clock->tv_sec++;
-			tv_clock->tv_usec -= 1000000;
-		}
-		/* set time to the time our next FN has to be transmitted */
-		osmo_timer_schedule(&transceiver_clock_timer, 0,
-			FRAME_DURATION_uS * (1 - elapsed_fn));
-
-		return 0;
-	}
-
-	/* transmit what we still need to transmit */
-	while (fn != transceiver_last_fn) {
-		transceiver_last_fn = (transceiver_last_fn + 1) % GSM_HYPERFRAME;
-		trx_sched_fn(bts, transceiver_last_fn);
-	}
-
-	/* schedule next FN to be transmitted */
-	memcpy(tv_clock, &tv_now, sizeof(struct timeval));
-	osmo_timer_schedule(&transceiver_clock_timer, 0, FRAME_DURATION_uS);
 
 	return 0;
 }
@@ -0,0 +1,384 @@
+/* GSM frame clock for OsmoBTS-TRX */
+
+/* (C) 2013 by Andreas Eversberg <jolly@eversberg.eu>
+ * (C) 2015 by Alexander Chemeris <Alexander.Chemeris@fairwaves.co>
+ * (C) 2015 by Harald Welte <laforge@gnumonks.org>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The frame clock runs from a timerfd on CLOCK_MONOTONIC, so that steps of
+ * the wall clock (NTP, date) do not disturb it.  Each FN has a due time on
+ * the monotonic clock, and the timer is armed to the absolute due time of
+ * the next FN.
+ *
+ * The transceiver indicates its current FN every now and then.  At each
+ * indication, the difference between the time the FN was expected on the
+ * local clock and the time the indication arrived is the phase error.  A
+ * proportional-integral loop takes a part of the phase error out and
+ * corrects the frame period by a small amount, so that the local clock
+ * follows the rate of the transceiver without jumping with every jittery
+ * indication.  Only a phase error of more than a frame re-synchronizes
+ * the clock hard, as before.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/linuxlist.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/scheduler.h>
+
+#include "l1_if.h"
+#include "trx_if.h"
+#include "trx_ul_pool.h"
+#include "trx_clock.h"
+
+#define MAX_FN_SKEW		50
+#define TRX_LOSS_FRAMES		400
+
+/* loop gains, as shift: take 1/4 of the phase error out at once and
+ * correct the period by 1/32 of the phase error per frame */
+#define PLL_KP_SHIFT		2
+#define PLL_KI_SHIFT		5
+/* limit of the frequency correction, in ppm */
+#define PLL_MAX_PPM		200
+
+const uint32_t trx_clock_late_bins_us[TRX_CLOCK_LATE_BINS - 1] = {
+	50, 100, 200, 500, 1000, 2000, FRAME_DURATION_uS,
+};
+
+/* clock states */
+static uint32_t transceiver_lost;
+uint32_t transceiver_last_fn;
+
+static struct {
+	struct osmo_fd ofd;		/* timerfd on CLOCK_MONOTONIC */
+	struct gsm_bts *bts;
+	int64_t due_ns;			/* time transceiver_last_fn was due */
+	int64_t due_ps;			/* sub-ns part of due_ns */
+	int64_t period_ps;		/* current frame period */
+	struct trx_clock_stats stats;
+} clk = {
+	.ofd = { .fd = -1 },
+	.period_ps = FRAME_DURATION_pS,
+};
+
+static int64_t clock_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* time at which the FN 'frames' after transceiver_last_fn is due */
+static int64_t clock_due_ns(int32_t frames)
+{
+	return clk.due_ns + (clk.due_ps + frames * clk.period_ps) / 1000;
+}
+
+static void clock_advance(void)
+{
+	clk.due_ps += clk.period_ps;
+	clk.due_ns += clk.due_ps / 1000;
+	clk.due_ps %= 1000;
+}
+
+static void clock_arm(int64_t when_ns)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = when_ns / 1000000000LL;
+	its.it_value.tv_nsec = when_ns % 1000000000LL;
+	timerfd_settime(clk.ofd.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void clock_disarm(void)
+{
+	struct itimerspec its;
+
+	if (clk.ofd.fd < 0)
+		return;
+	memset(&its, 0, sizeof(its));
+	timerfd_settime(clk.ofd.fd, 0, &its, NULL);
+}
+
+static void clock_stats_frame(int64_t late_ns, int64_t proc_ns)
+{
+	struct trx_clock_stats *st = &clk.stats;
+	uint32_t late_us = (late_ns > 0) ? late_ns / 1000 : 0;
+	uint32_t proc_us = (proc_ns > 0) ? proc_ns / 1000 : 0;
+	int i;
+
+	for (i = 0; i < TRX_CLOCK_LATE_BINS - 1; i++) {
+		if (late_us < trx_clock_late_bins_us[i])
+			break;
+	}
+	st->late_hist[i]++;
+	st->frames++;
+	st->late_sum_us += late_us;
+	st->late_sqsum_us += (uint64_t)late_us * late_us;
+	if (late_us > st->late_max_us)
+		st->late_max_us = late_us;
+	st->proc_sum_us += proc_us;
+	if (proc_us > st->proc_max_us)
+		st->proc_max_us = proc_us;
+}
+
+/* process all FN that are due, then arm the timer for the next one */
+static void clock_tick(int64_t now)
+{
+	int64_t due, done;
+
+	while ((due = clock_due_ns(1)) <= now) {
+		clock_advance();
+		transceiver_last_fn = (transceiver_last_fn + 1) % GSM_HYPERFRAME;
+		trx_sched_fn(clk.bts, transceiver_last_fn);
+		done = clock_now_ns();
+		clock_stats_frame(now - due, done - now);
+		now = done;
+	}
+	clock_arm(due);
+}
+
+static void clock_lost(struct gsm_bts *bts)
+{
+	struct gsm_bts_trx *trx;
+
+	transceiver_available = 0;
+	clock_disarm();
+
+	/* flush pending messages of transceiver */
+	/* close all logical channels and reset timeslots */
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		struct phy_instance *pinst = trx_phy_instance(trx);
+		struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
+		trx_if_flush(l1h);
+		trx_ul_pool_flush();
+		trx_sched_reset(&l1h->l1s);
+		if (trx->nr == 0)
+			trx_if_cmd_poweroff(l1h);
+	}
+
+	/* tell BSC */
+	check_transceiver_availability(bts, 0);
+}
+
+/* the timer fires for every FN to be processed */
+static int trx_clock_timer_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct gsm_bts *bts = clk.bts;
+	uint64_t expired;
+	int64_t now, late;
+
+	if (read(ofd->fd, &expired, sizeof(expired)) < 0 && errno == EAGAIN)
+		return 0;
+
+	/* check if transceiver is still alive */
+	if (transceiver_lost++ == TRX_LOSS_FRAMES) {
+		LOGP(DL1C, LOGL_NOTICE, "No more clock from transceiver\n");
+		clock_lost(bts);
+		return 0;
+	}
+
+	now = clock_now_ns();
+	late = now - clock_due_ns(1);
+
+	/* the monotonic clock does not step, so the process stalled */
+	if (late > (int64_t)FRAME_DURATION_uS * 1000 * MAX_FN_SKEW) {
+		LOGP(DL1C, LOGL_NOTICE, "PC clock skew: process stalled for "
+			"%d uS\n", (int)(late / 1000));
+		clock_lost(bts);
+		return 0;
+	}
+
+	clock_tick(now);
+
+	return 0;
+}
+
+static int clock_open(void)
+{
+	int fd;
+
+	if (clk.ofd.fd >= 0)
+		return 0;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		LOGP(DL1C, LOGL_FATAL, "Cannot create frame clock timer: %s\n",
+			strerror(errno));
+		return -errno;
+	}
+	clk.ofd.fd = fd;
+	clk.ofd.when = BSC_FD_READ;
+	clk.ofd.cb = trx_clock_timer_cb;
+	clk.ofd.data = NULL;
+	clk.ofd.priv_nr = 0;
+	osmo_fd_register(&clk.ofd);
+
+	return 0;
+}
+
+/* adjust phase and frequency of the local clock by the phase error at a
+ * CLK indication */
+static void clock_lock(int64_t err_ns, int32_t frames)
+{
+	struct trx_clock_stats *st = &clk.stats;
+	int64_t max_ps = FRAME_DURATION_pS / 1000000 * PLL_MAX_PPM;
+	int64_t abs_us = ((err_ns < 0) ? -err_ns : err_ns) / 1000;
+
+	st->clk_err_last_us = err_ns / 1000;
+	if (abs_us > st->clk_err_max_us)
+		st->clk_err_max_us = abs_us;
+	st->clk_err_sqsum_us += abs_us * abs_us;
+
+	clk.due_ns += err_ns >> PLL_KP_SHIFT;
+
+	if (frames < 1)
+		frames = 1;
+	clk.period_ps += (err_ns * 1000 / frames) >> PLL_KI_SHIFT;
+	if (clk.period_ps > FRAME_DURATION_pS + max_ps)
+		clk.period_ps = FRAME_DURATION_pS + max_ps;
+	if (clk.period_ps < FRAME_DURATION_pS - max_ps)
+		clk.period_ps = FRAME_DURATION_pS - max_ps;
+}
+
+extern int quit;
+/* receive clock from transceiver */
+int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
+{
+	static uint32_t last_ind_fn;
+	int64_t now, err;
+	int32_t elapsed_fn;
+
+	if (quit)
+		return 0;
+
+	/* reset lost counter */
+	transceiver_lost = 0;
+
+	now = clock_now_ns();
+	clk.stats.clk_inds++;
+
+	/* clock becomes valid */
+	if (!transceiver_available) {
+		LOGP(DL1C, LOGL_NOTICE, "initial GSM clock received: fn=%u\n",
+			fn);
+
+		if (clock_open() < 0)
+			return -EIO;
+
+		transceiver_available = 1;
+
+		/* start provisioning transceiver */
+		l1if_provision_transceiver(bts);
+
+		/* tell BSC */
+		check_transceiver_availability(bts, 1);
+
+new_clock:
+		clk.bts = bts;
+		clk.period_ps = FRAME_DURATION_pS;
+		transceiver_last_fn = fn;
+		trx_sched_fn(bts, transceiver_last_fn);
+
+		/* schedule first FN clock */
+		clk.due_ns = now;
+		clk.due_ps = 0;
+		last_ind_fn = fn;
+		clock_arm(clock_due_ns(1));
+
+		return 0;
+	}
+
+	/* how much frames have been elapsed since last fn processed */
+	elapsed_fn = (fn + GSM_HYPERFRAME - transceiver_last_fn) % GSM_HYPERFRAME;
+	if (elapsed_fn >= 135774)
+		elapsed_fn -= GSM_HYPERFRAME;
+
+	/* check for max clock skew */
+	if (elapsed_fn > MAX_FN_SKEW || elapsed_fn < -MAX_FN_SKEW) {
+		LOGP(DL1C, LOGL_NOTICE, "GSM clock skew: old fn=%u, "
+			"new fn=%u\n", transceiver_last_fn, fn);
+		clk.stats.clk_resyncs++;
+		goto new_clock;
+	}
+
+	/* phase error: when the indicated FN arrived, compared to when it
+	 * is due on the local clock */
+	err = now - clock_due_ns(elapsed_fn);
+
+	LOGP(DL1C, LOGL_INFO, "GSM clock jitter: %d\n", (int)(err / 1000));
+
+	if (err > (int64_t)FRAME_DURATION_uS * 1000
+	 || err < -(int64_t)FRAME_DURATION_uS * 1000) {
+		/* too far off, set the clock to the time the indicated FN
+		 * arrived. if we processed too many frames already, the next
+		 * one is delayed accordingly, otherwise the missing ones are
+		 * transmitted at once. */
+		clk.stats.clk_resyncs++;
+		clk.due_ns += err;
+	} else {
+		/* the indications come at irregular intervals, so the
+		 * frequency correction is scaled by the interval */
+		clock_lock(err, (fn + GSM_HYPERFRAME - last_ind_fn)
+			% GSM_HYPERFRAME);
+	}
+	last_ind_fn = fn;
+
+	clock_tick(now);
+
+	return 0;
+}
+
+int64_t trx_clock_period_ps(void)
+{
+	return clk.period_ps;
+}
+
+const struct trx_clock_stats *trx_clock_get_stats(void)
+{
+	return &clk.stats;
+}
+
+uint32_t trx_clock_isqrt(uint64_t x)
+{
+	uint64_t r = 0, b = 1ULL << 62;
+
+	while (b > x)
+		b >>= 2;
+	while (b) {
+		if (x >= r + b) {
+			x -= r + b;
+			r = (r >> 1) + b;
+		} else
+			r >>= 1;
+		b >>= 2;
+	}
+	return r;
+}
@@ -0,0 +1,46 @@
+#ifndef TRX_CLOCK_H
+#define TRX_CLOCK_H
+
+#include <stdint.h>
+
+struct gsm_bts;
+
+/* nominal duration of a TDMA frame: 120ms / 26 */
+#define FRAME_DURATION_pS	4615384615LL
+#define FRAME_DURATION_uS	4615
+
+/* number of buckets in the lateness histogram */
+#define TRX_CLOCK_LATE_BINS	8
+
+/* upper limits of the lateness buckets in us, the last bucket is open */
+extern const uint32_t trx_clock_late_bins_us[TRX_CLOCK_LATE_BINS - 1];
+
+struct trx_clock_stats {
+	/* scheduling of frames, relative to the time they are due */
+	uint32_t frames;		/* FN processed */
+	uint32_t late_hist[TRX_CLOCK_LATE_BINS];
+	uint64_t late_sum_us;
+	uint64_t late_sqsum_us;
+	uint32_t late_max_us;
+
+	/* time spent in processing one FN for all TRX */
+	uint64_t proc_sum_us;
+	uint32_t proc_max_us;
+
+	/* phase error of the local clock at CLK indications */
+	uint32_t clk_inds;		/* CLK indications received */
+	uint32_t clk_resyncs;		/* hard re-synchronizations */
+	int32_t clk_err_last_us;
+	uint32_t clk_err_max_us;
+	uint64_t clk_err_sqsum_us;
+};
+
+/* current frame period of the local clock, as locked to the transceiver */
+int64_t trx_clock_period_ps(void);
+const struct trx_clock_stats *trx_clock_get_stats(void);
+uint32_t trx_clock_isqrt(uint64_t x);
+
+/* provided by scheduler_trx.c: schedule all frames of all TRX for FN */
+int trx_sched_fn(struct gsm_bts *bts, uint32_t fn);
+
+#endif /* TRX_CLOCK_H */
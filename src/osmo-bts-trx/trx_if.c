@@ -39,9 +39,11 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/udp_batch.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
+#include "trx_ul_pool.h"
 
 /* enable to print RSSI level graph */
 //#define TOA_RSSI_DEBUG
@@ -403,11 +405,11 @@ rsp_error:
  * data
  */
 
-static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
+/* number of bursts to send / receive with one system call */
+#define TRX_DATA_BATCH	16
+
+static int trx_data_rx_burst(struct trx_l1h *l1h, const uint8_t *buf, int len)
 {
-	struct trx_l1h *l1h = ofd->data;
-	uint8_t buf[256];
-	int len;
 	uint8_t tn;
 	int8_t rssi;
 	float toa = 0.0;
@@ -415,9 +417,6 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 	sbit_t bits[148];
 	int i;
 
-	len = recv(ofd->fd, buf, sizeof(buf), 0);
-	if (len <= 0)
-		return len;
 	if (len != 158) {
 		LOGP(DTRX, LOGL_NOTICE, "Got data message with invalid lenght "
 			"'%d'\n", len);
@@ -462,13 +461,51 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 	return 0;
 }
 
+/* drain all bursts pending on the data socket */
+static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trx_l1h *l1h = ofd->data;
+	struct udp_batch *b = l1h->data_rx;
+	unsigned int i, len;
+	uint8_t *buf;
+	int rc;
+
+	do {
+		rc = udp_batch_recv(b, ofd->fd);
+		if (rc < 0)
+			return rc;
+		for (i = 0; i < b->num; i++) {
+			buf = udp_batch_rx_buf(b, i, &len);
+			trx_data_rx_burst(l1h, buf, len);
+		}
+	} while (b->num == b->size);
+
+	return 0;
+}
+
+/* queue a burst for transmission, see trx_if_data_flush() */
 int trx_if_data(struct trx_l1h *l1h, uint8_t tn, uint32_t fn, uint8_t pwr,
 	const ubit_t *bits)
 {
-	uint8_t buf[256];
+	struct phy_link *plink = l1h->phy_inst->phy_link;
+	uint8_t *buf;
 
 	LOGP(DTRX, LOGL_DEBUG, "TX burst tn=%u fn=%u pwr=%u\n", tn, fn, pwr);
 
+	/* we must be sure that we have clock, and we have sent all control
+	 * data */
+	if (!transceiver_available || !llist_empty(&l1h->trx_ctrl_list)) {
+		LOGP(DTRX, LOGL_DEBUG, "Ignoring TX data, transceiver "
+			"offline.\n");
+		return 0;
+	}
+
+	buf = udp_batch_tx_buf(l1h->data_tx);
+	if (!buf) {
+		trx_if_data_flush(l1h);
+		buf = udp_batch_tx_buf(l1h->data_tx);
+	}
+
 	buf[0] = tn;
 	buf[1] = (fn >> 24) & 0xff;
 	buf[2] = (fn >> 16) & 0xff;
@@ -476,20 +513,35 @@ int trx_if_data(struct trx_l1h *l1h, uint8_t tn, uint32_t fn, uint8_t pwr,
 	buf[4] = (fn >>  0) & 0xff;
 	buf[5] = pwr;
 
-	/* copy ubits {0,1} */
-	memcpy(buf + 6, bits, 148);
-
-	/* we must be sure that we have clock, and we have sent all control
-	 * data */
-	if (transceiver_available && llist_empty(&l1h->trx_ctrl_list)) {
-		send(l1h->trx_ofd_data.fd, buf, 154, 0);
-	} else
-		LOGP(DTRX, LOGL_DEBUG, "Ignoring TX data, transceiver "
-			"offline.\n");
+	if (plink->u.osmotrx.tx_packed) {
+		/* pack bits, MSB first */
+		osmo_ubit2pbit(buf + 6, bits, 148);
+		udp_batch_tx_commit(l1h->data_tx, 6 + 19);
+	} else {
+		/* copy ubits {0,1} */
+		memcpy(buf + 6, bits, 148);
+		udp_batch_tx_commit(l1h->data_tx, 154);
+	}
 
 	return 0;
 }
 
+/* send all bursts queued by trx_if_data() with one system call */
+int trx_if_data_flush(struct trx_l1h *l1h)
+{
+	int rc;
+
+	if (!l1h->data_tx || !l1h->data_tx->num)
+		return 0;
+
+	rc = udp_batch_send(l1h->data_tx, l1h->trx_ofd_data.fd);
+	if (rc < 0)
+		LOGP(DTRX, LOGL_NOTICE, "Failed to send TX data: %s\n",
+			strerror(-rc));
+
+	return rc;
+}
+
 
 /*
  * open/close
@@ -519,6 +571,10 @@ int bts_model_phy_link_open(struct phy_link *plink)
 		if (!pinst->u.osmotrx.hdl)
 			goto cleanup;
 	}
+	/* start the UL decoder threads, shared by all PHY links */
+	if (plink->u.osmotrx.ul_decode_threads && !trx_ul_pool_threads())
+		trx_ul_pool_start(plink->u.osmotrx.ul_decode_threads);
+
 	/* FIXME: is there better way to check/report TRX availability? */
 	transceiver_available = 1;
 	phy_link_state_set(plink, PHY_LINK_CONNECTED);
@@ -562,6 +618,14 @@ int trx_if_open(struct trx_l1h *l1h)
 	/* initialize ctrl queue */
 	INIT_LLIST_HEAD(&l1h->trx_ctrl_list);
 
+	/* allocate data batches */
+	l1h->data_tx = udp_batch_alloc(l1h, TRX_DATA_BATCH, 154);
+	l1h->data_rx = udp_batch_alloc(l1h, TRX_DATA_BATCH, 256);
+	if (!l1h->data_tx || !l1h->data_rx) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
 	/* open sockets */
 	rc = trx_udp_open(l1h, &l1h->trx_ofd_ctrl,
 			  plink->u.osmotrx.transceiver_ip,
@@ -615,6 +679,12 @@ void trx_if_close(struct trx_l1h *l1h)
 	/* close sockets */
 	trx_udp_close(&l1h->trx_ofd_ctrl);
 	trx_udp_close(&l1h->trx_ofd_data);
+
+	/* free data batches */
+	talloc_free(l1h->data_tx);
+	l1h->data_tx = NULL;
+	talloc_free(l1h->data_rx);
+	l1h->data_rx = NULL;
 }
 
 int trx_if_powered(struct trx_l1h *l1h)
@@ -0,0 +1,336 @@
+/* Uplink block decoder thread pool for OsmoBTS-TRX */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The channel decoders (de-interleaving, Viterbi, CRC) are by far the most
+ * expensive part of the uplink.  With many TRX, decoding every block inline
+ * in the select loop delays the downlink burst generation.  This pool moves
+ * the decoders to worker threads, while everything that touches scheduler,
+ * lchan or L2 state stays in the main loop:
+ *
+ *  - the scheduler copies the bursts of a complete block into a trx_ul_block
+ *    and submits it,
+ *  - a worker runs decode() on the private copy,
+ *  - the main loop calls finish() in the order of submission, when the
+ *    worker signals completion through an eventfd.
+ *
+ * A block of a logical channel depends on the outcome of its predecessor
+ * (AMR frame type / CMR, FACCH/H stealing), so the predecessor is finished
+ * before the next block of the same channel is submitted.  Without threads
+ * configured, blocks are decoded inline, as before.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+
+#include "trx_ul_pool.h"
+
+static struct {
+	int num_threads;
+	pthread_t threads[TRX_UL_POOL_MAX_THREADS];
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;	/* work queued or shutdown */
+	pthread_cond_t done_cond;	/* a block has been decoded */
+	struct llist_head free;		/* unused blocks */
+	struct llist_head pending;	/* in flight, in order of submission */
+	struct llist_head work;		/* not yet taken by a worker */
+	int num_pending;
+	int shutdown;
+	struct osmo_fd ofd;		/* eventfd signalling completion */
+	struct trx_ul_block blocks[TRX_UL_POOL_BLOCKS];
+	struct trx_ul_pool_stats stats;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work_cond = PTHREAD_COND_INITIALIZER,
+	.done_cond = PTHREAD_COND_INITIALIZER,
+	.ofd = { .fd = -1 },
+};
+
+static void *ul_pool_worker(void *arg)
+{
+	struct trx_ul_block *blk;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&pool.lock);
+	while (1) {
+		while (!pool.shutdown && llist_empty(&pool.work))
+			pthread_cond_wait(&pool.work_cond, &pool.lock);
+		if (pool.shutdown)
+			break;
+		blk = llist_entry(pool.work.next, struct trx_ul_block, work);
+		llist_del(&blk->work);
+		pthread_mutex_unlock(&pool.lock);
+
+		blk->decode(blk);
+
+		pthread_mutex_lock(&pool.lock);
+		blk->done = 1;
+		pthread_cond_broadcast(&pool.done_cond);
+		if (write(pool.ofd.fd, &one, sizeof(one)) < 0) {
+			/* the counter cannot overflow in practise, and
+			 * the main loop will pick the block up on the
+			 * next flush anyway */
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+/* hand the oldest pending block to its finish() callback, if it has been
+ * decoded or if 'wait' is set. returns 0 if nothing was delivered */
+static int ul_pool_deliver_head(int wait)
+{
+	struct trx_ul_block *blk;
+
+	pthread_mutex_lock(&pool.lock);
+	if (llist_empty(&pool.pending)) {
+		pthread_mutex_unlock(&pool.lock);
+		return 0;
+	}
+	blk = llist_entry(pool.pending.next, struct trx_ul_block, list);
+	while (!blk->done) {
+		if (!wait) {
+			pthread_mutex_unlock(&pool.lock);
+			return 0;
+		}
+		pthread_cond_wait(&pool.done_cond, &pool.lock);
+	}
+	llist_del(&blk->list);
+	pool.num_pending--;
+	pthread_mutex_unlock(&pool.lock);
+
+	/* finish() may end up in trx_ul_pool_flush() again, e.g. if L2
+	 * releases the channel. the block is already off the pending list,
+	 * so the nested flush continues with the next one. */
+	blk->finish(blk);
+
+	pthread_mutex_lock(&pool.lock);
+	llist_add_tail(&blk->list, &pool.free);
+	pthread_mutex_unlock(&pool.lock);
+
+	return 1;
+}
+
+static int ul_pool_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	uint64_t count;
+
+	if (read(ofd->fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return -errno;
+
+	while (ul_pool_deliver_head(0))
+		;
+
+	return 0;
+}
+
+/*! \brief start decoder threads, 0 keeps decoding inline */
+int trx_ul_pool_start(int num_threads)
+{
+	int i, rc;
+
+	if (pool.num_threads)
+		return -EBUSY;
+	if (num_threads <= 0)
+		return 0;
+	if (num_threads > TRX_UL_POOL_MAX_THREADS)
+		num_threads = TRX_UL_POOL_MAX_THREADS;
+
+	INIT_LLIST_HEAD(&pool.free);
+	INIT_LLIST_HEAD(&pool.pending);
+	INIT_LLIST_HEAD(&pool.work);
+	for (i = 0; i < TRX_UL_POOL_BLOCKS; i++) {
+		pool.blocks[i].pooled = 1;
+		llist_add_tail(&pool.blocks[i].list, &pool.free);
+	}
+	pool.num_pending = 0;
+	pool.shutdown = 0;
+
+	rc = eventfd(0, EFD_NONBLOCK);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot create eventfd for UL decoder "
+			"pool: %s\n", strerror(errno));
+		return -errno;
+	}
+	pool.ofd.fd = rc;
+	pool.ofd.when = BSC_FD_READ;
+	pool.ofd.cb = ul_pool_fd_cb;
+	pool.ofd.data = NULL;
+	pool.ofd.priv_nr = 0;
+	osmo_fd_register(&pool.ofd);
+
+	for (i = 0; i < num_threads; i++) {
+		rc = pthread_create(&pool.threads[i], NULL, ul_pool_worker,
+			NULL);
+		if (rc) {
+			LOGP(DL1C, LOGL_ERROR, "Cannot start UL decoder thread "
+				"%d: %s\n", i, strerror(rc));
+			break;
+		}
+		pool.num_threads++;
+	}
+	if (!pool.num_threads) {
+		osmo_fd_unregister(&pool.ofd);
+		close(pool.ofd.fd);
+		pool.ofd.fd = -1;
+		return -rc;
+	}
+
+	LOGP(DL1C, LOGL_NOTICE, "Decoding uplink blocks with %d threads\n",
+		pool.num_threads);
+
+	return pool.num_threads;
+}
+
+/*! \brief finish all pending blocks and stop the decoder threads */
+void trx_ul_pool_stop(void)
+{
+	int i;
+
+	if (!pool.num_threads)
+		return;
+
+	trx_ul_pool_flush();
+
+	pthread_mutex_lock(&pool.lock);
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.work_cond);
+	pthread_mutex_unlock(&pool.lock);
+	for (i = 0; i < pool.num_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+	pool.num_threads = 0;
+
+	osmo_fd_unregister(&pool.ofd);
+	close(pool.ofd.fd);
+	pool.ofd.fd = -1;
+}
+
+int trx_ul_pool_threads(void)
+{
+	return pool.num_threads;
+}
+
+int trx_ul_pool_pending(void)
+{
+	return pool.num_pending;
+}
+
+const struct trx_ul_pool_stats *trx_ul_pool_get_stats(void)
+{
+	return &pool.stats;
+}
+
+/*! \brief get a block to fill for the given channel state
+ *
+ * If a block of the same channel is still in flight, all blocks up to and
+ * including it are finished first, so the caller sees the channel state
+ * as updated by the previous block.  If no threads are running or all
+ * blocks are in flight, stack_blk is returned and decoded inline. */
+struct trx_ul_block *trx_ul_pool_get(const struct l1sched_chan_state *owner,
+	struct trx_ul_block *stack_blk)
+{
+	struct trx_ul_block *blk;
+	int busy;
+
+	stack_blk->pooled = 0;
+
+	if (!pool.num_threads)
+		return stack_blk;
+
+	/* only the main loop adds to or removes from the pending list, so
+	 * it can be walked here without holding the lock */
+	if (owner) {
+		busy = 0;
+		llist_for_each_entry(blk, &pool.pending, list) {
+			if (blk->chan_state == owner)
+				busy = 1;
+		}
+		if (busy) {
+			pool.stats.dep_flushes++;
+			do {
+				blk = llist_entry(pool.pending.next,
+					struct trx_ul_block, list);
+				ul_pool_deliver_head(1);
+			} while (blk->chan_state != owner
+			      && !llist_empty(&pool.pending));
+		}
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	if (llist_empty(&pool.free)) {
+		pthread_mutex_unlock(&pool.lock);
+		pool.stats.exhausted++;
+		/* keep the order of indications to the upper layers */
+		trx_ul_pool_flush();
+		return stack_blk;
+	}
+	blk = llist_entry(pool.free.next, struct trx_ul_block, list);
+	llist_del(&blk->list);
+	pthread_mutex_unlock(&pool.lock);
+
+	blk->done = 0;
+
+	return blk;
+}
+
+/*! \brief decode a filled block, either inline or on a worker thread */
+void trx_ul_pool_run(struct trx_ul_block *blk)
+{
+	if (!blk->pooled) {
+		pool.stats.inline_decoded++;
+		blk->decode(blk);
+		blk->finish(blk);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	llist_add_tail(&blk->list, &pool.pending);
+	llist_add_tail(&blk->work, &pool.work);
+	pool.num_pending++;
+	if (pool.num_pending > pool.stats.max_pending)
+		pool.stats.max_pending = pool.num_pending;
+	pool.stats.submitted++;
+	pthread_cond_signal(&pool.work_cond);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*! \brief wait for all blocks in flight and finish them
+ *
+ * Must be called before channel state is changed or released, so that no
+ * late indication refers to a reconfigured channel. */
+void trx_ul_pool_flush(void)
+{
+	if (!pool.num_threads)
+		return;
+
+	while (ul_pool_deliver_head(1))
+		;
+}
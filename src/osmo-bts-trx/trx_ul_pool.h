@@ -0,0 +1,79 @@
+#ifndef TRX_UL_POOL_H
+#define TRX_UL_POOL_H
+
+#include <stdint.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/bits.h>
+
+#include <osmo-bts/scheduler.h>
+
+/* maximum number of decoder threads and blocks in flight */
+#define TRX_UL_POOL_MAX_THREADS	16
+#define TRX_UL_POOL_BLOCKS	64
+
+struct trx_ul_block;
+
+typedef void trx_ul_block_cb(struct trx_ul_block *blk);
+
+/*! \brief one block of uplink bursts to be decoded
+ *
+ * All input is copied from the channel state on submission, so the
+ * decode() callback never touches scheduler state and may run on any
+ * thread.  finish() is always called from the main loop, in the same
+ * order as the blocks were submitted. */
+struct trx_ul_block {
+	struct llist_head list;		/* free or pending list */
+	struct llist_head work;		/* worker queue */
+	int pooled;			/* allocated from the pool */
+	int done;			/* decode() has completed */
+
+	trx_ul_block_cb *decode;	/* called from worker thread */
+	trx_ul_block_cb *finish;	/* called from main loop */
+
+	/* input */
+	struct l1sched_trx *l1t;
+	struct l1sched_chan_state *chan_state;
+	uint8_t tn;
+	uint32_t fn;			/* fn of last burst */
+	uint32_t first_fn;		/* fn of first burst */
+	enum trx_chan_type chan;
+	float rssi;
+	float toa;
+	uint8_t rsl_cmode, tch_mode;
+	uint8_t codec[4];
+	int codecs;
+	uint8_t ul_ft, ul_cmr;		/* updated by AMR decoding */
+	int skip;			/* only indicate a bad frame */
+	uint8_t bsic;			/* for RACH decoding */
+	int combine;			/* a bad SACCH block follows bursts */
+	sbit_t bursts[928];
+
+	/* output */
+	int rc;
+	int n_errors, n_bits_total;
+	int combined;			/* decoded by combining with it */
+	int amr_second_conf;		/* AMR decoded with second mode */
+	uint8_t data[128];
+};
+
+struct trx_ul_pool_stats {
+	uint32_t submitted;		/* blocks handed to the workers */
+	uint32_t inline_decoded;	/* blocks decoded in the main loop */
+	uint32_t exhausted;		/* no free block was available */
+	uint32_t dep_flushes;		/* waits for a previous block */
+	uint32_t max_pending;		/* highest number of blocks in flight */
+};
+
+int trx_ul_pool_start(int num_threads);
+void trx_ul_pool_stop(void);
+int trx_ul_pool_threads(void);
+int trx_ul_pool_pending(void);
+const struct trx_ul_pool_stats *trx_ul_pool_get_stats(void);
+
+struct trx_ul_block *trx_ul_pool_get(const struct l1sched_chan_state *owner,
+	struct trx_ul_block *stack_blk);
+void trx_ul_pool_run(struct trx_ul_block *blk);
+void trx_ul_pool_flush(void);
+
+#endif /* TRX_UL_POOL_H */
@@ -40,10 +40,15 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/udp_batch.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
 #include "loops.h"
+#include "gsm0503_viterbi.h"
+#include "trx_ul_pool.h"
+#include "trx_clock.h"
 
 #define OSMOTRX_STR	"OsmoTRX Transceiver configuration\n"
 
@@ -62,6 +67,20 @@ DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
 		vty_out(vty, "transceiver is connected, current fn=%u%s",
 			transceiver_last_fn, VTY_NEWLINE);
 	}
+	vty_out(vty, "viterbi decoder: %s%s",
+		get_value_string(gsm0503_viterbi_impl_names,
+				 gsm0503_viterbi_get_impl()), VTY_NEWLINE);
+	if (trx_ul_pool_threads()) {
+		const struct trx_ul_pool_stats *st = trx_ul_pool_get_stats();
+		vty_out(vty, "uplink decoder: %d threads, %d blocks pending%s",
+			trx_ul_pool_threads(), trx_ul_pool_pending(),
+			VTY_NEWLINE);
+		vty_out(vty, " submitted %u, inline %u, pool exhausted %u, "
+			"waited for previous block %u, max pending %u%s",
+			st->submitted, st->inline_decoded, st->exhausted,
+			st->dep_flushes, st->max_pending, VTY_NEWLINE);
+	} else
+		vty_out(vty, "uplink decoder: inline%s", VTY_NEWLINE);
 
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		struct phy_instance *pinst = trx_phy_instance(trx);
@@ -87,11 +106,100 @@ DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
 				VTY_NEWLINE);
 		else
 			vty_out(vty, " bisc   : undefined%s", VTY_NEWLINE);
+		if (l1h->data_tx && l1h->data_rx)
+			vty_out(vty, " data   : tx %lu bursts in %lu calls, "
+				"rx %lu bursts in %lu calls%s",
+				l1h->data_tx->datagrams, l1h->data_tx->syscalls,
+				l1h->data_rx->datagrams, l1h->data_rx->syscalls,
+				VTY_NEWLINE);
+		vty_out(vty, " bursts : %zu bytes of buffers, %u in use%s",
+			l1h->l1s.bursts_slab_size,
+			trx_sched_bursts_in_use(&l1h->l1s), VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_transceiver_clock, show_transceiver_clock_cmd,
+	"show transceiver clock",
+	SHOW_STR "Display information about transceivers\n"
+	"Display the GSM frame clock and its scheduling statistics\n")
+{
+	const struct trx_clock_stats *st = trx_clock_get_stats();
+	int64_t period = trx_clock_period_ps();
+	uint32_t lo = 0;
+	int i;
+
+	if (!transceiver_available)
+		vty_out(vty, "transceiver is not connected%s", VTY_NEWLINE);
+
+	vty_out(vty, "frame period: %lld.%03lld ns (%+d ppb)%s",
+		(long long)(period / 1000), (long long)(period % 1000),
+		(int)((period - FRAME_DURATION_pS) * 1000000000LL
+			/ FRAME_DURATION_pS),
+		VTY_NEWLINE);
+	vty_out(vty, "clock indications: %u, re-synchronizations: %u%s",
+		st->clk_inds, st->clk_resyncs, VTY_NEWLINE);
+	if (st->clk_inds)
+		vty_out(vty, "clock phase error: last %d us, max %u us, "
+			"rms %u us%s", st->clk_err_last_us, st->clk_err_max_us,
+			trx_clock_isqrt(st->clk_err_sqsum_us / st->clk_inds),
+			VTY_NEWLINE);
+
+	vty_out(vty, "frames scheduled: %u%s", st->frames, VTY_NEWLINE);
+	if (!st->frames)
+		return CMD_SUCCESS;
+	vty_out(vty, "lateness: mean %u us, max %u us, rms %u us%s",
+		(uint32_t)(st->late_sum_us / st->frames), st->late_max_us,
+		trx_clock_isqrt(st->late_sqsum_us / st->frames), VTY_NEWLINE);
+	vty_out(vty, "processing: mean %u us, max %u us%s",
+		(uint32_t)(st->proc_sum_us / st->frames), st->proc_max_us,
+		VTY_NEWLINE);
+	for (i = 0; i < TRX_CLOCK_LATE_BINS; i++) {
+		if (i < TRX_CLOCK_LATE_BINS - 1)
+			vty_out(vty, " %5u .. %5u us: %10u%s", lo,
+				trx_clock_late_bins_us[i], st->late_hist[i],
+				VTY_NEWLINE);
+		else
+			vty_out(vty, " %5u ..       us: %10u%s", lo,
+				st->late_hist[i], VTY_NEWLINE);
+		if (i < TRX_CLOCK_LATE_BINS - 1)
+			lo = trx_clock_late_bins_us[i];
 	}
 
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_transceiver_dl_queues, show_transceiver_dl_queues_cmd,
+	"show transceiver dl-queues",
+	SHOW_STR "Display information about transceivers\n"
+	"Display the depth of the downlink primitive queues\n")
+{
+	struct gsm_bts *bts = vty_bts;
+	struct gsm_bts_trx *trx;
+	struct l1sched_ts *l1ts;
+	struct l1sched_dl_queue *queue;
+	uint8_t tn;
+	int i;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		vty_out(vty, "TRX %d%s", trx->nr, VTY_NEWLINE);
+		for (tn = 0; tn < TRX_NR_TS; tn++) {
+			l1ts = l1sched_trx_get_ts(trx_l1sched_hdl(trx), tn);
+			for (i = 0; i < _TRX_CHAN_MAX; i++) {
+				queue = &l1ts->dl_queue[i];
+				if (!queue->depth_max)
+					continue;
+				vty_out(vty, " ts=%u %-12s: depth %u, max %u, "
+					"dropped %u%s", tn, trx_chan_desc[i].name,
+					queue->depth, queue->depth_max,
+					queue->dropped, VTY_NEWLINE);
+			}
+		}
+	}
+
+	return CMD_SUCCESS;
+}
 
 static void show_phy_inst_single(struct vty *vty, struct phy_instance *pinst)
 {
@@ -135,6 +243,9 @@ static void show_phy_single(struct vty *vty, struct phy_link *plink)
 			plink->u.osmotrx.power, VTY_NEWLINE);
 	else
 		vty_out(vty, " tx-attenuation : undefined%s", VTY_NEWLINE);
+	vty_out(vty, " tx-burst-format: %s%s",
+		plink->u.osmotrx.tx_packed ? "packed" : "unpacked",
+		VTY_NEWLINE);
 
 	llist_for_each_entry(pinst, &plink->instances, list)
 		show_phy_inst_single(vty, pinst);
@@ -320,6 +431,34 @@ DEFUN(cfg_phy_rts_advance, cfg_phy_rts_advance_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_phy_ul_decode_threads, cfg_phy_ul_decode_threads_cmd,
+	"osmotrx ul-decode-threads <0-16>",
+	OSMOTRX_STR
+	"Set the number of threads for decoding uplink blocks. With 0, blocks "
+	"are decoded in the main loop. Takes effect when the PHY is opened\n"
+	"Number of threads\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_decode_threads = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_tx_burst_format, cfg_phy_tx_burst_format_cmd,
+	"osmotrx tx-burst-format (unpacked|packed)",
+	OSMOTRX_STR
+	"Set the format of downlink bursts on the data interface\n"
+	"One byte per bit (default, supported by all transceivers)\n"
+	"Eight bits per byte, MSB first. The transceiver must support it!\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.tx_packed = !strcmp(argv[0], "packed");
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_phy_rxgain, cfg_phy_rxgain_cmd,
 	"osmotrx rx-gain <0-50>",
 	OSMOTRX_STR
@@ -440,6 +579,11 @@ void bts_model_config_write_phy(struct vty *vty, struct phy_link *plink)
 		plink->u.osmotrx.clock_advance, VTY_NEWLINE);
 	vty_out(vty, " osmotrx rts-advance %d%s",
 		plink->u.osmotrx.rts_advance, VTY_NEWLINE);
+	if (plink->u.osmotrx.ul_decode_threads)
+		vty_out(vty, " osmotrx ul-decode-threads %d%s",
+			plink->u.osmotrx.ul_decode_threads, VTY_NEWLINE);
+	if (plink->u.osmotrx.tx_packed)
+		vty_out(vty, " osmotrx tx-burst-format packed%s", VTY_NEWLINE);
 	if (plink->u.osmotrx.rxgain_valid)
 		vty_out(vty, " osmotrx rx-gain %d%s",
 			plink->u.osmotrx.rxgain, VTY_NEWLINE);
@@ -495,6 +639,8 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	vty_bts = bts;
 
 	install_element_ve(&show_transceiver_cmd);
+	install_element_ve(&show_transceiver_clock_cmd);
+	install_element_ve(&show_transceiver_dl_queues_cmd);
 	install_element_ve(&show_phy_cmd);
 
 	install_element(BTS_NODE, &cfg_bts_ms_power_loop_cmd);
@@ -509,6 +655,8 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	install_element(PHY_NODE, &cfg_phy_base_port_cmd);
 	install_element(PHY_NODE, &cfg_phy_fn_advance_cmd);
 	install_element(PHY_NODE, &cfg_phy_rts_advance_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_decode_threads_cmd);
+	install_element(PHY_NODE, &cfg_phy_tx_burst_format_cmd);
 	install_element(PHY_NODE, &cfg_phy_transc_ip_cmd);
 	install_element(PHY_NODE, &cfg_phy_rxgain_cmd);
 	install_element(PHY_NODE, &cfg_phy_tx_atten_cmd);
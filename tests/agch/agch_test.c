@@ -27,6 +27,7 @@
 
 #include <inttypes.h>
 #include <unistd.h>
+#include <time.h>
 
 static struct gsm_bts *bts;
 static struct gsm_bts_role_bts *btsb;
@@ -192,6 +193,171 @@ static void test_agch_queue(void)
 	       btsb->agch_queue_pch_msgs);
 }
 
+static void test_agch_rach_storm(void)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	struct timespec start, end;
+	/* 9 CCCH blocks per 51-multiframe, the first one AG reserved */
+	const int num_blocks = 9 * 2000;
+	/* every 200 multiframes, a storm of 50 multiframes */
+	const int storm_period = 9 * 200, storm_len = 9 * 50;
+	const int rach_per_block = 12, rach_per_block_quiet = 1;
+	int block, idx, rc, rach = 0, max_len = 0;
+	int imm_ass_count = 0, imm_ass_rej_ref_count = 0;
+	int sent_imm_ass = 0, sent_rej_refs = 0;
+	struct msgb *msg;
+	double ns;
+
+	printf("Testing AGCH queue with RACH storms.\n");
+
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+
+	btsb->agch_max_queue_length =
+		bts_agch_max_queue_length(32, RSL_BCCH_CCCH_CONF_1_NC);
+	btsb->agch_queue_low_level = GSM_BTS_AGCH_QUEUE_LOW_LEVEL_DEFAULT;
+	btsb->agch_queue_high_level = GSM_BTS_AGCH_QUEUE_HIGH_LEVEL_DEFAULT;
+	btsb->agch_queue_thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DEFAULT;
+	btsb->agch_queue_dropped_msgs = 0;
+	btsb->agch_queue_merged_msgs = 0;
+	btsb->agch_queue_rejected_msgs = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (block = 0; block < num_blocks; block++) {
+		int is_agch = (block % 9) == 0;
+		int num_rach = (block % storm_period) < storm_len ?
+			rach_per_block : rach_per_block_quiet;
+
+		/* the BSC has a channel for one in eight requests */
+		for (idx = 0; idx < num_rach; idx++, rach++) {
+			msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+			if (rach % 8 == 0) {
+				put_imm_ass(msg, rach & 0xff);
+				imm_ass_count++;
+			} else {
+				put_imm_ass_rej(msg, rach & 0xff, 10);
+				imm_ass_rej_ref_count++;
+			}
+			if (bts_agch_enqueue(bts, msg) < 0)
+				msgb_free(msg);
+		}
+		if (btsb->agch_queue_length > max_len)
+			max_len = btsb->agch_queue_length;
+
+		rc = bts_ccch_copy_msg(bts, out_buf, &g_time, is_agch);
+		if (rc <= 0)
+			continue;
+		switch (((struct gsm48_imm_ass *)out_buf)->msg_type) {
+		case GSM48_MT_RR_IMM_ASS:
+			sent_imm_ass++;
+			break;
+		case GSM48_MT_RR_IMM_ASS_REJ:
+			sent_rej_refs += count_imm_ass_rej_refs(
+				(struct gsm48_imm_ass_rej *)out_buf);
+			break;
+		default:
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	fprintf(stderr, "%d RACH in %d CCCH blocks: %.1f ms, %.0f ns/RACH\n",
+		rach, num_blocks, ns / 1e6, ns / rach);
+
+	printf("RACH storm: rach %d, imm.ass %d, imm.ass.rej refs %d, "
+	       "sent imm.ass %d, sent imm.ass.rej refs %d, queue limit %u, "
+	       "max occupied %d, dropped %"PRIu64", merged %"PRIu64", "
+	       "rejected %"PRIu64"\n",
+	       rach, imm_ass_count, imm_ass_rej_ref_count,
+	       sent_imm_ass, sent_rej_refs, btsb->agch_max_queue_length,
+	       max_len, btsb->agch_queue_dropped_msgs,
+	       btsb->agch_queue_merged_msgs, btsb->agch_queue_rejected_msgs);
+}
+
+static int ccch_block(uint32_t fn, int is_agch)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	int rc;
+
+	g_time.fn = fn;
+	g_time.t1 = fn / (26 * 51);
+	g_time.t2 = fn % 26;
+	g_time.t3 = fn % 51;
+
+	rc = bts_ccch_copy_msg(bts, out_buf, &g_time, is_agch);
+	if (rc <= 0)
+		return 0;
+	return ((struct gsm48_imm_ass *)out_buf)->msg_type;
+}
+
+static void test_ccch_sched(void)
+{
+	struct gsm_bts_ccch_sched *cs = &btsb->ccch_sched;
+	uint8_t ilv[sizeof(static_ilv)];
+	struct msgb *msg;
+	uint32_t mf = 0;
+	int idx, rc;
+
+	printf("Testing CCCH scheduling of paging and AGCH.\n");
+
+	/* start with empty queues */
+	while (ccch_block(6, 1))
+		;
+	memset(cs, 0, sizeof(*cs));
+	paging_config(btsb->paging_state, 200, 60);
+
+	/* paging group 0 is in block 1 (FN 6) of every second multiframe */
+	rc = paging_add_identity(btsb->paging_state, 0, static_ilv, 0);
+	OSMO_ASSERT(rc == 0);
+	OSMO_ASSERT(ccch_block(mf * 51 + 6, 0) == GSM48_MT_RR_PAG_REQ_1);
+
+	/* more IMM ASS than AGCH blocks: the repeat waits */
+	for (idx = 0; idx < 4; idx++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+		put_imm_ass(msg, idx);
+		OSMO_ASSERT(bts_agch_enqueue(bts, msg) == 0);
+	}
+	mf += 2;
+	OSMO_ASSERT(ccch_block(mf * 51 + 6, 0) == GSM48_MT_RR_IMM_ASS);
+	OSMO_ASSERT(cs->pag_deferred == 1);
+
+	/* a new identity is paged in any case */
+	memcpy(ilv, static_ilv, sizeof(ilv));
+	ilv[8] = 0x29;
+	rc = paging_add_identity(btsb->paging_state, 0, ilv, 0);
+	OSMO_ASSERT(rc == 0);
+	mf += 2;
+	OSMO_ASSERT(ccch_block(mf * 51 + 6, 0) == GSM48_MT_RR_PAG_REQ_1);
+	OSMO_ASSERT(cs->pag_deferred == 1);
+
+	/* once the AGCH is drained, the repeats are sent again */
+	while (ccch_block(mf * 51 + 6, 1) == GSM48_MT_RR_IMM_ASS)
+		;
+	OSMO_ASSERT(btsb->agch_queue_length == 0);
+	mf += 2;
+	OSMO_ASSERT(ccch_block(mf * 51 + 6, 0) == GSM48_MT_RR_PAG_REQ_1);
+	OSMO_ASSERT(cs->pag_deferred == 1);
+
+	/* one AGCH block per multiframe, no paging in the other groups */
+	for (mf = 100; mf < 200; mf++) {
+		ccch_block(mf * 51 + 2, 1);
+		ccch_block(mf * 51 + 12, 0);
+	}
+	OSMO_ASSERT(cs->ag_blocks256 == 256);
+	OSMO_ASSERT(cs->util256 == 0);
+
+	printf("CCCH: blocks %"PRIu64", used %"PRIu64", deferred %"PRIu64"\n",
+	       cs->blocks_total, cs->blocks_used_total, cs->pag_deferred);
+
+	paging_reset(btsb->paging_state);
+	paging_config(btsb->paging_state, 200, 0);
+}
+
 static void test_agch_queue_length_computation(void)
 {
 	static const int ccch_configs[] = {
@@ -241,6 +407,8 @@ int main(int argc, char **argv)
 	btsb = bts_role_bts(bts);
 	test_agch_queue_length_computation();
 	test_agch_queue();
+	test_agch_rach_storm();
+	test_ccch_sched();
 	printf("Success\n");
 
 	return 0;
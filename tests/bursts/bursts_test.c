@@ -23,12 +23,26 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <math.h>
 
 #include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
 #include <osmocom/core/utils.h>
 #include <osmo-bts/gsm_data.h>
 
 #include "../../src/osmo-bts-trx/gsm0503_coding.h"
+#include "../../src/osmo-bts-trx/gsm0503_conv.h"
+#include "../../src/osmo-bts-trx/gsm0503_viterbi.h"
+#include "../../src/osmo-bts-trx/gsm0503_interleaving.h"
+#include "../../src/osmo-bts-trx/gsm0503_tables.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+#else
+#define BENCH_UNIT "ns"
+#endif
 
 #include <osmo-bts/logging.h>
 
@@ -409,6 +423,575 @@ static void test_pdtch(uint8_t *l2, int len)
 	printd("\n");
 }
 
+static const struct {
+	const struct osmo_conv_code *code;
+	const char *name;
+} test_conv_codes[] = {
+	{ &gsm0503_conv_xcch,		"xcch" },
+	{ &gsm0503_conv_cs2,		"cs2" },
+	{ &gsm0503_conv_cs3,		"cs3" },
+	{ &gsm0503_conv_rach,		"rach" },
+	{ &gsm0503_conv_sch,		"sch" },
+	{ &gsm0503_conv_tch_fr,		"tch_fr" },
+	{ &gsm0503_conv_tch_hr,		"tch_hr" },
+	{ &gsm0503_conv_tch_afs_12_2,	"tch_afs_12_2" },
+	{ &gsm0503_conv_tch_afs_10_2,	"tch_afs_10_2" },
+	{ &gsm0503_conv_tch_afs_7_95,	"tch_afs_7_95" },
+	{ &gsm0503_conv_tch_afs_7_4,	"tch_afs_7_4" },
+	{ &gsm0503_conv_tch_afs_6_7,	"tch_afs_6_7" },
+	{ &gsm0503_conv_tch_afs_5_9,	"tch_afs_5_9" },
+	{ &gsm0503_conv_tch_afs_5_15,	"tch_afs_5_15" },
+	{ &gsm0503_conv_tch_afs_4_75,	"tch_afs_4_75" },
+	{ &gsm0503_conv_tch_ahs_7_95,	"tch_ahs_7_95" },
+	{ &gsm0503_conv_tch_ahs_7_4,	"tch_ahs_7_4" },
+	{ &gsm0503_conv_tch_ahs_6_7,	"tch_ahs_6_7" },
+	{ &gsm0503_conv_tch_ahs_5_9,	"tch_ahs_5_9" },
+	{ &gsm0503_conv_tch_ahs_5_15,	"tch_ahs_5_15" },
+	{ &gsm0503_conv_tch_ahs_4_75,	"tch_ahs_4_75" },
+};
+
+static uint32_t test_rand_state = 1;
+
+/* simple LCG, so the test does not depend on the libc rand() */
+static uint32_t test_rand(void)
+{
+	test_rand_state = test_rand_state * 1103515245 + 12345;
+	return (test_rand_state >> 16) & 0x7fff;
+}
+
+static uint64_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* bit errors of the input against the re-encoded output, as counted by
+ * osmo_conv_decode_ber() */
+static int test_viterbi_errors(const struct osmo_conv_code *code,
+	const sbit_t *input, const ubit_t *output)
+{
+	ubit_t recoded[4096];
+	int i, n, n_errors = 0;
+
+	n = osmo_conv_encode(code, output, recoded);
+	for (i = 0; i < n; i++) {
+		if (!((recoded[i] && input[i] < 0)
+		   || (!recoded[i] && input[i] > 0)))
+			n_errors++;
+	}
+
+	return n_errors;
+}
+
+static void test_viterbi(const struct osmo_conv_code *code, const char *name)
+{
+	ubit_t data[1024], ref[1024], result[1024], result_gen[1024];
+	ubit_t coded[4096];
+	sbit_t coded_s[4096];
+	int i, n, iter, impl, ref_errors = 0, n_errors, n_bits_total;
+
+	for (iter = 0; iter < 150; iter++) {
+		for (i = 0; i < code->len; i++)
+			data[i] = test_rand() & 1;
+		n = osmo_conv_encode(code, data, coded);
+
+		/* iteration 0 mod 3: error-free with random reliability, so
+		 * every decoder must return the sent data.  1 mod 3: pure
+		 * noise, the kernels must agree with each other.  2 mod 3:
+		 * noisy with some bit errors, every kernel must return the
+		 * output and error count of osmo_conv_decode(). */
+		for (i = 0; i < n; i++) {
+			switch (iter % 3) {
+			case 0:
+				coded_s[i] = (coded[i] ? -1 : 1) *
+					(int) (20 + test_rand() % 108);
+				break;
+			case 1:
+				coded_s[i] = (int) (test_rand() % 255) - 127;
+				break;
+			case 2:
+				coded_s[i] = (coded[i] ? -1 : 1) *
+					(int) (test_rand() % 128);
+				if (test_rand() % 16 == 0)
+					coded_s[i] = -coded_s[i];
+				break;
+			}
+		}
+
+		if (iter % 3 != 1) {
+			osmo_conv_decode(code, coded_s, ref);
+			ref_errors = test_viterbi_errors(code, coded_s, ref);
+		}
+		if (iter % 3 == 0)
+			ASSERT_TRUE(!memcmp(ref, data, code->len));
+
+		for (impl = 0; impl < _NUM_GSM0503_VITERBI_IMPL; impl++) {
+			if (gsm0503_viterbi_set_impl(impl))
+				continue;
+			osmo_conv_decode_ber(code, coded_s, result, &n_errors,
+				&n_bits_total);
+			ASSERT_TRUE(n_bits_total == n);
+			if (impl == GSM0503_VITERBI_GENERIC)
+				memcpy(result_gen, result, code->len);
+			ASSERT_TRUE(!memcmp(result_gen, result, code->len));
+			if (iter % 3 != 1) {
+				ASSERT_TRUE(!memcmp(ref, result, code->len));
+				ASSERT_TRUE(n_errors == ref_errors);
+			}
+		}
+	}
+
+	printf("viterbi: %s K=%d N=%d len=%d ok\n", name, code->K, code->N,
+		code->len);
+}
+
+/* results go to stderr, which is ignored by the testsuite */
+static void bench_viterbi(const struct osmo_conv_code *code, const char *name)
+{
+	ubit_t data[1024], result[1024], coded[4096];
+	sbit_t coded_s[4096];
+	uint64_t start;
+	int i, n, impl;
+	const int blocks = 200;
+
+	for (i = 0; i < code->len; i++)
+		data[i] = test_rand() & 1;
+	n = osmo_conv_encode(code, data, coded);
+	for (i = 0; i < n; i++)
+		coded_s[i] = coded[i] ? -100 : 100;
+
+	start = bench_ticks();
+	for (i = 0; i < blocks; i++)
+		osmo_conv_decode(code, coded_s, result);
+	fprintf(stderr, "viterbi bench: %-13s %-8s %8llu " BENCH_UNIT "/block\n",
+		name, "libosmo", (unsigned long long)
+			((bench_ticks() - start) / blocks));
+
+	for (impl = 0; impl < _NUM_GSM0503_VITERBI_IMPL; impl++) {
+		if (gsm0503_viterbi_set_impl(impl))
+			continue;
+		start = bench_ticks();
+		for (i = 0; i < blocks; i++)
+			gsm0503_conv_decode(code, coded_s, result);
+		fprintf(stderr, "viterbi bench: %-13s %-8s %8llu "
+			BENCH_UNIT "/block\n", name,
+			get_value_string(gsm0503_viterbi_impl_names, impl),
+			(unsigned long long) ((bench_ticks() - start) / blocks));
+	}
+}
+
+/* position of bit j of burst B, with the stealing flags skipped */
+static unsigned int burst_pos(unsigned int B, unsigned int j)
+{
+	return B * 116 + j + (j >= 57 ? 2 : 0);
+}
+
+/* check the burst position tables against the formulas of 45.003 */
+static void test_interleaving(void)
+{
+	unsigned int k, B, j;
+
+	for (k = 0; k < 456; k++) {
+		B = k & 3;
+		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
+		ASSERT_TRUE(gsm0503_xcch_burst_idx[k] == burst_pos(B, j));
+	}
+	printf("interleaving: xcch ok\n");
+
+	for (k = 0; k < 456; k++) {
+		B = k & 7;
+		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
+		ASSERT_TRUE(gsm0503_tch_fr_burst_idx[k] == burst_pos(B, j));
+	}
+	printf("interleaving: tch_fr ok\n");
+
+	for (k = 0; k < 228; k++) {
+		B = gsm0503_tch_hr_interleaving[k][1];
+		j = gsm0503_tch_hr_interleaving[k][0];
+		ASSERT_TRUE(gsm0503_tch_hr_burst_idx[k] == burst_pos(B, j));
+	}
+	printf("interleaving: tch_hr ok\n");
+
+	/* blocks 6 and 7 of FACCH/H are sent in bursts 2 and 3 */
+	for (k = 0; k < 456; k++) {
+		B = k & 7;
+		j = 2 * ((49 * k) % 57) + ((k & 7) >> 2);
+		if (B >= 6)
+			B -= 4;
+		ASSERT_TRUE(gsm0503_facch_h_burst_idx[k] == burst_pos(B, j));
+	}
+	printf("interleaving: facch_h ok\n");
+}
+
+/* results go to stderr, which is ignored by the testsuite */
+static void bench_interleaving(void)
+{
+	static const struct {
+		void (*deinterleave)(sbit_t *cB, const sbit_t *bursts);
+		void (*interleave)(const ubit_t *cB, ubit_t *bursts);
+		const char *name;
+	} variants[] = {
+		{ gsm0503_xcch_deinterleave, gsm0503_xcch_interleave,
+		  "xcch" },
+		{ gsm0503_tch_fr_deinterleave, gsm0503_tch_fr_interleave,
+		  "tch_fr" },
+		{ gsm0503_tch_hr_deinterleave, gsm0503_tch_hr_interleave,
+		  "tch_hr" },
+		{ gsm0503_facch_h_deinterleave, gsm0503_facch_h_interleave,
+		  "facch_h" },
+	};
+	ubit_t cB_u[456], bursts_u[116 * 8];
+	sbit_t cB_s[456], bursts_s[116 * 8];
+	uint64_t start;
+	int i, v;
+	const int blocks = 10000;
+
+	for (i = 0; i < sizeof(bursts_s); i++)
+		bursts_s[i] = (int) (test_rand() % 255) - 127;
+	for (i = 0; i < sizeof(cB_u); i++)
+		cB_u[i] = test_rand() & 1;
+
+	for (v = 0; v < ARRAY_SIZE(variants); v++) {
+		start = bench_ticks();
+		for (i = 0; i < blocks; i++)
+			variants[v].deinterleave(cB_s, bursts_s);
+		fprintf(stderr, "interleaving bench: %-8s deinterleave %6llu "
+			BENCH_UNIT "/block\n", variants[v].name,
+			(unsigned long long) ((bench_ticks() - start) / blocks));
+
+		start = bench_ticks();
+		for (i = 0; i < blocks; i++)
+			variants[v].interleave(cB_u, bursts_u);
+		fprintf(stderr, "interleaving bench: %-8s interleave   %6llu "
+			BENCH_UNIT "/block\n", variants[v].name,
+			(unsigned long long) ((bench_ticks() - start) / blocks));
+	}
+}
+
+/* codec modes of the active codec set, as in the MultiRate configuration */
+static uint8_t test_amr_codec[4] = { 0, 2, 5, 7 };
+
+static const struct {
+	int afs;
+	uint8_t ft;
+	int len, bits;
+	const char *name;
+} test_amr_modes[] = {
+	{ 1, 0, 12,  95, "tch_afs_4_75" },
+	{ 1, 3, 31, 244, "tch_afs_12_2" },
+	{ 0, 0, 12,  95, "tch_ahs_4_75" },
+	{ 0, 2, 20, 159, "tch_ahs_7_95" },
+};
+
+/* random speech frame, the unused bits of the last octet are zero */
+static void test_amr_frame(uint8_t *data, int len, int bits)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		data[i] = test_rand();
+	data[len - 1] &= 0xff << (len * 8 - bits);
+}
+
+static int test_amr_encode(int afs, ubit_t *bursts, uint8_t *data, int len,
+	uint8_t ft)
+{
+	if (afs)
+		return tch_afs_encode(bursts, data, len, 0, test_amr_codec, 4,
+			ft, 0);
+	return tch_ahs_encode(bursts, data, len, 0, test_amr_codec, 4, ft, 0);
+}
+
+static int test_amr_decode(int afs, uint8_t *data, sbit_t *bursts,
+	int codec_mode_req, uint8_t *ft, uint8_t *cmr, int *n_errors,
+	int *n_bits_total)
+{
+	if (afs)
+		return tch_afs_decode(data, bursts, codec_mode_req,
+			test_amr_codec, 4, ft, cmr, n_errors, n_bits_total,
+			NULL);
+	return tch_ahs_decode(data, bursts, 1, codec_mode_req, test_amr_codec,
+		4, ft, cmr, n_errors, n_bits_total, NULL);
+}
+
+/* position of in-band bit j of a speech frame in its bursts */
+static unsigned int test_amr_ic_pos(int afs, int j)
+{
+	return afs ? gsm0503_tch_fr_burst_idx[j] : gsm0503_tch_hr_burst_idx[j];
+}
+
+static void test_amr(int afs, uint8_t ft, int len, int bits,
+	const char *name)
+{
+	const sbit_t *ic = afs ? gsm0503_afs_ic_sbit[0] : gsm0503_ahs_ic_sbit[0];
+	int n = afs ? 8 : 4;
+	uint8_t data[31], result[31], ft_rx, cmr_rx, other = (ft + 1) & 3;
+	ubit_t bursts_u[116 * 8];
+	sbit_t bursts_s[116 * 8];
+	int j, rc, n_errors, n_bits_total;
+
+	test_amr_frame(data, len, bits);
+
+	ASSERT_TRUE(test_amr_encode(afs, bursts_u, data, len, ft) == 0);
+	ubits2sbits(bursts_u, bursts_s, 116 * 8);
+
+	ft_rx = 0xff;
+	rc = test_amr_decode(afs, result, bursts_s, 0, &ft_rx, &cmr_rx,
+		&n_errors, &n_bits_total);
+	ASSERT_TRUE(rc == len && ft_rx == ft);
+	ASSERT_TRUE(!memcmp(data, result, len));
+	printf("%s: ft=%u n_errors=%d n_bits_total=%d\n", name, ft_rx,
+		n_errors, n_bits_total);
+
+	/* weak in-band bits, pointing to the wrong code word */
+	for (j = 0; j < n; j++) {
+		if (ic[ft * n + j] == ic[other * n + j])
+			continue;
+		bursts_s[test_amr_ic_pos(afs, j)] = ic[other * n + j] / 16;
+	}
+	ft_rx = 0xff;
+	rc = test_amr_decode(afs, result, bursts_s, 0, &ft_rx, &cmr_rx,
+		&n_errors, &n_bits_total);
+	printf("%s: unreliable ID %u: rc=%d ft=%u\n", name, other, rc, ft_rx);
+	ASSERT_TRUE(rc == len && ft_rx == ft);
+	ASSERT_TRUE(!memcmp(data, result, len));
+
+	/* an unreliable CMR does not change the last one */
+	cmr_rx = 0xff;
+	ft_rx = ft;
+	rc = test_amr_decode(afs, result, bursts_s, 1, &ft_rx, &cmr_rx,
+		&n_errors, &n_bits_total);
+	printf("%s: unreliable CMR: rc=%d cmr=%u\n", name, rc, cmr_rx);
+	ASSERT_TRUE(rc == len && cmr_rx == 0xff);
+}
+
+static void test_amr_ic(void)
+{
+	sbit_t cB[8];
+	int i, j, id, second, confidence;
+
+	for (i = 0; i < 4; i++) {
+		memcpy(cB, gsm0503_afs_ic_sbit[i], 8);
+		id = gsm0503_afs_ic_decode(cB, &second, &confidence);
+		ASSERT_TRUE(id == i && confidence == 100);
+		memcpy(cB, gsm0503_ahs_ic_sbit[i], 4);
+		id = gsm0503_ahs_ic_decode(cB, &second, &confidence);
+		ASSERT_TRUE(id == i && confidence == 100);
+
+		/* halfway between two code words */
+		for (j = 0; j < 8; j++)
+			cB[j] = (gsm0503_afs_ic_sbit[i][j]
+				+ gsm0503_afs_ic_sbit[(i + 1) & 3][j]) / 2;
+		id = gsm0503_afs_ic_decode(cB, &second, &confidence);
+		ASSERT_TRUE(confidence == 0);
+		ASSERT_TRUE((id == i && second == ((i + 1) & 3))
+			 || (second == i && id == ((i + 1) & 3)));
+	}
+
+	memset(cB, 0, sizeof(cB));
+	gsm0503_afs_ic_decode(cB, NULL, &confidence);
+	ASSERT_TRUE(confidence == 0);
+
+	printf("amr in-band data: ok\n");
+}
+
+/* gaussian noise of given standard deviation, by Box-Muller */
+static double test_gauss(double sigma)
+{
+	double u1 = (test_rand() + 1.0) / 32769.0;
+	double u2 = test_rand() / 32768.0;
+
+	return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* frame and bit error rates of BPSK bursts over an AWGN channel, the
+ * results go to stderr, which is ignored by the testsuite */
+static void bench_amr_awgn(int afs, uint8_t ft, int len, int bits,
+	const char *name)
+{
+	static const int snr_db[] = { -2, 0, 2, 4, 6 };
+	uint8_t data[31], result[31], ft_rx, cmr_rx;
+	ubit_t bursts_u[116 * 8];
+	sbit_t bursts_s[116 * 8], cB[456];
+	int num_bits = afs ? 116 * 8 : 116 * 4;
+	int i, k, s, rc, n_errors, n_bits_total, id, conf;
+	int fer, ber, id_err, recovered;
+	double sigma, y;
+	const int frames = 500;
+
+	for (s = 0; s < ARRAY_SIZE(snr_db); s++) {
+		sigma = sqrt(1.0 / (2.0 * pow(10.0, snr_db[s] / 10.0)));
+		fer = ber = id_err = recovered = 0;
+
+		for (k = 0; k < frames; k++) {
+			test_amr_frame(data, len, bits);
+			test_amr_encode(afs, bursts_u, data, len, ft);
+			for (i = 0; i < num_bits; i++) {
+				y = (bursts_u[i] ? -1.0 : 1.0)
+					+ test_gauss(sigma);
+				y = y * 64.0;
+				bursts_s[i] = (y > 127) ? 127
+					: (y < -127) ? -127 : (int) lrint(y);
+			}
+
+			if (afs) {
+				gsm0503_tch_fr_deinterleave(cB, bursts_s);
+				id = gsm0503_afs_ic_decode(cB, NULL, &conf);
+			} else {
+				gsm0503_tch_hr_deinterleave(cB, bursts_s);
+				id = gsm0503_ahs_ic_decode(cB, NULL, &conf);
+			}
+
+			ft_rx = 0xff;
+			rc = test_amr_decode(afs, result, bursts_s, 0, &ft_rx,
+				&cmr_rx, &n_errors, &n_bits_total);
+			if (id != ft) {
+				id_err++;
+				if (rc == len && ft_rx == ft)
+					recovered++;
+			}
+			if (rc != len || ft_rx != ft) {
+				fer++;
+				continue;
+			}
+			for (i = 0; i < len; i++)
+				ber += __builtin_popcount(data[i] ^ result[i]);
+		}
+
+		/* the BER is the one of the frames with a valid CRC, as
+		 * the unprotected bits are not covered by the CRC */
+		fprintf(stderr, "amr awgn bench: %-13s Es/N0 %+3d dB: "
+			"FER %.4f BER %.5f ID errors %.4f, %d of them "
+			"recovered\n", name, snr_db[s], (double) fer / frames,
+			(fer < frames) ? (double) ber / ((frames - fer) * bits)
+				: 0.0,
+			(double) id_err / frames, recovered);
+	}
+}
+
+/* a repetition of a bad xCCH block is decoded with the soft bits of both */
+static void test_xcch_combine(uint8_t *l2, uint8_t *other)
+{
+	uint8_t result[23];
+	ubit_t bursts_u[116 * 4];
+	sbit_t first[116 * 4], repeated[116 * 4], unrelated[116 * 4];
+	int n_errors, n_bits_total, rc_first, rc_rep, rc, i;
+
+	xcch_encode(bursts_u, l2);
+	ubits2sbits(bursts_u, first, 116 * 4);
+	memcpy(repeated, first, sizeof(repeated));
+	xcch_encode(bursts_u, other);
+	ubits2sbits(bursts_u, unrelated, 116 * 4);
+
+	/* each transmission has the other half of the bits erased, and a
+	 * few errors */
+	test_rand_state = 1;
+	for (i = 0; i < 116 * 4; i++) {
+		if (i % 2 != 0)
+			first[i] = 0;
+		if (i % 2 != 1)
+			repeated[i] = 0;
+		if ((test_rand() & 31) == 0) {
+			first[i] = -first[i];
+			repeated[i] = -repeated[i];
+		}
+	}
+
+	rc_first = xcch_decode(result, first, &n_errors, &n_bits_total);
+	rc_rep = xcch_decode(result, repeated, &n_errors, &n_bits_total);
+	ASSERT_TRUE(rc_first != 0 && rc_rep != 0);
+
+	rc = xcch_decode_combined(result, repeated, first, &n_errors,
+		&n_bits_total);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(!memcmp(l2, result, 23));
+
+	/* a different block must not be taken for a repetition */
+	rc = xcch_decode_combined(result, unrelated, first, &n_errors,
+		&n_bits_total);
+	ASSERT_TRUE(rc != 0 || !memcmp(other, result, 23));
+
+	printf("xcch combining: ok\n");
+}
+
+/* a BPSK modulated bit after an AWGN channel, as soft bit */
+static sbit_t test_awgn_sbit(ubit_t bit, double sigma)
+{
+	double y = ((bit ? -1.0 : 1.0) + test_gauss(sigma)) * 64.0;
+
+	return (y > 127) ? 127 : (y < -127) ? -127 : (int) lrint(y);
+}
+
+/* block error rate of SACCH repetitions over an AWGN channel, alone and
+ * combined with the previous bad block, the results go to stderr */
+static void bench_xcch_combine(void)
+{
+	static const int snr_db[] = { -4, -2, 0 };
+	uint8_t l2[23], result[23];
+	ubit_t bursts_u[116 * 4];
+	sbit_t first[116 * 4], repeated[116 * 4];
+	int i, k, s, n_errors, n_bits_total;
+	int fer_first, fer_alone, fer_combined;
+	uint64_t t, ticks_alone, ticks_combined;
+	double sigma;
+	const int frames = 500;
+
+	for (s = 0; s < ARRAY_SIZE(snr_db); s++) {
+		sigma = sqrt(1.0 / (2.0 * pow(10.0, snr_db[s] / 10.0)));
+		fer_first = fer_alone = fer_combined = 0;
+		ticks_alone = ticks_combined = 0;
+
+		for (k = 0; k < frames; k++) {
+			for (i = 0; i < 23; i++)
+				l2[i] = test_rand();
+			xcch_encode(bursts_u, l2);
+			for (i = 0; i < 116 * 4; i++) {
+				first[i] = test_awgn_sbit(bursts_u[i], sigma);
+				repeated[i] = test_awgn_sbit(bursts_u[i],
+					sigma);
+			}
+
+			/* only a bad block is repeated */
+			if (xcch_decode(result, first, &n_errors,
+					&n_bits_total) == 0
+			 && !memcmp(l2, result, 23))
+				continue;
+			fer_first++;
+
+			t = bench_ticks();
+			if (xcch_decode(result, repeated, &n_errors,
+					&n_bits_total)
+			 || memcmp(l2, result, 23))
+				fer_alone++;
+			ticks_alone += bench_ticks() - t;
+
+			t = bench_ticks();
+			if (xcch_decode_combined(result, repeated, first,
+					&n_errors, &n_bits_total)
+			 || memcmp(l2, result, 23))
+				fer_combined++;
+			ticks_combined += bench_ticks() - t;
+		}
+
+		fprintf(stderr, "xcch combining bench: Es/N0 %+3d dB: "
+			"FER %.4f, of the repetitions alone %.4f, combined "
+			"%.4f, %llu / %llu " BENCH_UNIT "/block\n",
+			snr_db[s], (double) fer_first / frames,
+			fer_first ? (double) fer_alone / fer_first : 0.0,
+			fer_first ? (double) fer_combined / fer_first : 0.0,
+			(unsigned long long) (fer_first
+				? ticks_alone / fer_first : 0),
+			(unsigned long long) (fer_first
+				? ticks_combined / fer_first : 0));
+	}
+}
+
 uint8_t test_l2[][23] = {
 	/* dummy frame */
 	{ 0x03, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -449,6 +1032,8 @@ int main(int argc, char **argv)
 
 	bts_log_init(NULL);
 
+	gsm0503_viterbi_init();
+
 	for (i = 0; i < sizeof(test_l2) / sizeof(test_l2[0]); i++)
 		test_xcch(test_l2[i]);
 
@@ -489,6 +1074,27 @@ int main(int argc, char **argv)
 		test_pdtch(test_macblock[i], 54);
 	}
 
+	for (i = 0; i < ARRAY_SIZE(test_conv_codes); i++)
+		test_viterbi(test_conv_codes[i].code, test_conv_codes[i].name);
+	for (i = 0; i < ARRAY_SIZE(test_conv_codes); i++)
+		bench_viterbi(test_conv_codes[i].code, test_conv_codes[i].name);
+
+	test_interleaving();
+	bench_interleaving();
+
+	test_amr_ic();
+	for (i = 0; i < ARRAY_SIZE(test_amr_modes); i++)
+		test_amr(test_amr_modes[i].afs, test_amr_modes[i].ft,
+			test_amr_modes[i].len, test_amr_modes[i].bits,
+			test_amr_modes[i].name);
+	for (i = 0; i < ARRAY_SIZE(test_amr_modes); i++)
+		bench_amr_awgn(test_amr_modes[i].afs, test_amr_modes[i].ft,
+			test_amr_modes[i].len, test_amr_modes[i].bits,
+			test_amr_modes[i].name);
+
+	test_xcch_combine(test_l2[1], test_l2[2]);
+	bench_xcch_combine();
+
 	printf("Success\n");
 
 	return 0;
@@ -0,0 +1,196 @@
+/* testing the CBCH scheduling */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/gsm/protocol/gsm_04_12.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/cbch.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_BENCH_BLOCKS	(4 * 100000)
+
+static struct gsm_bts *bts;
+static struct gsm_bts_role_bts *btsb;
+
+/* CBCH block of the 51-multiframe mf */
+static const uint8_t *cbch_block(uint32_t mf)
+{
+	static uint8_t out[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+
+	gsm_fn2gsmtime(&g_time, mf * 51 + 32);
+	memset(out, 0, sizeof(out));
+	OSMO_ASSERT(bts_cbch_get(bts, out, &g_time) == 0);
+
+	return out;
+}
+
+/* sequence number of the block, with the last block flag in bit 4 */
+static int cbch_seq(uint32_t mf)
+{
+	const uint8_t *block = cbch_block(mf);
+	struct gsm412_block_type *bt = (struct gsm412_block_type *) block;
+
+	OSMO_ASSERT(bt->lpd == 1);
+	return bt->seq_nr | (bt->lb << 4);
+}
+
+static void smscb_cmd(uint8_t command, uint8_t last_block, int def_bcast,
+		      int extended, uint8_t fill)
+{
+	struct rsl_ie_cb_cmd_type cmd_type;
+	uint8_t msg[GSM412_MSG_LEN];
+
+	memset(&cmd_type, 0, sizeof(cmd_type));
+	cmd_type.command = command;
+	cmd_type.last_block = last_block;
+	cmd_type.def_bcast = def_bcast;
+	memset(msg, fill, sizeof(msg));
+
+	OSMO_ASSERT(bts_process_smscb_cmd(bts, cmd_type, extended,
+					  sizeof(msg), msg) == 0);
+}
+
+static void test_cbch_null(void)
+{
+	uint32_t mf;
+
+	printf("Testing CBCH without messages.\n");
+
+	for (mf = 0; mf < 16; mf++) {
+		const uint8_t *block = cbch_block(mf);
+		OSMO_ASSERT(cbch_seq(mf) == GSM412_SEQ_NULL_MSG);
+		OSMO_ASSERT(block[1] == GSM_MACBLOCK_PADDING);
+		OSMO_ASSERT(block[22] == GSM_MACBLOCK_PADDING);
+	}
+}
+
+static void test_cbch_basic_extended(void)
+{
+	const uint8_t *block;
+
+	printf("Testing basic and extended CBCH.\n");
+
+	/* two blocks on the basic, four on the extended CBCH */
+	smscb_cmd(RSL_CB_CMD_TYPE_NORMAL, RSL_CB_CMD_LASTBLOCK_2, 0, 0, 0x11);
+	smscb_cmd(RSL_CB_CMD_TYPE_NORMAL, RSL_CB_CMD_LASTBLOCK_4, 0, 1, 0x22);
+	smscb_cmd(RSL_CB_CMD_TYPE_SCHEDULE, RSL_CB_CMD_LASTBLOCK_1, 0, 0, 0x33);
+	OSMO_ASSERT(btsb->smscb_basic.queue_len == 2);
+	OSMO_ASSERT(btsb->smscb_extended.queue_len == 1);
+
+	block = cbch_block(8);
+	OSMO_ASSERT(block[0] == 0x20 && block[1] == 0x11 && block[22] == 0x11);
+	OSMO_ASSERT(cbch_seq(8 + 1) == (1 | 0x10));
+	OSMO_ASSERT(cbch_seq(8 + 2) == GSM412_SEQ_NULL_MSG);
+	OSMO_ASSERT(cbch_seq(8 + 3) == GSM412_SEQ_NULL_MSG);
+
+	block = cbch_block(8 + 4);
+	OSMO_ASSERT(block[0] == 0x20 && block[1] == 0x22);
+	OSMO_ASSERT(cbch_seq(8 + 5) == 1);
+	OSMO_ASSERT(cbch_seq(8 + 6) == 2);
+	OSMO_ASSERT(cbch_seq(8 + 7) == (3 | 0x10));
+
+	/* the schedule message is next on the basic CBCH */
+	OSMO_ASSERT(cbch_seq(16) == (GSM412_SEQ_FST_SCHED_BLOCK | 0x10));
+	OSMO_ASSERT(cbch_seq(16 + 1) == GSM412_SEQ_NULL_MSG);
+	OSMO_ASSERT(cbch_seq(16 + 4) == GSM412_SEQ_NULL_MSG);
+	OSMO_ASSERT(btsb->smscb_basic.queue_len == 0);
+	OSMO_ASSERT(btsb->smscb_extended.queue_len == 0);
+}
+
+static void test_cbch_default(void)
+{
+	uint32_t mf;
+
+	printf("Testing CBCH default message.\n");
+
+	/* a default message repeats while nothing else is queued */
+	smscb_cmd(RSL_CB_CMD_TYPE_DEFAULT, RSL_CB_CMD_LASTBLOCK_1, 0, 0, 0x44);
+	smscb_cmd(RSL_CB_CMD_TYPE_NORMAL, RSL_CB_CMD_LASTBLOCK_1, 0, 0, 0x55);
+
+	OSMO_ASSERT(cbch_block(24)[1] == 0x55);
+	for (mf = 32; mf < 64; mf += 8) {
+		OSMO_ASSERT(cbch_block(mf)[1] == 0x44);
+		OSMO_ASSERT(cbch_seq(mf) == (GSM412_SEQ_FST_BLOCK | 0x10));
+		OSMO_ASSERT(cbch_seq(mf + 1) == GSM412_SEQ_NULL_MSG);
+	}
+
+	/* replace it while it is being sent */
+	smscb_cmd(RSL_CB_CMD_TYPE_DEFAULT, RSL_CB_CMD_LASTBLOCK_1, 0, 0, 0x66);
+	OSMO_ASSERT(cbch_block(64)[1] == 0x66);
+
+	/* and go back to NULL messages */
+	smscb_cmd(RSL_CB_CMD_TYPE_DEFAULT, RSL_CB_CMD_LASTBLOCK_1, 1, 0, 0);
+	OSMO_ASSERT(cbch_seq(72) == GSM412_SEQ_NULL_MSG);
+	OSMO_ASSERT(btsb->smscb_basic.cur_msg == NULL);
+}
+
+static void test_cbch_bench(void)
+{
+	struct timespec start, end;
+	uint32_t mf;
+	double ns;
+
+	printf("Testing continuous CBCH broadcast.\n");
+
+	smscb_cmd(RSL_CB_CMD_TYPE_DEFAULT, RSL_CB_CMD_LASTBLOCK_4, 0, 0, 0x77);
+	smscb_cmd(RSL_CB_CMD_TYPE_DEFAULT, RSL_CB_CMD_LASTBLOCK_4, 0, 1, 0x88);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (mf = 80; mf < 80 + NUM_BENCH_BLOCKS; mf++)
+		OSMO_ASSERT(cbch_block(mf)[1] == (mf % 8 < 4 ? 0x77 : 0x88));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	fprintf(stderr, "%u CBCH blocks: %.1f ms, %.0f ns/block\n",
+		NUM_BENCH_BLOCKS, ns / 1e6, ns / NUM_BENCH_BLOCKS);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_msgb_ctx;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	tall_msgb_ctx = talloc_named_const(tall_bts_ctx, 1, "msgb");
+	msgb_set_talloc_ctx(tall_msgb_ctx);
+
+	bts_log_init(NULL);
+
+	bts = gsm_bts_alloc(tall_bts_ctx);
+	if (bts_init(bts) < 0) {
+		fprintf(stderr, "unable to open bts\n");
+		exit(1);
+	}
+
+	btsb = bts_role_bts(bts);
+	test_cbch_null();
+	test_cbch_basic_extended();
+	test_cbch_default();
+	test_cbch_bench();
+	printf("Success\n");
+
+	return 0;
+}
@@ -22,10 +22,16 @@
 #include <osmo-bts/paging.h>
 #include <osmo-bts/gsm_data.h>
 
+#include <osmo-bts/a5_ks.h>
+
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/gsm/a5.h>
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 static struct gsm_bts *bts;
 static struct gsm_bts_role_bts *btsb;
@@ -64,6 +70,111 @@ static void test_cipher_parsing(void)
 	ASSERT_TRUE(bts_supports_cipher(btsb, 0x9) == -ENOTSUP);
 }
 
+static const uint8_t test_key[8] = {
+	0x12, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+
+/* compare batched keystreams with osmo_a5() */
+static void test_a5_ks_gen(int algo)
+{
+	uint32_t fn[A5_KS_LANES];
+	uint64_t ks[114];
+	ubit_t ref[114];
+	int ul, j, i;
+
+	printf("Testing A5/%d keystream batches\n", algo);
+
+	for (j = 0; j < A5_KS_LANES; j++)
+		fn[j] = (j * 2713 + 42) % GSM_HYPERFRAME;
+	fn[A5_KS_LANES - 1] = GSM_HYPERFRAME - 1;
+
+	for (ul = 0; ul < 2; ul++) {
+		a5_ks_gen(algo, test_key, fn, A5_KS_LANES, ul, ks);
+		for (j = 0; j < A5_KS_LANES; j++) {
+			memset(ref, 0, sizeof(ref));
+			if (ul)
+				osmo_a5(algo, test_key, fn[j], NULL, ref);
+			else
+				osmo_a5(algo, test_key, fn[j], ref, NULL);
+			for (i = 0; i < 114; i++)
+				ASSERT_TRUE(((ks[i] >> j) & 1) == ref[i]);
+		}
+	}
+}
+
+static void test_a5_ks_cache(void)
+{
+	struct a5_ks_cache c;
+	uint32_t fn[4] = { 100, 104, 108, 112 };
+	uint8_t key2[8];
+
+	printf("Testing keystream cache\n");
+
+	memset(&c, 0, sizeof(c));
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 100) == -1);
+
+	a5_ks_fill(&c, 1, test_key, fn, 4, 0);
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 100) == 0);
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 108) == 2);
+	/* frame between two lanes */
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 110) == -1);
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 112) == 3);
+	/* frames before the current lane are gone */
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 104) == -1);
+	/* beyond the last lane */
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 116) == -1);
+
+	/* other key or algorithm */
+	a5_ks_fill(&c, 1, test_key, fn, 4, 0);
+	memcpy(key2, test_key, sizeof(key2));
+	key2[7] ^= 1;
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, key2, 100) == -1);
+	ASSERT_TRUE(a5_ks_lookup(&c, 3, test_key, 100) == -1);
+	ASSERT_TRUE(a5_ks_lookup(&c, 1, test_key, 100) == 0);
+}
+
+static double elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e9
+		+ (now.tv_nsec - start->tv_nsec);
+}
+
+#define BENCH_BATCHES	500
+
+/* throughput of osmo_a5() versus batched keystreams, to stderr */
+static void bench_a5_ks(int algo)
+{
+	uint32_t fn[A5_KS_LANES];
+	uint64_t ks[114];
+	ubit_t bits[114];
+	struct timespec start;
+	double t_scalar, t_batch;
+	int b, j;
+
+	for (j = 0; j < A5_KS_LANES; j++)
+		fn[j] = j;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (b = 0; b < BENCH_BATCHES; b++) {
+		for (j = 0; j < A5_KS_LANES; j++)
+			osmo_a5(algo, test_key, fn[j] + b, bits, NULL);
+	}
+	t_scalar = elapsed_ns(&start) / (BENCH_BATCHES * A5_KS_LANES);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (b = 0; b < BENCH_BATCHES; b++) {
+		fn[0] = b;
+		a5_ks_gen(algo, test_key, fn, A5_KS_LANES, 0, ks);
+	}
+	t_batch = elapsed_ns(&start) / (BENCH_BATCHES * A5_KS_LANES);
+
+	fprintf(stderr, "A5/%d: osmo_a5() %.0f ns/frame, batched %.0f "
+		"ns/frame (%s)\n", algo, t_scalar, t_batch,
+		(algo == 1 && a5_ks_bitsliced()) ? "bit-sliced" : "osmo_a5()");
+}
+
 int main(int argc, char **argv)
 {
 	void *tall_msgb_ctx;
@@ -82,6 +193,14 @@ int main(int argc, char **argv)
 
 	btsb = bts_role_bts(bts);
 	test_cipher_parsing();
+
+	a5_ks_init();
+	ASSERT_TRUE(a5_ks_bitsliced());
+	test_a5_ks_gen(1);
+	test_a5_ks_gen(3);
+	test_a5_ks_cache();
+	bench_a5_ks(1);
+	bench_a5_ks(3);
 	printf("Success\n");
 
 	return 0;
@@ -0,0 +1,206 @@
+/* testing the rate limited GSMTAP ring */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsmtap_ring.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n",  \
+		       __FILE__, __LINE__);          \
+		abort();			     \
+	}
+
+#define NUM_DATAGRAMS	5000
+
+static void *ctx;
+
+static int enqueue(struct gsmtap_ring *r, uint32_t fn, unsigned int len)
+{
+	uint8_t data[GSMTAP_RING_SLOT_SIZE];
+
+	memset(data, fn & 0xff, sizeof(data));
+	return gsmtap_ring_enqueue(r, 871 | GSMTAP_ARFCN_F_UPLINK, fn % 8,
+				   GSMTAP_CHANNEL_SDCCH, 3, fn, -70, 20,
+				   data, len);
+}
+
+static void test_ring_full(void)
+{
+	struct gsmtap_ring *r;
+	unsigned int i;
+
+	printf("Testing full ring\n");
+
+	/* without the sender thread, nothing leaves the ring */
+	r = gsmtap_ring_alloc(ctx, 5);
+	ASSERT_TRUE(r);
+	ASSERT_TRUE(r->num_slots == 8);
+
+	for (i = 0; i < 8; i++)
+		ASSERT_TRUE(enqueue(r, i, 23) == 0);
+	ASSERT_TRUE(enqueue(r, 8, 23) == -ENOBUFS);
+	ASSERT_TRUE(enqueue(r, 9, 23) == -ENOBUFS);
+	ASSERT_TRUE(enqueue(r, 10, GSMTAP_RING_SLOT_SIZE) == -EMSGSIZE);
+
+	printf(" queued %u, full %u, oversize %u\n", r->stats.queued,
+		r->stats.full, r->stats.oversize);
+
+	gsmtap_ring_free(r);
+}
+
+static void test_rate_limit(void)
+{
+	struct gsmtap_ring *r;
+	unsigned int i;
+
+	printf("Testing rate limit\n");
+
+	r = gsmtap_ring_alloc(ctx, 64);
+	ASSERT_TRUE(r);
+
+	/* a burst of 5, then one per second */
+	gsmtap_ring_set_rate(r, 1, 5);
+	for (i = 0; i < 20; i++)
+		enqueue(r, i, 23);
+	printf(" queued %u, rate limited %u\n", r->stats.queued,
+		r->stats.rate_limited);
+
+	gsmtap_ring_set_rate(r, 0, 0);
+	for (i = 0; i < 20; i++)
+		ASSERT_TRUE(enqueue(r, i, 23) == 0);
+	printf(" without limit: queued %u, rate limited %u\n",
+		r->stats.queued, r->stats.rate_limited);
+
+	gsmtap_ring_free(r);
+}
+
+/* check a datagram as gsmtap_makemsg() would build it */
+static void check_datagram(const uint8_t *buf, int len, uint32_t fn)
+{
+	const struct gsmtap_hdr *gh = (const struct gsmtap_hdr *) buf;
+	unsigned int i, pl_len = 1 + fn % 60;
+
+	ASSERT_TRUE(len == sizeof(*gh) + pl_len);
+	ASSERT_TRUE(gh->version == GSMTAP_VERSION);
+	ASSERT_TRUE(gh->hdr_len == sizeof(*gh) / 4);
+	ASSERT_TRUE(gh->type == GSMTAP_TYPE_UM);
+	ASSERT_TRUE(gh->timeslot == fn % 8);
+	ASSERT_TRUE(gh->sub_slot == 3);
+	ASSERT_TRUE(ntohs(gh->arfcn) == (871 | GSMTAP_ARFCN_F_UPLINK));
+	ASSERT_TRUE(gh->signal_dbm == -70);
+	ASSERT_TRUE(gh->snr_db == 20);
+	ASSERT_TRUE(ntohl(gh->frame_number) == fn);
+	ASSERT_TRUE(gh->sub_type == GSMTAP_CHANNEL_SDCCH);
+	for (i = 0; i < pl_len; i++)
+		ASSERT_TRUE(buf[sizeof(*gh) + i] == (fn & 0xff));
+}
+
+static void test_tx_thread(void)
+{
+	struct gsmtap_ring *r;
+	struct sockaddr_in sin;
+	socklen_t sin_len = sizeof(sin);
+	struct timespec start, end;
+	uint8_t buf[GSMTAP_RING_SLOT_SIZE];
+	unsigned int next = 0, fn = 0;
+	int rx_fd, tx_fd, rc;
+	double ns;
+
+	printf("Testing sender thread\n");
+
+	rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	ASSERT_TRUE(rx_fd >= 0 && tx_fd >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_TRUE(bind(rx_fd, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+	ASSERT_TRUE(getsockname(rx_fd, (struct sockaddr *) &sin,
+				&sin_len) == 0);
+	ASSERT_TRUE(connect(tx_fd, (struct sockaddr *) &sin, sin_len) == 0);
+
+	r = gsmtap_ring_alloc(ctx, 64);
+	ASSERT_TRUE(r);
+	ASSERT_TRUE(gsmtap_ring_start(r, tx_fd) == 0);
+	ASSERT_TRUE(gsmtap_ring_start(r, tx_fd) == -EBUSY);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (next < NUM_DATAGRAMS) {
+		/* the main loop drops, the test waits for the sender */
+		while (fn < NUM_DATAGRAMS
+		    && enqueue(r, fn, 1 + fn % 60) == 0)
+			fn++;
+
+		rc = recv(rx_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (rc < 0) {
+			ASSERT_TRUE(errno == EAGAIN);
+			usleep(100);
+			continue;
+		}
+		check_datagram(buf, rc, next);
+		next++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	fprintf(stderr, "%u datagrams in %.1f ms, %u system calls, "
+		"ring full %u times, max fill %u\n", NUM_DATAGRAMS, ns / 1e6,
+		r->stats.syscalls, r->stats.full, r->stats.max_fill);
+
+	gsmtap_ring_stop(r);
+	ASSERT_TRUE(r->stats.queued == NUM_DATAGRAMS);
+	ASSERT_TRUE(r->stats.sent == NUM_DATAGRAMS);
+	ASSERT_TRUE(r->stats.tx_errors == 0);
+	ASSERT_TRUE(r->stats.syscalls <= NUM_DATAGRAMS);
+
+	gsmtap_ring_free(r);
+	close(rx_fd);
+	close(tx_fd);
+}
+
+int main(int argc, char **argv)
+{
+	ctx = talloc_named_const(NULL, 1, "gsmtap_ring_test");
+
+	bts_log_init(NULL);
+
+	test_ring_full();
+	test_rate_limit();
+	test_tx_thread();
+
+	printf("Success\n");
+
+	return 0;
+}
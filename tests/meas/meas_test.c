@@ -0,0 +1,191 @@
+/* testing the uplink measurement processing */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/measurement.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static struct gsm_bts *bts;
+static struct gsm_bts_trx *trx;
+
+/* TS 05.08, Chapter 8.4.1: last frame of the measurement period, fn % 104
+ * for TCH and fn % 102 for SDCCH */
+static int is_meas_complete(enum gsm_phys_chan_config pchan, unsigned int ts,
+			    unsigned int subch, uint32_t fn)
+{
+	static const uint8_t tchf[] = { 103, 12, 25, 38, 51, 64, 77, 90 };
+	static const uint8_t tchh0[] = { 103, 103, 25, 25, 51, 51, 77, 77 };
+	static const uint8_t tchh1[] = { 12, 12, 38, 38, 64, 64, 90, 90 };
+
+	switch (pchan) {
+	case GSM_PCHAN_TCH_F:
+		return tchf[ts] == fn % 104;
+	case GSM_PCHAN_TCH_H:
+		return (subch ? tchh1 : tchh0)[ts] == fn % 104;
+	case GSM_PCHAN_SDCCH8_SACCH8C:
+		return fn % 102 == 11;
+	case GSM_PCHAN_CCCH_SDCCH4:
+		return fn % 102 == 36;
+	default:
+		return 0;
+	}
+}
+
+static void set_pchan(enum gsm_phys_chan_config pchan,
+		      enum gsm_chan_t type, unsigned int num_lchans)
+{
+	unsigned int tn, i;
+
+	for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+		struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+
+		ts->pchan = pchan;
+		for (i = 0; i < ARRAY_SIZE(ts->lchan); i++) {
+			ts->lchan[i].state = i < num_lchans ?
+				LCHAN_S_ACTIVE : LCHAN_S_NONE;
+			ts->lchan[i].type = type;
+			ts->lchan[i].meas.num_ul_meas = 0;
+		}
+	}
+}
+
+/* feed one measurement to every lchan in every frame, an lchan whose period
+ * ended has no measurement left */
+static void test_meas_period(const char *name,
+			     enum gsm_phys_chan_config pchan,
+			     enum gsm_chan_t type, unsigned int num_lchans)
+{
+	struct bts_ul_meas ulm = { .ber10k = 0, .inv_rssi = 70 };
+	unsigned int tn, i, num_rep = 0;
+	uint32_t fn;
+
+	printf("Testing measurement periods of %s\n", name);
+
+	set_pchan(pchan, type, num_lchans);
+
+	for (fn = 0; fn < 104 * 102; fn++) {
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++)
+			for (i = 0; i < num_lchans; i++)
+				OSMO_ASSERT(lchan_new_ul_meas(
+					&trx->ts[tn].lchan[i], &ulm) == 0);
+
+		trx_meas_check_compute(trx, fn);
+
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			for (i = 0; i < num_lchans; i++) {
+				struct gsm_lchan *lchan = &trx->ts[tn].lchan[i];
+				int rep = is_meas_complete(pchan, tn, i, fn);
+
+				OSMO_ASSERT(rep == (lchan->meas.num_ul_meas == 0));
+				if (rep) {
+					num_rep++;
+					/* the next period starts empty */
+					OSMO_ASSERT(lchan->meas.flags
+						    & LC_UL_M_F_RES_VALID);
+					lchan->meas.flags &= ~LC_UL_M_F_RES_VALID;
+				}
+			}
+		}
+	}
+
+	printf(" %u reports\n", num_rep);
+	set_pchan(GSM_PCHAN_NONE, GSM_LCHAN_NONE, 0);
+}
+
+static void test_meas_average(void)
+{
+	struct gsm_lchan *lchan = &trx->ts[2].lchan[0];
+	struct bts_ul_meas ulm;
+	unsigned int i;
+
+	printf("Testing averaging of measurements\n");
+
+	set_pchan(GSM_PCHAN_TCH_F, GSM_LCHAN_TCH_F, 1);
+
+	/* a stale measurement of an earlier period is not counted */
+	memset(&ulm, 0, sizeof(ulm));
+	ulm.ber10k = 10000;
+	lchan_new_ul_meas(lchan, &ulm);
+	trx_meas_check_compute(trx, 104 + 25);
+	lchan->meas.flags = 0;
+
+	for (i = 0; i < 4; i++) {
+		memset(&ulm, 0, sizeof(ulm));
+		ulm.ber10k = i * 100;
+		ulm.inv_rssi = 60 + 2 * i;
+		ulm.ta_offs_qbits = -2 + i;
+		ulm.is_sub = i < 2;
+		OSMO_ASSERT(lchan_new_ul_meas(lchan, &ulm) == 0);
+	}
+	OSMO_ASSERT(lchan->meas.num_ul_meas == 4);
+
+	/* not the end of the period of TS2 */
+	trx_meas_check_compute(trx, 2 * 104 + 12);
+	OSMO_ASSERT(lchan->meas.num_ul_meas == 4);
+	OSMO_ASSERT(!(lchan->meas.flags & LC_UL_M_F_RES_VALID));
+
+	trx_meas_check_compute(trx, 2 * 104 + 25);
+	OSMO_ASSERT(lchan->meas.num_ul_meas == 0);
+	OSMO_ASSERT(lchan->meas.flags & LC_UL_M_F_RES_VALID);
+
+	printf(" full: RXLEV %u RXQUAL %u, sub: RXLEV %u RXQUAL %u\n",
+		lchan->meas.ul_res.full.rx_lev,
+		lchan->meas.ul_res.full.rx_qual,
+		lchan->meas.ul_res.sub.rx_lev,
+		lchan->meas.ul_res.sub.rx_qual);
+
+	set_pchan(GSM_PCHAN_NONE, GSM_LCHAN_NONE, 0);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_msgb_ctx;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	tall_msgb_ctx = talloc_named_const(tall_bts_ctx, 1, "msgb");
+	msgb_set_talloc_ctx(tall_msgb_ctx);
+
+	bts_log_init(NULL);
+
+	bts = gsm_bts_alloc(tall_bts_ctx);
+	trx = gsm_bts_trx_alloc(bts);
+	if (!trx || bts_init(bts) < 0) {
+		fprintf(stderr, "unable to open bts\n");
+		exit(1);
+	}
+
+	test_meas_period("TCH/F", GSM_PCHAN_TCH_F, GSM_LCHAN_TCH_F, 1);
+	test_meas_period("TCH/H", GSM_PCHAN_TCH_H, GSM_LCHAN_TCH_H, 2);
+	test_meas_period("SDCCH/8", GSM_PCHAN_SDCCH8_SACCH8C,
+			 GSM_LCHAN_SDCCH, 8);
+	test_meas_period("SDCCH/4", GSM_PCHAN_CCCH_SDCCH4,
+			 GSM_LCHAN_SDCCH, 4);
+	test_meas_average();
+	printf("Success\n");
+
+	return 0;
+}
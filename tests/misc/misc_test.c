@@ -23,11 +23,17 @@
 #include <osmo-bts/bts.h>
 #include <osmo-bts/msg_utils.h>
 #include <osmo-bts/logging.h>
+#include <osmo-bts/dl_tch_ring.h>
+#include <osmo-bts/pcu_shm.h>
 
 #include <osmocom/gsm/protocol/ipaccess.h>
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 static const uint8_t ipa_rsl_connect[] = {
 	0x00, 0x1c, 0xff, 0x10, 0x80, 0x00, 0x0a, 0x0d,
@@ -157,6 +163,145 @@ static void test_sacch_get(void)
 	}
 }
 
+static void test_dl_tch_ring(void)
+{
+	struct dl_tch_ring ring;
+	uint8_t frame[DL_TCH_RING_MAX_LEN + 1];
+	const uint8_t *data;
+	unsigned int len;
+
+	printf("Testing downlink TCH ring\n");
+	dl_tch_ring_init(&ring);
+
+	/* nothing received yet is not an underrun */
+	OSMO_ASSERT(dl_tch_ring_pop(&ring, 0, 1, &len) == NULL);
+	OSMO_ASSERT(ring.stats.underrun == 0);
+
+	/* frames written out of order are played out in order */
+	memset(frame, 2, sizeof(frame));
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 320, frame, 33) == 0);
+	memset(frame, 1, sizeof(frame));
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 160, frame, 33) == 0);
+	data = dl_tch_ring_pop(&ring, 160, 1, &len);
+	OSMO_ASSERT(data && len == 33 && data[0] == 1);
+	data = dl_tch_ring_pop(&ring, 320, 1, &len);
+	OSMO_ASSERT(data && len == 33 && data[32] == 2);
+
+	/* too late or too large */
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 320, frame, 33) == -ETIME);
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 480, frame, sizeof(frame))
+		    == -EMSGSIZE);
+
+	/* a duplicate replaces the frame of the same time */
+	memset(frame, 3, sizeof(frame));
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 480, frame, 31) == 0);
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 480, frame, 33) == 0);
+	data = dl_tch_ring_pop(&ring, 480, 1, &len);
+	OSMO_ASSERT(data && len == 33 && data[0] == 3);
+
+	/* one lost frame is replaced by the previous one, the next is not */
+	data = dl_tch_ring_pop(&ring, 640, 1, &len);
+	OSMO_ASSERT(data && len == 33 && data[0] == 3);
+	OSMO_ASSERT(dl_tch_ring_pop(&ring, 800, 1, &len) == NULL);
+	/* without concealment, nothing is sent */
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 960, frame, 33) == 0);
+	OSMO_ASSERT(dl_tch_ring_pop(&ring, 960, 0, &len) != NULL);
+	OSMO_ASSERT(dl_tch_ring_pop(&ring, 1120, 0, &len) == NULL);
+
+	/* a frame far ahead in the slot is not overwritten */
+	memset(frame, 4, sizeof(frame));
+	OSMO_ASSERT(dl_tch_ring_put(&ring, 1280 + 8 * 160, frame, 33) == 0);
+	OSMO_ASSERT(dl_tch_ring_pop(&ring, 1280, 1, &len) == NULL);
+	data = dl_tch_ring_pop(&ring, 1280 + 8 * 160, 1, &len);
+	OSMO_ASSERT(data && data[0] == 4);
+
+	OSMO_ASSERT(ring.stats.rx == 6);
+	OSMO_ASSERT(ring.stats.tx == 5);
+	OSMO_ASSERT(ring.stats.late == 1);
+	OSMO_ASSERT(ring.stats.oversize == 1);
+	OSMO_ASSERT(ring.stats.dup == 1);
+	OSMO_ASSERT(ring.stats.concealed == 1);
+	OSMO_ASSERT(ring.stats.underrun == 3);
+}
+
+static unsigned int shm_rx_next;
+
+static int shm_rx_cb(struct pcu_shm *shm, struct gsm_pcu_if *pcu_prim)
+{
+	OSMO_ASSERT(pcu_prim->msg_type == PCU_IF_MSG_DATA_REQ);
+	OSMO_ASSERT(pcu_prim->u.data_req.fn == shm_rx_next);
+	shm_rx_next++;
+	return 0;
+}
+
+static void test_pcu_shm(void)
+{
+	struct pcu_shm *shm;
+	struct gsm_pcu_if_shm *pcu;
+	struct gsm_pcu_if_shm_ring *r;
+	struct gsm_pcu_if *pcu_prim;
+	uint64_t count;
+	unsigned int i;
+
+	printf("Testing PCU shared memory\n");
+
+	shm = pcu_shm_alloc(NULL);
+	OSMO_ASSERT(shm);
+	OSMO_ASSERT(pcu_shm_start(shm, shm_rx_cb, NULL) == 0);
+
+	/* the PCU maps the memory of the received file descriptor */
+	pcu = mmap(NULL, sizeof(*pcu), PROT_READ | PROT_WRITE, MAP_SHARED,
+		   shm->mem_fd, 0);
+	OSMO_ASSERT(pcu != MAP_FAILED);
+	OSMO_ASSERT(pcu->version == PCU_IF_SHM_VERSION);
+	OSMO_ASSERT(pcu->num_slots == PCU_IF_SHM_SLOTS);
+
+	/* the PCU sleeps: only the first record rings its doorbell */
+	r = &pcu->to_pcu;
+	r->wait = 1;
+	for (i = 0; i < PCU_IF_SHM_SLOTS; i++) {
+		pcu_prim = pcu_shm_tx_slot(shm);
+		OSMO_ASSERT(pcu_prim);
+		pcu_prim->msg_type = PCU_IF_MSG_TIME_IND;
+		pcu_prim->u.time_ind.fn = i;
+		pcu_shm_tx_commit(shm);
+	}
+	OSMO_ASSERT(pcu_shm_tx_slot(shm) == NULL);
+	OSMO_ASSERT(read(shm->to_pcu_fd, &count, sizeof(count)) == 8);
+	OSMO_ASSERT(count == 1);
+	OSMO_ASSERT(shm->stats.doorbells == 1 && shm->stats.tx_full == 1);
+
+	/* the PCU reads everything, which makes room again */
+	for (i = 0; r->tail != r->head; i++, r->tail++)
+		OSMO_ASSERT(r->rec[r->tail % PCU_IF_SHM_SLOTS].u.time_ind.fn
+			    == i);
+	OSMO_ASSERT(i == PCU_IF_SHM_SLOTS);
+	OSMO_ASSERT(pcu_shm_tx_slot(shm) != NULL);
+
+	/* records from the PCU, across the end of the ring */
+	r = &pcu->from_pcu;
+	OSMO_ASSERT(r->wait == 1);
+	r->head = r->tail = (uint32_t) -3;
+	shm_rx_next = 0;
+	for (i = 0; i < 10; i++) {
+		pcu_prim = &r->rec[r->head % PCU_IF_SHM_SLOTS];
+		pcu_prim->msg_type = PCU_IF_MSG_DATA_REQ;
+		pcu_prim->u.data_req.fn = i;
+		r->head++;
+	}
+	OSMO_ASSERT(pcu_shm_rx(shm) == 10);
+	OSMO_ASSERT(shm_rx_next == 10 && r->tail == r->head);
+	OSMO_ASSERT(r->wait == 1);
+
+	/* a corrupt head is not followed */
+	r->head += PCU_IF_SHM_SLOTS + 1;
+	OSMO_ASSERT(pcu_shm_rx(shm) == -EIO);
+	OSMO_ASSERT(shm_rx_next == 10);
+
+	munmap(pcu, sizeof(*pcu));
+	pcu_shm_free(shm);
+}
+
 int main(int argc, char **argv)
 {
 	bts_log_init(NULL);
@@ -164,5 +309,7 @@ int main(int argc, char **argv)
 	test_sacch_get();
 	test_msg_utils_ipa();
 	test_msg_utils_oml();
+	test_dl_tch_ring();
+	test_pcu_shm();
 	return EXIT_SUCCESS;
 }
@@ -19,6 +19,7 @@
  *
  */
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
 
 #include <osmo-bts/bts.h>
 #include <osmo-bts/logging.h>
@@ -26,6 +27,7 @@
 #include <osmo-bts/gsm_data.h>
 
 #include <unistd.h>
+#include <errno.h>
 
 static struct gsm_bts *bts;
 static struct gsm_bts_role_bts *btsb;
@@ -110,6 +112,113 @@ static void test_paging_sleep(void)
 	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
 }
 
+static void test_paging_duplicates(void)
+{
+	int rc, i;
+	uint8_t ilv[sizeof(static_ilv)];
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	int is_empty = -1;
+	printf("Testing that duplicate pagings are suppressed.\n");
+
+	paging_config(btsb->paging_state, 200, 10);
+
+	/* many different identities in two groups */
+	memcpy(ilv, static_ilv, sizeof(ilv));
+	for (i = 0; i < 100; i++) {
+		ilv[8] = i;
+		rc = paging_add_identity(btsb->paging_state, i % 2, ilv, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 100);
+	ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, 0) == 50);
+	ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, 1) == 50);
+
+	/* all of them again, nothing is added */
+	for (i = 0; i < 100; i++) {
+		ilv[8] = i;
+		rc = paging_add_identity(btsb->paging_state, i % 2, ilv, 0);
+		ASSERT_TRUE(rc == -EEXIST);
+	}
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 100);
+	ASSERT_TRUE(paging_get_duplicates(btsb->paging_state) == 100);
+
+	/* the same identity in another group is not a duplicate */
+	ilv[8] = 0;
+	rc = paging_add_identity(btsb->paging_state, 2, ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, 2) == 1);
+
+	/* paging them does not remove them before their lifetime */
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 0);
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 101);
+	ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, 0) == 50);
+
+	paging_reset(btsb->paging_state);
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
+	for (i = 0; i < 3; i++) {
+		ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, i) == 0);
+		ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, i));
+	}
+
+	/* and they can be added again */
+	rc = paging_add_identity(btsb->paging_state, 0, ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	paging_reset(btsb->paging_state);
+}
+
+static void test_paging_wheel(void)
+{
+	int rc;
+	uint8_t ilv[sizeof(static_ilv)];
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	int is_empty = -1;
+	printf("Testing that paging records expire in the background.\n");
+
+	paging_config(btsb->paging_state, 200, 1);
+
+	/* two identities in group 0, one in group 1 */
+	memcpy(ilv, static_ilv, sizeof(ilv));
+	rc = paging_add_identity(btsb->paging_state, 0, ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	ilv[8] = 0x20;
+	rc = paging_add_identity(btsb->paging_state, 0, ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	ilv[8] = 0x21;
+	rc = paging_add_identity(btsb->paging_state, 1, ilv, 0);
+	ASSERT_TRUE(rc == 0);
+
+	/* page group 0 only */
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 0);
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 3);
+
+	/* the wheel drops group 0, group 1 has not been paged yet */
+	while (paging_queue_length(btsb->paging_state) != 1)
+		osmo_select_main(0);
+	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 0));
+	ASSERT_TRUE(paging_group_occupancy(btsb->paging_state, 1) == 1);
+	ASSERT_TRUE(paging_get_expired(btsb->paging_state) == 3);
+
+	g_time.t3 = 12;
+	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 0);
+	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 1));
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
+
+	paging_config(btsb->paging_state, 200, 0);
+}
+
 int main(int argc, char **argv)
 {
 	void *tall_msgb_ctx;
@@ -129,6 +238,8 @@ int main(int argc, char **argv)
 	btsb = bts_role_bts(bts);
 	test_paging_smoke();
 	test_paging_sleep();
+	test_paging_duplicates();
+	test_paging_wheel();
 	printf("Success\n");
 
 	return 0;
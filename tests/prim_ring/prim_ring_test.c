@@ -0,0 +1,197 @@
+/* testing the ring between L1 receive thread and main loop */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/prim_ring.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n",  \
+		       __FILE__, __LINE__);          \
+		abort();			     \
+	}
+
+/* size of a primitive written to the pipe */
+#define PRIM_LEN	64
+#define NUM_PRIMS	100000
+
+static void *ctx;
+
+static void test_ring_wrap(void)
+{
+	struct prim_ring *r;
+	const uint8_t *data;
+	unsigned int i, round, len, seq = 0, next = 0;
+	int tag;
+
+	printf("Testing ring wrap-around\n");
+
+	r = prim_ring_alloc(ctx, 5, 16);
+	ASSERT_TRUE(r);
+	ASSERT_TRUE(r->num_slots == 8);
+	ASSERT_TRUE(prim_ring_peek(r, &len, &tag) == NULL);
+
+	for (round = 0; round < 10; round++) {
+		/* fill a different number of slots each round */
+		for (i = 0; i < 3 + round % 6; i++) {
+			ASSERT_TRUE(prim_ring_space(r) == 8 - i);
+			memset(prim_ring_slot_buf(r, 0), seq & 0xff, 16);
+			prim_ring_produce(r, 1 + seq % 16, seq);
+			seq++;
+		}
+		if (round % 6 == 5)
+			ASSERT_TRUE(prim_ring_space(r) == 0);
+
+		while ((data = prim_ring_peek(r, &len, &tag))) {
+			ASSERT_TRUE(tag == next);
+			ASSERT_TRUE(len == 1 + next % 16);
+			ASSERT_TRUE(data[0] == (next & 0xff));
+			ASSERT_TRUE(data[15] == (next & 0xff));
+			prim_ring_consume(r);
+			next++;
+		}
+		ASSERT_TRUE(prim_ring_space(r) == 8);
+	}
+	ASSERT_TRUE(next == seq);
+	ASSERT_TRUE(r->stats.produced == seq);
+	ASSERT_TRUE(r->stats.dispatched == seq);
+	ASSERT_TRUE(r->stats.max_fill == 8);
+
+	prim_ring_free(r);
+}
+
+static int pipe_fds[2];
+static unsigned int rx_next;
+
+/* receive thread: read one primitive per free slot */
+static int pipe_rx_cb(struct prim_ring *r, int fd, int tag)
+{
+	unsigned int i, space = prim_ring_space(r);
+	int rc;
+
+	for (i = 0; i < space; i++) {
+		rc = read(fd, prim_ring_slot_buf(r, 0), PRIM_LEN);
+		if (rc < 0) {
+			if (errno == EAGAIN || i)
+				break;
+			return -errno;
+		}
+		ASSERT_TRUE(rc == PRIM_LEN);
+		prim_ring_produce(r, rc, tag);
+	}
+
+	return i;
+}
+
+static void pipe_dispatch_cb(struct prim_ring *r, const uint8_t *data,
+			     unsigned int len, int tag)
+{
+	unsigned int seq;
+
+	ASSERT_TRUE(len == PRIM_LEN);
+	ASSERT_TRUE(tag == 42);
+	memcpy(&seq, data, sizeof(seq));
+	ASSERT_TRUE(seq == rx_next);
+	ASSERT_TRUE(data[PRIM_LEN - 1] == (seq & 0xff));
+	rx_next++;
+}
+
+static void *pipe_writer(void *arg)
+{
+	uint8_t buf[PRIM_LEN];
+	unsigned int seq;
+
+	for (seq = 0; seq < NUM_PRIMS; seq++) {
+		memset(buf, seq & 0xff, sizeof(buf));
+		memcpy(buf, &seq, sizeof(seq));
+		/* writes of up to PIPE_BUF bytes are atomic */
+		ASSERT_TRUE(write(pipe_fds[1], buf, sizeof(buf)) == PRIM_LEN);
+	}
+
+	return NULL;
+}
+
+static void test_rx_thread(void)
+{
+	struct prim_ring *r;
+	struct timespec start, end;
+	pthread_t writer;
+	double ns;
+
+	printf("Testing receive thread\n");
+
+	ASSERT_TRUE(pipe(pipe_fds) == 0);
+	/* like the PHY socket, the thread reads until nothing is left */
+	ASSERT_TRUE(fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK) == 0);
+
+	r = prim_ring_alloc(ctx, 64, PRIM_LEN);
+	ASSERT_TRUE(r);
+	ASSERT_TRUE(prim_ring_add_fd(r, pipe_fds[0], 42) == 0);
+	ASSERT_TRUE(prim_ring_start(r, pipe_rx_cb, pipe_dispatch_cb, NULL,
+				    0) == 0);
+	ASSERT_TRUE(prim_ring_add_fd(r, pipe_fds[0], 43) == -EBUSY);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ASSERT_TRUE(pthread_create(&writer, NULL, pipe_writer, NULL) == 0);
+	while (rx_next < NUM_PRIMS)
+		osmo_select_main(0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_join(writer, NULL);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	fprintf(stderr, "%u primitives in %.1f ms, %.0f ns/primitive, "
+		"ring full %u times, max fill %u\n", NUM_PRIMS, ns / 1e6,
+		ns / NUM_PRIMS, r->stats.full, r->stats.max_fill);
+
+	ASSERT_TRUE(r->stats.produced == NUM_PRIMS);
+	ASSERT_TRUE(r->stats.dispatched == NUM_PRIMS);
+	ASSERT_TRUE(r->stats.rx_errors == 0);
+
+	prim_ring_free(r);
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+}
+
+int main(int argc, char **argv)
+{
+	ctx = talloc_named_const(NULL, 1, "prim_ring_test");
+
+	bts_log_init(NULL);
+
+	test_ring_wrap();
+	test_rx_thread();
+
+	printf("Success\n");
+
+	return 0;
+}
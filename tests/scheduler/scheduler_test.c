@@ -0,0 +1,277 @@
+/* testing the dispatch of the common L1 scheduler */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n",  \
+		       __FILE__, __LINE__);          \
+		abort();			     \
+	}
+
+/* least common multiple of all multiframe periods */
+#define TEST_FRAMES	5304
+#define BENCH_ROUNDS	20
+
+static struct gsm_bts *bts;
+static struct l1sched_trx l1t;
+
+static ubit_t test_burst[148];
+static unsigned int dl_calls, ul_calls;
+static uint32_t last_fn;
+
+/*
+ * Burst handlers of the backend.  They only count, so the benchmark
+ * measures the dispatch of the scheduler itself.
+ */
+
+static ubit_t *tx_count(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{
+	ASSERT_TRUE(fn == last_fn);
+	dl_calls++;
+	return test_burst;
+}
+
+static int rx_count(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{
+	ASSERT_TRUE(fn == last_fn);
+	ul_calls++;
+	return 0;
+}
+
+ubit_t *tx_idle_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_fcch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_sch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+ubit_t *tx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid)
+{ return tx_count(l1t, tn, fn, chan, bid); }
+
+int rx_rach_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{ return rx_count(l1t, tn, fn, chan, bid, bits, rssi, toa); }
+int rx_data_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{ return rx_count(l1t, tn, fn, chan, bid, bits, rssi, toa); }
+int rx_pdtch_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{ return rx_count(l1t, tn, fn, chan, bid, bits, rssi, toa); }
+int rx_tchf_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{ return rx_count(l1t, tn, fn, chan, bid, bits, rssi, toa); }
+int rx_tchh_fn(struct l1sched_trx *l1t, uint8_t tn, uint32_t fn,
+	enum trx_chan_type chan, uint8_t bid, sbit_t *bits, int8_t rssi,
+	float toa)
+{ return rx_count(l1t, tn, fn, chan, bid, bits, rssi, toa); }
+
+void _sched_act_rach_det(struct l1sched_trx *l1t, uint8_t tn, uint8_t ss,
+	int activate)
+{
+}
+
+static void set_lchans(uint8_t tn, int active)
+{
+	int i;
+
+	for (i = 0; i < _TRX_CHAN_MAX; i++) {
+		if (trx_chan_desc[i].auto_active || !trx_chan_desc[i].chan_nr)
+			continue;
+		trx_sched_set_lchan(&l1t, trx_chan_desc[i].chan_nr | tn,
+			trx_chan_desc[i].link_id, active);
+	}
+}
+
+/* run the scheduler over all frames, starting at fn 1 */
+static void run_frames(uint8_t tn)
+{
+	sbit_t bits[148];
+	uint32_t fn;
+
+	memset(bits, 0, sizeof(bits));
+	for (fn = 1; fn <= TEST_FRAMES; fn++) {
+		last_fn = fn;
+		_sched_dl_burst(&l1t, tn, fn);
+		trx_sched_ul_burst(&l1t, tn, fn, bits, -60, 0);
+	}
+}
+
+static double elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e9
+		+ (now.tv_nsec - start->tv_nsec);
+}
+
+static void test_pchan(enum gsm_phys_chan_config pchan, const char *name,
+	uint8_t tn)
+{
+	struct timespec start;
+	int round, active;
+
+	for (active = 1; active >= 0; active--) {
+		trx_sched_init(&l1t, bts->c0);
+		ASSERT_TRUE(trx_sched_set_pchan(&l1t, tn, pchan) == 0);
+		if (active)
+			set_lchans(tn, 1);
+
+		dl_calls = ul_calls = 0;
+		run_frames(tn);
+		printf("%s ts=%u %s: %u DL and %u UL bursts\n", name, tn,
+			active ? "active" : "inactive", dl_calls, ul_calls);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (round = 0; round < BENCH_ROUNDS; round++) {
+			trx_sched_init(&l1t, bts->c0);
+			trx_sched_set_pchan(&l1t, tn, pchan);
+			if (active)
+				set_lchans(tn, 1);
+			run_frames(tn);
+		}
+		fprintf(stderr, "%s ts=%u %s: %.1f ns/frame\n", name, tn,
+			active ? "active" : "inactive",
+			elapsed_ns(&start) / (BENCH_ROUNDS * TEST_FRAMES));
+
+		/* deactivation must remove the handlers again */
+		if (active) {
+			set_lchans(tn, 0);
+			dl_calls = ul_calls = 0;
+			run_frames(tn);
+			printf("%s ts=%u deactivated: %u DL and %u UL bursts\n",
+				name, tn, dl_calls, ul_calls);
+		}
+		trx_sched_exit(&l1t);
+	}
+}
+
+static void test_bursts_slab(void)
+{
+	struct l1sched_ts *l1ts;
+	uint8_t *slab;
+	uint8_t tn;
+	int i;
+
+	printf("Testing burst buffers\n");
+
+	ASSERT_TRUE(trx_sched_init(&l1t, bts->c0) == 0);
+	slab = l1t.bursts_slab;
+	ASSERT_TRUE(slab && l1t.bursts_slab_size);
+
+	/* every buffer is aligned and inside the slab */
+	ASSERT_TRUE(l1sched_trx_get_ts(&l1t, 0)->dl_bursts_buf[TRXC_BCCH]);
+	ASSERT_TRUE(!l1sched_trx_get_ts(&l1t, 0)->ul_bursts_buf[TRXC_RACH]);
+	for (tn = 0; tn < TRX_NR_TS; tn++) {
+		l1ts = l1sched_trx_get_ts(&l1t, tn);
+		for (i = 0; i < _TRX_CHAN_MAX; i++) {
+			uint8_t *dl = l1ts->dl_bursts_buf[i];
+			uint8_t *ul = (uint8_t *) l1ts->ul_bursts_buf[i];
+			ASSERT_TRUE(!dl || !((size_t) dl
+					% TRX_SCHED_BURSTS_ALIGN));
+			ASSERT_TRUE(!ul || !((size_t) ul
+					% TRX_SCHED_BURSTS_ALIGN));
+			ASSERT_TRUE(!dl || (dl >= slab && dl < slab
+				+ l1t.bursts_slab_size + TRX_SCHED_BURSTS_ALIGN));
+			ASSERT_TRUE(!ul || (ul >= slab && ul < slab
+				+ l1t.bursts_slab_size + TRX_SCHED_BURSTS_ALIGN));
+		}
+	}
+
+	l1ts = l1sched_trx_get_ts(&l1t, 2);
+	l1ts->chan_state[TRXC_TCHF].dl_bursts =
+		_sched_dl_bursts(&l1t, 2, TRXC_TCHF);
+	l1ts->chan_state[TRXC_TCHF].ul_bursts =
+		_sched_ul_bursts(&l1t, 2, TRXC_TCHF);
+	printf(" %u buffers in use\n", trx_sched_bursts_in_use(&l1t));
+
+	/* a reset releases the buffers, but keeps the slab */
+	trx_sched_reset(&l1t);
+	ASSERT_TRUE(l1t.bursts_slab == slab);
+	printf(" after reset: %u buffers in use\n",
+		trx_sched_bursts_in_use(&l1t));
+
+	trx_sched_exit(&l1t);
+	ASSERT_TRUE(!l1t.bursts_slab);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_msgb_ctx;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	tall_msgb_ctx = talloc_named_const(tall_bts_ctx, 1, "msgb");
+	msgb_set_talloc_ctx(tall_msgb_ctx);
+
+	bts_log_init(NULL);
+	log_set_log_level(osmo_stderr_target, LOGL_ERROR);
+
+	bts = gsm_bts_alloc(tall_bts_ctx);
+	if (bts_init(bts) < 0) {
+		fprintf(stderr, "unable to open bts\n");
+		exit(1);
+	}
+
+	test_pchan(GSM_PCHAN_CCCH, "CCCH", 0);
+	test_pchan(GSM_PCHAN_CCCH_SDCCH4, "CCCH+SDCCH4", 0);
+	test_pchan(GSM_PCHAN_SDCCH8_SACCH8C, "SDCCH8", 1);
+	test_pchan(GSM_PCHAN_TCH_F, "TCH/F", 2);
+	test_pchan(GSM_PCHAN_TCH_H, "TCH/H", 3);
+	test_pchan(GSM_PCHAN_PDCH, "PDCH", 7);
+	test_bursts_slab();
+
+	printf("Success\n");
+
+	return 0;
+}
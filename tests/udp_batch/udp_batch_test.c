@@ -0,0 +1,296 @@
+/* testing the sendmmsg() / recvmmsg() batching of datagrams */
+
+/*
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/udp_batch.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n",  \
+		       __FILE__, __LINE__);          \
+		abort();			     \
+	}
+
+/* a TRX data burst as sent to the transceiver */
+#define BURST_LEN	154
+#define BURSTS_PER_FN	8
+#define BENCH_FRAMES	20000
+
+static int sock_tx, sock_rx;
+
+static int udp_sock(struct sockaddr_in *sin)
+{
+	socklen_t len = sizeof(*sin);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	ASSERT_TRUE(fd >= 0);
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_TRUE(bind(fd, (struct sockaddr *)sin, len) == 0);
+	ASSERT_TRUE(getsockname(fd, (struct sockaddr *)sin, &len) == 0);
+
+	return fd;
+}
+
+/* two UDP sockets on loopback, connected to each other */
+static void open_socks(void)
+{
+	struct sockaddr_in sin_tx, sin_rx;
+
+	sock_tx = udp_sock(&sin_tx);
+	sock_rx = udp_sock(&sin_rx);
+	ASSERT_TRUE(connect(sock_tx, (struct sockaddr *)&sin_rx,
+		sizeof(sin_rx)) == 0);
+	ASSERT_TRUE(connect(sock_rx, (struct sockaddr *)&sin_tx,
+		sizeof(sin_tx)) == 0);
+}
+
+static void wait_rx(void)
+{
+	struct pollfd pfd = { .fd = sock_rx, .events = POLLIN };
+
+	ASSERT_TRUE(poll(&pfd, 1, 1000) == 1);
+}
+
+static void fill_burst(uint8_t *buf, uint32_t fn, uint8_t tn)
+{
+	buf[0] = tn;
+	buf[1] = (fn >> 24) & 0xff;
+	buf[2] = (fn >> 16) & 0xff;
+	buf[3] = (fn >>  8) & 0xff;
+	buf[4] = (fn >>  0) & 0xff;
+	buf[5] = 0;
+	memset(buf + 6, (fn + tn) & 1, BURST_LEN - 6);
+}
+
+static int check_burst(const uint8_t *buf, unsigned int len, uint32_t fn,
+		       uint8_t tn)
+{
+	uint8_t ref[BURST_LEN];
+
+	fill_burst(ref, fn, tn);
+	return len == BURST_LEN && !memcmp(buf, ref, BURST_LEN);
+}
+
+static void test_tx_rx(void *ctx)
+{
+	struct udp_batch *tx, *rx;
+	unsigned int tn, len, got = 0;
+	uint8_t *buf;
+	int rc;
+
+	printf("Testing send and receive of a batch\n");
+
+	tx = udp_batch_alloc(ctx, BURSTS_PER_FN, BURST_LEN);
+	rx = udp_batch_alloc(ctx, 16, 256);
+	ASSERT_TRUE(tx && rx);
+
+	for (tn = 0; tn < BURSTS_PER_FN; tn++) {
+		buf = udp_batch_tx_buf(tx);
+		ASSERT_TRUE(buf);
+		fill_burst(buf, 1234, tn);
+		udp_batch_tx_commit(tx, BURST_LEN);
+	}
+	/* batch is full now */
+	ASSERT_TRUE(udp_batch_tx_buf(tx) == NULL);
+
+	rc = udp_batch_send(tx, sock_tx);
+	printf(" sent %d datagrams\n", rc);
+	ASSERT_TRUE(tx->num == 0);
+	ASSERT_TRUE(tx->datagrams == BURSTS_PER_FN);
+
+	while (got < BURSTS_PER_FN) {
+		wait_rx();
+		rc = udp_batch_recv(rx, sock_rx);
+		ASSERT_TRUE(rc > 0);
+		for (tn = 0; tn < rx->num; tn++) {
+			buf = udp_batch_rx_buf(rx, tn, &len);
+			ASSERT_TRUE(check_burst(buf, len, 1234, got + tn));
+		}
+		got += rx->num;
+	}
+	printf(" received %u datagrams in order\n", got);
+
+	/* nothing pending */
+	rc = udp_batch_recv(rx, sock_rx);
+	printf(" empty socket returns %d\n", rc);
+
+	talloc_free(tx);
+	talloc_free(rx);
+}
+
+/* as the L1 forwarding proxy: the sender is told where to send to, the
+ * receiver learns where the datagrams came from */
+static void test_unconnected(void *ctx)
+{
+	struct udp_batch *tx, *rx;
+	struct sockaddr_in sin_a, sin_b, *src;
+	unsigned int i, got = 0;
+	struct pollfd pfd;
+	int a, b;
+
+	printf("Testing unconnected sockets\n");
+
+	a = udp_sock(&sin_a);
+	b = udp_sock(&sin_b);
+	tx = udp_batch_alloc(ctx, 4, BURST_LEN);
+	rx = udp_batch_alloc(ctx, 4, 256);
+	ASSERT_TRUE(tx && rx);
+
+	udp_batch_set_dest(tx, (struct sockaddr *)&sin_b, sizeof(sin_b));
+	for (i = 0; i < 4; i++) {
+		fill_burst(udp_batch_tx_buf(tx), 42, i);
+		udp_batch_tx_commit(tx, BURST_LEN);
+	}
+	ASSERT_TRUE(udp_batch_send(tx, a) == 4);
+
+	while (got < 4) {
+		pfd.fd = b;
+		pfd.events = POLLIN;
+		ASSERT_TRUE(poll(&pfd, 1, 1000) == 1);
+		ASSERT_TRUE(udp_batch_recv(rx, b) > 0);
+		got += rx->num;
+	}
+	src = (struct sockaddr_in *) &rx->src;
+	ASSERT_TRUE(rx->src_len == sizeof(sin_a));
+	ASSERT_TRUE(src->sin_port == sin_a.sin_port);
+	printf(" received %u datagrams from the sender\n", got);
+
+	talloc_free(tx);
+	talloc_free(rx);
+	close(a);
+	close(b);
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+		+ (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/* one send() / recv() per burst, as the TRX data path did before */
+static void bench_single(void)
+{
+	uint8_t buf[256];
+	unsigned long calls = 0;
+	unsigned int tn, got;
+	uint32_t fn;
+	double t;
+
+	t = cpu_time();
+	for (fn = 0; fn < BENCH_FRAMES; fn++) {
+		for (tn = 0; tn < BURSTS_PER_FN; tn++) {
+			fill_burst(buf, fn, tn);
+			ASSERT_TRUE(send(sock_tx, buf, BURST_LEN, 0)
+				== BURST_LEN);
+			calls++;
+		}
+		for (got = 0; got < BURSTS_PER_FN; got++) {
+			wait_rx();
+			ASSERT_TRUE(recv(sock_rx, buf, sizeof(buf), 0)
+				== BURST_LEN);
+			calls++;
+		}
+	}
+	t = cpu_time() - t;
+
+	fprintf(stderr, "send/recv:         %u bursts, %lu syscalls, "
+		"%.3f s CPU, %.2f us/burst\n", BENCH_FRAMES * BURSTS_PER_FN,
+		calls, t, t * 1e6 / (BENCH_FRAMES * BURSTS_PER_FN));
+}
+
+/* one sendmmsg() per FN, drain with recvmmsg() */
+static void bench_batch(void *ctx)
+{
+	struct udp_batch *tx, *rx;
+	unsigned int tn, got;
+	uint32_t fn;
+	double t;
+
+	tx = udp_batch_alloc(ctx, BURSTS_PER_FN, BURST_LEN);
+	rx = udp_batch_alloc(ctx, 16, 256);
+	ASSERT_TRUE(tx && rx);
+
+	t = cpu_time();
+	for (fn = 0; fn < BENCH_FRAMES; fn++) {
+		for (tn = 0; tn < BURSTS_PER_FN; tn++) {
+			fill_burst(udp_batch_tx_buf(tx), fn, tn);
+			udp_batch_tx_commit(tx, BURST_LEN);
+		}
+		ASSERT_TRUE(udp_batch_send(tx, sock_tx) == BURSTS_PER_FN);
+		for (got = 0; got < BURSTS_PER_FN; got += rx->num) {
+			wait_rx();
+			ASSERT_TRUE(udp_batch_recv(rx, sock_rx) > 0);
+		}
+	}
+	t = cpu_time() - t;
+
+	fprintf(stderr, "sendmmsg/recvmmsg: %lu bursts, %lu syscalls, "
+		"%.3f s CPU, %.2f us/burst\n", tx->datagrams,
+		tx->syscalls + rx->syscalls, t,
+		t * 1e6 / tx->datagrams);
+
+	ASSERT_TRUE(rx->datagrams == BENCH_FRAMES * BURSTS_PER_FN);
+
+	talloc_free(tx);
+	talloc_free(rx);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 0, "udp_batch_test");
+
+	open_socks();
+
+	test_tx_rx(ctx);
+	test_unconnected(ctx);
+
+	/* the timing goes to stderr, it is not deterministic */
+	printf("Benchmarking %u frames of %u bursts\n", BENCH_FRAMES,
+		BURSTS_PER_FN);
+	bench_single();
+	bench_batch(ctx);
+
+	close(sock_tx);
+	close(sock_rx);
+
+	printf("Success\n");
+
+	return EXIT_SUCCESS;
+}